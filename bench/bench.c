@@ -0,0 +1,693 @@
+#include "bench.h"
+
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+//
+// Usage: result_bench [options]
+//
+//   --filter SUBSTR     only run benchmarks whose name contains SUBSTR
+//   --min-time MS       target duration of a single measurement (default 50)
+//   --json FILE         write the results as JSON to FILE
+//   --baseline FILE     compare against a JSON file written by --json
+//   --threshold PCT     allowed regression against the baseline (default 5,
+//                       inf to only compare)
+//   --geomean-threshold PCT
+//                       check the geometric mean of each group below against
+//                       PCT instead of each benchmark against --threshold
+//   --list              only print benchmark names
+//
+// The exit status is 1 if any benchmark (or group, with --geomean-threshold)
+// regressed past the threshold.
+//
+// With a baseline, the run ends with the geometric mean speedup in time for
+// each error rate, so eg. a profile-guided build trained on one mix of ok and
+// err can be checked against the others:
+//
+//   speedup against baseline.json:
+//     err=0%        1.247x   over 102 benchmarks
+//     err=1%        1.270x   over 102 benchmarks
+//     err=50%       1.199x   over 102 benchmarks
+//     other         1.145x   over 42 benchmarks
+//
+// The JSON file has one result per line so it's easy to diff and to parse
+// without a JSON library:
+//
+//   {"results": [
+//   {"name": "layout/result_t/8B/err=1%", "ns_per_op": 1.25, "insns_per_op": 14.0, "branch_misses_per_op": 0.01},
+//   ...
+//   ]}
+//
+// Counters that aren't available are written as null.
+//
+
+#define BENCH_REPEATS 5
+#define BENCH_MAX_RESULTS 4096
+#define BENCH_NAME_MAX 128
+
+struct bench_result_s {
+  char name[BENCH_NAME_MAX];
+  double ns_per_op;
+  double insns_per_op;
+  double branch_misses_per_op;
+};
+
+struct bench_s {
+  const char *filter;
+  uint64_t min_time_ns;
+  bool list_only;
+
+  int perf_fd;
+  int perf_branch_misses_fd;
+
+  struct bench_result_s *results;
+  size_t results_len;
+
+  struct bench_result_s *baseline;
+  size_t baseline_len;
+};
+
+struct bench_suite_s {
+  const char *name;
+  void (*run)(struct bench_s *bench);
+};
+
+static const struct bench_suite_s bench_suites[] = {
+  { "layout", bench_layout },
+  { "try", bench_try },
+  { "simd", bench_simd },
+  { "ctx", bench_ctx },
+  { "future", bench_future },
+  { "queue", bench_queue },
+  { "par", bench_par },
+  { "memo", bench_memo },
+  { "file", bench_file },
+  { "io", bench_io },
+  { "hpp", bench_hpp },
+  { "declare", bench_declare },
+  { "ref", bench_ref },
+  { "owned", bench_owned },
+  { "iter", bench_iter },
+  { "parse", bench_parse },
+};
+
+const unsigned bench_error_rates[3] = { 0, 1, 50 };
+
+/*sublime-c-static-fn-hoist-start*/
+static uint64_t now_ns(void);
+static void perf_open(struct bench_s *bench);
+static void perf_start(struct bench_s *bench);
+static bool perf_stop(struct bench_s *bench, uint64_t *insns, uint64_t *branch_misses);
+static void measure(struct bench_s *bench, bench_fn_t fn, void *arg, struct bench_result_s *out);
+static void print_result(const struct bench_s *bench, const struct bench_result_s *result);
+static const struct bench_result_s *find_baseline(const struct bench_s *bench, const char *name);
+static bool load_baseline(struct bench_s *bench, const char *path);
+static bool write_json(const struct bench_s *bench, const char *path);
+static void write_json_number(FILE *file, double value);
+static int compare_u64(const void *a, const void *b);
+static size_t count_regressions(const struct bench_s *bench, double threshold);
+static double print_speedups(const struct bench_s *bench, const char *baseline_path);
+static void usage(const char *argv0);
+/*sublime-c-static-fn-hoist-end*/
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static void perf_open(struct bench_s *bench) {
+  struct perf_event_attr attr = {
+    .size = sizeof(attr),
+    .type = PERF_TYPE_HARDWARE,
+    .config = PERF_COUNT_HW_INSTRUCTIONS,
+    .disabled = 1,
+    .exclude_kernel = 1,
+    .exclude_hv = 1,
+    .read_format = PERF_FORMAT_GROUP,
+  };
+
+  bench->perf_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  bench->perf_branch_misses_fd = -1;
+
+  if (bench->perf_fd < 0) {
+    fprintf(
+      stderr,
+      "perf_event_open: %s, instruction and branch miss counts disabled\n",
+      strerror(errno)
+    );
+
+    return;
+  }
+
+  attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+  attr.disabled = 0;
+
+  bench->perf_branch_misses_fd = syscall(
+    SYS_perf_event_open, &attr, 0, -1, bench->perf_fd, 0
+  );
+
+  if (bench->perf_branch_misses_fd < 0) {
+    close(bench->perf_fd);
+    bench->perf_fd = -1;
+  }
+}
+
+static void perf_start(struct bench_s *bench) {
+  if (bench->perf_fd < 0) {
+    return;
+  }
+
+  ioctl(bench->perf_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(bench->perf_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+static bool perf_stop(
+  struct bench_s *bench,
+  uint64_t *insns,
+  uint64_t *branch_misses
+) {
+  if (bench->perf_fd < 0) {
+    return false;
+  }
+
+  ioctl(bench->perf_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+  // PERF_FORMAT_GROUP: { nr, values[nr] }
+  uint64_t values[3];
+
+  if (read(bench->perf_fd, values, sizeof(values)) != sizeof(values)) {
+    return false;
+  }
+
+  *insns = values[1];
+  *branch_misses = values[2];
+  return true;
+}
+
+static void measure(
+  struct bench_s *bench,
+  bench_fn_t fn,
+  void *arg,
+  struct bench_result_s *out
+) {
+  uint64_t iterations = 64;
+  uint64_t checksum = 0;
+
+  // calibrate
+  for (;;) {
+    uint64_t start = now_ns();
+    checksum += fn(arg, iterations);
+    uint64_t elapsed = now_ns() - start;
+
+    if (elapsed >= bench->min_time_ns / 4 || iterations >= (1ull << 40)) {
+      if (elapsed > 0) {
+        iterations = w_max_2(
+          iterations,
+          (uint64_t) ((double) iterations * bench->min_time_ns / elapsed)
+        );
+      }
+
+      break;
+    }
+
+    iterations *= 4;
+  }
+
+  out->ns_per_op = INFINITY;
+  out->insns_per_op = NAN;
+  out->branch_misses_per_op = NAN;
+
+  for (int i = 0; i < BENCH_REPEATS; i++) {
+    uint64_t insns = 0;
+    uint64_t branch_misses = 0;
+
+    perf_start(bench);
+    uint64_t start = now_ns();
+    checksum += fn(arg, iterations);
+    uint64_t elapsed = now_ns() - start;
+    bool have_counters = perf_stop(bench, &insns, &branch_misses);
+
+    double ns_per_op = (double) elapsed / iterations;
+
+    if (ns_per_op < out->ns_per_op) {
+      out->ns_per_op = ns_per_op;
+
+      if (have_counters) {
+        out->insns_per_op = (double) insns / iterations;
+        out->branch_misses_per_op = (double) branch_misses / iterations;
+      }
+    }
+  }
+
+  bench_escape(&checksum);
+}
+
+static void print_result(
+  const struct bench_s *bench,
+  const struct bench_result_s *result
+) {
+  printf(
+    "%-56s %10.3f ns/op %10.2f insns/op %8.4f br-miss/op",
+    result->name,
+    result->ns_per_op,
+    result->insns_per_op,
+    result->branch_misses_per_op
+  );
+
+  const struct bench_result_s *base = find_baseline(bench, result->name);
+
+  if (base) {
+    printf(
+      "   time %+6.1f%%",
+      100.0 * (result->ns_per_op - base->ns_per_op) / base->ns_per_op
+    );
+
+    if (!isnan(result->insns_per_op) && !isnan(base->insns_per_op)) {
+      printf(
+        "   insns %+6.1f%%",
+        100.0 * (result->insns_per_op - base->insns_per_op) / base->insns_per_op
+      );
+    }
+  }
+
+  printf("\n");
+  fflush(stdout);
+}
+
+void bench_run(
+  struct bench_s *bench,
+  const char *name,
+  bench_fn_t fn,
+  void *arg
+) {
+  if (bench->filter && !strstr(name, bench->filter)) {
+    return;
+  }
+
+  if (bench->list_only) {
+    printf("%s\n", name);
+    return;
+  }
+
+  if (bench->results_len >= BENCH_MAX_RESULTS) {
+    fprintf(stderr, "too many benchmarks, skipping %s\n", name);
+    return;
+  }
+
+  struct bench_result_s *result = &bench->results[bench->results_len++];
+  snprintf(result->name, sizeof(result->name), "%s", name);
+
+  measure(bench, fn, arg, result);
+  print_result(bench, result);
+}
+
+void bench_runf(
+  struct bench_s *bench,
+  bench_fn_t fn,
+  void *arg,
+  const char *format,
+  ...
+) {
+  char name[BENCH_NAME_MAX];
+  va_list args;
+
+  va_start(args, format);
+  vsnprintf(name, sizeof(name), format, args);
+  va_end(args);
+
+  bench_run(bench, name, fn, arg);
+}
+
+void bench_fill_pattern(uint8_t *pattern, size_t len, unsigned percent) {
+  uint64_t state = 0x9e3779b97f4a7c15u;
+
+  for (size_t i = 0; i < len; i++) {
+    // xorshift64
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    pattern[i] = (state % 100) < percent;
+  }
+}
+
+static int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *) a;
+  uint64_t y = *(const uint64_t *) b;
+
+  return (x > y) - (x < y);
+}
+
+void bench_report_latency(
+  struct bench_s *bench,
+  const char *name,
+  uint64_t *samples,
+  size_t len
+) {
+  if (bench->list_only || len == 0) {
+    return;
+  }
+
+  if (bench->filter && !strstr(name, bench->filter)) {
+    return;
+  }
+
+  qsort(samples, len, sizeof(*samples), compare_u64);
+
+  printf(
+    "%-56s p50 %8" PRIu64 " ns   p99 %8" PRIu64 " ns"
+    "   max %8" PRIu64 " ns\n",
+    name,
+    samples[len / 2],
+    samples[len * 99 / 100],
+    samples[len - 1]
+  );
+
+  fflush(stdout);
+}
+
+void bench_report_value(
+  struct bench_s *bench,
+  const char *name,
+  double value,
+  const char *unit
+) {
+  if (bench->list_only) {
+    return;
+  }
+
+  if (bench->filter && !strstr(name, bench->filter)) {
+    return;
+  }
+
+  printf("%-56s %10.3f %s\n", name, value, unit);
+  fflush(stdout);
+}
+
+static const struct bench_result_s *find_baseline(
+  const struct bench_s *bench,
+  const char *name
+) {
+  for (size_t i = 0; i < bench->baseline_len; i++) {
+    if (strcmp(bench->baseline[i].name, name) == 0) {
+      return &bench->baseline[i];
+    }
+  }
+
+  return NULL;
+}
+
+static bool load_baseline(struct bench_s *bench, const char *path) {
+  FILE *file = fopen(path, "r");
+
+  if (!file) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return false;
+  }
+
+  char line[512];
+
+  while (
+    fgets(line, sizeof(line), file)
+    && bench->baseline_len < BENCH_MAX_RESULTS
+  ) {
+    const char *name = strstr(line, "\"name\": \"");
+    const char *ns = strstr(line, "\"ns_per_op\": ");
+    const char *insns = strstr(line, "\"insns_per_op\": ");
+
+    if (!name || !ns) {
+      continue;
+    }
+
+    struct bench_result_s *base = &bench->baseline[bench->baseline_len++];
+
+    name += strlen("\"name\": \"");
+    size_t name_len = strcspn(name, "\"");
+    name_len = w_min_2(name_len, sizeof(base->name) - 1);
+    memcpy(base->name, name, name_len);
+    base->name[name_len] = '\0';
+
+    base->ns_per_op = strtod(ns + strlen("\"ns_per_op\": "), NULL);
+    base->insns_per_op = NAN;
+    base->branch_misses_per_op = NAN;
+
+    if (insns && strncmp(insns + strlen("\"insns_per_op\": "), "null", 4)) {
+      base->insns_per_op = strtod(insns + strlen("\"insns_per_op\": "), NULL);
+    }
+  }
+
+  fclose(file);
+  return true;
+}
+
+static void write_json_number(FILE *file, double value) {
+  if (isnan(value) || isinf(value)) {
+    fprintf(file, "null");
+  }
+
+  else {
+    fprintf(file, "%.6g", value);
+  }
+}
+
+static bool write_json(const struct bench_s *bench, const char *path) {
+  FILE *file = fopen(path, "w");
+
+  if (!file) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return false;
+  }
+
+  fprintf(file, "{\"results\": [\n");
+
+  for (size_t i = 0; i < bench->results_len; i++) {
+    const struct bench_result_s *result = &bench->results[i];
+
+    fprintf(file, "{\"name\": \"%s\", \"ns_per_op\": ", result->name);
+    write_json_number(file, result->ns_per_op);
+    fprintf(file, ", \"insns_per_op\": ");
+    write_json_number(file, result->insns_per_op);
+    fprintf(file, ", \"branch_misses_per_op\": ");
+    write_json_number(file, result->branch_misses_per_op);
+    fprintf(file, "}%s\n", i + 1 < bench->results_len ? "," : "");
+  }
+
+  fprintf(file, "]}\n");
+  return fclose(file) == 0;
+}
+
+// Instruction counts are stable from run to run so they are the primary
+// signal. Time is only used when the counters aren't available.
+static size_t count_regressions(const struct bench_s *bench, double threshold) {
+  size_t regressions = 0;
+
+  for (size_t i = 0; i < bench->results_len; i++) {
+    const struct bench_result_s *result = &bench->results[i];
+    const struct bench_result_s *base = find_baseline(bench, result->name);
+
+    if (!base) {
+      continue;
+    }
+
+    bool have_insns = !isnan(result->insns_per_op)
+      && !isnan(base->insns_per_op);
+
+    double now = have_insns ? result->insns_per_op : result->ns_per_op;
+    double then = have_insns ? base->insns_per_op : base->ns_per_op;
+
+    if (now > then * (1.0 + threshold / 100.0)) {
+      fprintf(
+        stderr,
+        "REGRESSION %s: %s %.3f -> %.3f\n",
+        result->name,
+        have_insns ? "insns/op" : "ns/op",
+        then,
+        now
+      );
+
+      regressions++;
+    }
+  }
+
+  return regressions;
+}
+
+// Benchmarks are grouped by the "err=N%" in their name, the rest go under
+// "other". Time rather than instructions, since layout changes like the ones
+// profile-guided optimization makes often don't change the count. Returns the
+// lowest speedup of all groups.
+static double print_speedups(
+  const struct bench_s *bench,
+  const char *baseline_path
+) {
+  enum { groups = w_array_size(bench_error_rates) + 1 };
+  double log_sums[groups] = { 0 };
+  size_t counts[groups] = { 0 };
+  double lowest = INFINITY;
+
+  for (size_t i = 0; i < bench->results_len; i++) {
+    const struct bench_result_s *result = &bench->results[i];
+    const struct bench_result_s *base = find_baseline(bench, result->name);
+
+    if (!base || !(result->ns_per_op > 0) || !(base->ns_per_op > 0)) {
+      continue;
+    }
+
+    size_t group = groups - 1;
+    const char *err = strstr(result->name, "err=");
+
+    for (size_t r = 0; err && r < w_array_size(bench_error_rates); r++) {
+      char label[16];
+      snprintf(label, sizeof(label), "err=%u%%", bench_error_rates[r]);
+
+      if (strncmp(err, label, strlen(label)) == 0) {
+        group = r;
+        break;
+      }
+    }
+
+    log_sums[group] += log(base->ns_per_op / result->ns_per_op);
+    counts[group]++;
+  }
+
+  printf("\nspeedup against %s:\n", baseline_path);
+
+  for (size_t g = 0; g < groups; g++) {
+    char label[16];
+
+    if (counts[g] == 0) {
+      continue;
+    }
+
+    if (g < w_array_size(bench_error_rates)) {
+      snprintf(label, sizeof(label), "err=%u%%", bench_error_rates[g]);
+    } else {
+      snprintf(label, sizeof(label), "other");
+    }
+
+    double speedup = exp(log_sums[g] / (double) counts[g]);
+
+    lowest = w_min_2(lowest, speedup);
+    printf("  %-10s %8.3fx   over %zu benchmarks\n", label, speedup, counts[g]);
+  }
+
+  fflush(stdout);
+  return lowest;
+}
+
+static void usage(const char *argv0) {
+  fprintf(
+    stderr,
+    "usage: %s [--filter SUBSTR] [--min-time MS] [--json FILE]"
+    " [--baseline FILE] [--threshold PCT] [--geomean-threshold PCT]"
+    " [--list]\n",
+    argv0
+  );
+}
+
+int main(int argc, char **argv) {
+  struct bench_s bench = {
+    .min_time_ns = 50 * 1000000ull,
+    .perf_fd = -1,
+    .perf_branch_misses_fd = -1,
+  };
+
+  const char *json_path = NULL;
+  const char *baseline_path = NULL;
+  double threshold = 5.0;
+  double geomean_threshold = NAN;
+
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+
+    if (strcmp(argv[i], "--filter") == 0 && has_value) {
+      bench.filter = argv[++i];
+    }
+
+    else if (strcmp(argv[i], "--min-time") == 0 && has_value) {
+      bench.min_time_ns = strtoull(argv[++i], NULL, 10) * 1000000ull;
+    }
+
+    else if (strcmp(argv[i], "--json") == 0 && has_value) {
+      json_path = argv[++i];
+    }
+
+    else if (strcmp(argv[i], "--baseline") == 0 && has_value) {
+      baseline_path = argv[++i];
+    }
+
+    else if (strcmp(argv[i], "--threshold") == 0 && has_value) {
+      threshold = strtod(argv[++i], NULL);
+    }
+
+    else if (strcmp(argv[i], "--geomean-threshold") == 0 && has_value) {
+      geomean_threshold = strtod(argv[++i], NULL);
+    }
+
+    else if (strcmp(argv[i], "--list") == 0) {
+      bench.list_only = true;
+    }
+
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  bench.results = calloc(BENCH_MAX_RESULTS, sizeof(*bench.results));
+  bench.baseline = calloc(BENCH_MAX_RESULTS, sizeof(*bench.baseline));
+
+  if (!bench.results || !bench.baseline) {
+    fprintf(stderr, "out of memory\n");
+    return 2;
+  }
+
+  if (baseline_path && !load_baseline(&bench, baseline_path)) {
+    return 2;
+  }
+
+  if (!bench.list_only) {
+    perf_open(&bench);
+  }
+
+  for (size_t i = 0; i < w_array_size(bench_suites); i++) {
+    bench_suites[i].run(&bench);
+  }
+
+  int status = 0;
+
+  if (json_path && !write_json(&bench, json_path)) {
+    status = 2;
+  }
+
+  double lowest_speedup = INFINITY;
+
+  if (baseline_path && !bench.list_only) {
+    lowest_speedup = print_speedups(&bench, baseline_path);
+  }
+
+  if (baseline_path && !isnan(geomean_threshold)) {
+    if (lowest_speedup < 1.0 / (1.0 + geomean_threshold / 100.0)) {
+      fprintf(stderr, "REGRESSION geometric mean: %.3fx\n", lowest_speedup);
+      status = w_max_2(status, 1);
+    }
+  }
+
+  else if (baseline_path && count_regressions(&bench, threshold) > 0) {
+    status = w_max_2(status, 1);
+  }
+
+  if (bench.perf_fd >= 0) {
+    close(bench.perf_branch_misses_fd);
+    close(bench.perf_fd);
+  }
+
+  free(bench.results);
+  free(bench.baseline);
+  return status;
+}
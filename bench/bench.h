@@ -0,0 +1,99 @@
+#ifndef __bench_h__
+#define __bench_h__
+
+#include "core/defs.h"
+
+//
+// Tiny benchmark harness shared by the result_bench suites.
+//
+// A benchmark is a function that performs `iterations` operations and returns
+// a checksum so the compiler can't throw the work away. The harness picks an
+// iteration count that runs for roughly --min-time, repeats the measurement a
+// few times and keeps the fastest run. When perf_event_open(2) is available it
+// also reports retired instructions and branch misses per operation.
+//
+// Every suite registers its benchmarks with bench_run() and is listed in the
+// suite table in bench.c.
+//
+
+typedef uint64_t (*bench_fn_t)(void *arg, uint64_t iterations);
+
+struct bench_s;
+
+extern void bench_run(
+  struct bench_s *bench,
+  const char *name,
+  bench_fn_t fn,
+  void *arg
+);
+
+// Same as bench_run() but `name` is a printf-style format.
+extern void bench_runf(
+  struct bench_s *bench,
+  bench_fn_t fn,
+  void *arg,
+  const char *format,
+  ...
+) __attribute__((format(printf, 4, 5)));
+
+// Fills `pattern` with ones at roughly `percent` percent of the positions,
+// deterministically. Used to drive error rates.
+extern void bench_fill_pattern(uint8_t *pattern, size_t len, unsigned percent);
+
+// Prints the median, 99th percentile and maximum of `samples` (nanoseconds),
+// for suites that measure latency on top of throughput. Sorts `samples`. Not
+// part of the JSON output or the baseline comparison.
+extern void bench_report_latency(
+  struct bench_s *bench,
+  const char *name,
+  uint64_t *samples,
+  size_t len
+);
+
+// Prints `value` in `unit` for benchmark `name`, for suites that count
+// something other than time, eg. syscalls per operation. Not part of the JSON
+// output or the baseline comparison either.
+extern void bench_report_value(
+  struct bench_s *bench,
+  const char *name,
+  double value,
+  const char *unit
+);
+
+// Error rates every suite should cover.
+extern const unsigned bench_error_rates[3];
+
+// Keep the compiler from optimizing away values or caching memory contents.
+#define bench_escape(_ptr) __asm__ volatile("" : : "r"(_ptr) : "memory")
+#define bench_clobber() __asm__ volatile("" : : : "memory")
+
+// Stop the compiler from inlining or specializing a function so that calls
+// actually go through the ABI, which is what we want to measure.
+#if defined(__clang__)
+  #define bench_noinline __attribute__((noinline))
+#else
+  #define bench_noinline __attribute__((noipa))
+#endif
+
+//
+// Suites
+//
+
+extern void bench_layout(struct bench_s *bench);
+extern void bench_try(struct bench_s *bench);
+extern void bench_simd(struct bench_s *bench);
+extern void bench_ctx(struct bench_s *bench);
+extern void bench_future(struct bench_s *bench);
+extern void bench_queue(struct bench_s *bench);
+extern void bench_par(struct bench_s *bench);
+extern void bench_memo(struct bench_s *bench);
+extern void bench_file(struct bench_s *bench);
+extern void bench_io(struct bench_s *bench);
+extern void bench_hpp(struct bench_s *bench);
+extern void bench_declare(struct bench_s *bench);
+extern void bench_ref(struct bench_s *bench);
+extern void bench_owned(struct bench_s *bench);
+extern void bench_iter(struct bench_s *bench);
+extern void bench_parse(struct bench_s *bench);
+
+#endif // __bench_h__
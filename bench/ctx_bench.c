@@ -0,0 +1,157 @@
+#include "bench.h"
+#include "result_ctx.h"
+
+#include <inttypes.h>
+
+//
+// An error path that wants a message with context, where most errors are
+// retried or dropped and only every RENDER_EVERY'th one is actually printed:
+//
+//   - code: just an int, the floor
+//   - malloc: asprintf-style malloc + snprintf up front, free when dropped
+//   - result_ctx: capture into the per-thread arena, render on demand and reset
+//     the arena every REQUEST_LEN operations
+//
+
+#define PATTERN_LEN 4096
+#define PATTERN_MASK (PATTERN_LEN - 1)
+#define RENDER_EVERY 64
+#define REQUEST_LEN 256
+#define MESSAGE_FORMAT "read %s at offset %" PRIu64 ": error %d"
+
+typedef result_t(uint64_t, int) result_code_t;
+typedef result_t(uint64_t, char *) result_malloc_t;
+typedef result_t(uint64_t, struct result_ctx_s) result_with_ctx_t;
+
+static const char *path = "/var/lib/service/data.bin";
+
+static bench_noinline result_code_t read_code(uint64_t i, const uint8_t *fail) {
+  if (fail[i & PATTERN_MASK]) {
+    return (result_code_t) result_init_err((int) (i & 0xff));
+  }
+
+  return (result_code_t) result_init_ok(i);
+}
+
+static bench_noinline result_malloc_t read_malloc(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  if (fail[i & PATTERN_MASK]) {
+    int err = (int) (i & 0xff);
+    int len = snprintf(NULL, 0, MESSAGE_FORMAT, path, i, err);
+    char *message = malloc((size_t) len + 1);
+
+    snprintf(message, (size_t) len + 1, MESSAGE_FORMAT, path, i, err);
+    return (result_malloc_t) result_init_err(message);
+  }
+
+  return (result_malloc_t) result_init_ok(i);
+}
+
+static bench_noinline result_with_ctx_t read_ctx(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  if (fail[i & PATTERN_MASK]) {
+    int err = (int) (i & 0xff);
+
+    return (result_with_ctx_t) result_init_err(
+      result_ctx(err, MESSAGE_FORMAT, path, i, err)
+    );
+  }
+
+  return (result_with_ctx_t) result_init_ok(i);
+}
+
+static uint64_t bench_code(void *arg, uint64_t iterations) {
+  const uint8_t *fail = arg;
+  char message[128];
+  uint64_t sum = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    result_code_t res = read_code(i, fail);
+
+    {result_with_err(res, err) {
+      if (i % RENDER_EVERY == 0) {
+        sum += (uint64_t) snprintf(message, sizeof(message), "error %d", err);
+        bench_escape(message);
+      }
+    }
+
+    else {
+      sum += result_unwrap_unchecked(res);
+    }}
+  }
+
+  return sum;
+}
+
+static uint64_t bench_malloc(void *arg, uint64_t iterations) {
+  const uint8_t *fail = arg;
+  uint64_t sum = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    result_malloc_t res = read_malloc(i, fail);
+
+    {result_with_err(res, message) {
+      if (i % RENDER_EVERY == 0) {
+        sum += strlen(message);
+        bench_escape(message);
+      }
+
+      free(message);
+    }
+
+    else {
+      sum += result_unwrap_unchecked(res);
+    }}
+  }
+
+  return sum;
+}
+
+static uint64_t bench_result_ctx(void *arg, uint64_t iterations) {
+  const uint8_t *fail = arg;
+  char message[128];
+  uint64_t sum = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    result_with_ctx_t res = read_ctx(i, fail);
+
+    {result_with_err(res, ctx) {
+      if (i % RENDER_EVERY == 0) {
+        sum += result_ctx_render(ctx, message, sizeof(message));
+        bench_escape(message);
+      }
+    }
+
+    else {
+      sum += result_unwrap_unchecked(res);
+    }}
+
+    if (i % REQUEST_LEN == REQUEST_LEN - 1) {
+      result_ctx_reset();
+    }
+  }
+
+  result_ctx_reset();
+  return sum;
+}
+
+void bench_ctx(struct bench_s *bench) {
+  static uint8_t patterns[w_array_size(bench_error_rates)][PATTERN_LEN];
+
+  for (size_t r = 0; r < w_array_size(bench_error_rates); r++) {
+    unsigned rate = bench_error_rates[r];
+
+    bench_fill_pattern(patterns[r], PATTERN_LEN, rate);
+
+    bench_runf(bench, bench_code, patterns[r], "ctx/code/err=%u%%", rate);
+    bench_runf(bench, bench_malloc, patterns[r], "ctx/malloc/err=%u%%", rate);
+
+    bench_runf(
+      bench, bench_result_ctx, patterns[r], "ctx/result_ctx/err=%u%%", rate
+    );
+  }
+}
@@ -0,0 +1,188 @@
+#include "bench.h"
+#include "result_declare.h"
+
+//
+// The RESULT_DECLARE functions versus the result.h macros doing the same
+// thing, one operation is one element:
+//
+//   - pipeline: and_then, map and unwrap_or on a result_t(uint64_t, int),
+//     with result_and and result_ok for the macros
+//   - unwrap: unwrap_or_default on a result of a 256 byte struct, against
+//     result_unwrap_or_else without a block
+//
+// Each flavour is one noinline function, so for code size compare
+//
+//   nm --size-sort result_bench | grep declare_
+//
+
+#define PATTERN_LEN 4096
+#define PATTERN_MASK (PATTERN_LEN - 1)
+#define BIG_LEN 1024
+#define BIG_MASK (BIG_LEN - 1)
+
+struct big_s {
+  uint64_t words[32];
+};
+
+RESULT_DECLARE(result_u64, uint64_t, int)
+RESULT_DECLARE(result_big, struct big_s, int)
+
+/*sublime-c-static-fn-hoist-start*/
+static result_u64_t leaf(uint64_t i, const uint8_t *fail);
+static result_u64_t step(uint64_t value);
+static uint64_t triple(uint64_t value);
+static uint64_t declare_pipeline_macro(uint64_t i, const uint8_t *fail);
+static uint64_t declare_pipeline_fn(uint64_t i, const uint8_t *fail);
+static uint64_t declare_unwrap_macro(const result_big_t *res);
+static uint64_t declare_unwrap_fn(const result_big_t *res);
+static uint64_t bench_pipeline_macro(void *arg, uint64_t iterations);
+static uint64_t bench_pipeline_fn(void *arg, uint64_t iterations);
+static uint64_t bench_unwrap_macro(void *arg, uint64_t iterations);
+static uint64_t bench_unwrap_fn(void *arg, uint64_t iterations);
+/*sublime-c-static-fn-hoist-end*/
+
+static inline result_u64_t leaf(uint64_t i, const uint8_t *fail) {
+  if (fail[i & PATTERN_MASK]) {
+    return result_u64_err((int) (i & 0xff));
+  }
+
+  return result_u64_ok(i);
+}
+
+static inline result_u64_t step(uint64_t value) {
+  if (value == UINT64_MAX) {
+    return result_u64_err(-1);
+  }
+
+  return result_u64_ok(value + 1);
+}
+
+static inline uint64_t triple(uint64_t value) {
+  return value * 3;
+}
+
+static bench_noinline uint64_t declare_pipeline_macro(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  result_u64_t res = leaf(i, fail);
+
+  res = result_and(res, step(result_unwrap_unchecked(res)));
+
+  res = result_is_ok(res)
+    ? result_ok(res, triple(result_unwrap_unchecked(res)))
+    : res;
+
+  return result_unwrap_or(res, 1);
+}
+
+static bench_noinline uint64_t declare_pipeline_fn(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  result_u64_t res = leaf(i, fail);
+
+  res = result_u64_and_then(res, step);
+  res = result_u64_map(res, triple);
+
+  return result_u64_unwrap_or(res, 1);
+}
+
+static bench_noinline uint64_t declare_unwrap_macro(const result_big_t *res) {
+  struct big_s value = result_unwrap_or_else(*res);
+
+  return value.words[0] + value.words[31];
+}
+
+static bench_noinline uint64_t declare_unwrap_fn(const result_big_t *res) {
+  struct big_s value = result_big_unwrap_or_default(*res);
+
+  return value.words[0] + value.words[31];
+}
+
+static uint64_t bench_pipeline_macro(void *arg, uint64_t iterations) {
+  uint64_t total = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    total += declare_pipeline_macro(i, arg);
+  }
+
+  return total;
+}
+
+static uint64_t bench_pipeline_fn(void *arg, uint64_t iterations) {
+  uint64_t total = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    total += declare_pipeline_fn(i, arg);
+  }
+
+  return total;
+}
+
+static uint64_t bench_unwrap_macro(void *arg, uint64_t iterations) {
+  const result_big_t *results = arg;
+  uint64_t total = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    total += declare_unwrap_macro(&results[i & BIG_MASK]);
+  }
+
+  return total;
+}
+
+static uint64_t bench_unwrap_fn(void *arg, uint64_t iterations) {
+  const result_big_t *results = arg;
+  uint64_t total = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    total += declare_unwrap_fn(&results[i & BIG_MASK]);
+  }
+
+  return total;
+}
+
+void bench_declare(struct bench_s *bench) {
+  static uint8_t patterns[w_array_size(bench_error_rates)][PATTERN_LEN];
+  result_big_t *results = malloc(BIG_LEN * sizeof(*results));
+
+  for (size_t r = 0; r < w_array_size(bench_error_rates); r++) {
+    unsigned rate = bench_error_rates[r];
+    uint8_t *pattern = patterns[r];
+
+    bench_fill_pattern(pattern, PATTERN_LEN, rate);
+
+    for (size_t i = 0; i < BIG_LEN; i++) {
+      if (pattern[i]) {
+        results[i] = result_big_err((int) i);
+      } else {
+        struct big_s big;
+
+        for (size_t w = 0; w < w_array_size(big.words); w++) {
+          big.words[w] = i + w;
+        }
+
+        results[i] = result_big_ok(big);
+      }
+    }
+
+    bench_runf(
+      bench, bench_pipeline_macro, pattern, "declare/pipeline/macro/err=%u%%",
+      rate
+    );
+
+    bench_runf(
+      bench, bench_pipeline_fn, pattern, "declare/pipeline/fn/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_unwrap_macro, results, "declare/unwrap/macro/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_unwrap_fn, results, "declare/unwrap/fn/err=%u%%", rate
+    );
+  }
+
+  free(results);
+}
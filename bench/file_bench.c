@@ -0,0 +1,157 @@
+#include "bench.h"
+#include "result_file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+//
+// Reading a file of LEN results back and summing them, one operation is one
+// result:
+//
+//   - read: read(2) into a malloc'd array, the way ad-hoc structs get loaded
+//   - mapped: result_file_open and a pass over the mapping
+//   - next_err: result_file_next_err over the bitmap, without touching the
+//     elements
+//
+// The file stays in the page cache between runs, so this is the cost of the
+// page faults (or the copy), not of the disk.
+//
+
+#define LEN (1 << 22)
+#define PATH "/tmp/result_file_bench.res"
+
+typedef result_padded_t(uint64_t, int32_t) result_u64_t;
+
+/*sublime-c-static-fn-hoist-start*/
+static struct result_file_layout_s layout(void);
+static uint64_t sum(const result_u64_t *results, size_t n);
+static uint64_t bench_read(void *arg, uint64_t iterations);
+static uint64_t bench_mapped(void *arg, uint64_t iterations);
+static uint64_t bench_next_err(void *arg, uint64_t iterations);
+/*sublime-c-static-fn-hoist-end*/
+
+static struct result_file_layout_s layout(void) {
+  return result_file_layout(result_u64_t, 1, 2);
+}
+
+static uint64_t sum(const result_u64_t *results, size_t n) {
+  uint64_t total = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    total += result_unwrap_or(results[i], 1);
+  }
+
+  return total;
+}
+
+static uint64_t bench_read(void *arg, uint64_t iterations) {
+  result_u64_t *results = malloc(LEN * sizeof(*results));
+  uint64_t total = 0;
+
+  (void) arg;
+
+  for (uint64_t done = 0; done < iterations; done += LEN) {
+    size_t n = (size_t) w_min_2((uint64_t) LEN, iterations - done);
+    int fd = open(PATH, O_RDONLY);
+    size_t size = n * sizeof(*results);
+    size_t got = 0;
+
+    lseek(fd, RESULT_FILE_HEADER_SIZE, SEEK_SET);
+
+    while (got < size) {
+      ssize_t chunk = read(fd, (char *) results + got, size - got);
+
+      if (chunk <= 0) {
+        break;
+      }
+
+      got += (size_t) chunk;
+    }
+
+    close(fd);
+    total += sum(results, n);
+  }
+
+  free(results);
+  return total;
+}
+
+static uint64_t bench_mapped(void *arg, uint64_t iterations) {
+  const struct result_file_layout_s file_layout = layout();
+  uint64_t total = 0;
+
+  (void) arg;
+
+  for (uint64_t done = 0; done < iterations; done += LEN) {
+    struct result_file_s file;
+
+    result_file_open(&file, PATH, &file_layout);
+
+    size_t n = (size_t) w_min_2((uint64_t) LEN, iterations - done);
+    total += sum(result_file_data(&file, result_u64_t), n);
+
+    result_file_unmap(&file);
+  }
+
+  return total;
+}
+
+static uint64_t bench_next_err(void *arg, uint64_t iterations) {
+  const struct result_file_layout_s file_layout = layout();
+  uint64_t total = 0;
+
+  (void) arg;
+
+  for (uint64_t done = 0; done < iterations; done += LEN) {
+    struct result_file_s file;
+
+    result_file_open(&file, PATH, &file_layout);
+
+    size_t n = (size_t) w_min_2((uint64_t) LEN, iterations - done);
+
+    for (
+      size_t i = result_file_next_err(&file, 0);
+      i < n;
+      i = result_file_next_err(&file, i + 1)
+    ) {
+      total += i;
+    }
+
+    result_file_unmap(&file);
+  }
+
+  return total;
+}
+
+void bench_file(struct bench_s *bench) {
+  const struct result_file_layout_s file_layout = layout();
+  result_u64_t *results = malloc(LEN * sizeof(*results));
+  uint8_t *pattern = malloc(LEN);
+
+  for (size_t r = 0; r < w_array_size(bench_error_rates); r++) {
+    unsigned rate = bench_error_rates[r];
+    struct result_file_writer_s *writer;
+
+    bench_fill_pattern(pattern, LEN, rate);
+
+    for (size_t i = 0; i < LEN; i++) {
+      if (pattern[i]) {
+        results[i] = (result_u64_t) result_init_err(-1);
+      } else {
+        results[i] = (result_u64_t) result_init_ok(i);
+      }
+    }
+
+    result_file_create(&writer, PATH, &file_layout, RESULT_FILE_OK_BITMAP);
+    result_file_write(writer, results, LEN);
+    result_file_close(writer);
+
+    bench_runf(bench, bench_read, NULL, "file/read/err=%u%%", rate);
+    bench_runf(bench, bench_mapped, NULL, "file/mapped/err=%u%%", rate);
+    bench_runf(bench, bench_next_err, NULL, "file/next_err/err=%u%%", rate);
+  }
+
+  unlink(PATH);
+  free(pattern);
+  free(results);
+}
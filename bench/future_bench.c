@@ -0,0 +1,321 @@
+#include "bench.h"
+#include "result_future.h"
+
+#include <pthread.h>
+
+//
+// Handing a result from one thread to another:
+//
+//   - ping-pong: a request goes to a worker and its response comes back, one
+//     operation is one round trip
+//   - fan-in: PRODUCERS threads fulfill a slot each, one thread waits for all
+//     of them in order, one operation is one slot
+//
+// Each against the usual mutex + condvar + flag, initialized per handoff like
+// the code it replaces did.
+//
+
+#define PRODUCERS 4
+
+typedef result_t(uint64_t, int) result_u64_t;
+typedef result_future_of_t(result_u64_t) future_u64_t;
+
+struct condvar_s {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  bool ready;
+  result_u64_t result;
+};
+
+struct future_pair_s {
+  future_u64_t request;
+  future_u64_t response;
+  uint64_t iterations;
+};
+
+struct condvar_pair_s {
+  struct condvar_s request;
+  struct condvar_s response;
+  uint64_t iterations;
+};
+
+struct fan_in_s {
+  void *slots;
+  uint64_t iterations;
+  size_t producer;
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static void condvar_init(struct condvar_s *cv);
+static void condvar_destroy(struct condvar_s *cv);
+static void condvar_fulfill(struct condvar_s *cv, result_u64_t result);
+static result_u64_t condvar_wait(struct condvar_s *cv);
+static result_u64_t make_result(uint64_t i);
+static void *future_echo(void *arg);
+static void *condvar_echo(void *arg);
+static uint64_t bench_ping_pong_future(void *arg, uint64_t iterations);
+static uint64_t bench_ping_pong_condvar(void *arg, uint64_t iterations);
+static void *future_produce(void *arg);
+static void *condvar_produce(void *arg);
+static uint64_t fan_in(
+  void *slots,
+  size_t slot_size,
+  void *(*produce)(void *),
+  result_u64_t (*wait)(void *slot),
+  uint64_t iterations
+);
+static result_u64_t future_wait_slot(void *slot);
+static result_u64_t condvar_wait_slot(void *slot);
+static uint64_t bench_fan_in_future(void *arg, uint64_t iterations);
+static uint64_t bench_fan_in_condvar(void *arg, uint64_t iterations);
+/*sublime-c-static-fn-hoist-end*/
+
+static void condvar_init(struct condvar_s *cv) {
+  pthread_mutex_init(&cv->mutex, NULL);
+  pthread_cond_init(&cv->cond, NULL);
+  cv->ready = false;
+}
+
+static void condvar_destroy(struct condvar_s *cv) {
+  pthread_cond_destroy(&cv->cond);
+  pthread_mutex_destroy(&cv->mutex);
+}
+
+static void condvar_fulfill(struct condvar_s *cv, result_u64_t result) {
+  pthread_mutex_lock(&cv->mutex);
+  cv->result = result;
+  cv->ready = true;
+  pthread_cond_broadcast(&cv->cond);
+  pthread_mutex_unlock(&cv->mutex);
+}
+
+static result_u64_t condvar_wait(struct condvar_s *cv) {
+  pthread_mutex_lock(&cv->mutex);
+
+  while (!cv->ready) {
+    pthread_cond_wait(&cv->cond, &cv->mutex);
+  }
+
+  result_u64_t result = cv->result;
+  pthread_mutex_unlock(&cv->mutex);
+
+  return result;
+}
+
+static result_u64_t make_result(uint64_t i) {
+  if (i % 16 == 0) {
+    return (result_u64_t) result_init_err((int) i);
+  }
+
+  return (result_u64_t) result_init_ok(i);
+}
+
+//
+// ping-pong
+//
+// The requester resets (re-initializes) the response before it sends the
+// request, the worker does the same with the request before it responds, so
+// nobody touches a handoff that the other side is still using.
+//
+
+static void *future_echo(void *arg) {
+  struct future_pair_s *pair = arg;
+
+  for (uint64_t i = 0; i < pair->iterations; i++) {
+    result_u64_t res = result_future_wait(&pair->request);
+    result_future_reset(&pair->request);
+    result_future_fulfill(&pair->response, res);
+  }
+
+  return NULL;
+}
+
+static void *condvar_echo(void *arg) {
+  struct condvar_pair_s *pair = arg;
+
+  for (uint64_t i = 0; i < pair->iterations; i++) {
+    result_u64_t res = condvar_wait(&pair->request);
+
+    condvar_destroy(&pair->request);
+    condvar_init(&pair->request);
+    condvar_fulfill(&pair->response, res);
+  }
+
+  return NULL;
+}
+
+static uint64_t bench_ping_pong_future(void *arg, uint64_t iterations) {
+  struct future_pair_s pair = { .iterations = iterations };
+  pthread_t thread;
+  uint64_t sum = 0;
+
+  (void) arg;
+  pthread_create(&thread, NULL, future_echo, &pair);
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    result_future_reset(&pair.response);
+    result_future_fulfill(&pair.request, make_result(i));
+
+    result_u64_t res = result_future_wait(&pair.response);
+    sum += result_is_ok(res) ? result_unwrap_unchecked(res) : 1;
+  }
+
+  pthread_join(thread, NULL);
+  return sum;
+}
+
+static uint64_t bench_ping_pong_condvar(void *arg, uint64_t iterations) {
+  struct condvar_pair_s pair = { .iterations = iterations };
+  pthread_t thread;
+  uint64_t sum = 0;
+
+  (void) arg;
+  condvar_init(&pair.request);
+  condvar_init(&pair.response);
+  pthread_create(&thread, NULL, condvar_echo, &pair);
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    if (i > 0) {
+      condvar_destroy(&pair.response);
+      condvar_init(&pair.response);
+    }
+
+    condvar_fulfill(&pair.request, make_result(i));
+
+    result_u64_t res = condvar_wait(&pair.response);
+    sum += result_is_ok(res) ? result_unwrap_unchecked(res) : 1;
+  }
+
+  pthread_join(thread, NULL);
+  condvar_destroy(&pair.request);
+  condvar_destroy(&pair.response);
+
+  return sum;
+}
+
+//
+// fan-in
+//
+// Slot i belongs to producer i % PRODUCERS, so the waiter keeps catching up
+// with all of them at once.
+//
+
+static void *future_produce(void *arg) {
+  struct fan_in_s *fan_in = arg;
+  future_u64_t *slots = fan_in->slots;
+
+  for (uint64_t i = fan_in->producer; i < fan_in->iterations; i += PRODUCERS) {
+    result_future_fulfill(&slots[i], make_result(i));
+  }
+
+  return NULL;
+}
+
+static void *condvar_produce(void *arg) {
+  struct fan_in_s *fan_in = arg;
+  struct condvar_s *slots = fan_in->slots;
+
+  for (uint64_t i = fan_in->producer; i < fan_in->iterations; i += PRODUCERS) {
+    condvar_fulfill(&slots[i], make_result(i));
+  }
+
+  return NULL;
+}
+
+static uint64_t fan_in(
+  void *slots,
+  size_t slot_size,
+  void *(*produce)(void *),
+  result_u64_t (*wait)(void *slot),
+  uint64_t iterations
+) {
+  struct fan_in_s producers[PRODUCERS];
+  pthread_t threads[PRODUCERS];
+  uint64_t sum = 0;
+
+  for (size_t p = 0; p < PRODUCERS; p++) {
+    producers[p] = (struct fan_in_s) {
+      .slots = slots,
+      .iterations = iterations,
+      .producer = p,
+    };
+
+    pthread_create(&threads[p], NULL, produce, &producers[p]);
+  }
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    result_u64_t res = wait((char *) slots + i * slot_size);
+    sum += result_is_ok(res) ? result_unwrap_unchecked(res) : 1;
+  }
+
+  for (size_t p = 0; p < PRODUCERS; p++) {
+    pthread_join(threads[p], NULL);
+  }
+
+  return sum;
+}
+
+static result_u64_t future_wait_slot(void *slot) {
+  return result_future_wait((future_u64_t *) slot);
+}
+
+static result_u64_t condvar_wait_slot(void *slot) {
+  return condvar_wait(slot);
+}
+
+static uint64_t bench_fan_in_future(void *arg, uint64_t iterations) {
+  future_u64_t *slots = calloc(iterations, sizeof(*slots));
+
+  (void) arg;
+
+  uint64_t sum = fan_in(
+    slots,
+    sizeof(*slots),
+    future_produce,
+    future_wait_slot,
+    iterations
+  );
+
+  free(slots);
+  return sum;
+}
+
+static uint64_t bench_fan_in_condvar(void *arg, uint64_t iterations) {
+  struct condvar_s *slots = calloc(iterations, sizeof(*slots));
+
+  (void) arg;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    condvar_init(&slots[i]);
+  }
+
+  uint64_t sum = fan_in(
+    slots,
+    sizeof(*slots),
+    condvar_produce,
+    condvar_wait_slot,
+    iterations
+  );
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    condvar_destroy(&slots[i]);
+  }
+
+  free(slots);
+  return sum;
+}
+
+void bench_future(struct bench_s *bench) {
+  bench_run(bench, "future/ping-pong/future", bench_ping_pong_future, NULL);
+  bench_run(bench, "future/ping-pong/condvar", bench_ping_pong_condvar, NULL);
+
+  bench_runf(
+    bench, bench_fan_in_future, NULL, "future/fan-in/future/producers=%d",
+    PRODUCERS
+  );
+
+  bench_runf(
+    bench, bench_fan_in_condvar, NULL, "future/fan-in/condvar/producers=%d",
+    PRODUCERS
+  );
+}
@@ -0,0 +1,262 @@
+#include <expected>
+
+#include "core/defs.h"
+#include "result.hpp"
+
+extern "C" {
+  #include "bench.h"
+}
+
+//
+// Returning results by value through a two level call chain, one operation is
+// one call of the outer level (three calls in all):
+//
+//   - c: result_t and what result_try expands to, compiled as C++
+//   - wr: wr::result and wr_try
+//   - expected: std::expected and the equivalent if/return
+//
+// for an 8 byte payload, which all three return in two registers, and a 24
+// byte one, which goes through memory. Built with -std=c++23 for
+// <expected>, the rest of the tree is C++20. The 24 byte wr case is slower
+// because wr_try copies the ok value out (see result.hpp), not because of the
+// layout.
+//
+// For code size, compare the functions of each flavour:
+//
+//   nm -C --size-sort result_bench | grep hpp_bench
+//
+
+#define PATTERN_LEN 4096
+#define PATTERN_MASK (PATTERN_LEN - 1)
+
+namespace hpp_bench {
+
+struct triple_s {
+  uint64_t a;
+  uint64_t b;
+  uint64_t c;
+};
+
+typedef result_t(uint64_t, int) c_u64_t;
+typedef result_t(struct triple_s, int) c_triple_t;
+
+template <typename T>
+static T make(uint64_t i);
+
+template <>
+uint64_t make<uint64_t>(uint64_t i) {
+  return i * 3;
+}
+
+template <>
+triple_s make<triple_s>(uint64_t i) {
+  return { i, i * 3, i ^ 7 };
+}
+
+static uint64_t sum(uint64_t value) {
+  return value;
+}
+
+static uint64_t sum(const triple_s &value) {
+  return value.a + value.b + value.c;
+}
+
+static uint64_t combine(uint64_t a, uint64_t b) {
+  return a + b;
+}
+
+static triple_s combine(const triple_s &a, const triple_s &b) {
+  return { a.a + b.a, a.b + b.b, a.c + b.c };
+}
+
+//
+// c
+//
+
+// result_init_ok/err use nested designators, which C++ doesn't have.
+template <typename R, typename T>
+static R c_ok(const T &value) {
+  R res;
+
+  res.header.is_ok = true;
+  res.body.ok = value;
+  return res;
+}
+
+template <typename R>
+static R c_err(int err) {
+  R res;
+
+  res.header.is_ok = false;
+  res.body.err = err;
+  return res;
+}
+
+template <typename R>
+static bench_noinline R c_leaf(uint64_t i, const uint8_t *fail) {
+  if (fail[i & PATTERN_MASK]) {
+    return c_err<R>((int) (i & 0xff));
+  }
+
+  return c_ok<R>(make<decltype(R{}.body.ok)>(i));
+}
+
+template <typename R>
+static bench_noinline R c_chain(uint64_t i, const uint8_t *fail) {
+  R a = c_leaf<R>(i, fail);
+
+  if (w_unlikely(!a.header.is_ok)) {
+    result_cold_path();
+    return a;
+  }
+
+  R b = c_leaf<R>(i + 1, fail);
+
+  if (w_unlikely(!b.header.is_ok)) {
+    result_cold_path();
+    return b;
+  }
+
+  return c_ok<R>(combine(a.body.ok, b.body.ok));
+}
+
+template <typename R>
+static uint64_t bench_c(void *arg, uint64_t iterations) {
+  const uint8_t *fail = static_cast<const uint8_t *>(arg);
+  uint64_t total = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    R res = c_chain<R>(i, fail);
+
+    total += res.header.is_ok ? sum(res.body.ok) : 1;
+  }
+
+  return total;
+}
+
+//
+// wr
+//
+
+template <typename T>
+static bench_noinline wr::result<T, int> wr_leaf(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  if (fail[i & PATTERN_MASK]) {
+    return wr::err((int) (i & 0xff));
+  }
+
+  return make<T>(i);
+}
+
+template <typename T>
+static bench_noinline wr::result<T, int> wr_chain(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  T a = wr_try(wr_leaf<T>(i, fail));
+  T b = wr_try(wr_leaf<T>(i + 1, fail));
+
+  return combine(a, b);
+}
+
+template <typename T>
+static uint64_t bench_wr(void *arg, uint64_t iterations) {
+  const uint8_t *fail = static_cast<const uint8_t *>(arg);
+  uint64_t total = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    wr::result<T, int> res = wr_chain<T>(i, fail);
+
+    total += res ? sum(*res) : 1;
+  }
+
+  return total;
+}
+
+//
+// expected
+//
+
+template <typename T>
+static bench_noinline std::expected<T, int> expected_leaf(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  if (fail[i & PATTERN_MASK]) {
+    return std::unexpected((int) (i & 0xff));
+  }
+
+  return make<T>(i);
+}
+
+template <typename T>
+static bench_noinline std::expected<T, int> expected_chain(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  std::expected<T, int> a = expected_leaf<T>(i, fail);
+
+  if (!a) [[unlikely]] {
+    return std::unexpected(a.error());
+  }
+
+  std::expected<T, int> b = expected_leaf<T>(i + 1, fail);
+
+  if (!b) [[unlikely]] {
+    return std::unexpected(b.error());
+  }
+
+  return combine(*a, *b);
+}
+
+template <typename T>
+static uint64_t bench_expected(void *arg, uint64_t iterations) {
+  const uint8_t *fail = static_cast<const uint8_t *>(arg);
+  uint64_t total = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    std::expected<T, int> res = expected_chain<T>(i, fail);
+
+    total += res ? sum(*res) : 1;
+  }
+
+  return total;
+}
+
+} // namespace hpp_bench
+
+extern "C" void bench_hpp(struct bench_s *bench) {
+  using namespace hpp_bench;
+
+  static uint8_t patterns[w_array_size(bench_error_rates)][PATTERN_LEN];
+
+  for (size_t r = 0; r < w_array_size(bench_error_rates); r++) {
+    unsigned rate = bench_error_rates[r];
+    void *pattern = patterns[r];
+
+    bench_fill_pattern(patterns[r], PATTERN_LEN, rate);
+
+    bench_runf(bench, bench_c<c_u64_t>, pattern, "hpp/u64/c/err=%u%%", rate);
+    bench_runf(bench, bench_wr<uint64_t>, pattern, "hpp/u64/wr/err=%u%%", rate);
+
+    bench_runf(
+      bench, bench_expected<uint64_t>, pattern, "hpp/u64/expected/err=%u%%",
+      rate
+    );
+
+    bench_runf(
+      bench, bench_c<c_triple_t>, pattern, "hpp/triple/c/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_wr<triple_s>, pattern, "hpp/triple/wr/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_expected<triple_s>, pattern,
+      "hpp/triple/expected/err=%u%%", rate
+    );
+  }
+}
@@ -0,0 +1,254 @@
+#include "bench.h"
+#include "result_io.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+//
+// Reading many small files, one operation is one file: open it, read it into
+// its own buffer and close it. At the error rate, files are missing and the
+// open fails.
+//
+//   - sync: result_io_openat, result_io_read and result_io_close one file at
+//     a time, a syscall each
+//   - batch/syscalls: the same through a batch of BATCH files without
+//     io_uring, to see what the batching costs by itself
+//   - batch/ring: the batch through io_uring, three io_uring_enter(2) for
+//     BATCH files (opens, reads, closes)
+//
+// After the timings, syscalls/file is printed for each of them. The files stay
+// in the page cache, so this is the cost of the syscalls, not of the disk.
+//
+
+#define FILES 256
+#define FILE_SIZE 512
+#define BATCH 64
+
+struct io_bench_s {
+  char dir[64];
+  char paths[FILES][96];
+  char (*bufs)[FILE_SIZE];
+  struct result_io_batch_s *syscalls;
+  struct result_io_batch_s *ring;
+  uint64_t sync_syscalls;
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static uint64_t read_sync(struct io_bench_s *io, size_t from, size_t n);
+static uint64_t read_batch(
+  struct io_bench_s *io,
+  struct result_io_batch_s *batch,
+  size_t from,
+  size_t n
+);
+static uint64_t bench_sync(void *arg, uint64_t iterations);
+static uint64_t bench_batch_syscalls(void *arg, uint64_t iterations);
+static uint64_t bench_batch_ring(void *arg, uint64_t iterations);
+/*sublime-c-static-fn-hoist-end*/
+
+static uint64_t read_sync(struct io_bench_s *io, size_t from, size_t n) {
+  uint64_t total = 0;
+
+  for (size_t i = from; i < from + n; i++) {
+    result_io_t fd = result_io_openat(AT_FDCWD, io->paths[i], O_RDONLY, 0);
+    io->sync_syscalls++;
+
+    if (result_is_err(fd)) {
+      total++;
+      continue;
+    }
+
+    int raw = (int) result_unwrap_unchecked(fd);
+
+    result_io_t got = result_io_read(
+      raw, (struct fatptr_s) { { io->bufs[i] }, FILE_SIZE }, 0
+    );
+
+    total += (uint64_t) result_unwrap_or(got, 0);
+    result_io_close(raw);
+    io->sync_syscalls += 2;
+  }
+
+  return total;
+}
+
+static uint64_t read_batch(
+  struct io_bench_s *io,
+  struct result_io_batch_s *batch,
+  size_t from,
+  size_t n
+) {
+  result_io_t opened[BATCH];
+  result_io_t got[BATCH];
+  uint64_t total = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    result_io_queue_openat(batch, AT_FDCWD, io->paths[from + i], O_RDONLY, 0);
+  }
+
+  result_io_submit(batch, opened);
+
+  for (size_t i = 0; i < n; i++) {
+    if (result_is_err(opened[i])) {
+      total++;
+      continue;
+    }
+
+    result_io_queue_read(
+      batch, (int) result_unwrap_unchecked(opened[i]),
+      (struct fatptr_s) { { io->bufs[from + i] }, FILE_SIZE }, 0
+    );
+  }
+
+  size_t reads = result_io_submit(batch, got);
+
+  for (size_t i = 0; i < reads; i++) {
+    total += (uint64_t) result_unwrap_or(got[i], 0);
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    if (result_is_ok(opened[i])) {
+      result_io_queue_close(batch, (int) result_unwrap_unchecked(opened[i]));
+    }
+  }
+
+  result_io_submit(batch, got);
+  return total;
+}
+
+static uint64_t bench_sync(void *arg, uint64_t iterations) {
+  struct io_bench_s *io = arg;
+  uint64_t total = 0;
+
+  for (uint64_t done = 0; done < iterations; done += BATCH) {
+    size_t from = (size_t) (done % FILES);
+    size_t n = (size_t) w_min_2((uint64_t) BATCH, iterations - done);
+
+    total += read_sync(io, from, n);
+  }
+
+  return total;
+}
+
+static uint64_t bench_batch_syscalls(void *arg, uint64_t iterations) {
+  struct io_bench_s *io = arg;
+  uint64_t total = 0;
+
+  for (uint64_t done = 0; done < iterations; done += BATCH) {
+    size_t from = (size_t) (done % FILES);
+    size_t n = (size_t) w_min_2((uint64_t) BATCH, iterations - done);
+
+    total += read_batch(io, io->syscalls, from, n);
+  }
+
+  return total;
+}
+
+static uint64_t bench_batch_ring(void *arg, uint64_t iterations) {
+  struct io_bench_s *io = arg;
+  uint64_t total = 0;
+
+  for (uint64_t done = 0; done < iterations; done += BATCH) {
+    size_t from = (size_t) (done % FILES);
+    size_t n = (size_t) w_min_2((uint64_t) BATCH, iterations - done);
+
+    total += read_batch(io, io->ring, from, n);
+  }
+
+  return total;
+}
+
+void bench_io(struct bench_s *bench) {
+  static struct io_bench_s io;
+  uint8_t pattern[FILES];
+  char data[FILE_SIZE];
+
+  strcpy(io.dir, "/tmp/result_io_bench.XXXXXX");
+
+  if (!mkdtemp(io.dir)) {
+    return;
+  }
+
+  io.bufs = malloc(FILES * sizeof(*io.bufs));
+  result_io_batch_create(&io.syscalls, BATCH, RESULT_IO_SYSCALLS);
+  result_io_batch_create(&io.ring, BATCH, 0);
+  memset(data, 'x', sizeof(data));
+
+  for (size_t i = 0; i < FILES; i++) {
+    snprintf(io.paths[i], sizeof(io.paths[i]), "%s/%zu", io.dir, i);
+
+    int fd = open(io.paths[i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    result_io_write(fd, (struct const_fatptr_s) { { data }, FILE_SIZE }, 0);
+    close(fd);
+  }
+
+  for (size_t r = 0; r < w_array_size(bench_error_rates); r++) {
+    unsigned rate = bench_error_rates[r];
+    char name[64];
+
+    // missing files are the ones whose name has a trailing "-"
+    bench_fill_pattern(pattern, FILES, rate);
+
+    for (size_t i = 0; i < FILES; i++) {
+      snprintf(
+        io.paths[i], sizeof(io.paths[i]), "%s/%zu%s", io.dir, i,
+        pattern[i] ? "-" : ""
+      );
+    }
+
+    bench_runf(bench, bench_sync, &io, "io/sync/err=%u%%", rate);
+
+    bench_runf(
+      bench, bench_batch_syscalls, &io, "io/batch/syscalls/err=%u%%", rate
+    );
+
+    if (result_io_batch_has_ring(io.ring)) {
+      bench_runf(bench, bench_batch_ring, &io, "io/batch/ring/err=%u%%", rate);
+    }
+
+    // one pass over all the files for the syscall counts
+    uint64_t before_syscalls = result_io_batch_syscalls(io.syscalls);
+    uint64_t before_ring = result_io_batch_syscalls(io.ring);
+
+    io.sync_syscalls = 0;
+    bench_sync(&io, FILES);
+    bench_batch_syscalls(&io, FILES);
+    bench_batch_ring(&io, FILES);
+
+    snprintf(name, sizeof(name), "io/sync/err=%u%%", rate);
+
+    bench_report_value(
+      bench, name, (double) io.sync_syscalls / FILES, "syscalls/file"
+    );
+
+    snprintf(name, sizeof(name), "io/batch/syscalls/err=%u%%", rate);
+
+    bench_report_value(
+      bench, name,
+      (double) (result_io_batch_syscalls(io.syscalls) - before_syscalls)
+        / FILES,
+      "syscalls/file"
+    );
+
+    if (result_io_batch_has_ring(io.ring)) {
+      snprintf(name, sizeof(name), "io/batch/ring/err=%u%%", rate);
+
+      bench_report_value(
+        bench, name,
+        (double) (result_io_batch_syscalls(io.ring) - before_ring) / FILES,
+        "syscalls/file"
+      );
+    }
+  }
+
+  for (size_t i = 0; i < FILES; i++) {
+    snprintf(io.paths[i], sizeof(io.paths[i]), "%s/%zu", io.dir, i);
+    unlink(io.paths[i]);
+  }
+
+  rmdir(io.dir);
+  result_io_batch_destroy(io.syscalls);
+  result_io_batch_destroy(io.ring);
+  free(io.bufs);
+}
@@ -0,0 +1,347 @@
+#include "bench.h"
+#include "result_iter.h"
+
+//
+// Pipelines of 3 and 5 stages over a cache-resident array of results, folded
+// into a sum. One operation is one element, errors happen at the error rate
+// (plus the ~6% the range check turns into errs):
+//
+//   - fused: result_iter_fold, one loop for all the stages
+//   - materialized: every stage in its own loop, writing an array of results
+//     that the next one reads, the way you'd chain array-at-a-time helpers
+//   - loop: the fused loop written by hand, for reference
+//
+// 3 stages: and_then(check), map(scale), filter_ok(is_even)
+// 5 stages: the same, then map(mix), map_err(widen_err)
+//
+// collect_ok is measured with 3 stages too, into a buffer as big as the input.
+//
+
+#define PATTERN_LEN 4096
+#define LIMIT 0xf0000000u
+
+typedef result_t(uint32_t, uint8_t) result_u32_t;
+typedef result_t(uint64_t, uint8_t) result_u64_t;
+typedef result_t(uint64_t, uint32_t) result_u64_wide_t;
+
+struct input_s {
+  result_u32_t items[PATTERN_LEN];
+};
+
+static result_u64_t stage_1[PATTERN_LEN];
+static result_u64_t stage_2[PATTERN_LEN];
+static result_u64_t stage_3[PATTERN_LEN];
+static result_u64_t stage_4[PATTERN_LEN];
+static result_u64_wide_t stage_5[PATTERN_LEN];
+static uint64_t collected[PATTERN_LEN];
+
+static inline result_u64_t check(uint32_t x) {
+  if (w_unlikely(x >= LIMIT)) {
+    return (result_u64_t) result_init_err(2);
+  }
+
+  return (result_u64_t) result_init_ok((uint64_t) x);
+}
+
+static inline uint64_t scale(uint64_t x) {
+  return x * 3 + 1;
+}
+
+static inline bool is_even(uint64_t x) {
+  return (x & 1) == 0;
+}
+
+static inline uint64_t mix(uint64_t x) {
+  return x ^ (x >> 7);
+}
+
+static inline uint32_t widen_err(uint8_t err) {
+  return (uint32_t) err << 8;
+}
+
+static inline uint64_t add(uint64_t acc, uint64_t x) {
+  return acc + x;
+}
+
+static inline size_t chunk(uint64_t done, uint64_t iterations) {
+  return iterations - done < PATTERN_LEN
+    ? (size_t) (iterations - done)
+    : PATTERN_LEN;
+}
+
+//
+// fused
+//
+
+static uint64_t bench_fused_3(void *arg, uint64_t iterations) {
+  struct input_s *input = arg;
+  uint64_t total = 0;
+
+  for (uint64_t done = 0; done < iterations; done += PATTERN_LEN) {
+    total += result_iter_fold(
+      (uint64_t) 0, add,
+      result_iter_array(input->items, chunk(done, iterations)),
+      result_iter_and_then(check),
+      result_iter_map(scale),
+      result_iter_filter_ok(is_even)
+    );
+  }
+
+  return total;
+}
+
+static uint64_t bench_fused_5(void *arg, uint64_t iterations) {
+  struct input_s *input = arg;
+  uint64_t total = 0;
+
+  for (uint64_t done = 0; done < iterations; done += PATTERN_LEN) {
+    total += result_iter_fold(
+      (uint64_t) 0, add,
+      result_iter_array(input->items, chunk(done, iterations)),
+      result_iter_and_then(check),
+      result_iter_map(scale),
+      result_iter_filter_ok(is_even),
+      result_iter_map(mix),
+      result_iter_map_err(widen_err)
+    );
+  }
+
+  return total;
+}
+
+static uint64_t bench_fused_collect_3(void *arg, uint64_t iterations) {
+  struct input_s *input = arg;
+  uint64_t total = 0;
+
+  for (uint64_t done = 0; done < iterations; done += PATTERN_LEN) {
+    size_t n = result_iter_collect_ok(
+      collected, PATTERN_LEN,
+      result_iter_array(input->items, chunk(done, iterations)),
+      result_iter_and_then(check),
+      result_iter_map(scale),
+      result_iter_filter_ok(is_even)
+    );
+
+    bench_escape(collected);
+    total += n;
+  }
+
+  return total;
+}
+
+//
+// materialized
+//
+
+static size_t materialize_3(const result_u32_t *items, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    stage_1[i] = result_is_ok(items[i])
+      ? check(result_unwrap_unchecked(items[i]))
+      : (result_u64_t) result_init_err(result_unwrap_err_unchecked(items[i]));
+  }
+
+  for (size_t i = 0; i < len; i++) {
+    stage_2[i] = stage_1[i];
+
+    if (result_is_ok(stage_1[i])) {
+      stage_2[i].body.ok = scale(result_unwrap_unchecked(stage_1[i]));
+    }
+  }
+
+  size_t kept = 0;
+
+  for (size_t i = 0; i < len; i++) {
+    if (result_is_ok(stage_2[i])
+      && !is_even(result_unwrap_unchecked(stage_2[i]))) {
+      continue;
+    }
+
+    stage_3[kept++] = stage_2[i];
+  }
+
+  return kept;
+}
+
+static uint64_t bench_materialized_3(void *arg, uint64_t iterations) {
+  struct input_s *input = arg;
+  uint64_t total = 0;
+
+  for (uint64_t done = 0; done < iterations; done += PATTERN_LEN) {
+    size_t kept = materialize_3(input->items, chunk(done, iterations));
+
+    for (size_t i = 0; i < kept; i++) {
+      if (result_is_ok(stage_3[i])) {
+        total += result_unwrap_unchecked(stage_3[i]);
+      }
+    }
+  }
+
+  return total;
+}
+
+static uint64_t bench_materialized_5(void *arg, uint64_t iterations) {
+  struct input_s *input = arg;
+  uint64_t total = 0;
+
+  for (uint64_t done = 0; done < iterations; done += PATTERN_LEN) {
+    size_t kept = materialize_3(input->items, chunk(done, iterations));
+
+    for (size_t i = 0; i < kept; i++) {
+      stage_4[i] = stage_3[i];
+
+      if (result_is_ok(stage_3[i])) {
+        stage_4[i].body.ok = mix(result_unwrap_unchecked(stage_3[i]));
+      }
+    }
+
+    for (size_t i = 0; i < kept; i++) {
+      stage_5[i] = result_is_ok(stage_4[i])
+        ? (result_u64_wide_t) result_init_ok(
+          result_unwrap_unchecked(stage_4[i])
+        )
+        : (result_u64_wide_t) result_init_err(
+          widen_err(result_unwrap_err_unchecked(stage_4[i]))
+        );
+    }
+
+    for (size_t i = 0; i < kept; i++) {
+      if (result_is_ok(stage_5[i])) {
+        total += result_unwrap_unchecked(stage_5[i]);
+      }
+    }
+  }
+
+  return total;
+}
+
+static uint64_t bench_materialized_collect_3(void *arg, uint64_t iterations) {
+  struct input_s *input = arg;
+  uint64_t total = 0;
+
+  for (uint64_t done = 0; done < iterations; done += PATTERN_LEN) {
+    size_t kept = materialize_3(input->items, chunk(done, iterations));
+    size_t n = 0;
+
+    for (size_t i = 0; i < kept; i++) {
+      if (result_is_ok(stage_3[i])) {
+        collected[n++] = result_unwrap_unchecked(stage_3[i]);
+      }
+    }
+
+    bench_escape(collected);
+    total += n;
+  }
+
+  return total;
+}
+
+//
+// by hand
+//
+
+static uint64_t bench_loop_3(void *arg, uint64_t iterations) {
+  struct input_s *input = arg;
+  uint64_t total = 0;
+
+  for (uint64_t done = 0; done < iterations; done += PATTERN_LEN) {
+    size_t len = chunk(done, iterations);
+
+    for (size_t i = 0; i < len; i++) {
+      result_u32_t res = input->items[i];
+
+      if (result_is_err(res) || result_unwrap_unchecked(res) >= LIMIT) {
+        continue;
+      }
+
+      uint64_t x = scale(result_unwrap_unchecked(res));
+
+      if (is_even(x)) {
+        total += x;
+      }
+    }
+  }
+
+  return total;
+}
+
+static uint64_t bench_loop_5(void *arg, uint64_t iterations) {
+  struct input_s *input = arg;
+  uint64_t total = 0;
+
+  for (uint64_t done = 0; done < iterations; done += PATTERN_LEN) {
+    size_t len = chunk(done, iterations);
+
+    for (size_t i = 0; i < len; i++) {
+      result_u32_t res = input->items[i];
+
+      if (result_is_err(res) || result_unwrap_unchecked(res) >= LIMIT) {
+        continue;
+      }
+
+      uint64_t x = scale(result_unwrap_unchecked(res));
+
+      if (is_even(x)) {
+        total += mix(x);
+      }
+    }
+  }
+
+  return total;
+}
+
+void bench_iter(struct bench_s *bench) {
+  static struct input_s inputs[w_array_size(bench_error_rates)];
+  uint8_t pattern[PATTERN_LEN];
+
+  for (size_t r = 0; r < w_array_size(bench_error_rates); r++) {
+    unsigned rate = bench_error_rates[r];
+    struct input_s *input = &inputs[r];
+
+    bench_fill_pattern(pattern, PATTERN_LEN, rate);
+
+    for (size_t i = 0; i < PATTERN_LEN; i++) {
+      // spread over the whole range, so some fail the range check
+      uint32_t x = (uint32_t) (i * 2654435761u);
+
+      input->items[i] = pattern[i]
+        ? (result_u32_t) result_init_err(1)
+        : (result_u32_t) result_init_ok(x);
+    }
+
+    bench_runf(
+      bench, bench_fused_3, input, "iter/fused/stages=3/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_materialized_3, input,
+      "iter/materialized/stages=3/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_loop_3, input, "iter/loop/stages=3/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_fused_5, input, "iter/fused/stages=5/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_materialized_5, input,
+      "iter/materialized/stages=5/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_loop_5, input, "iter/loop/stages=5/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_fused_collect_3, input,
+      "iter/fused/collect/stages=3/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_materialized_collect_3, input,
+      "iter/materialized/collect/stages=3/err=%u%%", rate
+    );
+  }
+}
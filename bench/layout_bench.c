@@ -0,0 +1,199 @@
+#include "bench.h"
+#include "result.h"
+
+#include <errno.h>
+
+//
+// Cost of constructing, returning, checking and unwrapping a result on the
+// hot path, for each of the result.h layouts and for the two classic C styles
+// (int status + out-param, errno), across payload sizes and error rates.
+//
+// Producers are kept out of line so the value really travels through the
+// calling convention, which is where the layouts differ: eg. a 16 byte
+// result_t(payload_8_t, int) is returned in two registers while the padded
+// variant of the same is 24 bytes and goes through memory.
+//
+
+#define PATTERN_LEN 4096
+#define PATTERN_MASK (PATTERN_LEN - 1)
+
+#define define_payload(_size) \
+  typedef struct { uint8_t bytes[_size]; } payload_##_size##_t;
+
+define_payload(1)
+define_payload(8)
+define_payload(13)
+define_payload(16)
+define_payload(32)
+define_payload(128)
+
+// `_style` is one of result, result_padded, result_packed, result_auto
+
+#define define_result_bench(_style, _size) \
+  typedef _style##_t(payload_##_size##_t, int) _style##_##_size##_t; \
+  \
+  static bench_noinline _style##_##_size##_t produce_##_style##_##_size( \
+    uint64_t i, \
+    const uint8_t *fail \
+  ) { \
+    if (fail[i & PATTERN_MASK]) { \
+      return (_style##_##_size##_t) result_init_err((int) i); \
+    } \
+    \
+    payload_##_size##_t payload; \
+    memset(&payload, (int) i, sizeof(payload)); \
+    \
+    return (_style##_##_size##_t) result_init_ok(payload); \
+  } \
+  \
+  static uint64_t bench_##_style##_##_size(void *arg, uint64_t iterations) { \
+    const uint8_t *fail = arg; \
+    uint64_t sum = 0; \
+    \
+    for (uint64_t i = 0; i < iterations; i++) { \
+      _style##_##_size##_t res = produce_##_style##_##_size(i, fail); \
+      \
+      if (result_is_ok(res)) { \
+        sum += result_unwrap_unchecked(res).bytes[_size - 1]; \
+      } \
+      \
+      else { \
+        sum += (uint64_t) result_unwrap_err_unchecked(res); \
+      } \
+    } \
+    \
+    return sum; \
+  }
+
+#define define_outparam_bench(_size) \
+  static bench_noinline int produce_outparam_##_size( \
+    uint64_t i, \
+    const uint8_t *fail, \
+    payload_##_size##_t *out \
+  ) { \
+    if (fail[i & PATTERN_MASK]) { \
+      return -(int) i; \
+    } \
+    \
+    memset(out, (int) i, sizeof(*out)); \
+    return 0; \
+  } \
+  \
+  static uint64_t bench_outparam_##_size(void *arg, uint64_t iterations) { \
+    const uint8_t *fail = arg; \
+    uint64_t sum = 0; \
+    \
+    for (uint64_t i = 0; i < iterations; i++) { \
+      payload_##_size##_t payload; \
+      int err = produce_outparam_##_size(i, fail, &payload); \
+      \
+      if (err == 0) { \
+        sum += payload.bytes[_size - 1]; \
+      } \
+      \
+      else { \
+        sum += (uint64_t) -err; \
+      } \
+    } \
+    \
+    return sum; \
+  }
+
+#define define_errno_bench(_size) \
+  static bench_noinline payload_##_size##_t produce_errno_##_size( \
+    uint64_t i, \
+    const uint8_t *fail \
+  ) { \
+    payload_##_size##_t payload; \
+    \
+    if (fail[i & PATTERN_MASK]) { \
+      errno = (int) i; \
+      memset(&payload, 0, sizeof(payload)); \
+      return payload; \
+    } \
+    \
+    memset(&payload, (int) i, sizeof(payload)); \
+    return payload; \
+  } \
+  \
+  static uint64_t bench_errno_##_size(void *arg, uint64_t iterations) { \
+    const uint8_t *fail = arg; \
+    uint64_t sum = 0; \
+    \
+    for (uint64_t i = 0; i < iterations; i++) { \
+      errno = 0; \
+      payload_##_size##_t payload = produce_errno_##_size(i, fail); \
+      \
+      if (errno == 0) { \
+        sum += payload.bytes[_size - 1]; \
+      } \
+      \
+      else { \
+        sum += (uint64_t) errno; \
+      } \
+    } \
+    \
+    return sum; \
+  }
+
+#define define_all_benches(_size) \
+  define_result_bench(result, _size) \
+  define_result_bench(result_padded, _size) \
+  define_result_bench(result_packed, _size) \
+  define_result_bench(result_auto, _size) \
+  define_outparam_bench(_size) \
+  define_errno_bench(_size)
+
+define_all_benches(1)
+define_all_benches(8)
+define_all_benches(13)
+define_all_benches(16)
+define_all_benches(32)
+define_all_benches(128)
+
+struct layout_bench_s {
+  const char *style;
+  size_t size;
+  bench_fn_t fn;
+};
+
+#define layout_benches(_size) \
+  { "result_t", _size, bench_result_##_size }, \
+  { "result_padded_t", _size, bench_result_padded_##_size }, \
+  { "result_packed_t", _size, bench_result_packed_##_size }, \
+  { "result_auto_t", _size, bench_result_auto_##_size }, \
+  { "int+outparam", _size, bench_outparam_##_size }, \
+  { "errno", _size, bench_errno_##_size }
+
+static const struct layout_bench_s layout_benches[] = {
+  layout_benches(1),
+  layout_benches(8),
+  layout_benches(13),
+  layout_benches(16),
+  layout_benches(32),
+  layout_benches(128),
+};
+
+void bench_layout(struct bench_s *bench) {
+  static uint8_t patterns[w_array_size(bench_error_rates)][PATTERN_LEN];
+
+  for (size_t r = 0; r < w_array_size(bench_error_rates); r++) {
+    bench_fill_pattern(patterns[r], PATTERN_LEN, bench_error_rates[r]);
+  }
+
+  for (size_t i = 0; i < w_array_size(layout_benches); i++) {
+    const struct layout_bench_s *lb = &layout_benches[i];
+
+    for (size_t r = 0; r < w_array_size(bench_error_rates); r++) {
+      bench_runf(
+        bench,
+        lb->fn,
+        patterns[r],
+        "layout/%s/%zuB/err=%u%%",
+        lb->style,
+        lb->size,
+        bench_error_rates[r]
+      );
+    }
+  }
+}
@@ -0,0 +1,67 @@
+#include <stdio.h>
+
+#include "result.h"
+
+//
+// Prints, as a markdown table, the size of each result.h layout for a matrix
+// of ok and err types, and which layout result_auto_t picked for them:
+//
+//   ./build-release/result_layout_report
+//
+
+typedef struct { char x[1]; } chars_1_t;
+typedef struct { char x[2]; } chars_2_t;
+typedef struct { char x[3]; } chars_3_t;
+typedef struct { char x[5]; } chars_5_t;
+typedef struct { char x[6]; } chars_6_t;
+typedef struct { char x[7]; } chars_7_t;
+typedef struct { char x[9]; } chars_9_t;
+typedef struct { char x[13]; } chars_13_t;
+typedef struct { char x[24]; } chars_24_t;
+
+#define report_row(_type, _err_type) \
+  printf( \
+    "| %-10s | %-8s | %8zu | %8zu | %8zu | %6zu | %-7s |\n", \
+    #_type, \
+    #_err_type, \
+    sizeof(result_t(_type, _err_type)), \
+    sizeof(result_padded_t(_type, _err_type)), \
+    sizeof(result_packed_t(_type, _err_type)), \
+    sizeof(result_auto_t(_type, _err_type)), \
+    result_auto_has_tail(_type, _err_type) ? "tail" : "natural" \
+  )
+
+#define report_rows(_type) \
+  report_row(_type, uint8_t); \
+  report_row(_type, uint16_t); \
+  report_row(_type, uint32_t); \
+  report_row(_type, uint64_t)
+
+int main(void) {
+  printf(
+    "| %-10s | %-8s | %8s | %8s | %8s | %6s | %-7s |\n",
+    "ok", "err", "result", "padded", "packed", "auto", "picked"
+  );
+
+  printf(
+    "|------------|----------|----------|----------|----------|--------|"
+    "---------|\n"
+  );
+
+  report_rows(uint8_t);
+  report_rows(uint16_t);
+  report_rows(uint32_t);
+  report_rows(uint64_t);
+  report_rows(void *);
+  report_rows(chars_1_t);
+  report_rows(chars_2_t);
+  report_rows(chars_3_t);
+  report_rows(chars_5_t);
+  report_rows(chars_6_t);
+  report_rows(chars_7_t);
+  report_rows(chars_9_t);
+  report_rows(chars_13_t);
+  report_rows(chars_24_t);
+
+  return 0;
+}
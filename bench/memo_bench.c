@@ -0,0 +1,121 @@
+#include "bench.h"
+#include "result_memo.h"
+
+//
+// Looking up KEYS keys over and over with an expensive result-returning
+// function, one operation is one lookup:
+//
+//   - uncached: calls the function every time
+//   - ok-only: result_memo with no room for errs, so every err key is
+//     computed again, which is what a cache of values (rather than results)
+//     does
+//   - ok+err: result_memo caching errs too
+//
+// Both caches have room for every key (twice over, since keys don't spread
+// evenly over the shards), so after the first round only the errs that aren't
+// cached miss.
+//
+
+#define KEYS 4096
+#define WORK 256
+
+typedef result_padded_t(uint64_t, int) result_u64_t;
+typedef result_memo_t(uint64_t, result_u64_t) memo_u64_t;
+
+struct memo_bench_s {
+  uint8_t pattern[KEYS];
+  memo_u64_t memo;
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static result_u64_t expensive(const uint8_t *pattern, uint64_t key);
+static uint64_t bench_uncached(void *arg, uint64_t iterations);
+static uint64_t bench_cached(void *arg, uint64_t iterations);
+/*sublime-c-static-fn-hoist-end*/
+
+// A few hundred nanoseconds of dependent multiplies, standing in for a
+// syscall or a parse.
+static bench_noinline result_u64_t expensive(
+  const uint8_t *pattern,
+  uint64_t key
+) {
+  uint64_t value = key;
+
+  for (size_t i = 0; i < WORK; i++) {
+    value = (value ^ (value >> 29)) * 0xbf58476d1ce4e5b9u;
+  }
+
+  if (pattern[key]) {
+    return (result_u64_t) result_init_err((int) (value & 0xff) + 1);
+  }
+
+  return (result_u64_t) result_init_ok(value);
+}
+
+static uint64_t bench_uncached(void *arg, uint64_t iterations) {
+  struct memo_bench_s *config = arg;
+  uint64_t sum = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    uint64_t key = (i * 2654435761u) % KEYS;
+    result_u64_t res = expensive(config->pattern, key);
+
+    sum += result_is_ok(res) ? result_unwrap_unchecked(res) : 1;
+  }
+
+  return sum;
+}
+
+static uint64_t bench_cached(void *arg, uint64_t iterations) {
+  struct memo_bench_s *config = arg;
+  uint64_t sum = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    uint64_t key = (i * 2654435761u) % KEYS;
+
+    result_u64_t res = result_memo_call(
+      &config->memo,
+      &key,
+      expensive(config->pattern, key)
+    );
+
+    sum += result_is_ok(res) ? result_unwrap_unchecked(res) : 1;
+  }
+
+  return sum;
+}
+
+void bench_memo(struct bench_s *bench) {
+  struct memo_bench_s *config = calloc(1, sizeof(*config));
+
+  for (size_t r = 0; r < w_array_size(bench_error_rates); r++) {
+    unsigned rate = bench_error_rates[r];
+
+    bench_fill_pattern(config->pattern, KEYS, rate);
+
+    bench_runf(
+      bench, bench_uncached, config, "memo/uncached/err=%u%%", rate
+    );
+
+    result_memo_init(&config->memo, .ok_capacity = 2 * KEYS);
+
+    bench_runf(
+      bench, bench_cached, config, "memo/ok-only/err=%u%%", rate
+    );
+
+    result_memo_free(&config->memo);
+    result_memo_init(
+      &config->memo,
+      .ok_capacity = 2 * KEYS,
+      .err_capacity = 2 * KEYS
+    );
+
+    bench_runf(
+      bench, bench_cached, config, "memo/ok+err/err=%u%%", rate
+    );
+
+    result_memo_free(&config->memo);
+  }
+
+  free(config);
+}
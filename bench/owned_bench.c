@@ -0,0 +1,237 @@
+#include "bench.h"
+#include "result_owned.h"
+
+//
+// An error with a message, created at the bottom of a three level call chain
+// and passed up to the top, which looks at it and lets it go. One operation
+// is one call, errors happen at the error rate:
+//
+//   - stack: the message is copied into a char[DETAIL_SIZE] in the err, and
+//     the err is copied up by value, which is what we do to avoid leaks
+//   - malloc: an owned result with the message in a malloc'd copy, moved up
+//     with result_owned_move and freed by its cleanup
+//   - pool: the same with result_owned_strdup from the per-thread pool
+//
+// After the timings, allocs/op is printed for malloc and pool, counting
+// malloc(3) calls only: the pool's stay at 0 once it has its slab.
+//
+
+#define PATTERN_LEN 4096
+#define PATTERN_MASK (PATTERN_LEN - 1)
+#define DETAIL_SIZE 64
+
+static const char detail[] = "record 1234: field 'timestamp' is out of range";
+
+struct stack_error_s {
+  int code;
+  char detail[DETAIL_SIZE];
+};
+
+struct owned_error_s {
+  int code;
+  w_heap char *detail;
+};
+
+typedef result_t(uint64_t, struct stack_error_s) result_stack_t;
+
+/*sublime-c-static-fn-hoist-start*/
+static void malloc_error_drop(struct owned_error_s *err);
+static void pool_error_drop(struct owned_error_s *err);
+/*sublime-c-static-fn-hoist-end*/
+
+static uint64_t mallocs;
+
+static void malloc_error_drop(struct owned_error_s *err) {
+  free(err->detail);
+}
+
+static void pool_error_drop(struct owned_error_s *err) {
+  result_owned_free(err->detail);
+}
+
+RESULT_OWNED_DECLARE(
+  result_malloc, uint64_t, result_owned_no_drop,
+  struct owned_error_s, malloc_error_drop
+)
+
+RESULT_OWNED_DECLARE(
+  result_pool, uint64_t, result_owned_no_drop,
+  struct owned_error_s, pool_error_drop
+)
+
+#define define_owned_chain(_name, _result_type, _new_err) \
+  static bench_noinline _result_type _name##_leaf( \
+    uint64_t i, \
+    const uint8_t *fail \
+  ) { \
+    if (fail[i & PATTERN_MASK]) { \
+      return (_result_type) result_init_err(_new_err); \
+    } \
+    \
+    return (_result_type) result_init_ok(i); \
+  } \
+  \
+  static bench_noinline _result_type _name##_level_2( \
+    uint64_t i, \
+    const uint8_t *fail \
+  ) { \
+    result_owned(_name) res = _name##_leaf(i, fail); \
+    \
+    if (result_is_ok(res)) { \
+      res.body.ok += 1; \
+    } \
+    \
+    return result_owned_move(res); \
+  } \
+  \
+  static bench_noinline _result_type _name##_level_1( \
+    uint64_t i, \
+    const uint8_t *fail \
+  ) { \
+    result_owned(_name) res = _name##_level_2(i, fail); \
+    \
+    if (result_is_ok(res)) { \
+      res.body.ok *= 3; \
+    } \
+    \
+    return result_owned_move(res); \
+  } \
+  \
+  static uint64_t bench_##_name(void *arg, uint64_t iterations) { \
+    uint64_t total = 0; \
+    \
+    for (uint64_t i = 0; i < iterations; i++) { \
+      result_owned(_name) res = _name##_level_1(i, arg); \
+      \
+      if (result_is_ok(res)) { \
+        total += result_unwrap_unchecked(res); \
+      } else { \
+        total += (uint64_t) result_unwrap_err_unchecked(res).detail[7]; \
+      } \
+    } \
+    \
+    return total; \
+  }
+
+static inline struct owned_error_s malloc_error(int code) {
+  char *copy = malloc(sizeof(detail));
+
+  memcpy(copy, detail, sizeof(detail));
+  mallocs++;
+
+  return (struct owned_error_s) { .code = code, .detail = copy };
+}
+
+static inline struct owned_error_s pool_error(int code) {
+  return (struct owned_error_s) {
+    .code = code,
+    .detail = result_owned_strdup(detail),
+  };
+}
+
+define_owned_chain(result_malloc, result_malloc_t, malloc_error((int) i))
+define_owned_chain(result_pool, result_pool_t, pool_error((int) i))
+
+//
+// by value
+//
+
+static bench_noinline result_stack_t stack_leaf(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  if (fail[i & PATTERN_MASK]) {
+    struct stack_error_s err = { .code = (int) i };
+
+    memcpy(err.detail, detail, sizeof(detail));
+    return (result_stack_t) result_init_err(err);
+  }
+
+  return (result_stack_t) result_init_ok(i);
+}
+
+static bench_noinline result_stack_t stack_level_2(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  result_stack_t res = stack_leaf(i, fail);
+
+  if (result_is_ok(res)) {
+    res.body.ok += 1;
+  }
+
+  return res;
+}
+
+static bench_noinline result_stack_t stack_level_1(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  result_stack_t res = stack_level_2(i, fail);
+
+  if (result_is_ok(res)) {
+    res.body.ok *= 3;
+  }
+
+  return res;
+}
+
+static uint64_t bench_stack(void *arg, uint64_t iterations) {
+  uint64_t total = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    result_stack_t res = stack_level_1(i, arg);
+
+    if (result_is_ok(res)) {
+      total += result_unwrap_unchecked(res);
+    } else {
+      total += (uint64_t) result_unwrap_err_unchecked(res).detail[7];
+    }
+  }
+
+  return total;
+}
+
+void bench_owned(struct bench_s *bench) {
+  static uint8_t patterns[w_array_size(bench_error_rates)][PATTERN_LEN];
+
+  for (size_t r = 0; r < w_array_size(bench_error_rates); r++) {
+    unsigned rate = bench_error_rates[r];
+    uint8_t *pattern = patterns[r];
+    char name[64];
+
+    bench_fill_pattern(pattern, PATTERN_LEN, rate);
+
+    bench_runf(bench, bench_stack, pattern, "owned/stack/err=%u%%", rate);
+
+    bench_runf(
+      bench, bench_result_malloc, pattern, "owned/malloc/err=%u%%", rate
+    );
+
+    bench_runf(bench, bench_result_pool, pattern, "owned/pool/err=%u%%", rate);
+
+    // one more pass of each for the malloc(3) counts
+    struct result_owned_stats_s before = result_owned_stats();
+
+    mallocs = 0;
+    bench_result_malloc(pattern, PATTERN_LEN);
+    bench_result_pool(pattern, PATTERN_LEN);
+
+    struct result_owned_stats_s after = result_owned_stats();
+
+    snprintf(name, sizeof(name), "owned/malloc/err=%u%%", rate);
+
+    bench_report_value(
+      bench, name, (double) mallocs / PATTERN_LEN, "allocs/op"
+    );
+
+    snprintf(name, sizeof(name), "owned/pool/err=%u%%", rate);
+
+    bench_report_value(
+      bench, name,
+      (double) (after.slabs - before.slabs + after.large - before.large)
+        / PATTERN_LEN,
+      "allocs/op"
+    );
+  }
+}
@@ -0,0 +1,138 @@
+#include "bench.h"
+#include "result_par.h"
+
+//
+// Mapping a cheap result-returning function over a large array, one operation
+// is one element:
+//
+//   - loop: the single-threaded for loop it replaces
+//   - par_map: result_par_map with 1 to 32 threads, in both modes
+//   - first_err/cancel: the only err is at 10% of the array, so most of the
+//     work should be cancelled
+//
+// Thread counts above the number of cores measure oversubscription rather
+// than scaling.
+//
+
+#define LEN (1 << 20)
+#define CANCEL_AT (LEN / 10)
+
+typedef result_t(uint32_t, uint32_t) result_u32_t;
+
+struct par_bench_s {
+  uint32_t *in;
+  result_u32_t *out;
+  enum result_par_mode_e mode;
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static result_u32_t hash(uint32_t value);
+static uint64_t bench_loop(void *arg, uint64_t iterations);
+static uint64_t bench_par_map(void *arg, uint64_t iterations);
+/*sublime-c-static-fn-hoist-end*/
+
+// A few cycles of work, with an err for the marker value.
+static result_u32_t hash(uint32_t value) {
+  if (w_unlikely(value == UINT32_MAX)) {
+    return (result_u32_t) result_init_err(value);
+  }
+
+  value ^= value >> 16;
+  value *= 0x7feb352d;
+  value ^= value >> 15;
+  value *= 0x846ca68b;
+  value ^= value >> 16;
+
+  return (result_u32_t) result_init_ok(value);
+}
+
+result_par_kernel(hash_all, hash, uint32_t, result_u32_t)
+
+static uint64_t bench_loop(void *arg, uint64_t iterations) {
+  struct par_bench_s *config = arg;
+  uint64_t sum = 0;
+
+  for (uint64_t done = 0; done < iterations; done += LEN) {
+    size_t n = (size_t) w_min_2((uint64_t) LEN, iterations - done);
+
+    for (size_t i = 0; i < n; i++) {
+      config->out[i] = hash(config->in[i]);
+
+      if (
+        config->mode == RESULT_PAR_FIRST_ERR
+        && !result_is_ok(config->out[i])
+      ) {
+        break;
+      }
+    }
+
+    bench_escape(config->out);
+    sum += result_unwrap_or(config->out[n / 2], 0);
+  }
+
+  return sum;
+}
+
+static uint64_t bench_par_map(void *arg, uint64_t iterations) {
+  struct par_bench_s *config = arg;
+  uint64_t sum = 0;
+
+  for (uint64_t done = 0; done < iterations; done += LEN) {
+    size_t n = (size_t) w_min_2((uint64_t) LEN, iterations - done);
+
+    struct result_par_s par = result_par_map(
+      config->in, config->out, n, hash_all, config->mode
+    );
+
+    bench_escape(config->out);
+    sum += par.first_err + result_unwrap_or(config->out[n / 2], 0);
+  }
+
+  return sum;
+}
+
+void bench_par(struct bench_s *bench) {
+  static const size_t threads[] = { 1, 2, 4, 8, 16, 32 };
+  struct par_bench_s config = {
+    .in = calloc(LEN, sizeof(*config.in)),
+    .out = aligned_alloc(64, LEN * sizeof(*config.out)),
+  };
+
+  for (uint32_t i = 0; i < LEN; i++) {
+    config.in[i] = i;
+  }
+
+  config.mode = RESULT_PAR_COLLECT_ALL;
+  bench_run(bench, "par/loop", bench_loop, &config);
+
+  for (size_t t = 0; t < w_array_size(threads); t++) {
+    result_par_restart(threads[t]);
+
+    config.mode = RESULT_PAR_COLLECT_ALL;
+    bench_runf(
+      bench, bench_par_map, &config, "par/collect_all/threads=%zu", threads[t]
+    );
+
+    config.mode = RESULT_PAR_FIRST_ERR;
+    bench_runf(
+      bench, bench_par_map, &config, "par/first_err/threads=%zu", threads[t]
+    );
+  }
+
+  config.in[CANCEL_AT] = UINT32_MAX;
+  config.mode = RESULT_PAR_FIRST_ERR;
+  bench_run(bench, "par/first_err/cancel/loop", bench_loop, &config);
+
+  for (size_t t = 0; t < w_array_size(threads); t++) {
+    result_par_restart(threads[t]);
+
+    bench_runf(
+      bench, bench_par_map, &config, "par/first_err/cancel/threads=%zu",
+      threads[t]
+    );
+  }
+
+  result_par_restart(0);
+  free(config.in);
+  free(config.out);
+}
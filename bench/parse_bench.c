@@ -0,0 +1,339 @@
+#include "bench.h"
+#include "result_parse.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// A line of FIELDS comma-separated numbers, one operation is one field, and
+// a field is invalid (a digit replaced by 'x') at the error rate:
+//
+//   - strtoull, strtod: one call per field, given where it starts, checking
+//     that it stopped where the field ends
+//   - result: result_parse_u64/f64 per field, given the slice
+//   - fields/strtoull, fields/strtod: the whole line, one call after another,
+//     looking for the next comma with memchr(3) after an invalid field
+//   - fields/result: result_parse_u64/f64_fields on the whole line
+//
+// The integers have 1 to 20 digits, the floats are printed with 0 to 6
+// decimals, and every 16th with %.17g, which mostly misses the fast path.
+//
+
+#define FIELDS 1024
+#define FIELDS_MASK (FIELDS - 1)
+#define FIELD_SIZE 32
+
+struct line_s {
+  char text[FIELDS * FIELD_SIZE];
+  size_t len;
+  uint32_t starts[FIELDS];
+  uint32_t lens[FIELDS];
+};
+
+static result_parse_u64_t u64_out[FIELDS];
+static result_parse_f64_t f64_out[FIELDS];
+
+static uint64_t next_random(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+
+  return *state;
+}
+
+static void make_line(struct line_s *line, bool floats, unsigned rate) {
+  uint8_t pattern[FIELDS];
+  uint64_t state = 0x9e3779b97f4a7c15ull;
+  size_t len = 0;
+
+  bench_fill_pattern(pattern, FIELDS, rate);
+
+  for (size_t f = 0; f < FIELDS; f++) {
+    char *field = line->text + len;
+    uint64_t r = next_random(&state);
+    int n;
+
+    if (floats) {
+      double x = (double) (r >> 11) / (double) (1ull << 53) * 100000;
+
+      n = f % 16 == 15
+        ? snprintf(field, FIELD_SIZE, "%.17g", x)
+        : snprintf(field, FIELD_SIZE, "%.*f", (int) (r % 7), x);
+    } else {
+      // 1 to 20 digits
+      unsigned digits = (unsigned) (r % 20) + 1;
+      uint64_t x = next_random(&state);
+
+      n = snprintf(field, FIELD_SIZE, "%" PRIu64, x);
+
+      if ((unsigned) n > digits) {
+        n = (int) digits;
+      }
+    }
+
+    if (pattern[f]) {
+      field[r % (unsigned) n] = 'x';
+    }
+
+    line->starts[f] = (uint32_t) len;
+    line->lens[f] = (uint32_t) n;
+    len += (size_t) n;
+    line->text[len++] = ',';
+  }
+
+  // no comma after the last one
+  line->text[--len] = '\0';
+  line->len = len;
+}
+
+//
+// one field at a time
+//
+
+static uint64_t bench_strtoull(void *arg, uint64_t iterations) {
+  struct line_s *line = arg;
+  uint64_t total = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    const char *start = line->text + line->starts[i & FIELDS_MASK];
+    char *end;
+
+    errno = 0;
+
+    uint64_t x = strtoull(start, &end, 10);
+
+    if (end == start + line->lens[i & FIELDS_MASK] && end != start
+      && errno == 0) {
+      total += x;
+    } else {
+      total += 1;
+    }
+  }
+
+  return total;
+}
+
+static uint64_t bench_result_u64(void *arg, uint64_t iterations) {
+  struct line_s *line = arg;
+  uint64_t total = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    result_parse_u64_t res = result_parse_u64((struct const_fatptr_s) {
+      { line->text + line->starts[i & FIELDS_MASK] },
+      line->lens[i & FIELDS_MASK],
+    });
+
+    if (result_is_ok(res)) {
+      total += result_unwrap_unchecked(res);
+    } else {
+      total += 1;
+    }
+  }
+
+  return total;
+}
+
+static uint64_t bench_strtod(void *arg, uint64_t iterations) {
+  struct line_s *line = arg;
+  double total = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    const char *start = line->text + line->starts[i & FIELDS_MASK];
+    char *end;
+
+    errno = 0;
+
+    double x = strtod(start, &end);
+
+    if (end == start + line->lens[i & FIELDS_MASK] && end != start
+      && errno == 0) {
+      total += x;
+    } else {
+      total += 1;
+    }
+  }
+
+  return (uint64_t) total;
+}
+
+static uint64_t bench_result_f64(void *arg, uint64_t iterations) {
+  struct line_s *line = arg;
+  double total = 0;
+
+  for (uint64_t i = 0; i < iterations; i++) {
+    result_parse_f64_t res = result_parse_f64((struct const_fatptr_s) {
+      { line->text + line->starts[i & FIELDS_MASK] },
+      line->lens[i & FIELDS_MASK],
+    });
+
+    if (result_is_ok(res)) {
+      total += result_unwrap_unchecked(res);
+    } else {
+      total += 1;
+    }
+  }
+
+  return (uint64_t) total;
+}
+
+//
+// whole lines
+//
+
+// Where the field after the one at `p` starts, after strto*() stopped at
+// `end` and said whether the field was a number.
+static inline const char *next_field(
+  const char *p,
+  char *end,
+  const char *line_end,
+  bool *valid
+) {
+  *valid = end != p && errno == 0 && (end == line_end || *end == ',');
+
+  if (!*valid) {
+    end = memchr(p, ',', (size_t) (line_end - p));
+
+    if (!end) {
+      return line_end + 1;
+    }
+  }
+
+  return end + 1;
+}
+
+static uint64_t bench_fields_strtoull(void *arg, uint64_t iterations) {
+  struct line_s *line = arg;
+  const char *line_end = line->text + line->len;
+  uint64_t total = 0;
+
+  for (uint64_t done = 0; done < iterations; done += FIELDS) {
+    const char *p = line->text;
+
+    for (size_t f = 0; f < FIELDS && p <= line_end; f++) {
+      char *end;
+      bool valid;
+
+      errno = 0;
+
+      uint64_t x = strtoull(p, &end, 10);
+
+      p = next_field(p, end, line_end, &valid);
+      total += valid ? x : 1;
+    }
+  }
+
+  return total;
+}
+
+static uint64_t bench_fields_result_u64(void *arg, uint64_t iterations) {
+  struct line_s *line = arg;
+  uint64_t total = 0;
+
+  for (uint64_t done = 0; done < iterations; done += FIELDS) {
+    size_t n = result_parse_u64_fields(
+      (struct const_fatptr_s) { { line->text }, line->len },
+      ',', u64_out, FIELDS
+    );
+
+    for (size_t f = 0; f < n; f++) {
+      total += result_is_ok(u64_out[f])
+        ? result_unwrap_unchecked(u64_out[f])
+        : 1;
+    }
+  }
+
+  return total;
+}
+
+static uint64_t bench_fields_strtod(void *arg, uint64_t iterations) {
+  struct line_s *line = arg;
+  const char *line_end = line->text + line->len;
+  double total = 0;
+
+  for (uint64_t done = 0; done < iterations; done += FIELDS) {
+    const char *p = line->text;
+
+    for (size_t f = 0; f < FIELDS && p <= line_end; f++) {
+      char *end;
+      bool valid;
+
+      errno = 0;
+
+      double x = strtod(p, &end);
+
+      p = next_field(p, end, line_end, &valid);
+      total += valid ? x : 1;
+    }
+  }
+
+  return (uint64_t) total;
+}
+
+static uint64_t bench_fields_result_f64(void *arg, uint64_t iterations) {
+  struct line_s *line = arg;
+  double total = 0;
+
+  for (uint64_t done = 0; done < iterations; done += FIELDS) {
+    size_t n = result_parse_f64_fields(
+      (struct const_fatptr_s) { { line->text }, line->len },
+      ',', f64_out, FIELDS
+    );
+
+    for (size_t f = 0; f < n; f++) {
+      total += result_is_ok(f64_out[f])
+        ? result_unwrap_unchecked(f64_out[f])
+        : 1;
+    }
+  }
+
+  return (uint64_t) total;
+}
+
+void bench_parse(struct bench_s *bench) {
+  static struct line_s ints[w_array_size(bench_error_rates)];
+  static struct line_s floats[w_array_size(bench_error_rates)];
+
+  for (size_t r = 0; r < w_array_size(bench_error_rates); r++) {
+    unsigned rate = bench_error_rates[r];
+
+    make_line(&ints[r], false, rate);
+    make_line(&floats[r], true, rate);
+
+    bench_runf(
+      bench, bench_strtoull, &ints[r], "parse/u64/strtoull/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_result_u64, &ints[r], "parse/u64/result/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_fields_strtoull, &ints[r],
+      "parse/u64/fields/strtoull/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_fields_result_u64, &ints[r],
+      "parse/u64/fields/result/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_strtod, &floats[r], "parse/f64/strtod/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_result_f64, &floats[r], "parse/f64/result/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_fields_strtod, &floats[r],
+      "parse/f64/fields/strtod/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_fields_result_f64, &floats[r],
+      "parse/f64/fields/result/err=%u%%", rate
+    );
+  }
+}
@@ -0,0 +1,338 @@
+#include "bench.h"
+#include "result_queue.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+//
+// Moving results between pipeline stages, one operation is one result:
+//
+//   - spsc: one producer thread, the benchmark thread consumes
+//   - mpsc: 1 to 32 producer threads
+//   - single: push and pop one result at a time
+//   - batch: push and pop BATCH results at a time
+//   - pop_ok_n: the consumer takes the ok values and leaves the errs in a side
+//     channel, which it drains itself now and then
+//
+// The ok values are the time they were pushed, so the consumer also samples
+// the end-to-end latency (push to pop, including time spent in the queue)
+// and the suite prints its percentiles after the throughput.
+//
+// Full and empty queues yield, so that this also works with fewer cores than
+// threads.
+//
+
+#define CAPACITY 1024
+#define BATCH 32
+#define SAMPLE_EVERY 64
+#define MAX_SAMPLES (1 << 16)
+#define MAX_PRODUCERS 32
+
+typedef result_t(uint64_t, int32_t) result_stamp_t;
+typedef result_spsc_t(result_stamp_t) spsc_stamp_t;
+typedef result_mpsc_t(result_stamp_t) mpsc_stamp_t;
+
+struct queue_bench_s {
+  size_t producers;
+  size_t batch;
+  const uint8_t *fail;
+
+  uint64_t samples[MAX_SAMPLES];
+  size_t samples_len;
+};
+
+struct producer_s {
+  void *queue;
+  const struct queue_bench_s *config;
+  uint64_t first;
+  uint64_t count;
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static uint64_t now_ns(void);
+static result_stamp_t stamp(const struct queue_bench_s *config, uint64_t i);
+static void sample(struct queue_bench_s *config, uint64_t sent);
+static void *produce_spsc(void *arg);
+static void *produce_mpsc(void *arg);
+static void start_producers(
+  struct queue_bench_s *config,
+  void *queue,
+  void *(*produce)(void *),
+  uint64_t iterations,
+  pthread_t *threads,
+  struct producer_s *producers
+);
+static void join_producers(struct queue_bench_s *config, pthread_t *threads);
+static uint64_t bench_spsc(void *arg, uint64_t iterations);
+static uint64_t bench_mpsc(void *arg, uint64_t iterations);
+static uint64_t bench_spsc_pop_ok_n(void *arg, uint64_t iterations);
+/*sublime-c-static-fn-hoist-end*/
+
+#define PATTERN_LEN 4096
+#define PATTERN_MASK (PATTERN_LEN - 1)
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static result_stamp_t stamp(const struct queue_bench_s *config, uint64_t i) {
+  if (config->fail && config->fail[i & PATTERN_MASK]) {
+    return (result_stamp_t) result_init_err((int32_t) i);
+  }
+
+  return (result_stamp_t) result_init_ok(
+    i % SAMPLE_EVERY == 0 ? now_ns() : 0
+  );
+}
+
+static void sample(struct queue_bench_s *config, uint64_t sent) {
+  if (sent != 0 && config->samples_len < MAX_SAMPLES) {
+    config->samples[config->samples_len++] = now_ns() - sent;
+  }
+}
+
+static void *produce_spsc(void *arg) {
+  struct producer_s *producer = arg;
+  const struct queue_bench_s *config = producer->config;
+  result_stamp_t batch[BATCH];
+
+  for (uint64_t i = 0; i < producer->count;) {
+    size_t n = (size_t) w_min_2((uint64_t) config->batch, producer->count - i);
+
+    for (size_t j = 0; j < n; j++) {
+      batch[j] = stamp(config, producer->first + i + j);
+    }
+
+    for (size_t pushed = 0; pushed < n;) {
+      size_t more = result_spsc_push_n(
+        (spsc_stamp_t *) producer->queue,
+        &batch[pushed],
+        n - pushed
+      );
+
+      if (more == 0) {
+        sched_yield();
+      }
+
+      pushed += more;
+    }
+
+    i += n;
+  }
+
+  return NULL;
+}
+
+static void *produce_mpsc(void *arg) {
+  struct producer_s *producer = arg;
+  const struct queue_bench_s *config = producer->config;
+  result_stamp_t batch[BATCH];
+
+  for (uint64_t i = 0; i < producer->count;) {
+    size_t n = (size_t) w_min_2((uint64_t) config->batch, producer->count - i);
+
+    for (size_t j = 0; j < n; j++) {
+      batch[j] = stamp(config, producer->first + i + j);
+    }
+
+    for (size_t pushed = 0; pushed < n;) {
+      size_t more = result_mpsc_push_n(
+        (mpsc_stamp_t *) producer->queue,
+        &batch[pushed],
+        n - pushed
+      );
+
+      if (more == 0) {
+        sched_yield();
+      }
+
+      pushed += more;
+    }
+
+    i += n;
+  }
+
+  return NULL;
+}
+
+static void start_producers(
+  struct queue_bench_s *config,
+  void *queue,
+  void *(*produce)(void *),
+  uint64_t iterations,
+  pthread_t *threads,
+  struct producer_s *producers
+) {
+  uint64_t share = iterations / config->producers;
+
+  config->samples_len = 0;
+
+  for (size_t p = 0; p < config->producers; p++) {
+    producers[p] = (struct producer_s) {
+      .queue = queue,
+      .config = config,
+      .first = p * share,
+      .count = p + 1 == config->producers ? iterations - p * share : share,
+    };
+
+    pthread_create(&threads[p], NULL, produce, &producers[p]);
+  }
+}
+
+static void join_producers(struct queue_bench_s *config, pthread_t *threads) {
+  for (size_t p = 0; p < config->producers; p++) {
+    pthread_join(threads[p], NULL);
+  }
+}
+
+static uint64_t bench_spsc(void *arg, uint64_t iterations) {
+  struct queue_bench_s *config = arg;
+  struct producer_s producers[1];
+  pthread_t threads[1];
+  result_stamp_t batch[BATCH];
+  spsc_stamp_t queue;
+  uint64_t sum = 0;
+
+  result_spsc_init(&queue, CAPACITY);
+  start_producers(config, &queue, produce_spsc, iterations, threads, producers);
+
+  for (uint64_t i = 0; i < iterations;) {
+    size_t n = result_spsc_pop_n(&queue, batch, config->batch);
+
+    if (n == 0) {
+      sched_yield();
+    }
+
+    for (size_t j = 0; j < n; j++, i++) {
+      sample(config, result_unwrap_or(batch[j], 0));
+      sum += result_is_ok(batch[j]);
+    }
+  }
+
+  join_producers(config, threads);
+  result_spsc_free(&queue);
+
+  return sum;
+}
+
+static uint64_t bench_mpsc(void *arg, uint64_t iterations) {
+  struct queue_bench_s *config = arg;
+  struct producer_s producers[MAX_PRODUCERS];
+  pthread_t threads[MAX_PRODUCERS];
+  result_stamp_t batch[BATCH];
+  mpsc_stamp_t queue;
+  uint64_t sum = 0;
+
+  result_mpsc_init(&queue, CAPACITY);
+  start_producers(config, &queue, produce_mpsc, iterations, threads, producers);
+
+  for (uint64_t i = 0; i < iterations;) {
+    size_t n = result_mpsc_pop_n(&queue, batch, config->batch);
+
+    if (n == 0) {
+      sched_yield();
+    }
+
+    for (size_t j = 0; j < n; j++, i++) {
+      sample(config, result_unwrap_or(batch[j], 0));
+      sum += result_is_ok(batch[j]);
+    }
+  }
+
+  join_producers(config, threads);
+  result_mpsc_free(&queue);
+
+  return sum;
+}
+
+static uint64_t bench_spsc_pop_ok_n(void *arg, uint64_t iterations) {
+  struct queue_bench_s *config = arg;
+  struct producer_s producers[1];
+  pthread_t threads[1];
+  uint64_t ok[BATCH];
+  result_stamp_t err;
+  spsc_stamp_t queue;
+  mpsc_stamp_t errs;
+  uint64_t sum = 0;
+
+  result_spsc_init(&queue, CAPACITY);
+  result_mpsc_init(&errs, CAPACITY);
+  start_producers(config, &queue, produce_spsc, iterations, threads, producers);
+
+  for (uint64_t i = 0; i < iterations;) {
+    uint64_t errs_before = result_mpsc_len(&errs);
+    size_t n = result_spsc_pop_ok_n(&queue, ok, config->batch, &errs);
+    uint64_t errs_popped = result_mpsc_len(&errs) - errs_before;
+
+    for (size_t j = 0; j < n; j++) {
+      sample(config, ok[j]);
+      sum += ok[j] != 0;
+    }
+
+    i += n + errs_popped;
+
+    // the last stage of the pipeline, picking the errs up
+    if (result_mpsc_len(&errs) >= CAPACITY / 2 || n + errs_popped == 0) {
+      while (result_mpsc_pop(&errs, &err)) {
+        sum += (uint64_t) result_unwrap_err_unchecked(err);
+      }
+    }
+
+    if (n + errs_popped == 0) {
+      sched_yield();
+    }
+  }
+
+  join_producers(config, threads);
+  result_spsc_free(&queue);
+  result_mpsc_free(&errs);
+
+  return sum;
+}
+
+void bench_queue(struct bench_s *bench) {
+  static struct queue_bench_s config;
+  static uint8_t patterns[w_array_size(bench_error_rates)][PATTERN_LEN];
+  static const size_t batches[] = { 1, BATCH };
+  static const size_t producers[] = { 1, 2, 4, 8, 16, 32 };
+  char name[128];
+
+  for (size_t b = 0; b < w_array_size(batches); b++) {
+    const char *mode = batches[b] == 1 ? "single" : "batch";
+
+    config.producers = 1;
+    config.batch = batches[b];
+    config.fail = NULL;
+    snprintf(name, sizeof(name), "queue/spsc/%s", mode);
+    bench_run(bench, name, bench_spsc, &config);
+    bench_report_latency(bench, name, config.samples, config.samples_len);
+
+    for (size_t p = 0; p < w_array_size(producers); p++) {
+      config.producers = producers[p];
+
+      snprintf(
+        name, sizeof(name), "queue/mpsc/%s/producers=%zu", mode, producers[p]
+      );
+
+      bench_run(bench, name, bench_mpsc, &config);
+      bench_report_latency(bench, name, config.samples, config.samples_len);
+    }
+  }
+
+  for (size_t r = 0; r < w_array_size(bench_error_rates); r++) {
+    unsigned rate = bench_error_rates[r];
+
+    bench_fill_pattern(patterns[r], PATTERN_LEN, rate);
+
+    config.producers = 1;
+    config.batch = BATCH;
+    config.fail = patterns[r];
+
+    snprintf(name, sizeof(name), "queue/spsc/pop_ok_n/err=%u%%", rate);
+    bench_run(bench, name, bench_spsc_pop_ok_n, &config);
+    bench_report_latency(bench, name, config.samples, config.samples_len);
+  }
+}
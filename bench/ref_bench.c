@@ -0,0 +1,142 @@
+#include "bench.h"
+#include "result.h"
+
+//
+// Copying versus by-reference access to big payloads, one operation is one
+// result out of an array of LEN:
+//
+//   - with/copy: result_with_ok, which copies the body into the variable
+//   - with/ref: result_with_ok_ref, which points into it
+//   - build/literal: filling a payload and assigning result_init_ok(payload)
+//   - build/emplace: filling the body through result_emplace_ok
+//
+// The payload is handed to an out of line function in every case, the way
+// real code would use it, so the copies can't be optimized away.
+//
+
+#define LEN 64
+
+#define define_ref_bench(_size) \
+  typedef struct { uint64_t words[_size / 8]; } payload_##_size##_t; \
+  typedef result_t(payload_##_size##_t, int) result_##_size##_t; \
+  \
+  static bench_noinline uint64_t use_##_size( \
+    const payload_##_size##_t *payload \
+  ) { \
+    return payload->words[0] + payload->words[_size / 8 - 1]; \
+  } \
+  \
+  static bench_noinline void fill_##_size( \
+    payload_##_size##_t *payload, \
+    uint64_t i \
+  ) { \
+    for (size_t w = 0; w < _size / 8; w++) { \
+      payload->words[w] = i + w; \
+    } \
+  } \
+  \
+  static uint64_t bench_with_copy_##_size(void *arg, uint64_t iterations) { \
+    const result_##_size##_t *results = arg; \
+    uint64_t total = 0; \
+    \
+    for (uint64_t i = 0; i < iterations; i++) { \
+      result_with_ok(results[i % LEN], value) { \
+        total += use_##_size(&value); \
+      } \
+    } \
+    \
+    return total; \
+  } \
+  \
+  static uint64_t bench_with_ref_##_size(void *arg, uint64_t iterations) { \
+    const result_##_size##_t *results = arg; \
+    uint64_t total = 0; \
+    \
+    for (uint64_t i = 0; i < iterations; i++) { \
+      result_with_ok_ref(results[i % LEN], value) { \
+        total += use_##_size(value); \
+      } \
+    } \
+    \
+    return total; \
+  } \
+  \
+  static uint64_t bench_build_literal_##_size( \
+    void *arg, \
+    uint64_t iterations \
+  ) { \
+    result_##_size##_t *results = arg; \
+    \
+    for (uint64_t i = 0; i < iterations; i++) { \
+      payload_##_size##_t payload; \
+      \
+      fill_##_size(&payload, i); \
+      results[i % LEN] = (result_##_size##_t) result_init_ok(payload); \
+    } \
+    \
+    bench_escape(results); \
+    return iterations; \
+  } \
+  \
+  static uint64_t bench_build_emplace_##_size( \
+    void *arg, \
+    uint64_t iterations \
+  ) { \
+    result_##_size##_t *results = arg; \
+    \
+    for (uint64_t i = 0; i < iterations; i++) { \
+      fill_##_size(result_emplace_ok(results[i % LEN]), i); \
+    } \
+    \
+    bench_escape(results); \
+    return iterations; \
+  } \
+  \
+  static void bench_ref_##_size(struct bench_s *bench) { \
+    result_##_size##_t *results = malloc(LEN * sizeof(*results)); \
+    uint8_t pattern[LEN]; \
+    \
+    for (size_t r = 0; r < w_array_size(bench_error_rates); r++) { \
+      unsigned rate = bench_error_rates[r]; \
+      \
+      bench_fill_pattern(pattern, LEN, rate); \
+      \
+      for (size_t i = 0; i < LEN; i++) { \
+        if (pattern[i]) { \
+          results[i] = (result_##_size##_t) result_init_err((int) i); \
+        } else { \
+          fill_##_size(result_emplace_ok(results[i]), i); \
+        } \
+      } \
+      \
+      bench_runf( \
+        bench, bench_with_copy_##_size, results, \
+        "ref/with/copy/%d/err=%u%%", _size, rate \
+      ); \
+      \
+      bench_runf( \
+        bench, bench_with_ref_##_size, results, \
+        "ref/with/ref/%d/err=%u%%", _size, rate \
+      ); \
+    } \
+    \
+    bench_runf( \
+      bench, bench_build_literal_##_size, results, \
+      "ref/build/literal/%d", _size \
+    ); \
+    \
+    bench_runf( \
+      bench, bench_build_emplace_##_size, results, \
+      "ref/build/emplace/%d", _size \
+    ); \
+    \
+    free(results); \
+  }
+
+define_ref_bench(256)
+define_ref_bench(2048)
+
+void bench_ref(struct bench_s *bench) {
+  bench_ref_256(bench);
+  bench_ref_2048(bench);
+}
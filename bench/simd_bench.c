@@ -0,0 +1,204 @@
+#include "bench.h"
+#include "result_simd.h"
+
+//
+// result_simd.h bulk kernels at every level the CPU supports, versus the
+// obvious loop over the result.h macros (which is what the compiler gets to
+// auto-vectorize on its own). One operation is one element.
+//
+
+#define ARRAY_LEN 4096
+
+typedef result_t(int32_t, int32_t) result_i32_t;
+typedef result_padded_t(int32_t, int32_t) result_padded_i32_t;
+
+struct simd_arg_s {
+  const void *array;
+  enum result_simd_level_e level;
+};
+
+static const char *level_names[] = {
+  [RESULT_SIMD_SCALAR] = "scalar",
+  [RESULT_SIMD_SSE2] = "sse2",
+  [RESULT_SIMD_AVX2] = "avx2",
+  [RESULT_SIMD_AVX512] = "avx512",
+};
+
+// `_body` runs once per ARRAY_LEN elements with `array`, `out`, `out_elements`
+// and `sum` in scope.
+#define define_simd_bench(_name, _type, _body) \
+  static uint64_t bench_##_name(void *arg, uint64_t iterations) { \
+    const struct simd_arg_s *simd = arg; \
+    const _type *array = simd->array; \
+    static int32_t out[ARRAY_LEN]; \
+    static _type out_elements[ARRAY_LEN]; \
+    uint64_t sum = 0; \
+    \
+    result_simd_force_level(simd->level); \
+    \
+    for (uint64_t i = 0; i < iterations; i += ARRAY_LEN) { \
+      bench_clobber(); \
+      _body; \
+      bench_escape(out); \
+      bench_escape(out_elements); \
+    } \
+    \
+    return sum; \
+  }
+
+#define define_type_benches(_prefix, _type) \
+  define_simd_bench(_prefix##_count_err_loop, _type, { \
+    for (size_t j = 0; j < ARRAY_LEN; j++) { \
+      sum += result_is_err(array[j]); \
+    } \
+  }) \
+  \
+  define_simd_bench(_prefix##_count_err, _type, { \
+    sum += result_count_err(array, ARRAY_LEN); \
+  }) \
+  \
+  define_simd_bench(_prefix##_unwrap_or_loop, _type, { \
+    for (size_t j = 0; j < ARRAY_LEN; j++) { \
+      out[j] = result_unwrap_or(array[j], -1); \
+    } \
+  }) \
+  \
+  define_simd_bench(_prefix##_unwrap_or, _type, { \
+    result_unwrap_or_array(array, ARRAY_LEN, -1, out); \
+  }) \
+  \
+  define_simd_bench(_prefix##_compact_ok_loop, _type, { \
+    size_t n = 0; \
+    \
+    for (size_t j = 0; j < ARRAY_LEN; j++) { \
+      if (result_is_ok(array[j])) { \
+        out[n++] = result_unwrap_unchecked(array[j]); \
+      } \
+    } \
+    \
+    sum += n; \
+  }) \
+  \
+  define_simd_bench(_prefix##_compact_ok, _type, { \
+    sum += result_compact_ok(array, ARRAY_LEN, out); \
+  }) \
+  \
+  define_simd_bench(_prefix##_partition_loop, _type, { \
+    size_t n = 0; \
+    \
+    for (size_t j = 0; j < ARRAY_LEN; j++) { \
+      if (result_is_ok(array[j])) { \
+        out_elements[n++] = array[j]; \
+      } \
+    } \
+    \
+    sum += n; \
+    \
+    for (size_t j = 0; j < ARRAY_LEN; j++) { \
+      if (result_is_err(array[j])) { \
+        out_elements[n++] = array[j]; \
+      } \
+    } \
+  }) \
+  \
+  define_simd_bench(_prefix##_partition, _type, { \
+    sum += result_partition(array, ARRAY_LEN, out_elements); \
+  })
+
+define_type_benches(i32, result_i32_t)
+define_type_benches(padded, result_padded_i32_t)
+
+struct simd_bench_s {
+  const char *type;
+  bool is_padded;
+  const char *op;
+  bench_fn_t loop;
+  bench_fn_t kernel;
+};
+
+#define simd_benches(_prefix, _type_name, _is_padded) \
+  { \
+    _type_name, _is_padded, "count_err", \
+    bench_##_prefix##_count_err_loop, bench_##_prefix##_count_err \
+  }, \
+  { \
+    _type_name, _is_padded, "unwrap_or", \
+    bench_##_prefix##_unwrap_or_loop, bench_##_prefix##_unwrap_or \
+  }, \
+  { \
+    _type_name, _is_padded, "compact_ok", \
+    bench_##_prefix##_compact_ok_loop, bench_##_prefix##_compact_ok \
+  }, \
+  { \
+    _type_name, _is_padded, "partition", \
+    bench_##_prefix##_partition_loop, bench_##_prefix##_partition \
+  }
+
+static const struct simd_bench_s simd_benches[] = {
+  simd_benches(i32, "result_t(int32_t,int32_t)", false),
+  simd_benches(padded, "result_padded_t(int32_t,int32_t)", true),
+};
+
+void bench_simd(struct bench_s *bench) {
+  static result_i32_t i32_arrays[w_array_size(bench_error_rates)][ARRAY_LEN];
+  static result_padded_i32_t padded_arrays[w_array_size(bench_error_rates)][ARRAY_LEN];
+  static uint8_t pattern[ARRAY_LEN];
+
+  enum result_simd_level_e best = result_simd_force_level(RESULT_SIMD_AVX512);
+
+  for (size_t r = 0; r < w_array_size(bench_error_rates); r++) {
+    bench_fill_pattern(pattern, ARRAY_LEN, bench_error_rates[r]);
+
+    for (size_t i = 0; i < ARRAY_LEN; i++) {
+      if (pattern[i]) {
+        result_set_err(i32_arrays[r][i], (int32_t) i);
+        result_set_err(padded_arrays[r][i], (int32_t) i);
+      } else {
+        result_set_ok(i32_arrays[r][i], (int32_t) i);
+        result_set_ok(padded_arrays[r][i], (int32_t) i);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < w_array_size(simd_benches); i++) {
+    const struct simd_bench_s *sb = &simd_benches[i];
+
+    for (size_t r = 0; r < w_array_size(bench_error_rates); r++) {
+      const void *array = sb->is_padded
+        ? (const void *) padded_arrays[r]
+        : (const void *) i32_arrays[r];
+
+      struct simd_arg_s loop_arg = { .array = array, .level = best };
+
+      bench_runf(
+        bench,
+        sb->loop,
+        &loop_arg,
+        "simd/%s/%s/loop/err=%u%%",
+        sb->type,
+        sb->op,
+        bench_error_rates[r]
+      );
+
+      for (int level = 0; level <= (int) best; level++) {
+        struct simd_arg_s arg = {
+          .array = array,
+          .level = (enum result_simd_level_e) level,
+        };
+
+        bench_runf(
+          bench,
+          sb->kernel,
+          &arg,
+          "simd/%s/%s/%s/err=%u%%",
+          sb->type,
+          sb->op,
+          level_names[level],
+          bench_error_rates[r]
+        );
+      }
+    }
+  }
+
+  result_simd_force_level(RESULT_SIMD_AVX512);
+}
@@ -0,0 +1,184 @@
+#include "bench.h"
+#include "result.h"
+
+//
+// result_try_map_err versus the hand-written
+//
+//   if (result_is_err(res)) return convert(res);
+//
+// through a three level call chain where every level does some bookkeeping on
+// the error path. The hand-written version lays that bookkeeping out inline
+// between the calls, result_try moves it to the .cold part of each function:
+//
+//   objdump -d result_bench | grep -A20 'try_level_2.*cold'
+//
+
+#define PATTERN_LEN 4096
+#define PATTERN_MASK (PATTERN_LEN - 1)
+#define TRACE_LEN 64
+
+typedef result_t(uint64_t, int) result_u64_t;
+
+static struct {
+  uint32_t trace[TRACE_LEN];
+  uint64_t trace_len;
+  uint64_t errors;
+} self;
+
+static inline result_u64_t wrap_err(int err) {
+  // typical error path bookkeeping: remember where the error came from
+  self.trace[self.trace_len++ & (TRACE_LEN - 1)] = (uint32_t) err;
+  self.errors++;
+
+  if (self.errors % 1024 == 0) {
+    memset(self.trace, 0, sizeof(self.trace));
+  }
+
+  return (result_u64_t) result_init_err(err * 31 + 7);
+}
+
+static bench_noinline result_u64_t leaf(uint64_t i, const uint8_t *fail) {
+  if (fail[i & PATTERN_MASK]) {
+    return (result_u64_t) result_init_err((int) (i & 0xff));
+  }
+
+  return (result_u64_t) result_init_ok(i * 3);
+}
+
+//
+// hand-written
+//
+
+static bench_noinline result_u64_t hand_level_3(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  result_u64_t a = leaf(i, fail);
+
+  if (result_is_err(a)) {
+    return wrap_err(result_unwrap_err_unchecked(a));
+  }
+
+  result_u64_t b = leaf(i + 1, fail);
+
+  if (result_is_err(b)) {
+    return wrap_err(result_unwrap_err_unchecked(b));
+  }
+
+  return (result_u64_t) result_init_ok(
+    result_unwrap_unchecked(a) + result_unwrap_unchecked(b)
+  );
+}
+
+static bench_noinline result_u64_t hand_level_2(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  result_u64_t a = hand_level_3(i, fail);
+
+  if (result_is_err(a)) {
+    return wrap_err(result_unwrap_err_unchecked(a));
+  }
+
+  result_u64_t b = hand_level_3(i + 2, fail);
+
+  if (result_is_err(b)) {
+    return wrap_err(result_unwrap_err_unchecked(b));
+  }
+
+  return (result_u64_t) result_init_ok(
+    result_unwrap_unchecked(a) ^ result_unwrap_unchecked(b)
+  );
+}
+
+static bench_noinline result_u64_t hand_level_1(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  result_u64_t a = hand_level_2(i, fail);
+
+  if (result_is_err(a)) {
+    return wrap_err(result_unwrap_err_unchecked(a));
+  }
+
+  result_u64_t b = hand_level_2(i + 4, fail);
+
+  if (result_is_err(b)) {
+    return wrap_err(result_unwrap_err_unchecked(b));
+  }
+
+  return (result_u64_t) result_init_ok(
+    result_unwrap_unchecked(a) + result_unwrap_unchecked(b)
+  );
+}
+
+//
+// result_try_map_err
+//
+
+static bench_noinline result_u64_t try_level_3(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  uint64_t a = result_try_map_err(leaf(i, fail), wrap_err);
+  uint64_t b = result_try_map_err(leaf(i + 1, fail), wrap_err);
+
+  return (result_u64_t) result_init_ok(a + b);
+}
+
+static bench_noinline result_u64_t try_level_2(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  uint64_t a = result_try_map_err(try_level_3(i, fail), wrap_err);
+  uint64_t b = result_try_map_err(try_level_3(i + 2, fail), wrap_err);
+
+  return (result_u64_t) result_init_ok(a ^ b);
+}
+
+static bench_noinline result_u64_t try_level_1(
+  uint64_t i,
+  const uint8_t *fail
+) {
+  uint64_t a = result_try_map_err(try_level_2(i, fail), wrap_err);
+  uint64_t b = result_try_map_err(try_level_2(i + 4, fail), wrap_err);
+
+  return (result_u64_t) result_init_ok(a + b);
+}
+
+#define define_chain_bench(_name) \
+  static uint64_t bench_chain_##_name(void *arg, uint64_t iterations) { \
+    const uint8_t *fail = arg; \
+    uint64_t sum = 0; \
+    \
+    for (uint64_t i = 0; i < iterations; i++) { \
+      result_u64_t res = _name##_level_1(i * 8, fail); \
+      sum += result_unwrap_or(res, 1); \
+    } \
+    \
+    return sum; \
+  }
+
+define_chain_bench(hand)
+define_chain_bench(try)
+
+void bench_try(struct bench_s *bench) {
+  static uint8_t patterns[w_array_size(bench_error_rates)][PATTERN_LEN];
+
+  for (size_t r = 0; r < w_array_size(bench_error_rates); r++) {
+    // each chain makes 8 leaf calls, so scale the per-leaf rate down to get
+    // roughly the requested rate per chain
+    unsigned rate = bench_error_rates[r];
+    unsigned leaf_rate = rate == 0 ? 0 : w_max_2(rate / 8, 1u);
+
+    bench_fill_pattern(patterns[r], PATTERN_LEN, leaf_rate);
+
+    bench_runf(
+      bench, bench_chain_hand, patterns[r], "try/hand-written/err=%u%%", rate
+    );
+
+    bench_runf(
+      bench, bench_chain_try, patterns[r], "try/result_try_map_err/err=%u%%", rate
+    );
+  }
+}
@@ -0,0 +1,176 @@
+#
+# Checks the disassembly of codegen/probes.c against a budgets file.
+#
+#   cmake \
+#     -D OBJDUMP=objdump \
+#     -D OBJECT=probes-gcc-O2.o \
+#     -D BUDGETS=codegen/budgets-gcc-12.txt \
+#     -D VARIANT="gcc -O2" \
+#     -P codegen/check.cmake
+#
+# Every probe over its budget is printed as a diff of the budget line against
+# what was measured, followed by its disassembly.
+#
+
+cmake_minimum_required(VERSION 3.20)
+
+foreach (variable OBJDUMP OBJECT BUDGETS VARIANT)
+  if (NOT DEFINED ${variable})
+    message(FATAL_ERROR "${variable} is not set")
+  endif()
+endforeach()
+
+execute_process(
+  COMMAND "${OBJDUMP}" -d --no-show-raw-insn "${OBJECT}"
+  OUTPUT_VARIABLE disassembly
+  ERROR_VARIABLE objdump_error
+  RESULT_VARIABLE objdump_status
+)
+
+if (NOT objdump_status EQUAL 0)
+  message(FATAL_ERROR "${OBJDUMP} failed: ${objdump_error}")
+endif()
+
+function(pad _out _text _width)
+  string(LENGTH "${_text}" length)
+  set(padded "${_text}")
+
+  while (length LESS _width)
+    string(APPEND padded " ")
+    math(EXPR length "${length} + 1")
+  endwhile()
+
+  set(${_out} "${padded}" PARENT_SCOPE)
+endfunction()
+
+function(format_line _out _prefix _name _insns _branches _stores)
+  pad(name "${_name}" 27)
+  pad(insns "${_insns}" 6)
+  pad(branches "${_branches}" 9)
+  set(${_out} "${_prefix}${name} ${insns} ${branches} ${_stores}" PARENT_SCOPE)
+endfunction()
+
+#
+# Count instructions, branches and stores per function
+#
+
+string(REPLACE "\n" ";" lines "${disassembly}")
+set(functions "")
+set(current "")
+
+foreach (line IN LISTS lines)
+  # any symbol, eg. a helper's `.constprop.0` clone, so that its instructions
+  # aren't counted in the probe before it
+  if (line MATCHES "^[0-9a-f]+ <([^>]+)>:$")
+    set(current "${CMAKE_MATCH_1}")
+    list(APPEND functions "${current}")
+    set(insns_${current} 0)
+    set(branches_${current} 0)
+    set(stores_${current} 0)
+    set(listing_${current} "")
+    continue()
+  endif()
+
+  if (current STREQUAL "" OR NOT line MATCHES "^ *[0-9a-f]+:\t([a-z0-9]+)(.*)$")
+    continue()
+  endif()
+
+  set(mnemonic "${CMAKE_MATCH_1}")
+  set(operands "${CMAKE_MATCH_2}")
+
+  # alignment padding between functions
+  if (line MATCHES "nop" OR mnemonic MATCHES "^(int3|endbr64)$")
+    continue()
+  endif()
+
+  math(EXPR insns_${current} "${insns_${current}} + 1")
+  string(APPEND listing_${current} "      ${line}\n")
+
+  if (mnemonic MATCHES "^(j[a-z]+|call[a-z]*)$")
+    math(EXPR branches_${current} "${branches_${current}} + 1")
+  endif()
+
+  # AT&T syntax, the destination is the last operand
+  string(REGEX REPLACE "^.*," "" destination "${operands}")
+
+  if (mnemonic MATCHES "^(push[a-z]*|call[a-z]*)$"
+  OR (destination MATCHES "\\(" AND NOT mnemonic MATCHES "^(cmp|test|bt)"))
+    math(EXPR stores_${current} "${stores_${current}} + 1")
+  endif()
+endforeach()
+
+#
+# Compare with the budgets
+#
+
+file(STRINGS "${BUDGETS}" budget_lines)
+set(report "")
+set(checked 0)
+set(failed 0)
+
+foreach (line IN LISTS budget_lines)
+  if (line MATCHES "^#" OR line MATCHES "^[ \t]*$")
+    continue()
+  endif()
+
+  set(col "[ \t]+([0-9]+|-)")
+
+  if (NOT line MATCHES "^([A-Za-z0-9_]+)[ \t]+([0-9]+)${col}${col}[ \t]*$")
+    message(FATAL_ERROR "can't parse ${BUDGETS}: ${line}")
+  endif()
+
+  set(name "${CMAKE_MATCH_1}")
+  set(max_insns "${CMAKE_MATCH_2}")
+  set(max_branches "${CMAKE_MATCH_3}")
+  set(max_stores "${CMAKE_MATCH_4}")
+  math(EXPR checked "${checked} + 1")
+
+  if (NOT name IN_LIST functions)
+    string(APPEND report "${name}: not found in ${OBJECT}\n\n")
+    math(EXPR failed "${failed} + 1")
+    continue()
+  endif()
+
+  set(over FALSE)
+
+  if (insns_${name} GREATER max_insns)
+    set(over TRUE)
+  endif()
+
+  if (NOT max_branches STREQUAL "-" AND branches_${name} GREATER max_branches)
+    set(over TRUE)
+  endif()
+
+  if (NOT max_stores STREQUAL "-" AND stores_${name} GREATER max_stores)
+    set(over TRUE)
+  endif()
+
+  if (over)
+    format_line(
+      expected "-" "${name}" "${max_insns}" "${max_branches}" "${max_stores}"
+    )
+
+    format_line(
+      actual "+" "${name}" "${insns_${name}}" "${branches_${name}}"
+      "${stores_${name}}"
+    )
+
+    string(APPEND report "${expected}\n${actual}\n${listing_${name}}\n")
+    math(EXPR failed "${failed} + 1")
+  endif()
+endforeach()
+
+if (failed GREATER 0)
+  # NOTICE prints as is, FATAL_ERROR would reflow the columns
+  message(NOTICE
+    "--- budget (${BUDGETS})\n"
+    "+++ actual (${VARIANT})\n"
+    "${report}"
+  )
+
+  message(FATAL_ERROR
+    "${failed} of ${checked} probes over budget with ${VARIANT}"
+  )
+endif()
+
+message(STATUS "${checked} probes within budget with ${VARIANT}")
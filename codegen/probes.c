@@ -0,0 +1,117 @@
+#include "result.h"
+
+//
+// Probe functions for the codegen harness, one macro each. codegen/check.cmake
+// disassembles them and compares them against the budgets of the compiler,
+// codegen/budgets-<compiler>-<major>.txt.
+//
+// Results are passed and returned by value, so the probes also show whether
+// a result travels in registers: the 16 byte result_u64_t should, in two.
+//
+
+struct node_s {
+  uint64_t key;
+};
+
+enum node_err_e { NODE_ERR_NONE, NODE_ERR_MISSING, NODE_ERR_BUSY };
+
+typedef result_t(uint64_t, int) result_u64_t;
+typedef result_t(uint32_t, int) result_u32_t;
+typedef result_nonneg_t(int) result_nonneg_int_t;
+typedef result_nonnull_t(char *) result_str_t;
+typedef result_tagged_ptr_t(struct node_s, enum node_err_e, NODE_ERR_BUSY)
+  result_node_t;
+
+bool probe_is_ok(const result_u64_t *res);
+bool probe_is_ok_nonneg(result_nonneg_int_t res);
+bool probe_is_ok_nonnull(result_str_t res);
+bool probe_is_ok_tagged(result_node_t res);
+uint64_t probe_unwrap_or(result_u64_t res, uint64_t default_value);
+uint32_t probe_unwrap_or_u32(result_u32_t res, uint32_t default_value);
+int probe_unwrap_or_nonneg(result_nonneg_int_t res, int default_value);
+uint64_t probe_unwrap_or_else(result_u64_t res, uint64_t default_value);
+result_u64_t probe_and(result_u64_t a, result_u64_t b);
+result_u64_t probe_or(result_u64_t a, result_u64_t b);
+result_nonneg_int_t probe_and_nonneg(
+  result_nonneg_int_t a,
+  result_nonneg_int_t b
+);
+result_str_t probe_or_nonnull(result_str_t a, result_str_t b);
+result_u64_t probe_ok(uint64_t value);
+result_u64_t probe_err(int err);
+result_u32_t probe_set_err(result_u32_t res, int err);
+uint64_t probe_unwrap_after_check(result_u64_t res);
+
+bool probe_is_ok(const result_u64_t *res) {
+  return result_is_ok(*res);
+}
+
+bool probe_is_ok_nonneg(result_nonneg_int_t res) {
+  return result_is_ok(res);
+}
+
+bool probe_is_ok_nonnull(result_str_t res) {
+  return result_is_ok(res);
+}
+
+bool probe_is_ok_tagged(result_node_t res) {
+  return result_is_ok(res);
+}
+
+uint64_t probe_unwrap_or(result_u64_t res, uint64_t default_value) {
+  return result_unwrap_or(res, default_value);
+}
+
+uint32_t probe_unwrap_or_u32(result_u32_t res, uint32_t default_value) {
+  return result_unwrap_or(res, default_value);
+}
+
+int probe_unwrap_or_nonneg(result_nonneg_int_t res, int default_value) {
+  return result_unwrap_or(res, default_value);
+}
+
+// The flag that tells the block to run must not be stored anywhere.
+uint64_t probe_unwrap_or_else(result_u64_t res, uint64_t default_value) {
+  uint64_t value = result_unwrap_or_else(res) {
+    value = default_value;
+  }
+
+  return value;
+}
+
+result_u64_t probe_and(result_u64_t a, result_u64_t b) {
+  return result_and(a, b);
+}
+
+result_u64_t probe_or(result_u64_t a, result_u64_t b) {
+  return result_or(a, b);
+}
+
+result_nonneg_int_t probe_and_nonneg(
+  result_nonneg_int_t a,
+  result_nonneg_int_t b
+) {
+  return result_and(a, b);
+}
+
+result_str_t probe_or_nonnull(result_str_t a, result_str_t b) {
+  return result_or(a, b);
+}
+
+result_u64_t probe_ok(uint64_t value) {
+  return (result_u64_t) result_init_ok(value);
+}
+
+result_u64_t probe_err(int err) {
+  return (result_u64_t) result_init_err(err);
+}
+
+result_u32_t probe_set_err(result_u32_t res, int err) {
+  result_set_err(res, err);
+  return res;
+}
+
+// With RESULT_CHECKED, the accessor's own check has to fold into this one.
+uint64_t probe_unwrap_after_check(result_u64_t res) {
+  return result_is_ok(res) ? result_unwrap_unchecked(res) : 0;
+}
@@ -22,7 +22,11 @@
 #
 
 set(CMAKE_C_FLAGS_RELEASE "-D NDEBUG -O3")
+set(CMAKE_C_FLAGS_RELWITHLTO "-D NDEBUG -O3")
 set(CMAKE_C_FLAGS_DEBUG   "-D DEBUG  -O0 -g3")
+set(CMAKE_CXX_FLAGS_RELEASE "-D NDEBUG -O3")
+set(CMAKE_CXX_FLAGS_RELWITHLTO "-D NDEBUG -O3")
+set(CMAKE_CXX_FLAGS_DEBUG   "-D DEBUG  -O0 -g3")
 
 #
 # build type
@@ -30,8 +34,6 @@ set(CMAKE_C_FLAGS_DEBUG   "-D DEBUG  -O0 -g3")
 
 if (NOT CMAKE_BUILD_TYPE)
   set(CMAKE_BUILD_TYPE "Debug" CACHE STRING "" FORCE)
-else()
-  set(CMAKE_BUILD_TYPE "Debug" CACHE STRING "")
 endif()
 
 set_property(
@@ -39,8 +41,17 @@ set_property(
   PROPERTY STRINGS
     Debug
     Release
+    RelWithLTO
 )
 
+if (CMAKE_BUILD_TYPE STREQUAL "RelWithLTO")
+  # Release plus link time optimization, which also takes care of using
+  # gcc-ar for static libraries
+  include(CheckIPOSupported)
+  check_ipo_supported(LANGUAGES C CXX)
+  set(CMAKE_INTERPROCEDURAL_OPTIMIZATION ON)
+endif()
+
 #
 # link flags
 #
@@ -71,7 +82,10 @@ add_compile_options(
   -ffunction-sections
   -fdata-sections
 
-  -std=c99
+  # C++ sources (result.hpp and its tests) get the same warnings, minus the
+  # ones that only exist for C
+  $<$<COMPILE_LANGUAGE:C>:-std=c99>
+  $<$<COMPILE_LANGUAGE:CXX>:-std=c++20>
   -D_GNU_SOURCE
   -fms-extensions
 
@@ -79,23 +93,23 @@ add_compile_options(
   -Wextra
 
   -Werror
-  -Wimplicit-function-declaration
+  $<$<COMPILE_LANGUAGE:C>:-Wimplicit-function-declaration>
 
   # -Wdeclaration-after-statement
   -Wformat=2
   # -Wmissing-include-dirs
-  -Wnested-externs
-  -Wold-style-definition
+  $<$<COMPILE_LANGUAGE:C>:-Wnested-externs>
+  $<$<COMPILE_LANGUAGE:C>:-Wold-style-definition>
   # -Wpedantic
   -Wredundant-decls
   -Wshadow
   -Wwrite-strings
-  -Wstrict-prototypes
+  $<$<COMPILE_LANGUAGE:C>:-Wstrict-prototypes>
   -Wvla
 
   # Because this sort of thing is kind of common, we don't want to prevent that
   # struct foo_s foo = { FOO_defaults, .key = value };
-  -Wno-override-init
+  $<$<COMPILE_LANGUAGE:C>:-Wno-override-init>
 
   -Wno-missing-field-initializers
   -Wno-unused-parameter
@@ -146,7 +160,7 @@ AND CMAKE_C_COMPILER_VERSION VERSION_GREATER_EQUAL 7)
   )
 endif()
 
-if (CMAKE_BUILD_TYPE STREQUAL "Release")
+if (CMAKE_BUILD_TYPE MATCHES "^(Release|RelWithLTO)$")
   # in a release build some logging calls may be removed so the variables they
   # reference become unused, and similarly some functions might become unused
   # as well
@@ -6,6 +6,7 @@
 //
 
 #include <stdbool.h>
+#include <stdint.h>
 
 //
 // You can use the _t suffix (and typedef) to create anonymous structs when you
@@ -50,12 +51,257 @@
   union { bool is_ok; } header; \
 }
 
+// result_auto_t picks a layout from the sizes and alignments of the two types,
+// at compile time. With S the size of the bigger one and A the stricter
+// alignment:
+//
+//   - when S isn't a multiple of A, the union of the two has tail padding
+//     that neither ok nor err ever writes, so the header goes there. The body
+//     is packed (so it ends at S) and the whole struct aligned to A, eg.
+//     result_auto_t(char[5], int) is 8 bytes where result_t is 12.
+//   - otherwise there's nothing to reuse, and it's result_t with the header
+//     widened to A bytes.
+//
+// Either way the header fills what would have been padding, so there are no
+// padding bytes (like result_padded_t, but without the pointer-sized
+// header), and the result is as big as round_up(S + 1, A): never bigger than
+// result_t, and only bigger than result_packed_t by what it takes to keep
+// arrays of it aligned.
+//
+//   typedef result_auto_t(struct name_s, int) result_name_t;
+//
+// All the result.h macros work on it. Since the type is picked with __typeof,
+// there's no _d variant for forward declarations, and when the tail layout
+// is picked its body is packed: taking the address of body.ok or body.err
+// (the _ref macros, result_emplace_*) warns like it does for result_packed_t.
+// result_auto_has_tail tells which one it is.
+//
+// Smaller isn't always faster to return: when the tail layout brings a result
+// down to 16 bytes it's returned in two registers, and for an odd-sized
+// payload GCC assembles those through the stack with narrow stores and wide
+// loads that can't be forwarded (see layout/result_auto_t/13B in the bench).
+// The win is in arrays and anything else that keeps results in memory.
+
+#define result_auto_size(_type, _err_type) \
+  (sizeof(_type) > sizeof(_err_type) ? sizeof(_type) : sizeof(_err_type))
+
+#define result_auto_align(_type, _err_type) ( \
+  __alignof__(_type) > __alignof__(_err_type) \
+    ? __alignof__(_type) \
+    : __alignof__(_err_type) \
+)
+
+#define result_auto_has_tail(_type, _err_type) ( \
+  result_auto_size(_type, _err_type) % result_auto_align(_type, _err_type) \
+    != 0 \
+)
+
+#define result_auto_header_size(_type, _err_type) ( \
+  result_auto_align(_type, _err_type) \
+    - result_auto_size(_type, _err_type) % result_auto_align(_type, _err_type) \
+)
+
+#define result_auto_t(_type, _err_type) \
+  __typeof(__builtin_choose_expr( \
+    result_auto_has_tail(_type, _err_type), \
+    *(struct result_auto_tail_d(_type, _err_type) *) 0, \
+    *(struct result_auto_natural_d(_type, _err_type) *) 0 \
+  ))
+
+#define result_auto_tail_d(_type, _err_type) \
+  __attribute__((aligned(result_auto_align(_type, _err_type)))) { \
+    union __attribute__((packed)) { _type ok; _err_type err; } body; \
+    union { \
+      bool is_ok; \
+      char fill[result_auto_header_size(_type, _err_type)]; \
+    } header; \
+  }
+
+#define result_auto_natural_d(_type, _err_type) { \
+  union { _type ok; _err_type err; } body; \
+  union { \
+    bool is_ok; \
+    char fill[result_auto_header_size(_type, _err_type)]; \
+  } header; \
+}
+
+// Niche-optimized variants don't have a header of their own. Instead they
+// store the error in a value that the ok type can never hold, so they are
+// exactly as big as the payload and fit in a single register:
+//
+//   result_nonnull_t(_type)     ok is a non-NULL pointer, err is NULL
+//   result_nonneg_t(_type)      ok is >= 0, err is negative (eg. -EINVAL)
+//   result_status_t(_err_type)  ok is 0 (no payload), err is anything else
+//
+//   result_nonneg_t(ssize_t) res = result_init_err(-EINVAL);
+//
+// It is up to you to only store values that are in the right range: eg.
+// result_init_ok(-1) on a result_nonneg_t is an error.
+//
+// These are unions, not structs, so forward declarations look like
+//
+//   union named_u;
+//   union named_u result_nonneg_d(int);
+//
+// The header overlaps the body. Its is_ok member exists so that all the
+// result_init_*, result_set_* and result_ok/err macros compile unchanged: they
+// always write the header before the body, so the body wins (this needs
+// -Wno-override-init for the initializers). The type of is_ok tells
+// result_is_ok which niche to check.
+
+enum __attribute__((packed)) result_niche_nonnull_e { result_niche_nonnull };
+enum __attribute__((packed)) result_niche_nonneg_e { result_niche_nonneg };
+enum __attribute__((packed)) result_niche_status_e { result_niche_status };
+
+#define result_nonnull_t(_type) \
+  union result_nonnull_d(_type)
+
+#define result_nonnull_d(_type) { \
+  union { _type ok; _type err; } body; \
+  union { enum result_niche_nonnull_e is_ok; } header; \
+}
+
+#define result_nonneg_t(_type) \
+  union result_nonneg_d(_type)
+
+#define result_nonneg_d(_type) { \
+  union { _type ok; _type err; } body; \
+  union { enum result_niche_nonneg_e is_ok; } header; \
+}
+
+#define result_status_t(_err_type) \
+  union result_status_d(_err_type)
+
+#define result_status_d(_err_type) { \
+  union { _err_type ok; _err_type err; } body; \
+  union { enum result_niche_status_e is_ok; } header; \
+}
+
+// A tagged pointer result keeps small error codes in the low bits that the
+// alignment of `_type` guarantees to be zero in a valid pointer. The ok value
+// is a `_type *` (NULL is a valid ok value), the err is an error-only word
+// holding a code in the range [1, _err_max]. Checking it is a single `test`
+// of the low bits.
+//
+//   enum lookup_err_e { LOOKUP_ERR_NONE, LOOKUP_ERR_MISSING, LOOKUP_ERR_BUSY };
+//
+//   result_tagged_ptr_t(struct node_s, enum lookup_err_e, LOOKUP_ERR_BUSY) res
+//     = result_init_err(LOOKUP_ERR_MISSING);
+//
+// It fails to compile if the alignment of `_type` doesn't leave room for
+// `_err_max`. Error code 0 is reserved for ok and must not be used.
+//
+// The error is written into the first bytes of the word, which only lines up
+// with the low bits on little-endian targets.
+
+enum __attribute__((packed)) result_niche_tagged_e { result_niche_tagged };
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+#define result_tagged_ptr_t(_type, _err_type, _err_max) \
+  union result_tagged_ptr_d(_type, _err_type, _err_max)
+
+#define result_tagged_ptr_d(_type, _err_type, _err_max) { \
+  union { _type *ok; _err_type err; uintptr_t bits; } body; \
+  union { \
+    enum result_niche_tagged_e is_ok; \
+    char err_max_must_fit_in_alignment_bits[ \
+      (_err_max) > 0 && (_err_max) < __alignof__(_type) ? 0 : -1 \
+    ]; \
+  } header; \
+}
+
+#endif
+
 #define result_init_ok(_value) \
   { .header.is_ok = true, .body.ok = (_value) }
 
+#ifdef RESULT_SITE_COUNTERS
+
+// See result_sites.h, every err constructed here is counted per callsite.
+
+#include "result_sites.h"
+
+#define result_init_err(_err) { \
+  .header.is_ok = false, \
+  .body.err = (result_site_count("result_init_err"), (_err)) \
+}
+
+#define result_site_count_err(_macro) result_site_count(_macro)
+
+#else
+
 #define result_init_err(_err) \
   { .header.is_ok = false, .body.err = (_err) }
 
+#define result_site_count_err(_macro) ((void) 0)
+
+#endif
+
+#if defined(RESULT_CHECKED) && !defined(__cplusplus)
+
+// See result_checked.h, the unchecked accessors check and constructors fill
+// the inactive bytes with a pattern.
+
+#include "result_checked.h"
+
+#else
+
+#define result_checked_fill(_body) ((void) 0)
+
+#endif
+
+//
+// Every macro evaluates its `_result` argument exactly once, so it's fine to
+// pass a function call (or `results[i++]`). That needs GNU extensions; the
+// fallbacks without them, below, evaluate `_result` more than once and should
+// only be given plain variables.
+//
+// Macros that take a second expression and may be nested in themselves (eg.
+// result_unwrap_or(a, result_unwrap_or(b, 0))) name their temporaries with
+// result_unique so the inner one doesn't shadow the outer one.
+//
+
+#define result_unique(_name) result_unique_(_name, __COUNTER__)
+#define result_unique_(_name, _counter) result_unique__(_name, _counter)
+#define result_unique__(_name, _counter) _name##_##_counter
+
+#if defined(__GNUC__) || defined(__clang__)
+
+// `_result` must be an lvalue. The new value is evaluated before anything is
+// written, so it may read the result, eg. result_set_ok(res, res.body.ok + 1).
+
+#define result_set_ok(_result, _value) result_set_ok_( \
+  _result, _value, result_unique(result_set_self), \
+  result_unique(result_set_value) \
+)
+
+#define result_set_ok_(_result, _value, _self, _new) ({ \
+  __typeof(_result) *_self = &(_result); \
+  __typeof((_result).body.ok) _new = (_value); \
+  \
+  result_checked_fill(_self->body); \
+  _self->header.is_ok = true; \
+  _self->body.ok = _new; \
+})
+
+#define result_set_err(_result, _err) result_set_err_( \
+  _result, _err, result_unique(result_set_self), \
+  result_unique(result_set_value) \
+)
+
+#define result_set_err_(_result, _err, _self, _new) ({ \
+  __typeof(_result) *_self = &(_result); \
+  __typeof((_result).body.err) _new = (_err); \
+  \
+  result_site_count_err("result_set_err"); \
+  result_checked_fill(_self->body); \
+  _self->header.is_ok = false; \
+  _self->body.err = _new; \
+})
+
+#else
+
 #define result_set_ok(_result, _value) ( \
   (_result).header.is_ok = true, \
   (_result).body.ok = (_value) \
@@ -66,11 +312,164 @@
   (_result).body.err = (_err) \
 )
 
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+
+// Everything else is decided at compile time, so for the regular layouts this
+// is still just a read of header.is_ok. The niche checks only ever see the
+// body of their own kind of result, everyone else gets a dummy 0.
+
+#define result_niche_is(_result, _niche) \
+  __builtin_types_compatible_p( \
+    __typeof((_result).header.is_ok), \
+    enum result_niche_##_niche##_e \
+  )
+
+#define result_niche_body(_result, _niche) \
+  __builtin_choose_expr( \
+    result_niche_is(_result, _niche), \
+    (_result).body.ok, \
+    0 \
+  )
+
+#define result_tagged_body(_result) \
+  __builtin_choose_expr( \
+    result_niche_is(_result, tagged), \
+    (_result).body.ok, \
+    (char *) 0 \
+  )
+
+#define result_tagged_mask(_result) \
+  ((uintptr_t) __alignof__(*result_tagged_body(_result)) - 1)
+
+#define result_is_ok(_result) ( \
+  __builtin_choose_expr(result_niche_is(_result, tagged), \
+    ((uintptr_t) result_tagged_body(_result) & result_tagged_mask(_result)) \
+      == 0, \
+  __builtin_choose_expr(result_niche_is(_result, nonnull), \
+    result_niche_body(_result, nonnull) != 0, \
+  __builtin_choose_expr(result_niche_is(_result, nonneg), \
+    result_niche_body(_result, nonneg) >= 0, \
+  __builtin_choose_expr(result_niche_is(_result, status), \
+    result_niche_body(_result, status) == 0, \
+  (_result).header.is_ok)))) \
+)
+
+#else
+
+// Niche-optimized variants are not supported without GNU extensions.
+
 #define result_is_ok(_result) \
   (_result).header.is_ok
 
+#endif
+
 #define result_is_err(_result) \
-  (!((_result).header.is_ok))
+  (!result_is_ok(_result))
+
+#if defined(RESULT_CHECKED) && !defined(__cplusplus)
+
+#define result_unwrap_unchecked(_result) \
+  result_checked_unwrap( \
+    _result, ok, result_is_ok, "result_unwrap_unchecked of an err" \
+  )
+
+#define result_unwrap_err_unchecked(_result) \
+  result_checked_unwrap( \
+    _result, err, result_is_err, "result_unwrap_err_unchecked of an ok" \
+  )
+
+#else
+
+#define result_unwrap_unchecked(_result) \
+  (_result).body.ok
+
+#define result_unwrap_err_unchecked(_result) \
+  (_result).body.err
+
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+
+#define result_and(_a, _b) \
+  result_and_(_a, _b, result_unique(result_and_a))
+
+#define result_and_(_a, _b, _tmp) ({ \
+  __typeof(_a) _tmp = (_a); \
+  \
+  result_is_ok(_tmp) ? (_b) : _tmp; \
+})
+
+#define result_or(_a, _b) \
+  result_or_(_a, _b, result_unique(result_or_a))
+
+#define result_or_(_a, _b, _tmp) ({ \
+  __typeof(_a) _tmp = (_a); \
+  \
+  result_is_ok(_tmp) ? _tmp : (_b); \
+})
+
+#define result_unwrap_or(_result, _default_value) \
+  result_unwrap_or_(_result, _default_value, result_unique(result_unwrap_or))
+
+#define result_unwrap_or_(_result, _default_value, _tmp) ({ \
+  __typeof(_result) _tmp = (_result); \
+  \
+  result_is_ok(_tmp) \
+    ? result_unwrap_unchecked(_tmp) \
+    : (_default_value); \
+})
+
+// The macros ending in a block, like result_unwrap_or_else_ptr, can't declare
+// a variable for the result before the one they're assigned to, so they
+// evaluate it once and leave whether the block should run here. The `for`
+// right after copies it into a variable of its own (named per expansion)
+// before anything else can run, so the block can use these macros again
+// without affecting it. Nothing reads the flag otherwise, so from -O1 the
+// compiler forwards the store and drops the flag: no thread-local access is
+// left (see probe_unwrap_or_else in codegen/probes.c).
+
+static __thread bool result_else_taken __attribute__((unused));
+
+#define result_unwrap_or_else_ptr(_result) \
+  result_unwrap_or_else_ptr_(_result, result_unique(result_else_run))
+
+#define result_unwrap_or_else_ptr_(_result, _run) ({ \
+  __typeof(_result) *result_else_self = &(_result); \
+  \
+  result_else_taken = result_is_err(*result_else_self); \
+  \
+  result_else_taken \
+    ? NULL \
+    : &result_else_self->body.ok; \
+}); \
+  \
+  for (bool _run = result_else_taken; _run; _run = false)
+
+// The same for the err: a pointer into the body, or NULL (and the block runs)
+// when the result is ok.
+//
+//   const struct error_s *err = result_unwrap_err_or_else_ptr(res) {
+//     return;
+//   }
+
+#define result_unwrap_err_or_else_ptr(_result) \
+  result_unwrap_err_or_else_ptr_(_result, result_unique(result_else_run))
+
+#define result_unwrap_err_or_else_ptr_(_result, _run) ({ \
+  __typeof(_result) *result_else_self = &(_result); \
+  \
+  result_else_taken = result_is_ok(*result_else_self); \
+  \
+  result_else_taken \
+    ? NULL \
+    : &result_else_self->body.err; \
+}); \
+  \
+  for (bool _run = result_else_taken; _run; _run = false)
+
+#else
 
 #define result_and(_a, _b) ( \
   result_is_ok(_a) \
@@ -84,12 +483,6 @@
     : (_b) \
 )
 
-#define result_unwrap_unchecked(_result) \
-  (_result).body.ok
-
-#define result_unwrap_err_unchecked(_result) \
-  (_result).body.err
-
 #define result_unwrap_or(_result, _default_value) ( \
   result_is_ok(_result) \
     ? result_unwrap_unchecked(_result) \
@@ -103,25 +496,175 @@
   \
   for (bool ran = false; !ran && result_is_err(_result); ran = true)
 
+#define result_unwrap_err_or_else_ptr(_result) \
+  result_is_err(_result) \
+    ? &result_unwrap_err_unchecked(_result) \
+    : NULL; \
+  \
+  for (bool ran = false; !ran && result_is_ok(_result); ran = true)
+
+#endif
+
 //
 // Everything below uses GNU extensions. Supported by GCC and clang.
 //
 
+#if defined(RESULT_CHECKED) && !defined(__cplusplus)
+
+#define result_ok(_result, _value) \
+  result_checked_new(_result, true, ok, _value)
+
+#define result_err(_result, _err) result_checked_new( \
+  _result, false, err, (result_site_count_err("result_err"), (_err)) \
+)
+
+#elif defined(RESULT_SITE_COUNTERS)
+
+#define result_ok(_result, _value) \
+  (__typeof(_result)) { .header.is_ok = true, .body.ok = (_value) }
+
+#define result_err(_result, _err) (__typeof(_result)) { \
+  .header.is_ok = false, \
+  .body.err = (result_site_count("result_err"), (_err)) \
+}
+
+#else
+
 #define result_ok(_result, _value) \
   (__typeof(_result)) { .header.is_ok = true, .body.ok = (_value) }
 
 #define result_err(_result, _err) \
   (__typeof(_result)) { .header.is_ok = false, .body.err = (_err) }
 
+#endif
+
 #define result_unwrap_or_else(_result) \
-  result_is_ok(_result) \
-    ? result_unwrap_unchecked(_result) \
-    : result_unwrap_unchecked(result_zero(_result)); \
+  result_unwrap_or_else_(_result, result_unique(result_else_run))
+
+#define result_unwrap_or_else_(_result, _run) ({ \
+  __typeof(_result) result_else_tmp = (_result); \
   \
-  for (bool ran = false; !ran && result_is_err(_result); ran = true)
+  result_else_taken = result_is_err(result_else_tmp); \
+  \
+  result_else_taken \
+    ? result_zero(result_else_tmp).body.ok \
+    : result_unwrap_unchecked(result_else_tmp); \
+}); \
+  \
+  for (bool _run = result_else_taken; _run; _run = false)
 
 #define result_zero(_result) ((__typeof(_result)) { 0 })
 
+// result_emplace_{ok,err} make `_result` (an lvalue) an ok or an err and
+// evaluate to a pointer into its body, to be filled in place instead of
+// assigning a whole compound literal like result_ok/result_err do:
+//
+//   struct big_s *big = result_emplace_ok(res);
+//
+//   big->len = 0;
+//   read_into(big->data, &big->len);
+//
+// The old body is left as it was, so all of it must be written. Taking the
+// address doesn't work for packed results (or the niche ones, which have no
+// header of their own).
+
+#define result_emplace_ok(_result) \
+  result_emplace_ok_(_result, result_unique(result_emplace_self))
+
+#define result_emplace_ok_(_result, _self) ({ \
+  __typeof(_result) *_self = &(_result); \
+  \
+  _self->header.is_ok = true; \
+  &_self->body.ok; \
+})
+
+#define result_emplace_err(_result) \
+  result_emplace_err_(_result, result_unique(result_emplace_self))
+
+#define result_emplace_err_(_result, _self) ({ \
+  __typeof(_result) *_self = &(_result); \
+  \
+  result_site_count_err("result_emplace_err"); \
+  _self->header.is_ok = false; \
+  &_self->body.err; \
+})
+
+// result_try is the equivalent of Rust's `?` operator. It evaluates `_result`
+// once; if it's an err, it's returned from the current function as is,
+// otherwise the whole thing evaluates to the ok value.
+//
+//   typedef result_t(int, int) result_int_t;
+//
+//   result_int_t sum(const char *a, const char *b) {
+//     int x = result_try(parse(a));
+//     int y = result_try(parse(b));
+//
+//     return (result_int_t) result_init_ok(x + y);
+//   }
+//
+// That requires the function to return the same type as `_result`. When only
+// the err types match, use result_try_as with the return type, and when they
+// don't, result_try_map_err with a function that turns the err into the
+// return type:
+//
+//   result_str_t describe(const char *a) {
+//     int x = result_try_as(result_str_t, parse(a));
+//     int y = result_try_map_err(lookup(x), str_from_lookup_err);
+//     ...
+//   }
+//
+// The error branch calls result_cold_path(), which makes GCC move it out of
+// line into .text.unlikely (the `function.cold` part) instead of laying it
+// out between the hot instructions.
+
+static __attribute__((cold, noinline, unused)) void result_cold_path(void) {
+  // Calling a cold function is what marks the path unlikely. This keeps the
+  // call from being optimized away.
+  __asm__ volatile("");
+}
+
+#define result_try(_result) \
+  result_try_(_result, result_unique(result_try_tmp))
+
+#define result_try_(_result, _tmp) ({ \
+  __typeof(_result) _tmp = (_result); \
+  \
+  if (__builtin_expect(!!(result_is_err(_tmp)), 0)) { \
+    result_cold_path(); \
+    return _tmp; \
+  } \
+  \
+  result_unwrap_unchecked(_tmp); \
+})
+
+#define result_try_as(_return_type, _result) \
+  result_try_as_(_return_type, _result, result_unique(result_try_tmp))
+
+#define result_try_as_(_return_type, _result, _tmp) ({ \
+  __typeof(_result) _tmp = (_result); \
+  \
+  if (__builtin_expect(!!(result_is_err(_tmp)), 0)) { \
+    result_cold_path(); \
+    return (_return_type) result_init_err(result_unwrap_err_unchecked(_tmp)); \
+  } \
+  \
+  result_unwrap_unchecked(_tmp); \
+})
+
+#define result_try_map_err(_result, _fn) \
+  result_try_map_err_(_result, _fn, result_unique(result_try_tmp))
+
+#define result_try_map_err_(_result, _fn, _tmp) ({ \
+  __typeof(_result) _tmp = (_result); \
+  \
+  if (__builtin_expect(!!(result_is_err(_tmp)), 0)) { \
+    result_cold_path(); \
+    return _fn(result_unwrap_err_unchecked(_tmp)); \
+  } \
+  \
+  result_unwrap_unchecked(_tmp); \
+})
+
 // result_with_{ok,err} is sort of an `if let Ok(value)` / `if let Err(value)`
 // equivalent.
 //
@@ -140,43 +683,96 @@
 //     printf("there was no value\n");
 //   }}
 
+// `_result` is evaluated once, into a copy named after `_variable` (eg.
+// result_with_value), and the payload is copied from there. GCC doesn't merge
+// the two copies for big payloads, so use the _ref variants for those: they
+// keep a pointer to the result instead and never copy.
+
 #define result_with_ok(_result, _variable) \
-  __typeof((_result).body.ok) _variable = (_result).body.ok; \
+  __typeof(_result) result_with_##_variable = (_result); \
+  __typeof((_result).body.ok) _variable = result_with_##_variable.body.ok; \
   \
-  if (result_is_ok(_result))
+  if (result_is_ok(result_with_##_variable))
 
 #define result_with_err(_result, _variable) \
-  __typeof((_result).body.err) _variable = (_result).body.err; \
+  __typeof(_result) result_with_##_variable = (_result); \
+  __typeof((_result).body.err) _variable = result_with_##_variable.body.err; \
   \
-  if (result_is_err(_result))
+  if (result_is_err(result_with_##_variable))
+
+// The _ref variants bind a pointer into the body instead of a copy of it,
+// which matters for big payloads: the copy above is made whether or not the
+// branch is taken. `_result` must be an lvalue, and the pointer is const if
+// it is:
+//
+//   result_with_ok_ref(res, big) {
+//     big->len++;
+//   }
+
+#define result_with_ok_ref(_result, _variable) \
+  __typeof(_result) *result_with_##_variable = &(_result); \
+  __typeof((_result).body.ok) *_variable = &result_with_##_variable->body.ok; \
+  \
+  if (result_is_ok(*result_with_##_variable))
+
+#define result_with_err_ref(_result, _variable) \
+  __typeof(_result) *result_with_##_variable = &(_result); \
+  __typeof((_result).body.err) *_variable = \
+    &result_with_##_variable->body.err; \
+  \
+  if (result_is_err(*result_with_##_variable))
 
 //
 // Scoped versions of the above.
 //
 
 #define result_scoped_with_ok(_result, _variable, _block) { \
-  __typeof((_result).body.ok) _variable = (_result).body.ok; \
-  \
-  if (result_is_ok(_result)) _block; \
+  result_with_ok(_result, _variable) _block; \
 }
 
 #define result_scoped_with_err(_result, _variable, _block) { \
-  __typeof((_result).body.err) _variable = (_result).body.err; \
-  \
-  if (result_is_err(_result)) _block; \
+  result_with_err(_result, _variable) _block; \
 }
 
 #define result_scoped_with_ok_or_else(_result, _variable, _block, _else_block) { \
-  __typeof((_result).body.ok) _variable = (_result).body.ok; \
-  \
-  if (result_is_ok(_result)) _block; \
+  result_with_ok(_result, _variable) _block; \
   else _else_block; \
 }
 
 #define result_scoped_with_err_or_else(_result, _variable, _block, _else_block) { \
-  __typeof((_result).body.err) _variable = (_result).body.err; \
-  \
-  if (result_is_err(_result)) _block; \
+  result_with_err(_result, _variable) _block; \
+  else _else_block; \
+}
+
+//
+// Scoped versions of the _ref variants.
+//
+
+#define result_scoped_with_ok_ref(_result, _variable, _block) { \
+  result_with_ok_ref(_result, _variable) _block; \
+}
+
+#define result_scoped_with_err_ref(_result, _variable, _block) { \
+  result_with_err_ref(_result, _variable) _block; \
+}
+
+#define result_scoped_with_ok_ref_or_else( \
+  _result, \
+  _variable, \
+  _block, \
+  _else_block \
+) { \
+  result_with_ok_ref(_result, _variable) _block; \
+  else _else_block; \
+}
+
+#define result_scoped_with_err_ref_or_else( \
+  _result, \
+  _variable, \
+  _block, \
+  _else_block \
+) { \
+  result_with_err_ref(_result, _variable) _block; \
   else _else_block; \
 }
 
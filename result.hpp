@@ -0,0 +1,539 @@
+#ifndef __result_hpp__
+#define __result_hpp__
+
+#include "result.h"
+
+#include <bit>
+#include <cassert>
+#include <concepts>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+//
+// C++20 counterpart of result_t, with the same layout, so results cross the
+// C/C++ boundary without being converted:
+//
+//   // shared with C
+//   typedef result_t(int, int) result_int_t;
+//   extern "C" result_int_t parse(const char *text);
+//
+//   wr::result<int, int> twice(const char *text) {
+//     int value = wr_try(wr::result<int, int>::from_c(parse(text)));
+//
+//     return value * 2;
+//   }
+//
+// wr::result<T, E> has the members of result_d(T, E) (`body.ok`, `body.err`,
+// `header.is_ok`) in the same order, which is checked with static_assert for
+// every instantiation. For C types (trivially copyable ones) it's trivially
+// copyable too, so it's passed and returned exactly like the C struct:
+// from_c() and to_c() are std::bit_cast and compile to nothing, and a C
+// function can even be declared as returning the wr::result directly:
+//
+//   extern "C" wr::result<int, int> parse(const char *text);
+//
+// Other types work as well (say std::string), they're constructed, moved and
+// destroyed properly, they just don't mean anything to C. Moving a result must
+// not throw: both types have to be nothrow move constructible, which keeps
+// every operation noexcept when the payload's is.
+//
+// Constructing:
+//
+//   wr::result<int, int> a = 1;               // ok, like std::expected
+//   wr::result<int, int> b = wr::ok(1);
+//   wr::result<int, int> c = wr::err(EINVAL);
+//   wr::result<std::string, int> d(wr::in_place_ok, 3, 'x');
+//
+// All of it is constexpr. map(), map_err(), and_then() and or_else() work like
+// std::expected's transform(), transform_error(), and_then() and or_else().
+//
+// wr_try() is result_try for C++: it evaluates to the ok value, or returns
+// the err from the current function, which can return any wr::result with a
+// compatible err type. It needs GNU statement expressions, like result_try.
+// The ok value is copied out of the statement expression: for payloads that
+// are returned in memory (more than 16 bytes on x86-64) that's a load right
+// after the callee's stores, which can cost a stalled store forward. On hot
+// paths with big payloads, keep the result and test it instead.
+//
+
+// assert() that can be used in constant expressions as long as it holds.
+#define wr_assert(_condition) ((_condition) ? (void) 0 : assert(_condition))
+
+namespace wr {
+
+template <typename T, typename E>
+class result;
+
+template <typename E>
+struct err_value {
+  E value;
+};
+
+template <typename T>
+struct ok_value {
+  T value;
+};
+
+struct in_place_ok_t {
+  explicit in_place_ok_t() = default;
+};
+
+struct in_place_err_t {
+  explicit in_place_err_t() = default;
+};
+
+inline constexpr in_place_ok_t in_place_ok{};
+inline constexpr in_place_err_t in_place_err{};
+
+template <typename T>
+constexpr ok_value<std::decay_t<T>> ok(T &&value) {
+  return { std::forward<T>(value) };
+}
+
+template <typename E>
+constexpr err_value<std::decay_t<E>> err(E &&value) {
+  return { std::forward<E>(value) };
+}
+
+namespace detail {
+  // What result_t(T, E) is in C.
+  template <typename T, typename E>
+  struct c_result result_d(T, E);
+
+  template <typename R>
+  struct is_result : std::false_type {};
+
+  template <typename T, typename E>
+  struct is_result<result<T, E>> : std::true_type {};
+}
+
+// A C result (or anything else) with the same members as wr::result<T, E>.
+template <typename C, typename T, typename E>
+concept c_result_of =
+  std::is_trivially_copyable_v<C>
+  && std::is_trivially_copyable_v<result<T, E>>
+  && std::same_as<
+    std::remove_cvref_t<decltype(std::declval<C &>().body.ok)>, T
+  >
+  && std::same_as<
+    std::remove_cvref_t<decltype(std::declval<C &>().body.err)>, E
+  >
+  && sizeof(C) == sizeof(result<T, E>)
+  && alignof(C) == alignof(result<T, E>);
+
+template <typename T, typename E>
+class result {
+  static_assert(
+    std::is_nothrow_move_constructible_v<T>
+    && std::is_nothrow_move_constructible_v<E>,
+    "wr::result needs types that move without throwing"
+  );
+
+  static constexpr bool trivially_destructible =
+    std::is_trivially_destructible_v<T>
+    && std::is_trivially_destructible_v<E>;
+
+  static constexpr bool trivially_copyable =
+    std::is_trivially_copyable_v<T> && std::is_trivially_copyable_v<E>;
+
+  static constexpr bool copyable =
+    std::is_copy_constructible_v<T> && std::is_copy_constructible_v<E>;
+
+public:
+  using value_type = T;
+  using error_type = E;
+
+  union body_u {
+    T ok;
+    E err;
+
+    template <typename... A>
+    constexpr body_u(in_place_ok_t, A &&...args)
+      : ok(std::forward<A>(args)...) {}
+
+    template <typename... A>
+    constexpr body_u(in_place_err_t, A &&...args)
+      : err(std::forward<A>(args)...) {}
+
+    constexpr body_u(const body_u &) = default;
+    constexpr body_u(body_u &&) = default;
+    constexpr body_u &operator=(const body_u &) = default;
+    constexpr body_u &operator=(body_u &&) = default;
+
+    // the result destroys the active member
+    constexpr ~body_u() requires trivially_destructible = default;
+    constexpr ~body_u() {}
+  };
+
+  union header_u {
+    bool is_ok;
+  };
+
+  body_u body;
+  header_u header;
+
+  static_assert(
+    sizeof(body_u) == sizeof(decltype(detail::c_result<T, E>::body))
+    && alignof(body_u) == alignof(decltype(detail::c_result<T, E>::body))
+    && sizeof(header_u) == sizeof(decltype(detail::c_result<T, E>::header))
+    && alignof(header_u) == alignof(decltype(detail::c_result<T, E>::header)),
+    "wr::result must have the layout of result_d"
+  );
+
+  // ok
+  template <typename U = T>
+    requires (
+      std::is_constructible_v<T, U>
+      && !std::is_same_v<std::remove_cvref_t<U>, result>
+      && !std::is_same_v<std::remove_cvref_t<U>, in_place_ok_t>
+      && !std::is_same_v<std::remove_cvref_t<U>, in_place_err_t>
+    )
+  constexpr result(U &&value)
+    noexcept(std::is_nothrow_constructible_v<T, U>)
+    : body(in_place_ok, std::forward<U>(value)), header{ true } {}
+
+  template <typename U>
+  constexpr result(ok_value<U> value)
+    noexcept(std::is_nothrow_constructible_v<T, U>)
+    : body(in_place_ok, std::move(value.value)), header{ true } {}
+
+  template <typename... A>
+  constexpr explicit result(in_place_ok_t, A &&...args)
+    noexcept(std::is_nothrow_constructible_v<T, A...>)
+    : body(in_place_ok, std::forward<A>(args)...), header{ true } {}
+
+  // err
+  template <typename G>
+  constexpr result(err_value<G> value)
+    noexcept(std::is_nothrow_constructible_v<E, G>)
+    : body(in_place_err, std::move(value.value)), header{ false } {}
+
+  template <typename... A>
+  constexpr explicit result(in_place_err_t, A &&...args)
+    noexcept(std::is_nothrow_constructible_v<E, A...>)
+    : body(in_place_err, std::forward<A>(args)...), header{ false } {}
+
+  // copies and moves, trivial when both types are
+
+  constexpr result(const result &) requires trivially_copyable = default;
+
+  constexpr result(const result &other)
+    noexcept(
+      std::is_nothrow_copy_constructible_v<T>
+      && std::is_nothrow_copy_constructible_v<E>
+    )
+    requires (copyable && !trivially_copyable)
+    : body(make_body(other)), header(other.header) {}
+
+  constexpr result(result &&) requires trivially_copyable = default;
+
+  constexpr result(result &&other) noexcept
+    : body(make_body(std::move(other))), header(other.header) {}
+
+  constexpr result &operator=(const result &)
+    requires trivially_copyable = default;
+
+  constexpr result &operator=(const result &other)
+    noexcept(
+      std::is_nothrow_copy_constructible_v<T>
+      && std::is_nothrow_copy_constructible_v<E>
+    )
+    requires (copyable && !trivially_copyable) {
+    if (this != &other) {
+      // copied first, so that a throwing copy leaves *this alone
+      result copy(other);
+
+      *this = std::move(copy);
+    }
+
+    return *this;
+  }
+
+  constexpr result &operator=(result &&) requires trivially_copyable = default;
+
+  constexpr result &operator=(result &&other) noexcept {
+    if (this != &other) {
+      destroy();
+
+      if (other.header.is_ok) {
+        std::construct_at(&body.ok, std::move(other.body.ok));
+      } else {
+        std::construct_at(&body.err, std::move(other.body.err));
+      }
+
+      header = other.header;
+    }
+
+    return *this;
+  }
+
+  constexpr ~result() requires trivially_destructible = default;
+
+  constexpr ~result() {
+    destroy();
+  }
+
+  // C interop
+
+  template <c_result_of<T, E> C>
+  static constexpr result from_c(const C &c) noexcept {
+    // std::bit_cast can't copy unions in constant expressions
+    if (std::is_constant_evaluated()) {
+      return c.header.is_ok
+        ? result(in_place_ok, c.body.ok)
+        : result(in_place_err, c.body.err);
+    }
+
+    return std::bit_cast<result>(c);
+  }
+
+  template <c_result_of<T, E> C>
+  constexpr C to_c() const noexcept {
+    if (std::is_constant_evaluated()) {
+      C c{};
+
+      c.header.is_ok = header.is_ok;
+
+      if (header.is_ok) {
+        c.body.ok = body.ok;
+      } else {
+        c.body.err = body.err;
+      }
+
+      return c;
+    }
+
+    return std::bit_cast<C>(*this);
+  }
+
+  // observers
+
+  constexpr bool is_ok() const noexcept {
+    return header.is_ok;
+  }
+
+  constexpr bool is_err() const noexcept {
+    return !header.is_ok;
+  }
+
+  constexpr explicit operator bool() const noexcept {
+    return header.is_ok;
+  }
+
+  // Only valid for ok results (asserted), like result_unwrap_unchecked.
+  constexpr T &value() & noexcept {
+    wr_assert(header.is_ok);
+    return body.ok;
+  }
+
+  constexpr const T &value() const & noexcept {
+    wr_assert(header.is_ok);
+    return body.ok;
+  }
+
+  constexpr T &&value() && noexcept {
+    wr_assert(header.is_ok);
+    return std::move(body.ok);
+  }
+
+  constexpr T &operator*() & noexcept {
+    return value();
+  }
+
+  constexpr const T &operator*() const & noexcept {
+    return value();
+  }
+
+  constexpr T &&operator*() && noexcept {
+    return std::move(*this).value();
+  }
+
+  constexpr T *operator->() noexcept {
+    return &value();
+  }
+
+  constexpr const T *operator->() const noexcept {
+    return &value();
+  }
+
+  // Only valid for errs (asserted), like result_unwrap_err_unchecked.
+  constexpr E &error() & noexcept {
+    wr_assert(!header.is_ok);
+    return body.err;
+  }
+
+  constexpr const E &error() const & noexcept {
+    wr_assert(!header.is_ok);
+    return body.err;
+  }
+
+  constexpr E &&error() && noexcept {
+    wr_assert(!header.is_ok);
+    return std::move(body.err);
+  }
+
+  template <typename U>
+  constexpr T value_or(U &&fallback) const & {
+    return header.is_ok
+      ? body.ok
+      : static_cast<T>(std::forward<U>(fallback));
+  }
+
+  template <typename U>
+  constexpr T value_or(U &&fallback) && {
+    return header.is_ok
+      ? std::move(body.ok)
+      : static_cast<T>(std::forward<U>(fallback));
+  }
+
+  // monadic operations, with the same overloads for every value category
+
+  template <typename F>
+  constexpr auto map(F &&fn) const & {
+    return map_impl(*this, std::forward<F>(fn));
+  }
+
+  template <typename F>
+  constexpr auto map(F &&fn) && {
+    return map_impl(std::move(*this), std::forward<F>(fn));
+  }
+
+  template <typename F>
+  constexpr auto map_err(F &&fn) const & {
+    return map_err_impl(*this, std::forward<F>(fn));
+  }
+
+  template <typename F>
+  constexpr auto map_err(F &&fn) && {
+    return map_err_impl(std::move(*this), std::forward<F>(fn));
+  }
+
+  template <typename F>
+  constexpr auto and_then(F &&fn) const & {
+    return and_then_impl(*this, std::forward<F>(fn));
+  }
+
+  template <typename F>
+  constexpr auto and_then(F &&fn) && {
+    return and_then_impl(std::move(*this), std::forward<F>(fn));
+  }
+
+  template <typename F>
+  constexpr auto or_else(F &&fn) const & {
+    return or_else_impl(*this, std::forward<F>(fn));
+  }
+
+  template <typename F>
+  constexpr auto or_else(F &&fn) && {
+    return or_else_impl(std::move(*this), std::forward<F>(fn));
+  }
+
+private:
+  template <typename R>
+  static constexpr body_u make_body(R &&other) {
+    if (other.header.is_ok) {
+      return body_u(in_place_ok, std::forward<R>(other).body.ok);
+    }
+
+    return body_u(in_place_err, std::forward<R>(other).body.err);
+  }
+
+  constexpr void destroy() noexcept {
+    if constexpr (!trivially_destructible) {
+      if (header.is_ok) {
+        std::destroy_at(&body.ok);
+      } else {
+        std::destroy_at(&body.err);
+      }
+    }
+  }
+
+  template <typename R, typename F>
+  static constexpr auto map_impl(R &&self, F &&fn) {
+    using U = std::remove_cvref_t<
+      std::invoke_result_t<F, decltype(std::forward<R>(self).body.ok)>
+    >;
+
+    if (self.header.is_ok) {
+      return result<U, E>(
+        in_place_ok,
+        std::invoke(std::forward<F>(fn), std::forward<R>(self).body.ok)
+      );
+    }
+
+    return result<U, E>(in_place_err, std::forward<R>(self).body.err);
+  }
+
+  template <typename R, typename F>
+  static constexpr auto map_err_impl(R &&self, F &&fn) {
+    using G = std::remove_cvref_t<
+      std::invoke_result_t<F, decltype(std::forward<R>(self).body.err)>
+    >;
+
+    if (self.header.is_ok) {
+      return result<T, G>(in_place_ok, std::forward<R>(self).body.ok);
+    }
+
+    return result<T, G>(
+      in_place_err,
+      std::invoke(std::forward<F>(fn), std::forward<R>(self).body.err)
+    );
+  }
+
+  template <typename R, typename F>
+  static constexpr auto and_then_impl(R &&self, F &&fn) {
+    using U = std::remove_cvref_t<
+      std::invoke_result_t<F, decltype(std::forward<R>(self).body.ok)>
+    >;
+
+    static_assert(
+      detail::is_result<U>::value
+      && std::is_same_v<typename U::error_type, E>,
+      "and_then() needs a function that returns a result with the same err"
+    );
+
+    if (self.header.is_ok) {
+      return std::invoke(std::forward<F>(fn), std::forward<R>(self).body.ok);
+    }
+
+    return U(in_place_err, std::forward<R>(self).body.err);
+  }
+
+  template <typename R, typename F>
+  static constexpr auto or_else_impl(R &&self, F &&fn) {
+    using G = std::remove_cvref_t<
+      std::invoke_result_t<F, decltype(std::forward<R>(self).body.err)>
+    >;
+
+    static_assert(
+      detail::is_result<G>::value
+      && std::is_same_v<typename G::value_type, T>,
+      "or_else() needs a function that returns a result with the same ok"
+    );
+
+    if (self.header.is_ok) {
+      return G(in_place_ok, std::forward<R>(self).body.ok);
+    }
+
+    return std::invoke(std::forward<F>(fn), std::forward<R>(self).body.err);
+  }
+};
+
+} // namespace wr
+
+#define wr_try(...) ({ \
+  auto &&wr_try_result = (__VA_ARGS__); \
+  \
+  if (__builtin_expect(!!(wr_try_result.is_err()), 0)) { \
+    result_cold_path(); \
+    return ::wr::err( \
+      std::forward<decltype(wr_try_result)>(wr_try_result).error() \
+    ); \
+  } \
+  \
+  std::forward<decltype(wr_try_result)>(wr_try_result).value(); \
+})
+
+#endif // __result_hpp__
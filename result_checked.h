@@ -0,0 +1,91 @@
+#ifndef __result_checked_h__
+#define __result_checked_h__
+
+#include <stdio.h>
+
+#include "core/defs.h"
+
+//
+// A checked build, cheap enough to leave on in production.
+//
+// Compile with -D RESULT_CHECKED and:
+//
+//   - result_unwrap_unchecked and result_unwrap_err_unchecked check which
+//     side is active after all, and trap (SIGILL) when it's the other one,
+//     after printing their file and line:
+//
+//       src/load.c:42: result_unwrap_unchecked of an err
+//
+//   - result_set_ok/err and result_ok/err fill the body with
+//     RESULT_CHECKED_PATTERN before writing the new side, so the bytes past
+//     it don't keep what the other side left there. Reading the inactive side
+//     with `.body` directly then gets the pattern: as a pointer it's
+//     non-canonical on x86-64 and faults on the first dereference, as a
+//     number it's easy to spot.
+//
+// The check is a test of the tag behind w_unlikely, and the fill is dead
+// (and removed by the compiler) when the side written covers the body, so
+// the overhead is small: `make checked` runs the benchmarks against a Release
+// build and fails if it's more than 2%.
+//
+// The fill isn't done with ASan's manual poisoning, even in ASan builds:
+// results are copied whole (returned, assigned), and every copy would read
+// the poisoned bytes and be reported. Results made with result_init_ok/err
+// aren't filled either, they're initializers, and neither are the ones from
+// result_emplace_ok/err, whose callers write all of the body anyway.
+//
+// Caveats: the accessors evaluate to a copy of the side, not an lvalue, so
+// their address can't be taken (use `&res.body.ok` after checking the tag),
+// and result_ok/err can no longer be used in initializers at file scope. It's
+// C only, C++ gets the plain macros (result.hpp asserts in its own accessors).
+//
+
+#define RESULT_CHECKED_PATTERN 0xa5
+
+static __attribute__((cold, noinline, noreturn, unused))
+void result_checked_fail(const char *file, int line, const char *what) {
+  fprintf(stderr, "%s:%d: %s\n", file, line, what);
+  __builtin_trap();
+}
+
+// On a copy, so that the argument can be any expression (a result returned by
+// a function, say), the way it can without RESULT_CHECKED. The check folds
+// into one the caller made on a result in registers. On one in memory, GCC
+// reloads the tag of the copy as another type and keeps a branch on the same
+// flags, which is never taken but can stop a loop from being if-converted
+// (the compact_ok/loop bench at err=50% goes from 1.1 to 6 ns/op).
+#define result_checked_unwrap(_result, _side, _is_side, _what) \
+  result_checked_unwrap_( \
+    _result, _side, _is_side, _what, result_unique(result_checked_self) \
+  )
+
+#define result_checked_unwrap_(_result, _side, _is_side, _what, _self) ({ \
+  __typeof(_result) _self = (_result); \
+  \
+  if (w_unlikely(!_is_side(_self))) { \
+    result_checked_fail(__FILE__, __LINE__, _what); \
+  } \
+  \
+  _self.body._side; \
+})
+
+#define result_checked_fill(_body) \
+  __builtin_memset(&(_body), RESULT_CHECKED_PATTERN, sizeof(_body))
+
+#define result_checked_new(_result, _is_ok, _side, _value) \
+  result_checked_new_( \
+    _result, _is_ok, _side, _value, result_unique(result_checked_new) \
+  )
+
+// Zeroed first: other header fields, like the `moved` of result_owned_t, start
+// out cleared like they would in a compound literal.
+#define result_checked_new_(_result, _is_ok, _side, _value, _tmp) ({ \
+  __typeof(_result) _tmp = { 0 }; \
+  \
+  result_checked_fill(_tmp.body); \
+  _tmp.header.is_ok = (_is_ok); \
+  _tmp.body._side = (_value); \
+  _tmp; \
+})
+
+#endif // __result_checked_h__
@@ -0,0 +1,328 @@
+#include "core/defs.h"
+#include "result.h"
+#include "result_owned.h"
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+typedef result_t(int, int) result_int_t;
+typedef result_t(uint8_t, uint64_t) result_small_ok_t;
+typedef result_t(uint64_t, uint8_t) result_small_err_t;
+typedef result_nonnull_t(int *) result_ptr_t;
+
+static int drops;
+
+static void count_drop(int *value);
+
+RESULT_OWNED_DECLARE(result_counted, int, count_drop, int, count_drop)
+
+/*sublime-c-static-fn-hoist-start*/
+static void expect_trap(void (*fn)(void), int line, const char *message);
+static result_int_t sum(result_int_t a, result_int_t b);
+static void assert_filled(const void *bytes, size_t from, size_t to);
+static void test_is_enabled(void **ts);
+static void test_unwrap_active_side(void **ts);
+static void test_unwrap_evaluates_once(void **ts);
+static void test_unwrap_of_rvalue(void **ts);
+static void test_trap_unwrap_err(void **ts);
+static void test_trap_unwrap_err_of_ok(void **ts);
+static void test_trap_niche(void **ts);
+static void test_other_macros(void **ts);
+static void test_set_fills_inactive_bytes(void **ts);
+static void test_new_fills_inactive_bytes(void **ts);
+static void test_set_reads_before_writing(void **ts);
+static void dirty_stack(void);
+static void make_owned(bool ok);
+static void test_new_owned_is_dropped(void **ts);
+/*sublime-c-static-fn-hoist-end*/
+
+#ifndef RESULT_CHECKED
+  #error "result_checked_test must be built with RESULT_CHECKED"
+#endif
+
+// Defines `_name`, which unwraps the wrong side of `_init`, and `_name##_line`,
+// the line it'll be reported for.
+#define define_bad_unwrap(_name, _type, _init, _unwrap) \
+  static const int _name##_line = __LINE__; \
+  \
+  static void _name(void) { \
+    _type res = _init; \
+    (void) escape(_unwrap(res)); \
+  }
+
+// Keeps the unwrap from being optimized away.
+#define escape(_value) ({ \
+  __typeof(_value) escape_value = (_value); \
+  \
+  __asm__ volatile("" : : "g"(&escape_value) : "memory"); \
+  escape_value; \
+})
+
+define_bad_unwrap(
+  unwrap_err, result_int_t, result_init_err(1), result_unwrap_unchecked
+)
+
+define_bad_unwrap(
+  unwrap_err_of_ok, result_int_t, result_init_ok(1),
+  result_unwrap_err_unchecked
+)
+
+define_bad_unwrap(
+  unwrap_niche_err, result_ptr_t, result_init_err(NULL),
+  result_unwrap_unchecked
+)
+
+// Runs `fn` in a child and checks that it trapped after printing `message`
+// for `line` of this file.
+static void expect_trap(void (*fn)(void), int line, const char *message) {
+  int fds[2];
+  char expected[256];
+  char got[256] = { 0 };
+  size_t n = 0;
+  int status;
+
+  assert_int_equal(0, pipe(fds));
+
+  pid_t pid = fork();
+  assert_true(pid >= 0);
+
+  if (pid == 0) {
+    dup2(fds[1], STDERR_FILENO);
+    fn();
+    _exit(0);
+  }
+
+  close(fds[1]);
+
+  while (n < sizeof(got) - 1) {
+    ssize_t read_now = read(fds[0], got + n, sizeof(got) - 1 - n);
+
+    if (read_now <= 0) {
+      break;
+    }
+
+    n += (size_t) read_now;
+  }
+
+  close(fds[0]);
+  assert_int_equal(pid, waitpid(pid, &status, 0));
+
+  assert_true(WIFSIGNALED(status));
+  assert_int_equal(SIGILL, WTERMSIG(status));
+
+  snprintf(
+    expected, sizeof(expected), "%s:%d: %s\n", __FILE__, line, message
+  );
+  assert_string_equal(expected, got);
+}
+
+static result_int_t sum(result_int_t a, result_int_t b) {
+  int x = result_try(a);
+  int y = result_try(b);
+
+  return (result_int_t) result_init_ok(x + y);
+}
+
+static void assert_filled(const void *bytes, size_t from, size_t to) {
+  const uint8_t *body = bytes;
+
+  for (size_t i = from; i < to; i++) {
+    assert_int_equal(RESULT_CHECKED_PATTERN, body[i]);
+  }
+}
+
+static void test_is_enabled(void **ts) {
+  assert_int_equal(0xa5, RESULT_CHECKED_PATTERN);
+}
+
+static void test_unwrap_active_side(void **ts) {
+  result_int_t ok = result_init_ok(3);
+  result_int_t err = result_init_err(4);
+  int value = 5;
+  result_ptr_t ptr = result_init_ok(&value);
+
+  assert_int_equal(3, result_unwrap_unchecked(ok));
+  assert_int_equal(4, result_unwrap_err_unchecked(err));
+  assert_ptr_equal(&value, result_unwrap_unchecked(ptr));
+}
+
+static void test_unwrap_evaluates_once(void **ts) {
+  result_int_t results[] = { result_init_ok(1), result_init_ok(2) };
+  size_t i = 0;
+
+  assert_int_equal(1, result_unwrap_unchecked(results[i++]));
+  assert_int_equal(1, i);
+
+  // nested in itself
+  result_t(result_int_t, int) outer = result_init_ok(results[1]);
+
+  assert_int_equal(
+    2, result_unwrap_unchecked(result_unwrap_unchecked(outer))
+  );
+}
+
+static void test_unwrap_of_rvalue(void **ts) {
+  result_int_t one = result_init_ok(1);
+  result_int_t two = result_init_err(2);
+
+  assert_int_equal(2, result_unwrap_unchecked(sum(one, one)));
+  assert_int_equal(2, result_unwrap_err_unchecked(sum(one, two)));
+}
+
+static void test_trap_unwrap_err(void **ts) {
+  expect_trap(
+    unwrap_err, unwrap_err_line, "result_unwrap_unchecked of an err"
+  );
+}
+
+static void test_trap_unwrap_err_of_ok(void **ts) {
+  expect_trap(
+    unwrap_err_of_ok, unwrap_err_of_ok_line,
+    "result_unwrap_err_unchecked of an ok"
+  );
+}
+
+static void test_trap_niche(void **ts) {
+  expect_trap(
+    unwrap_niche_err, unwrap_niche_err_line,
+    "result_unwrap_unchecked of an err"
+  );
+}
+
+static void test_other_macros(void **ts) {
+  result_int_t ok = result_init_ok(1);
+  result_int_t err = result_init_err(2);
+
+  // they check before unwrapping, so they never trap
+  assert_int_equal(1, result_unwrap_or(ok, 0));
+  assert_int_equal(7, result_unwrap_or(err, 7));
+
+  // through result_try
+  result_int_t three = sum(ok, result_ok(ok, 2));
+  result_int_t two = sum(ok, err);
+
+  assert_int_equal(3, result_unwrap_unchecked(three));
+  assert_int_equal(2, result_unwrap_err_unchecked(two));
+
+  int value = result_unwrap_or_else(err) {
+    value = 9;
+  }
+
+  assert_int_equal(9, value);
+
+  const int *ptr = result_unwrap_or_else_ptr(ok) {
+    fail();
+  }
+
+  assert_int_equal(1, *ptr);
+
+  result_with_err(err, code) {
+    assert_int_equal(2, code);
+  }
+}
+
+static void test_set_fills_inactive_bytes(void **ts) {
+  result_small_ok_t res = result_init_err(UINT64_MAX);
+
+  result_set_ok(res, 1);
+
+  assert_int_equal(1, result_unwrap_unchecked(res));
+  assert_filled(&res.body, sizeof(res.body.ok), sizeof(res.body));
+
+  result_set_err(res, 2);
+  assert_int_equal(2, result_unwrap_err_unchecked(res));
+
+  result_small_err_t small = result_init_ok(UINT64_MAX);
+
+  result_set_err(small, 3);
+
+  assert_int_equal(3, result_unwrap_err_unchecked(small));
+  assert_filled(&small.body, sizeof(small.body.err), sizeof(small.body));
+}
+
+static void test_new_fills_inactive_bytes(void **ts) {
+  result_small_ok_t res = result_init_err(0);
+
+  res = result_ok(res, 4);
+
+  assert_int_equal(4, result_unwrap_unchecked(res));
+  assert_filled(&res.body, sizeof(res.body.ok), sizeof(res.body));
+
+  result_small_err_t small = result_init_ok(0);
+
+  small = result_err(small, 5);
+
+  assert_int_equal(5, result_unwrap_err_unchecked(small));
+  assert_filled(&small.body, sizeof(small.body.err), sizeof(small.body));
+}
+
+static void test_set_reads_before_writing(void **ts) {
+  result_int_t res = result_init_ok(1);
+
+  // the new value is computed from the old one before the fill
+  result_set_ok(res, res.body.ok + 1);
+  assert_int_equal(2, result_unwrap_unchecked(res));
+
+  result_set_err(res, result_unwrap_unchecked(res) * 3);
+  assert_int_equal(6, result_unwrap_err_unchecked(res));
+
+  result_set_err(res, result_unwrap_err_unchecked(res) + 1);
+  assert_int_equal(7, result_unwrap_err_unchecked(res));
+}
+
+static void count_drop(int *value) {
+  (void) value;
+  drops++;
+}
+
+// Leaves non-zero bytes where the next call's locals go.
+static __attribute__((noinline)) void dirty_stack(void) {
+  volatile uint8_t bytes[4096];
+
+  for (size_t i = 0; i < sizeof(bytes); i++) {
+    bytes[i] = 0xff;
+  }
+}
+
+static __attribute__((noinline)) void make_owned(bool ok) {
+  // only for the type, it owns nothing
+  result_counted_t template = result_init_ok(0);
+
+  result_owned(result_counted) res = ok
+    ? result_ok(template, 5)
+    : result_err(template, 6);
+
+  (void) res;
+}
+
+static void test_new_owned_is_dropped(void **ts) {
+  drops = 0;
+
+  dirty_stack();
+  make_owned(true);
+  assert_int_equal(1, drops);
+
+  dirty_stack();
+  make_owned(false);
+  assert_int_equal(2, drops);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_is_enabled),
+    cmocka_unit_test(test_unwrap_active_side),
+    cmocka_unit_test(test_unwrap_evaluates_once),
+    cmocka_unit_test(test_unwrap_of_rvalue),
+    cmocka_unit_test(test_trap_unwrap_err),
+    cmocka_unit_test(test_trap_unwrap_err_of_ok),
+    cmocka_unit_test(test_trap_niche),
+    cmocka_unit_test(test_other_macros),
+    cmocka_unit_test(test_set_fills_inactive_bytes),
+    cmocka_unit_test(test_new_fills_inactive_bytes),
+    cmocka_unit_test(test_set_reads_before_writing),
+    cmocka_unit_test(test_new_owned_is_dropped),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
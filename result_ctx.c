@@ -0,0 +1,354 @@
+#include "result_ctx.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_INITIAL_CAPACITY (16 * 1024)
+#define ARENA_ALIGNMENT 8
+
+// A ref is the record's offset divided by the alignment, plus the first ref of
+// the current generation. Every reset moves that past the refs handed out so
+// far, so a handle from an older generation is below it and find_record()
+// rejects it with a subtraction and a compare.
+//
+// The refs only come around again after 32 GiB worth of records. Capping the
+// arena keeps a single generation to a small part of that range.
+#define ARENA_MAX_CAPACITY ((size_t) 128 * 1024 * 1024)
+#define ARENA_MAX_REFS ((uint32_t) (ARENA_MAX_CAPACITY / ARENA_ALIGNMENT))
+
+struct record_s {
+  const char *format;
+  uint32_t arg_count;
+
+  // aligned, up to the next record
+  uint32_t size;
+
+  // strings are copied after the args, see result_ctx_arg_s.copy
+  struct result_ctx_arg_s args[];
+};
+
+struct arena_s {
+  uint8_t *base;
+
+  // offset 0 is never handed out so that a zero ref means "no record"
+  size_t used;
+  size_t capacity;
+  uint32_t first_ref;
+
+  size_t allocations;
+  size_t dropped;
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static size_t align_up(size_t size);
+static bool arena_reserve(struct arena_s *arena, size_t size, size_t *offset);
+static const struct record_s *find_record(struct result_ctx_s ctx);
+static size_t render_arg(
+  char *buffer,
+  size_t size,
+  const char *spec,
+  size_t spec_len,
+  char conversion,
+  const struct result_ctx_arg_s *arg
+);
+/*sublime-c-static-fn-hoist-end*/
+
+static __thread struct arena_s self = {
+  .used = ARENA_ALIGNMENT,
+};
+
+static size_t align_up(size_t size) {
+  return (size + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+}
+
+static bool arena_reserve(struct arena_s *arena, size_t size, size_t *offset) {
+  size = align_up(size);
+
+  if (size > ARENA_MAX_CAPACITY - arena->used) {
+    return false;
+  }
+
+  if (w_unlikely(arena->used + size > arena->capacity)) {
+    size_t capacity = w_max_2(arena->capacity * 2, (size_t) ARENA_INITIAL_CAPACITY);
+
+    while (capacity < arena->used + size) {
+      capacity *= 2;
+    }
+
+    capacity = w_min_2(capacity, ARENA_MAX_CAPACITY);
+
+    // records are found by offset, so moving the arena is fine
+    uint8_t *base = realloc(arena->base, capacity);
+
+    if (!base) {
+      return false;
+    }
+
+    arena->base = base;
+    arena->capacity = capacity;
+    arena->allocations++;
+  }
+
+  *offset = arena->used;
+  arena->used += size;
+
+  return true;
+}
+
+struct result_ctx_s result_ctx_new(
+  int32_t code,
+  const char *format,
+  const struct result_ctx_arg_s *args,
+  size_t arg_count
+) {
+  struct result_ctx_s ctx = { .code = code };
+  size_t size = sizeof(struct record_s) + arg_count * sizeof(*args);
+
+  for (size_t i = 0; i < arg_count; i++) {
+    if (args[i].kind == RESULT_CTX_STRING && args[i].value.s) {
+      size += strlen(args[i].value.s) + 1;
+    }
+  }
+
+  size_t offset;
+
+  if (!arena_reserve(&self, size, &offset)) {
+    self.dropped++;
+    return ctx;
+  }
+
+  struct record_s *record = (struct record_s *) (self.base + offset);
+  size_t string_offset = offset + sizeof(*record) + arg_count * sizeof(*args);
+
+  record->format = format;
+  record->arg_count = (uint32_t) arg_count;
+  record->size = (uint32_t) align_up(size);
+  memcpy(record->args, args, arg_count * sizeof(*args));
+
+  for (size_t i = 0; i < arg_count; i++) {
+    struct result_ctx_arg_s *arg = &record->args[i];
+
+    if (arg->kind != RESULT_CTX_STRING) {
+      continue;
+    }
+
+    if (!arg->value.s) {
+      arg->copy = UINT32_MAX;
+      continue;
+    }
+
+    size_t len = strlen(arg->value.s);
+
+    memcpy(self.base + string_offset, arg->value.s, len + 1);
+    arg->copy = (uint32_t) string_offset;
+    string_offset += len + 1;
+  }
+
+  ctx.ref = self.first_ref + (uint32_t) (offset / ARENA_ALIGNMENT);
+
+  return ctx;
+}
+
+static const struct record_s *find_record(struct result_ctx_s ctx) {
+  // wraps around for refs from older generations, which end up past `used`
+  size_t offset = (size_t) (ctx.ref - self.first_ref) * ARENA_ALIGNMENT;
+
+  if (ctx.ref == 0 || offset == 0 || offset >= self.used) {
+    return NULL;
+  }
+
+  return (const struct record_s *) (self.base + offset);
+}
+
+bool result_ctx_is_live(struct result_ctx_s ctx) {
+  return find_record(ctx) != NULL;
+}
+
+void result_ctx_reset(void) {
+  self.first_ref += (uint32_t) (self.used / ARENA_ALIGNMENT);
+  self.used = ARENA_ALIGNMENT;
+
+  // start over before a generation's refs could wrap around to zero
+  if (self.first_ref > UINT32_MAX - ARENA_MAX_REFS) {
+    self.first_ref = 0;
+  }
+}
+
+void result_ctx_free(void) {
+  free(self.base);
+
+  self.base = NULL;
+  self.capacity = 0;
+
+  result_ctx_reset();
+}
+
+struct result_ctx_stats_s result_ctx_stats(void) {
+  return (struct result_ctx_stats_s) {
+    .used = self.used - ARENA_ALIGNMENT,
+    .capacity = self.capacity,
+    .allocations = self.allocations,
+    .dropped = self.dropped,
+  };
+}
+
+//
+// rendering
+//
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+
+// `spec` is one conversion from the format with any length modifier removed,
+// so the right one for the captured type can be put back in.
+static size_t render_arg(
+  char *buffer,
+  size_t size,
+  const char *spec,
+  size_t spec_len,
+  char conversion,
+  const struct result_ctx_arg_s *arg
+) {
+  char format[32];
+  int len = -1;
+
+  if (spec_len + 3 >= sizeof(format)) {
+    return 0;
+  }
+
+  memcpy(format, spec, spec_len);
+
+  long long i = arg->kind == RESULT_CTX_DOUBLE
+    ? (long long) arg->value.d
+    : arg->value.i;
+
+  double d = arg->kind == RESULT_CTX_INT ? (double) arg->value.i
+    : arg->kind == RESULT_CTX_UINT ? (double) arg->value.u
+    : arg->value.d;
+
+  switch (conversion) {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+      memcpy(format + spec_len, "ll", 2);
+      format[spec_len + 2] = conversion;
+      format[spec_len + 3] = '\0';
+      len = snprintf(buffer, size, format, i);
+      break;
+
+    case 'c':
+      format[spec_len] = conversion;
+      format[spec_len + 1] = '\0';
+      len = snprintf(buffer, size, format, (int) i);
+      break;
+
+    case 'f': case 'F': case 'e': case 'E':
+    case 'g': case 'G': case 'a': case 'A':
+      format[spec_len] = conversion;
+      format[spec_len + 1] = '\0';
+      len = snprintf(buffer, size, format, d);
+      break;
+
+    case 's': {
+      const char *s = arg->kind != RESULT_CTX_STRING ? "(?)"
+        : arg->copy == UINT32_MAX ? "(null)"
+        : (const char *) (self.base + arg->copy);
+
+      format[spec_len] = conversion;
+      format[spec_len + 1] = '\0';
+      len = snprintf(buffer, size, format, s);
+      break;
+    }
+
+    case 'p':
+      format[spec_len] = conversion;
+      format[spec_len + 1] = '\0';
+      len = snprintf(buffer, size, format, arg->value.p);
+      break;
+
+    default:
+      break;
+  }
+
+  return len < 0 ? 0 : (size_t) len;
+}
+
+#pragma GCC diagnostic pop
+
+size_t result_ctx_render(
+  struct result_ctx_s ctx,
+  char *buffer,
+  size_t size
+) {
+  const struct record_s *record = find_record(ctx);
+  size_t len = 0;
+
+  if (!record) {
+    int n = snprintf(buffer, size, "error %d", (int) ctx.code);
+    return n < 0 ? 0 : (size_t) n;
+  }
+
+  const char *p = record->format;
+  size_t next_arg = 0;
+
+  while (*p) {
+    if (*p != '%') {
+      if (len + 1 < size) {
+        buffer[len] = *p;
+      }
+
+      len++;
+      p++;
+      continue;
+    }
+
+    if (p[1] == '%') {
+      if (len + 1 < size) {
+        buffer[len] = '%';
+      }
+
+      len++;
+      p += 2;
+      continue;
+    }
+
+    // %[flags][width][.precision][length]conversion
+    const char *start = p++;
+
+    p += strspn(p, "-+ #0'");
+    p += strspn(p, "0123456789");
+
+    if (*p == '.') {
+      p++;
+      p += strspn(p, "0123456789");
+    }
+
+    size_t spec_len = (size_t) (p - start);
+
+    p += strspn(p, "hljztLq");
+
+    if (!*p) {
+      break;
+    }
+
+    char conversion = *p++;
+
+    // once the buffer is full keep going without writing anything, to count
+    // the full length like snprintf(3) does
+    if (next_arg < record->arg_count) {
+      len += render_arg(
+        len < size ? buffer + len : NULL,
+        len < size ? size - len : 0,
+        start,
+        spec_len,
+        conversion,
+        &record->args[next_arg++]
+      );
+    }
+  }
+
+  if (size > 0) {
+    buffer[w_min_2(len, size - 1)] = '\0';
+  }
+
+  return len;
+}
@@ -0,0 +1,226 @@
+#ifndef __result_ctx_h__
+#define __result_ctx_h__
+
+#include "core/defs.h"
+#include "result.h"
+
+//
+// Error context that is only formatted if someone actually looks at it.
+//
+// result_ctx() records an error code, a format string and its arguments into a
+// per-thread bump arena and returns a small handle that fits in a register, so
+// it works as the err type of any result:
+//
+//   typedef result_t(int, struct result_ctx_s) result_fd_t;
+//
+//   result_fd_t open_config(const char *path) {
+//     int fd = open(path, O_RDONLY);
+//
+//     if (fd < 0) {
+//       return (result_fd_t) result_init_err(
+//         result_ctx(errno, "open %s: %s", path, strerror(errno))
+//       );
+//     }
+//
+//     return (result_fd_t) result_init_ok(fd);
+//   }
+//
+//   result_with_err(res, ctx) {
+//     char message[256];
+//     result_ctx_render(ctx, message, sizeof(message));
+//   }
+//
+// Nothing is formatted and nothing is malloc'd on the error path (the arena
+// grows a few times while it warms up and then stays put). Strings are copied
+// since they may not outlive the call, everything else is captured by value.
+// The format must be a string literal and the arguments are checked against
+// it like printf's. At most 8 arguments, and `*` widths are not supported.
+//
+// Handles are only meaningful on the thread that created them, and only until
+// that thread calls result_ctx_reset(), eg. at the end of each request. After
+// that they render as "error <code>"; the code itself is always kept in the
+// handle.
+//
+
+struct result_ctx_s {
+  int32_t code;
+  uint32_t ref;
+};
+
+enum result_ctx_kind_e {
+  RESULT_CTX_INT,
+  RESULT_CTX_UINT,
+  RESULT_CTX_DOUBLE,
+  RESULT_CTX_STRING,
+  RESULT_CTX_POINTER,
+};
+
+struct result_ctx_arg_s {
+  enum result_ctx_kind_e kind;
+
+  // where a string was copied to in the arena, or UINT32_MAX for NULL, so
+  // value.s is still the pointer for %p
+  uint32_t copy;
+
+  union {
+    long long i;
+    unsigned long long u;
+    double d;
+    const char *s;
+    const void *p;
+  } value;
+};
+
+struct result_ctx_stats_s {
+  size_t used;
+  size_t capacity;
+
+  // how many times the arena had to be (re)allocated
+  size_t allocations;
+
+  // contexts that didn't fit in the arena, they only keep their code
+  size_t dropped;
+};
+
+#define result_ctx(_code, ...) ({ \
+  (void) (0 && result_ctx_check_format(__VA_ARGS__)); \
+  \
+  const struct result_ctx_arg_s result_ctx_args[] = { \
+    result_ctx_map_args(__VA_ARGS__) \
+  }; \
+  \
+  result_ctx_new( \
+    (_code), \
+    "" result_ctx_format(__VA_ARGS__) "", \
+    result_ctx_args, \
+    w_array_size(result_ctx_args) \
+  ); \
+})
+
+// Writes the formatted message like snprintf(3) and likewise returns the
+// length it would have had without truncation.
+extern size_t result_ctx_render(
+  struct result_ctx_s ctx,
+  char *buffer,
+  size_t size
+);
+
+// Whether `ctx` still refers to a record in this thread's arena.
+extern bool result_ctx_is_live(struct result_ctx_s ctx);
+
+// Invalidates every handle created on this thread and makes the whole arena
+// available again. Keeps the memory.
+extern void result_ctx_reset(void);
+
+// Same as result_ctx_reset() but also frees the memory, eg. before a thread
+// exits.
+extern void result_ctx_free(void);
+
+extern struct result_ctx_stats_s result_ctx_stats(void);
+
+extern struct result_ctx_s result_ctx_new(
+  int32_t code,
+  const char *format,
+  const struct result_ctx_arg_s *args,
+  size_t arg_count
+);
+
+//
+// Argument capture
+//
+
+static inline __attribute__((format(printf, 1, 2), unused))
+int result_ctx_check_format(const char *format, ...) {
+  return 0;
+}
+
+#define result_ctx_format(_format, ...) _format
+
+// Everything goes through `+ 0` first so arrays decay and small integers are
+// promoted, the same as they would be when passed to printf.
+#define result_ctx_arg(_arg) ({ \
+  __typeof((_arg) + 0) result_ctx_value = (_arg); \
+  \
+  int result_ctx_class = __builtin_classify_type(result_ctx_value); \
+  \
+  bool result_ctx_is_string = \
+    __builtin_types_compatible_p(__typeof(result_ctx_value), char *) || \
+    __builtin_types_compatible_p(__typeof(result_ctx_value), const char *); \
+  \
+  __typeof(__builtin_choose_expr( \
+    __builtin_classify_type(result_ctx_value) == 1, \
+    result_ctx_value, \
+    0 \
+  )) result_ctx_minus_one = -1; \
+  \
+  struct result_ctx_arg_s result_ctx_captured = { 0 }; \
+  \
+  if (result_ctx_is_string) { \
+    result_ctx_captured.kind = RESULT_CTX_STRING; \
+    result_ctx_captured.value.s = (const char *) __builtin_choose_expr( \
+      __builtin_classify_type(result_ctx_value) == 5, \
+      result_ctx_value, \
+      (char *) 0 \
+    ); \
+  } else if (result_ctx_class == 5) { \
+    result_ctx_captured.kind = RESULT_CTX_POINTER; \
+    result_ctx_captured.value.p = (const void *) __builtin_choose_expr( \
+      __builtin_classify_type(result_ctx_value) == 5, \
+      result_ctx_value, \
+      (void *) 0 \
+    ); \
+  } else if (result_ctx_class == 8) { \
+    result_ctx_captured.kind = RESULT_CTX_DOUBLE; \
+    result_ctx_captured.value.d = (double) __builtin_choose_expr( \
+      __builtin_classify_type(result_ctx_value) == 8, \
+      result_ctx_value, \
+      0.0 \
+    ); \
+  } else if (result_ctx_minus_one < 1) { \
+    result_ctx_captured.kind = RESULT_CTX_INT; \
+    result_ctx_captured.value.i = (long long) __builtin_choose_expr( \
+      __builtin_classify_type(result_ctx_value) == 1, \
+      result_ctx_value, \
+      0 \
+    ); \
+  } else { \
+    result_ctx_captured.kind = RESULT_CTX_UINT; \
+    result_ctx_captured.value.u = (unsigned long long) __builtin_choose_expr( \
+      __builtin_classify_type(result_ctx_value) == 1, \
+      result_ctx_value, \
+      0 \
+    ); \
+  } \
+  \
+  result_ctx_captured; \
+})
+
+#define result_ctx_nth_arg(_1, _2, _3, _4, _5, _6, _7, _8, _9, _n, ...) _n
+
+#define result_ctx_map_args(...) \
+  result_ctx_map_args_n( \
+    result_ctx_nth_arg(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0, _), \
+    __VA_ARGS__ \
+  )
+
+#define result_ctx_map_args_n(_n, ...) result_ctx_map_args_n_(_n, __VA_ARGS__)
+#define result_ctx_map_args_n_(_n, ...) result_ctx_map_##_n(__VA_ARGS__)
+
+#define result_ctx_map_0(_format)
+#define result_ctx_map_1(_format, _a) result_ctx_arg(_a)
+#define result_ctx_map_2(_format, _a, ...) \
+  result_ctx_arg(_a), result_ctx_map_1(_format, __VA_ARGS__)
+#define result_ctx_map_3(_format, _a, ...) \
+  result_ctx_arg(_a), result_ctx_map_2(_format, __VA_ARGS__)
+#define result_ctx_map_4(_format, _a, ...) \
+  result_ctx_arg(_a), result_ctx_map_3(_format, __VA_ARGS__)
+#define result_ctx_map_5(_format, _a, ...) \
+  result_ctx_arg(_a), result_ctx_map_4(_format, __VA_ARGS__)
+#define result_ctx_map_6(_format, _a, ...) \
+  result_ctx_arg(_a), result_ctx_map_5(_format, __VA_ARGS__)
+#define result_ctx_map_7(_format, _a, ...) \
+  result_ctx_arg(_a), result_ctx_map_6(_format, __VA_ARGS__)
+#define result_ctx_map_8(_format, _a, ...) \
+  result_ctx_arg(_a), result_ctx_map_7(_format, __VA_ARGS__)
+
+#endif // __result_ctx_h__
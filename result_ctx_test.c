@@ -0,0 +1,253 @@
+#include "core/defs.h"
+#include "result_ctx.h"
+
+#include <inttypes.h>
+
+/*sublime-c-static-fn-hoist-start*/
+static void test_keeps_the_code_in_the_handle(void **ts);
+static void test_renders_like_snprintf(void **ts);
+static void test_renders_without_arguments(void **ts);
+static void test_copies_strings(void **ts);
+static void test_truncates_like_snprintf(void **ts);
+static void test_reset_invalidates_handles(void **ts);
+static void test_rejects_handles_from_any_older_generation(void **ts);
+static void test_survives_arena_growth(void **ts);
+static void test_stops_allocating_once_warm(void **ts);
+static void test_works_as_the_err_of_a_result(void **ts);
+/*sublime-c-static-fn-hoist-end*/
+
+#define assert_renders(_expected, _ctx) { \
+  char buffer[256]; \
+  size_t len = result_ctx_render((_ctx), buffer, sizeof(buffer)); \
+  \
+  assert_string_equal((_expected), buffer); \
+  assert_int_equal(strlen(_expected), len); \
+}
+
+// Renders the same format and arguments with result_ctx and snprintf(3).
+#define assert_renders_like_snprintf(...) { \
+  char expected[256]; \
+  snprintf(expected, sizeof(expected), __VA_ARGS__); \
+  assert_renders(expected, result_ctx(1, __VA_ARGS__)); \
+}
+
+static void test_keeps_the_code_in_the_handle(void **ts) {
+  struct result_ctx_s ctx = result_ctx(-42, "oops");
+
+  assert_int_equal(8, sizeof(ctx));
+  assert_int_equal(-42, ctx.code);
+  assert_true(result_ctx_is_live(ctx));
+
+  result_ctx_reset();
+}
+
+static void test_renders_like_snprintf(void **ts) {
+  int negative = -17;
+  unsigned char byte = 200;
+  short small = -3;
+  size_t size = 123456789;
+  uint64_t big = UINT64_MAX;
+  float ratio = 0.25f;
+  const char *name = "config.toml";
+  char array[] = "on the stack";
+  enum { RED, GREEN } color = GREEN;
+  bool flag = true;
+
+  assert_renders_like_snprintf("%d %i", negative, negative);
+  assert_renders_like_snprintf("%u %x %X %o", byte, byte, byte, byte);
+  assert_renders_like_snprintf("%hd %5d|%-5d|%05d", small, small, small, small);
+  assert_renders_like_snprintf("%zu %zx", size, size);
+  assert_renders_like_snprintf("%" PRIu64 " %" PRIx64, big, big);
+  assert_renders_like_snprintf("%lld", (long long) INT64_MIN);
+  assert_renders_like_snprintf("%f %.2f %g %e", ratio, 3.14159, 1e100, 2.5);
+  assert_renders_like_snprintf("%s %10s|%-14s|%.3s", name, "x", array, name);
+  assert_renders_like_snprintf("%c%c", 'o', 'k');
+  assert_renders_like_snprintf("%d %d %u", color, flag, (unsigned) color);
+  assert_renders_like_snprintf("%p %p", (void *) name, name);
+  assert_renders_like_snprintf("100%% of %d", 8);
+  assert_renders_like_snprintf(
+    "%d %d %d %d %d %d %d %d", 1, 2, 3, 4, 5, 6, 7, 8
+  );
+
+  result_ctx_reset();
+}
+
+static void test_renders_without_arguments(void **ts) {
+  assert_renders("plain message", result_ctx(3, "plain message"));
+
+  result_ctx_reset();
+}
+
+static void test_copies_strings(void **ts) {
+  char path[32] = "/etc/passwd";
+  const char *missing = NULL;
+
+  struct result_ctx_s ctx = result_ctx(2, "open %s", path);
+  struct result_ctx_s null_ctx = result_ctx(2, "open %s", missing);
+
+  strcpy(path, "/changed");
+
+  assert_renders("open /etc/passwd", ctx);
+  assert_renders("open (null)", null_ctx);
+
+  result_ctx_reset();
+}
+
+static void test_truncates_like_snprintf(void **ts) {
+  struct result_ctx_s ctx = result_ctx(
+    5, "value %d is out of range %s", 12345, "[0, 10)"
+  );
+
+  const char *full = "value 12345 is out of range [0, 10)";
+
+  for (size_t size = 0; size <= strlen(full) + 1; size++) {
+    char buffer[64];
+    char expected[64];
+
+    memset(buffer, 'x', sizeof(buffer));
+    memset(expected, 'x', sizeof(expected));
+    snprintf(expected, size, "%s", full);
+
+    assert_int_equal(strlen(full), result_ctx_render(ctx, buffer, size));
+    assert_memory_equal(expected, buffer, sizeof(buffer));
+  }
+
+  assert_int_equal(strlen(full), result_ctx_render(ctx, NULL, 0));
+
+  result_ctx_reset();
+}
+
+static void test_reset_invalidates_handles(void **ts) {
+  struct result_ctx_s old = result_ctx(7, "request %d failed", 1);
+
+  result_ctx_reset();
+
+  struct result_ctx_s fresh = result_ctx(8, "request %d failed", 2);
+
+  assert_false(result_ctx_is_live(old));
+  assert_true(result_ctx_is_live(fresh));
+
+  // the code survives, the context doesn't
+  assert_renders("error 7", old);
+  assert_renders("request 2 failed", fresh);
+
+  struct result_ctx_s zero = { 0 };
+  assert_false(result_ctx_is_live(zero));
+
+  result_ctx_reset();
+}
+
+static void test_rejects_handles_from_any_older_generation(void **ts) {
+  result_ctx(1, "first");
+
+  struct result_ctx_s old = result_ctx(7, "request %d failed", 1);
+
+  // well past 255 resets, with a newer record either where `old` was or
+  // across it
+  for (int i = 0; i < 1000; i++) {
+    result_ctx_reset();
+
+    if (i % 2) {
+      result_ctx(1, "first");
+      result_ctx(8, "request %d failed", 2);
+    } else {
+      result_ctx(8, "%s", "a string long enough to cover where `old` was");
+    }
+
+    assert_false(result_ctx_is_live(old));
+  }
+
+  assert_renders("error 7", old);
+
+  result_ctx_reset();
+}
+
+static void test_survives_arena_growth(void **ts) {
+  struct result_ctx_s first = result_ctx(1, "first %s", "record");
+  struct result_ctx_s last = first;
+
+  for (int i = 0; i < 10000; i++) {
+    last = result_ctx(i, "record %d of %s", i, "many");
+  }
+
+  assert_true(result_ctx_stats().allocations > 1);
+  assert_renders("first record", first);
+  assert_renders("record 9999 of many", last);
+
+  result_ctx_free();
+  assert_int_equal(0, result_ctx_stats().capacity);
+}
+
+static void test_stops_allocating_once_warm(void **ts) {
+  for (int request = 0; request < 100; request++) {
+    for (int i = 0; i < 200; i++) {
+      struct result_ctx_s ctx = result_ctx(
+        i, "attempt %d of request %d: %s", i, request, "timeout"
+      );
+
+      (void) ctx;
+    }
+
+    result_ctx_reset();
+  }
+
+  size_t allocations = result_ctx_stats().allocations;
+
+  for (int request = 0; request < 100; request++) {
+    for (int i = 0; i < 200; i++) {
+      struct result_ctx_s ctx = result_ctx(
+        i, "attempt %d of request %d: %s", i, request, "timeout"
+      );
+
+      (void) ctx;
+    }
+
+    result_ctx_reset();
+  }
+
+  assert_int_equal(allocations, result_ctx_stats().allocations);
+  assert_int_equal(0, result_ctx_stats().dropped);
+}
+
+static void test_works_as_the_err_of_a_result(void **ts) {
+  typedef result_t(int, struct result_ctx_s) result_int_t;
+
+  result_int_t a = result_init_err(
+    result_ctx(9, "parse %s at %zu", "header", (size_t) 17)
+  );
+
+  result_int_t b = result_init_ok(1);
+
+  b = result_err(b, result_ctx(10, "nested"));
+
+  bool saw_err = false;
+
+  {result_with_err(a, ctx) {
+    assert_int_equal(9, ctx.code);
+    assert_renders("parse header at 17", ctx);
+    saw_err = true;
+  }}
+
+  assert_true(saw_err);
+  assert_true(result_is_err(b));
+  assert_renders("nested", result_unwrap_err_unchecked(b));
+
+  result_ctx_reset();
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_keeps_the_code_in_the_handle),
+    cmocka_unit_test(test_renders_like_snprintf),
+    cmocka_unit_test(test_renders_without_arguments),
+    cmocka_unit_test(test_copies_strings),
+    cmocka_unit_test(test_truncates_like_snprintf),
+    cmocka_unit_test(test_reset_invalidates_handles),
+    cmocka_unit_test(test_rejects_handles_from_any_older_generation),
+    cmocka_unit_test(test_survives_arena_growth),
+    cmocka_unit_test(test_stops_allocating_once_warm),
+    cmocka_unit_test(test_works_as_the_err_of_a_result),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
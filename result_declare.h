@@ -0,0 +1,178 @@
+#ifndef __result_declare_h__
+#define __result_declare_h__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core/defs.h"
+#include "result.h"
+
+//
+// Typed function families for a result type. Every result_t(T, E) expansion
+// is a new anonymous struct, and every combinator in result.h is a macro that
+// is expanded again at each use. RESULT_DECLARE instead emits one named type
+// and a set of static inline functions for it, in plain C99 without
+// statement expressions:
+//
+//   RESULT_DECLARE(result_u64, uint64_t, int)
+//
+//   static uint64_t twice(uint64_t value) { return value * 2; }
+//   static result_u64_t parse(uint64_t value);
+//
+//   result_u64_t res = result_u64_and_then(result_u64_ok(21), parse);
+//   uint64_t value = result_u64_unwrap_or(result_u64_map(res, twice), 0);
+//
+// declares
+//
+//   struct result_u64_s, result_u64_t    the result_d(T, E) itself
+//   result_u64_ok_t, result_u64_err_t    T and E
+//   result_u64_ok(T), result_u64_err(E)  constructors
+//   result_u64_is_ok, result_u64_is_err
+//   result_u64_map                       T -> T on the ok value
+//   result_u64_map_err                   E -> E on the err
+//   result_u64_and_then                  T -> result on the ok value
+//   result_u64_or_else                   E -> result on the err
+//   result_u64_unwrap_or                 the ok value or a default
+//   result_u64_unwrap_or_else            the ok value or E -> T
+//   result_u64_unwrap_or_default         the ok value or a zero T
+//   result_u64_expect                    the ok value or abort(3)
+//
+// Since all results of the same T and E can now share one type, they can be
+// passed between functions without a cast, and GCC sees the same function
+// for every call, so it inlines (and CSEs) them like any other function. Use
+// it once per T and E, in a header, and the result_t macros from result.h
+// keep working on the type.
+//
+// The callbacks are plain function pointers. When they're constant at the
+// call site, as above, GCC inlines the combinator and then the callback too,
+// so there's no indirect call left.
+//
+// unwrap_or_default builds only a zero T, on the err path, where
+// result_unwrap_or_else zeroes a whole result.
+//
+// To map between two declared families with the same err type,
+// RESULT_DECLARE_MAP emits a function from one to the other:
+//
+//   RESULT_DECLARE(result_str, const char *, int)
+//   RESULT_DECLARE_MAP(result_u64_to_str, result_u64, result_str)
+//
+//   result_str_t str = result_u64_to_str(res, describe);
+//
+
+// Shared by every _expect, out of line so the callers only have a call on
+// their cold path.
+static __attribute__((cold, noinline, noreturn, unused))
+void result_expect_failed(const char *message) {
+  fprintf(stderr, "%s\n", message);
+  abort();
+}
+
+#define RESULT_DECLARE(_name, _type, _err_type) \
+  typedef _type _name##_ok_t; \
+  typedef _err_type _name##_err_t; \
+  typedef struct _name##_s result_d(_type, _err_type) _name##_t; \
+  \
+  static inline __attribute__((unused)) \
+  _name##_t _name##_ok(_type value) { \
+    return (_name##_t) result_init_ok(value); \
+  } \
+  \
+  static inline __attribute__((unused)) \
+  _name##_t _name##_err(_err_type err) { \
+    return (_name##_t) result_init_err(err); \
+  } \
+  \
+  static inline __attribute__((unused)) \
+  bool _name##_is_ok(_name##_t res) { \
+    return res.header.is_ok; \
+  } \
+  \
+  static inline __attribute__((unused)) \
+  bool _name##_is_err(_name##_t res) { \
+    return !res.header.is_ok; \
+  } \
+  \
+  static inline __attribute__((unused)) \
+  _name##_t _name##_map(_name##_t res, _type (*fn)(_type)) { \
+    if (res.header.is_ok) { \
+      res.body.ok = fn(res.body.ok); \
+    } \
+    \
+    return res; \
+  } \
+  \
+  static inline __attribute__((unused)) \
+  _name##_t _name##_map_err(_name##_t res, _err_type (*fn)(_err_type)) { \
+    if (!res.header.is_ok) { \
+      res.body.err = fn(res.body.err); \
+    } \
+    \
+    return res; \
+  } \
+  \
+  static inline __attribute__((unused)) \
+  _name##_t _name##_and_then(_name##_t res, _name##_t (*fn)(_type)) { \
+    if (res.header.is_ok) { \
+      return fn(res.body.ok); \
+    } \
+    \
+    return res; \
+  } \
+  \
+  static inline __attribute__((unused)) \
+  _name##_t _name##_or_else(_name##_t res, _name##_t (*fn)(_err_type)) { \
+    if (!res.header.is_ok) { \
+      return fn(res.body.err); \
+    } \
+    \
+    return res; \
+  } \
+  \
+  static inline __attribute__((unused)) \
+  _type _name##_unwrap_or(_name##_t res, _type default_value) { \
+    if (res.header.is_ok) { \
+      return res.body.ok; \
+    } \
+    \
+    return default_value; \
+  } \
+  \
+  static inline __attribute__((unused)) \
+  _type _name##_unwrap_or_else(_name##_t res, _type (*fn)(_err_type)) { \
+    if (res.header.is_ok) { \
+      return res.body.ok; \
+    } \
+    \
+    return fn(res.body.err); \
+  } \
+  \
+  static inline __attribute__((unused)) \
+  _type _name##_unwrap_or_default(_name##_t res) { \
+    if (res.header.is_ok) { \
+      return res.body.ok; \
+    } \
+    \
+    _type zero = { 0 }; \
+    return zero; \
+  } \
+  \
+  static inline __attribute__((unused)) \
+  _type _name##_expect(_name##_t res, const char *message) { \
+    if (w_unlikely(!res.header.is_ok)) { \
+      result_expect_failed(message); \
+    } \
+    \
+    return res.body.ok; \
+  }
+
+#define RESULT_DECLARE_MAP(_fn_name, _from, _to) \
+  static inline __attribute__((unused)) \
+  _to##_t _fn_name(_from##_t res, _to##_ok_t (*fn)(_from##_ok_t)) { \
+    if (res.header.is_ok) { \
+      return _to##_ok(fn(res.body.ok)); \
+    } \
+    \
+    return _to##_err(res.body.err); \
+  }
+
+#endif // __result_declare_h__
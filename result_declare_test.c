@@ -0,0 +1,192 @@
+#include "core/defs.h"
+#include "result_declare.h"
+
+struct pair_s {
+  uint64_t a;
+  uint64_t b;
+};
+
+RESULT_DECLARE(result_u64, uint64_t, int)
+RESULT_DECLARE(result_str, const char *, int)
+RESULT_DECLARE(result_pair, struct pair_s, int)
+RESULT_DECLARE_MAP(result_u64_to_str, result_u64, result_str)
+
+/*sublime-c-static-fn-hoist-start*/
+static uint64_t twice(uint64_t value);
+static int negate(int err);
+static result_u64_t halve(uint64_t value);
+static result_u64_t recover(int err);
+static uint64_t from_err(int err);
+static const char *describe(uint64_t value);
+static result_u64_t forward(result_u64_t res);
+static void test_constructs_and_checks(void **ts);
+static void test_shares_one_type(void **ts);
+static void test_works_with_result_h_macros(void **ts);
+static void test_map_only_touches_ok(void **ts);
+static void test_map_err_only_touches_err(void **ts);
+static void test_and_then_chains_until_an_err(void **ts);
+static void test_or_else_recovers_from_an_err(void **ts);
+static void test_unwrap_or_and_or_else(void **ts);
+static void test_unwrap_or_default_zeroes_only_the_ok_type(void **ts);
+static void test_expect_returns_the_ok_value(void **ts);
+static void test_declare_map_converts_between_families(void **ts);
+/*sublime-c-static-fn-hoist-end*/
+
+static uint64_t twice(uint64_t value) {
+  return value * 2;
+}
+
+static int negate(int err) {
+  return -err;
+}
+
+static result_u64_t halve(uint64_t value) {
+  if (value % 2) {
+    return result_u64_err((int) value);
+  }
+
+  return result_u64_ok(value / 2);
+}
+
+static result_u64_t recover(int err) {
+  return result_u64_ok((uint64_t) err * 100);
+}
+
+static uint64_t from_err(int err) {
+  return (uint64_t) err + 1;
+}
+
+static const char *describe(uint64_t value) {
+  return value > 10 ? "big" : "small";
+}
+
+static result_u64_t forward(result_u64_t res) {
+  return res;
+}
+
+static void test_constructs_and_checks(void **ts) {
+  result_u64_t ok = result_u64_ok(7);
+  result_u64_t err = result_u64_err(3);
+
+  assert_true(result_u64_is_ok(ok));
+  assert_false(result_u64_is_err(ok));
+  assert_true(result_u64_is_err(err));
+  assert_int_equal(7, result_unwrap_unchecked(ok));
+  assert_int_equal(3, result_unwrap_err_unchecked(err));
+}
+
+static void test_shares_one_type(void **ts) {
+  struct result_u64_s named = result_u64_ok(1);
+  result_u64_t res = forward(named);
+
+  assert_true(__builtin_types_compatible_p(
+    struct result_u64_s,
+    result_u64_t
+  ));
+
+  assert_true(__builtin_types_compatible_p(result_u64_ok_t, uint64_t));
+  assert_true(__builtin_types_compatible_p(result_u64_err_t, int));
+  assert_int_equal(1, result_unwrap_unchecked(res));
+}
+
+static void test_works_with_result_h_macros(void **ts) {
+  result_u64_t res = result_init_err(4);
+
+  assert_int_equal(9, result_unwrap_or(res, 9));
+
+  result_set_ok(res, 5);
+  assert_true(result_is_ok(res));
+  assert_int_equal(5, result_u64_unwrap_or(res, 9));
+}
+
+static void test_map_only_touches_ok(void **ts) {
+  result_u64_t ok = result_u64_map(result_u64_ok(21), twice);
+  result_u64_t err = result_u64_map(result_u64_err(5), twice);
+
+  assert_int_equal(42, result_unwrap_unchecked(ok));
+  assert_true(result_u64_is_err(err));
+  assert_int_equal(5, result_unwrap_err_unchecked(err));
+}
+
+static void test_map_err_only_touches_err(void **ts) {
+  result_u64_t ok = result_u64_map_err(result_u64_ok(21), negate);
+  result_u64_t err = result_u64_map_err(result_u64_err(5), negate);
+
+  assert_int_equal(21, result_unwrap_unchecked(ok));
+  assert_int_equal(-5, result_unwrap_err_unchecked(err));
+}
+
+static void test_and_then_chains_until_an_err(void **ts) {
+  result_u64_t res = result_u64_ok(12);
+
+  res = result_u64_and_then(res, halve);
+  res = result_u64_and_then(res, halve);
+  assert_int_equal(3, result_unwrap_unchecked(res));
+
+  res = result_u64_and_then(res, halve);
+  res = result_u64_and_then(res, halve);
+  assert_true(result_u64_is_err(res));
+  assert_int_equal(3, result_unwrap_err_unchecked(res));
+}
+
+static void test_or_else_recovers_from_an_err(void **ts) {
+  result_u64_t ok = result_u64_or_else(result_u64_ok(1), recover);
+  result_u64_t err = result_u64_or_else(result_u64_err(3), recover);
+
+  assert_int_equal(1, result_unwrap_unchecked(ok));
+  assert_true(result_u64_is_ok(err));
+  assert_int_equal(300, result_unwrap_unchecked(err));
+}
+
+static void test_unwrap_or_and_or_else(void **ts) {
+  assert_int_equal(1, result_u64_unwrap_or(result_u64_ok(1), 2));
+  assert_int_equal(2, result_u64_unwrap_or(result_u64_err(3), 2));
+  assert_int_equal(1, result_u64_unwrap_or_else(result_u64_ok(1), from_err));
+  assert_int_equal(4, result_u64_unwrap_or_else(result_u64_err(3), from_err));
+}
+
+static void test_unwrap_or_default_zeroes_only_the_ok_type(void **ts) {
+  struct pair_s ok = result_pair_unwrap_or_default(
+    result_pair_ok((struct pair_s) { .a = 1, .b = 2 })
+  );
+
+  struct pair_s err = result_pair_unwrap_or_default(result_pair_err(3));
+
+  assert_int_equal(1, ok.a);
+  assert_int_equal(2, ok.b);
+  assert_int_equal(0, err.a);
+  assert_int_equal(0, err.b);
+  assert_null(result_str_unwrap_or_default(result_str_err(1)));
+  assert_int_equal(0, result_u64_unwrap_or_default(result_u64_err(1)));
+}
+
+static void test_expect_returns_the_ok_value(void **ts) {
+  assert_int_equal(8, result_u64_expect(result_u64_ok(8), "no value"));
+}
+
+static void test_declare_map_converts_between_families(void **ts) {
+  result_str_t big = result_u64_to_str(result_u64_ok(11), describe);
+  result_str_t err = result_u64_to_str(result_u64_err(6), describe);
+
+  assert_string_equal("big", result_unwrap_unchecked(big));
+  assert_true(result_str_is_err(err));
+  assert_int_equal(6, result_unwrap_err_unchecked(err));
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_constructs_and_checks),
+    cmocka_unit_test(test_shares_one_type),
+    cmocka_unit_test(test_works_with_result_h_macros),
+    cmocka_unit_test(test_map_only_touches_ok),
+    cmocka_unit_test(test_map_err_only_touches_err),
+    cmocka_unit_test(test_and_then_chains_until_an_err),
+    cmocka_unit_test(test_or_else_recovers_from_an_err),
+    cmocka_unit_test(test_unwrap_or_and_or_else),
+    cmocka_unit_test(test_unwrap_or_default_zeroes_only_the_ok_type),
+    cmocka_unit_test(test_expect_returns_the_ok_value),
+    cmocka_unit_test(test_declare_map_converts_between_families),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,551 @@
+#include "result_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BUFFER_SIZE ((size_t) 1 << 20)
+
+static const char magic[8] = "RESULTS";
+
+struct result_file_writer_s {
+  int fd;
+  struct result_file_layout_s layout;
+  unsigned flags;
+  uint64_t len;
+
+  uint8_t *buffer;
+  size_t buffered;
+
+  uint8_t *bitmap;
+  size_t bitmap_capacity;
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static result_file_status_t status_of(int err);
+static int write_all(int fd, const void *data, size_t len);
+static int flush(struct result_file_writer_s *writer);
+static bool grow_bitmap(struct result_file_writer_s *writer, uint64_t len);
+static void append(
+  struct result_file_writer_s *writer,
+  const uint8_t *result
+);
+static void swap_bytes(uint8_t *bytes, size_t len);
+static void swap_header(struct result_file_header_s *header);
+static bool can_map(
+  const struct result_file_header_s *header,
+  const struct result_file_layout_s *layout,
+  bool swapped
+);
+static int check(
+  const struct result_file_header_s *header,
+  const struct result_file_layout_s *layout,
+  bool swapped,
+  size_t size
+);
+static int convert(struct result_file_s *file, bool swapped);
+/*sublime-c-static-fn-hoist-end*/
+
+static result_file_status_t status_of(int err) {
+  if (err != 0) {
+    return (result_file_status_t) result_init_err(err);
+  }
+
+  return (result_file_status_t) result_init_ok(0);
+}
+
+static int write_all(int fd, const void *data, size_t len) {
+  const uint8_t *bytes = data;
+
+  while (len > 0) {
+    ssize_t written = write(fd, bytes, len);
+
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return errno;
+    }
+
+    bytes += written;
+    len -= (size_t) written;
+  }
+
+  return 0;
+}
+
+static int flush(struct result_file_writer_s *writer) {
+  int err = write_all(writer->fd, writer->buffer, writer->buffered);
+
+  writer->buffered = 0;
+  return err;
+}
+
+static bool grow_bitmap(struct result_file_writer_s *writer, uint64_t len) {
+  size_t needed = (size_t) (len + 7) / 8;
+
+  if (needed <= writer->bitmap_capacity) {
+    return true;
+  }
+
+  size_t capacity = w_max_2(needed, 2 * writer->bitmap_capacity);
+  uint8_t *bitmap = realloc(writer->bitmap, capacity);
+
+  if (!bitmap) {
+    return false;
+  }
+
+  memset(
+    bitmap + writer->bitmap_capacity,
+    0,
+    capacity - writer->bitmap_capacity
+  );
+
+  writer->bitmap = bitmap;
+  writer->bitmap_capacity = capacity;
+  return true;
+}
+
+// Copies the result into the buffer with its padding zeroed.
+static void append(
+  struct result_file_writer_s *writer,
+  const uint8_t *result
+) {
+  const struct result_file_layout_s *layout = &writer->layout;
+  uint8_t *element = writer->buffer + writer->buffered;
+  bool is_ok = result[0] != 0;
+  size_t payload = is_ok ? layout->ok_size : layout->err_size;
+
+  memset(element, 0, layout->element_size);
+  element[0] = is_ok;
+
+  memcpy(
+    element + layout->body_offset,
+    result + layout->body_offset,
+    payload
+  );
+
+  if (is_ok && writer->bitmap) {
+    writer->bitmap[writer->len / 8] |= (uint8_t) (1u << (writer->len % 8));
+  }
+
+  writer->buffered += layout->element_size;
+  writer->len++;
+}
+
+result_file_status_t result_file_create(
+  struct result_file_writer_s **writer,
+  const char *path,
+  const struct result_file_layout_s *layout,
+  unsigned flags
+) {
+  struct result_file_writer_s *self = calloc(1, sizeof(*self));
+
+  *writer = NULL;
+
+  if (!self) {
+    return status_of(ENOMEM);
+  }
+
+  self->layout = *layout;
+  self->flags = flags;
+  self->buffer = malloc(w_max_2(BUFFER_SIZE, (size_t) layout->element_size));
+
+  if (!self->buffer) {
+    free(self);
+    return status_of(ENOMEM);
+  }
+
+  self->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+  if (self->fd < 0) {
+    int err = errno;
+
+    free(self->buffer);
+    free(self);
+    return status_of(err);
+  }
+
+  // a placeholder without the magic until result_file_close()
+  uint8_t header[RESULT_FILE_HEADER_SIZE] = { 0 };
+  int err = write_all(self->fd, header, sizeof(header));
+
+  if (err != 0) {
+    result_file_abort(self);
+    return status_of(err);
+  }
+
+  *writer = self;
+  return status_of(0);
+}
+
+result_file_status_t result_file_write(
+  struct result_file_writer_s *writer,
+  const void *results,
+  size_t n
+) {
+  const uint8_t *bytes = results;
+  size_t element_size = writer->layout.element_size;
+
+  if (
+    (writer->flags & RESULT_FILE_OK_BITMAP)
+    && !grow_bitmap(writer, writer->len + n)
+  ) {
+    return status_of(ENOMEM);
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    if (writer->buffered + element_size > BUFFER_SIZE) {
+      int err = flush(writer);
+
+      if (err != 0) {
+        return status_of(err);
+      }
+    }
+
+    append(writer, bytes + i * element_size);
+  }
+
+  return status_of(0);
+}
+
+result_file_status_t result_file_close(struct result_file_writer_s *writer) {
+  const struct result_file_layout_s *layout = &writer->layout;
+  uint64_t data_end = RESULT_FILE_HEADER_SIZE
+    + writer->len * layout->element_size;
+
+  struct result_file_header_s header = {
+    .byte_order = RESULT_FILE_BYTE_ORDER,
+    .version = RESULT_FILE_VERSION,
+    .flags = (uint16_t) (writer->flags & RESULT_FILE_OK_BITMAP),
+    .header_size = RESULT_FILE_HEADER_SIZE,
+    .element_size = layout->element_size,
+    .body_offset = layout->body_offset,
+    .ok_size = layout->ok_size,
+    .err_size = layout->err_size,
+    .ok_type_id = layout->ok_type_id,
+    .err_type_id = layout->err_type_id,
+    .len = writer->len,
+    .data_offset = RESULT_FILE_HEADER_SIZE,
+  };
+
+  memcpy(header.magic, magic, sizeof(magic));
+
+  int err = flush(writer);
+
+  if (err == 0 && (writer->flags & RESULT_FILE_OK_BITMAP)) {
+    static const uint8_t zeros[8] = { 0 };
+    size_t padding = (size_t) ((8 - data_end % 8) % 8);
+
+    header.bitmap_offset = data_end + padding;
+    err = write_all(writer->fd, zeros, padding);
+
+    if (err == 0) {
+      err = write_all(writer->fd, writer->bitmap, (writer->len + 7) / 8);
+    }
+  }
+
+  if (err == 0 && pwrite(writer->fd, &header, sizeof(header), 0) < 0) {
+    err = errno;
+  }
+
+  if (close(writer->fd) != 0 && err == 0) {
+    err = errno;
+  }
+
+  writer->fd = -1;
+  result_file_abort(writer);
+
+  return status_of(err);
+}
+
+void result_file_abort(struct result_file_writer_s *writer) {
+  if (!writer) {
+    return;
+  }
+
+  if (writer->fd >= 0) {
+    close(writer->fd);
+  }
+
+  free(writer->buffer);
+  free(writer->bitmap);
+  free(writer);
+}
+
+static void swap_bytes(uint8_t *bytes, size_t len) {
+  for (size_t i = 0; i < len / 2; i++) {
+    uint8_t byte = bytes[i];
+
+    bytes[i] = bytes[len - 1 - i];
+    bytes[len - 1 - i] = byte;
+  }
+}
+
+static void swap_header(struct result_file_header_s *header) {
+  swap_bytes((uint8_t *) &header->byte_order, sizeof(header->byte_order));
+  swap_bytes((uint8_t *) &header->version, sizeof(header->version));
+  swap_bytes((uint8_t *) &header->flags, sizeof(header->flags));
+  swap_bytes((uint8_t *) &header->header_size, sizeof(header->header_size));
+  swap_bytes((uint8_t *) &header->element_size, sizeof(header->element_size));
+  swap_bytes((uint8_t *) &header->body_offset, sizeof(header->body_offset));
+  swap_bytes((uint8_t *) &header->ok_size, sizeof(header->ok_size));
+  swap_bytes((uint8_t *) &header->err_size, sizeof(header->err_size));
+  swap_bytes((uint8_t *) &header->ok_type_id, sizeof(header->ok_type_id));
+  swap_bytes((uint8_t *) &header->err_type_id, sizeof(header->err_type_id));
+  swap_bytes((uint8_t *) &header->len, sizeof(header->len));
+  swap_bytes((uint8_t *) &header->data_offset, sizeof(header->data_offset));
+  swap_bytes(
+    (uint8_t *) &header->bitmap_offset,
+    sizeof(header->bitmap_offset)
+  );
+}
+
+static bool can_map(
+  const struct result_file_header_s *header,
+  const struct result_file_layout_s *layout,
+  bool swapped
+) {
+  return !swapped
+    && header->element_size == layout->element_size
+    && header->body_offset == layout->body_offset
+    && header->data_offset % layout->body_offset == 0;
+}
+
+// Whether the header describes a file of `size` bytes that can be read with
+// `layout`, as an errno value.
+static int check(
+  const struct result_file_header_s *header,
+  const struct result_file_layout_s *layout,
+  bool swapped,
+  size_t size
+) {
+  if (header->version != RESULT_FILE_VERSION) {
+    return ENOTSUP;
+  }
+
+  uint32_t payload = w_max_2(header->ok_size, header->err_size);
+
+  if (
+    header->header_size < RESULT_FILE_HEADER_SIZE
+    || header->data_offset < header->header_size
+    || header->body_offset == 0
+    || header->body_offset > header->element_size
+    || payload > header->element_size - header->body_offset
+  ) {
+    return EBADMSG;
+  }
+
+  if (
+    header->ok_type_id != layout->ok_type_id
+    || header->err_type_id != layout->err_type_id
+  ) {
+    return EPROTOTYPE;
+  }
+
+  // the same types, so conversions only move them around (and swap them)
+  if (
+    header->ok_size != layout->ok_size
+    || header->err_size != layout->err_size
+  ) {
+    return EPROTOTYPE;
+  }
+
+  if (swapped && (!layout->ok_is_scalar || !layout->err_is_scalar)) {
+    return ENOTSUP;
+  }
+
+  if (
+    header->data_offset > size
+    || header->len > (size - header->data_offset) / header->element_size
+  ) {
+    return EBADMSG;
+  }
+
+  if (
+    (header->flags & RESULT_FILE_OK_BITMAP)
+    && (
+      header->bitmap_offset > size
+      || (header->len + 7) / 8 > size - header->bitmap_offset
+    )
+  ) {
+    return EBADMSG;
+  }
+
+  return 0;
+}
+
+static int convert(struct result_file_s *file, bool swapped) {
+  const struct result_file_header_s *header = &file->header;
+  const struct result_file_layout_s *layout = &file->layout;
+  const uint8_t *from = (const uint8_t *) file->map + header->data_offset;
+
+  if (file->len > SIZE_MAX / layout->element_size) {
+    return ENOMEM;
+  }
+
+  uint8_t *to = calloc(file->len, layout->element_size);
+
+  if (!to && file->len > 0) {
+    return ENOMEM;
+  }
+
+  for (size_t i = 0; i < file->len; i++) {
+    const uint8_t *source = from + i * header->element_size;
+    uint8_t *element = to + i * layout->element_size;
+    bool is_ok = source[0] != 0;
+    size_t payload = is_ok ? layout->ok_size : layout->err_size;
+
+    element[0] = is_ok;
+    memcpy(
+      element + layout->body_offset,
+      source + header->body_offset,
+      payload
+    );
+
+    if (swapped) {
+      swap_bytes(element + layout->body_offset, payload);
+    }
+  }
+
+  file->converted = to;
+  file->data = to;
+  return 0;
+}
+
+result_file_status_t result_file_open(
+  struct result_file_s *file,
+  const char *path,
+  const struct result_file_layout_s *layout
+) {
+  struct stat st;
+
+  *file = (struct result_file_s) { .layout = *layout };
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+  if (fd < 0) {
+    return status_of(errno);
+  }
+
+  if (fstat(fd, &st) != 0) {
+    int err = errno;
+
+    close(fd);
+    return status_of(err);
+  }
+
+  if ((uint64_t) st.st_size < RESULT_FILE_HEADER_SIZE) {
+    close(fd);
+    return status_of(EBADMSG);
+  }
+
+  file->map_size = (size_t) st.st_size;
+  file->map = mmap(NULL, file->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (file->map == MAP_FAILED) {
+    int err = errno;
+
+    *file = (struct result_file_s) { 0 };
+    return status_of(err);
+  }
+
+  memcpy(&file->header, file->map, sizeof(file->header));
+
+  struct result_file_header_s *header = &file->header;
+  bool swapped = header->byte_order != RESULT_FILE_BYTE_ORDER;
+
+  if (swapped) {
+    swap_header(header);
+  }
+
+  int err = memcmp(header->magic, magic, sizeof(magic)) != 0
+    || header->byte_order != RESULT_FILE_BYTE_ORDER
+    ? EBADMSG
+    : check(header, layout, swapped, file->map_size);
+
+  if (err != 0) {
+    result_file_unmap(file);
+    return status_of(err);
+  }
+
+  file->len = (size_t) header->len;
+
+  if (header->flags & RESULT_FILE_OK_BITMAP) {
+    file->ok_bitmap = (const uint8_t *) file->map + header->bitmap_offset;
+  }
+
+  if (can_map(header, layout, swapped)) {
+    file->data = (const uint8_t *) file->map + header->data_offset;
+
+    madvise(file->map, file->map_size, MADV_SEQUENTIAL);
+    return status_of(0);
+  }
+
+  err = convert(file, swapped);
+
+  if (err != 0) {
+    result_file_unmap(file);
+    return status_of(err);
+  }
+
+  return status_of(0);
+}
+
+void result_file_unmap(struct result_file_s *file) {
+  if (file->map && file->map != MAP_FAILED) {
+    munmap(file->map, file->map_size);
+  }
+
+  free(file->converted);
+  *file = (struct result_file_s) { 0 };
+}
+
+bool result_file_is_mapped(const struct result_file_s *file) {
+  return file->data != NULL && file->data != file->converted;
+}
+
+size_t result_file_next_err(const struct result_file_s *file, size_t from) {
+  if (!file->ok_bitmap) {
+    const uint8_t *data = file->data;
+
+    for (size_t i = from; i < file->len; i++) {
+      if (data[i * file->layout.element_size] == 0) {
+        return i;
+      }
+    }
+
+    return file->len;
+  }
+
+  size_t i = from;
+
+  // up to a byte boundary, then skip all-ok words
+  for (; i < file->len && i % 8 != 0; i++) {
+    if (!(file->ok_bitmap[i / 8] & (1u << (i % 8)))) {
+      return i;
+    }
+  }
+
+  for (; i + 64 <= file->len; i += 64) {
+    uint64_t word;
+
+    memcpy(&word, file->ok_bitmap + i / 8, sizeof(word));
+
+    if (word != UINT64_MAX) {
+      break;
+    }
+  }
+
+  for (; i < file->len; i++) {
+    if (!(file->ok_bitmap[i / 8] & (1u << (i % 8)))) {
+      return i;
+    }
+  }
+
+  return file->len;
+}
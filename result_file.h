@@ -0,0 +1,212 @@
+#ifndef __result_file_h__
+#define __result_file_h__
+
+#include "core/defs.h"
+#include "result.h"
+
+//
+// Versioned binary files of result_padded_t arrays, written as a stream and
+// read back with mmap(2):
+//
+//   typedef result_padded_t(struct sample_s, int) result_sample_t;
+//
+//   const struct result_file_layout_s layout = result_file_layout(
+//     result_sample_t, SAMPLE_TYPE_ID, ERRNO_TYPE_ID
+//   );
+//
+//   struct result_file_writer_s *writer;
+//   result_file_status_t st = result_file_create(
+//     &writer, "samples.res", &layout, RESULT_FILE_OK_BITMAP
+//   );
+//
+//   st = result_file_write(writer, batch, w_array_size(batch));
+//   st = result_file_close(writer);
+//
+//   struct result_file_s file;
+//   st = result_file_open(&file, "samples.res", &layout);
+//
+//   const result_sample_t *samples = result_file_data(&file, result_sample_t);
+//
+//   for (size_t i = 0; i < file.len; i++) {
+//     ...
+//   }
+//
+//   result_file_unmap(&file);
+//
+// Every function returns a result_file_status_t, with an errno value as the
+// err: the ones from the syscalls, or EBADMSG for a file that isn't one of
+// these (or was never closed), EPROTOTYPE when its type ids aren't the ones
+// asked for and ENOTSUP when it can't be converted.
+//
+// The file is a header, the elements and then, optionally, a bitmap of which
+// elements are ok:
+//
+//   offset          size                    what
+//   0               128                     struct result_file_header_s
+//   data_offset     len * element_size      elements, as they are in memory
+//   bitmap_offset   (len + 7) / 8           bit i % 8 of byte i / 8 is set
+//                                           when element i is ok
+//
+// Integers in the header and the elements are in the writer's byte order,
+// which `byte_order` gives away. The header is written last, by
+// result_file_close(), so a file that was never closed doesn't open.
+//
+// result_padded_d makes every field a multiple of the pointer size and puts
+// is_ok in the first byte, so an element in the file is byte for byte the
+// element in memory: when the writer had the same byte order and pointer size,
+// result_file_open() maps the file and result_file_data() points right into
+// it, and reading the whole thing costs exactly its page faults. Otherwise the
+// elements are converted into a malloc'd array once, which works as long as
+// ok and err are the same types on both ends and, for the other byte order,
+// scalars. The writer zeroes the padding, so files are reproducible and don't
+// leak whatever was in it.
+//
+// The type ids are whatever the program wants them to be, they're only there
+// so that a file of one thing isn't read as another thing of the same size.
+//
+
+#define RESULT_FILE_VERSION 1
+#define RESULT_FILE_BYTE_ORDER 0x01020304u
+#define RESULT_FILE_HEADER_SIZE 128
+
+typedef result_status_t(int) result_file_status_t;
+
+enum result_file_flags_e {
+  RESULT_FILE_OK_BITMAP = 1 << 0,
+};
+
+struct result_file_header_s {
+  char magic[8];
+  uint32_t byte_order;
+  uint16_t version;
+  uint16_t flags;
+  uint32_t header_size;
+
+  // the offset of the body is the size of the padded header
+  uint32_t element_size;
+  uint32_t body_offset;
+  uint32_t ok_size;
+  uint32_t err_size;
+  uint32_t ok_type_id;
+  uint32_t err_type_id;
+  uint32_t zero;
+
+  uint64_t len;
+  uint64_t data_offset;
+  uint64_t bitmap_offset;
+
+  // zeros, for later versions
+  uint8_t reserved[56];
+};
+
+_Static_assert(
+  sizeof(struct result_file_header_s) == RESULT_FILE_HEADER_SIZE,
+  "the header has a fixed size"
+);
+
+struct result_file_layout_s {
+  uint32_t element_size;
+  uint32_t body_offset;
+  uint32_t ok_size;
+  uint32_t err_size;
+  uint32_t ok_type_id;
+  uint32_t err_type_id;
+
+  // ok and err can be byte swapped as a whole
+  bool ok_is_scalar;
+  bool err_is_scalar;
+};
+
+struct result_file_writer_s;
+
+struct result_file_s {
+  size_t len;
+  const void *data;
+
+  // NULL without RESULT_FILE_OK_BITMAP
+  const uint8_t *ok_bitmap;
+
+  struct result_file_header_s header;
+  struct result_file_layout_s layout;
+  void *map;
+  size_t map_size;
+  void *converted;
+};
+
+#define result_file_layout(_result_type, _ok_type_id, _err_type_id) ({ \
+  _Static_assert( \
+    __builtin_offsetof(_result_type, body) == sizeof(void *) \
+    && sizeof(((_result_type *) 0)->header) == sizeof(void *), \
+    "result_file needs a result_padded_t" \
+  ); \
+  \
+  (struct result_file_layout_s) { \
+    .element_size = sizeof(_result_type), \
+    .body_offset = __builtin_offsetof(_result_type, body), \
+    .ok_size = sizeof(((_result_type *) 0)->body.ok), \
+    .err_size = sizeof(((_result_type *) 0)->body.err), \
+    .ok_type_id = (_ok_type_id), \
+    .err_type_id = (_err_type_id), \
+    .ok_is_scalar = result_file_is_scalar(((_result_type *) 0)->body.ok), \
+    .err_is_scalar = result_file_is_scalar(((_result_type *) 0)->body.err), \
+  }; \
+})
+
+// Integers, enums, bools and floating point, but not pointers.
+#define result_file_is_scalar(_expr) ( \
+  __builtin_classify_type(_expr) == 1 \
+  || __builtin_classify_type(_expr) == 2 \
+  || __builtin_classify_type(_expr) == 3 \
+  || __builtin_classify_type(_expr) == 4 \
+  || __builtin_classify_type(_expr) == 8 \
+)
+
+// The elements as a `const _result_type *`, which has to be the type the
+// layout was made from.
+#define result_file_data(_file, _result_type) \
+  ((__typeof(_result_type) const *) (_file)->data)
+
+// Creates (or truncates) `path`. `flags` are enum result_file_flags_e.
+extern result_file_status_t result_file_create(
+  struct result_file_writer_s **writer,
+  const char *path,
+  const struct result_file_layout_s *layout,
+  unsigned flags
+);
+
+// Appends `n` elements of the writer's layout.
+extern result_file_status_t result_file_write(
+  struct result_file_writer_s *writer,
+  const void *results,
+  size_t n
+);
+
+// Writes out everything that's buffered, the bitmap and the header. Frees the
+// writer even if that fails.
+extern result_file_status_t result_file_close(
+  struct result_file_writer_s *writer
+);
+
+// Frees the writer and leaves the file as it is, which doesn't open.
+extern void result_file_abort(struct result_file_writer_s *writer);
+
+extern result_file_status_t result_file_open(
+  struct result_file_s *file,
+  const char *path,
+  const struct result_file_layout_s *layout
+);
+
+extern void result_file_unmap(struct result_file_s *file);
+
+// Whether result_file_data() points into the mapped file, rather than at a
+// converted copy.
+extern bool result_file_is_mapped(const struct result_file_s *file);
+
+// The index of the first err at or after `from`, or file->len. Only reads the
+// bitmap if the file has one.
+extern size_t result_file_next_err(
+  const struct result_file_s *file,
+  size_t from
+);
+
+#endif // __result_file_h__
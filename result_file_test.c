@@ -0,0 +1,515 @@
+#include "core/defs.h"
+#include "result_file.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+typedef result_padded_t(uint64_t, int32_t) result_u64_t;
+
+struct point_s {
+  int32_t x;
+  int32_t y;
+};
+
+typedef result_padded_t(struct point_s, int32_t) result_point_t;
+
+enum {
+  TYPE_U64 = 1,
+  TYPE_POINT = 2,
+  TYPE_ERRNO = 3,
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static void temp_path(char *path);
+static void fill(result_u64_t *results, size_t n);
+static void check_results(
+  const result_u64_t *expected,
+  const result_u64_t *actual,
+  size_t n
+);
+static void write_results(
+  const char *path,
+  const result_u64_t *results,
+  size_t n,
+  unsigned flags
+);
+static void read_file(const char *path, uint8_t **data, size_t *size);
+static void write_file(const char *path, const uint8_t *data, size_t size);
+static void swap(void *data, size_t len);
+static void test_round_trip(void **ts);
+static void test_empty(void **ts);
+static void test_without_bitmap(void **ts);
+static void test_padding_is_zeroed(void **ts);
+static void test_unclosed(void **ts);
+static void test_bad_files(void **ts);
+static void test_other_byte_order(void **ts);
+static void test_other_pointer_size(void **ts);
+static void test_struct_other_byte_order(void **ts);
+/*sublime-c-static-fn-hoist-end*/
+
+#define LEN 100003
+
+static void temp_path(char *path) {
+  strcpy(path, "/tmp/result_file_test.XXXXXX");
+
+  int fd = mkstemp(path);
+
+  assert_true(fd >= 0);
+  close(fd);
+}
+
+// Every 7th one is an err.
+static void fill(result_u64_t *results, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (i % 7 == 3) {
+      results[i] = (result_u64_t) result_init_err(-(int32_t) i);
+    } else {
+      results[i] = (result_u64_t) result_init_ok(i * 1000003);
+    }
+  }
+}
+
+static void check_results(
+  const result_u64_t *expected,
+  const result_u64_t *actual,
+  size_t n
+) {
+  for (size_t i = 0; i < n; i++) {
+    assert_int_equal(result_is_ok(expected[i]), result_is_ok(actual[i]));
+
+    if (result_is_ok(actual[i])) {
+      assert_true(
+        result_unwrap_unchecked(expected[i])
+        == result_unwrap_unchecked(actual[i])
+      );
+    } else {
+      assert_int_equal(
+        result_unwrap_err_unchecked(expected[i]),
+        result_unwrap_err_unchecked(actual[i])
+      );
+    }
+  }
+}
+
+static void write_results(
+  const char *path,
+  const result_u64_t *results,
+  size_t n,
+  unsigned flags
+) {
+  const struct result_file_layout_s layout = result_file_layout(
+    result_u64_t, TYPE_U64, TYPE_ERRNO
+  );
+
+  struct result_file_writer_s *writer;
+
+  assert_true(result_is_ok(
+    result_file_create(&writer, path, &layout, flags)
+  ));
+
+  // in uneven batches
+  for (size_t i = 0; i < n; i += 1 + i % 4096) {
+    size_t batch = w_min_2(n - i, 1 + i % 4096);
+
+    assert_true(result_is_ok(result_file_write(writer, results + i, batch)));
+  }
+
+  assert_true(result_is_ok(result_file_close(writer)));
+}
+
+static void read_file(const char *path, uint8_t **data, size_t *size) {
+  FILE *file = fopen(path, "rb");
+
+  assert_non_null(file);
+  fseek(file, 0, SEEK_END);
+  *size = (size_t) ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  *data = malloc(*size);
+  assert_int_equal(*size, fread(*data, 1, *size, file));
+  fclose(file);
+}
+
+static void write_file(const char *path, const uint8_t *data, size_t size) {
+  FILE *file = fopen(path, "wb");
+
+  assert_non_null(file);
+  assert_int_equal(size, fwrite(data, 1, size, file));
+  fclose(file);
+}
+
+static void swap(void *data, size_t len) {
+  uint8_t *bytes = data;
+
+  for (size_t i = 0; i < len / 2; i++) {
+    uint8_t byte = bytes[i];
+
+    bytes[i] = bytes[len - 1 - i];
+    bytes[len - 1 - i] = byte;
+  }
+}
+
+static void test_round_trip(void **ts) {
+  char path[64];
+  result_u64_t *results = calloc(LEN, sizeof(*results));
+  struct result_file_s file;
+
+  temp_path(path);
+  fill(results, LEN);
+  write_results(path, results, LEN, RESULT_FILE_OK_BITMAP);
+
+  const struct result_file_layout_s layout = result_file_layout(
+    result_u64_t, TYPE_U64, TYPE_ERRNO
+  );
+
+  assert_true(result_is_ok(result_file_open(&file, path, &layout)));
+  assert_true(result_file_is_mapped(&file));
+  assert_int_equal(LEN, file.len);
+  assert_non_null(file.ok_bitmap);
+
+  check_results(results, result_file_data(&file, result_u64_t), LEN);
+
+  size_t errs = 0;
+
+  for (
+    size_t i = result_file_next_err(&file, 0);
+    i < file.len;
+    i = result_file_next_err(&file, i + 1)
+  ) {
+    assert_int_equal(3, i % 7);
+    errs++;
+  }
+
+  assert_int_equal((LEN + 3) / 7, errs);
+
+  result_file_unmap(&file);
+  assert_null(file.data);
+
+  free(results);
+  unlink(path);
+}
+
+static void test_empty(void **ts) {
+  char path[64];
+  struct result_file_s file;
+
+  const struct result_file_layout_s layout = result_file_layout(
+    result_u64_t, TYPE_U64, TYPE_ERRNO
+  );
+
+  temp_path(path);
+  write_results(path, NULL, 0, RESULT_FILE_OK_BITMAP);
+
+  assert_true(result_is_ok(result_file_open(&file, path, &layout)));
+  assert_int_equal(0, file.len);
+  assert_int_equal(0, result_file_next_err(&file, 0));
+
+  result_file_unmap(&file);
+  unlink(path);
+}
+
+static void test_without_bitmap(void **ts) {
+  char path[64];
+  result_u64_t results[100];
+  struct result_file_s file;
+
+  const struct result_file_layout_s layout = result_file_layout(
+    result_u64_t, TYPE_U64, TYPE_ERRNO
+  );
+
+  temp_path(path);
+  fill(results, w_array_size(results));
+  write_results(path, results, w_array_size(results), 0);
+
+  assert_true(result_is_ok(result_file_open(&file, path, &layout)));
+  assert_null(file.ok_bitmap);
+  assert_int_equal(3, result_file_next_err(&file, 0));
+  assert_int_equal(10, result_file_next_err(&file, 4));
+  assert_int_equal(100, result_file_next_err(&file, 95));
+
+  result_file_unmap(&file);
+  unlink(path);
+}
+
+static void test_padding_is_zeroed(void **ts) {
+  char path[64];
+  result_u64_t results[2];
+  uint8_t *data;
+  size_t size;
+
+  // garbage everywhere but the fields
+  memset(results, 0xa5, sizeof(results));
+  results[0].header.is_ok = true;
+  results[0].body.ok = 1;
+  results[1].header.is_ok = false;
+  results[1].body.err = 2;
+
+  temp_path(path);
+  write_results(path, results, w_array_size(results), 0);
+  read_file(path, &data, &size);
+
+  const uint8_t *elements = data + RESULT_FILE_HEADER_SIZE;
+
+  for (size_t i = 1; i < sizeof(void *); i++) {
+    assert_int_equal(0, elements[i]);
+    assert_int_equal(0, elements[sizeof(results[0]) + i]);
+  }
+
+  // past the int32_t err
+  for (size_t i = sizeof(void *) + 4; i < sizeof(results[0]); i++) {
+    assert_int_equal(0, elements[sizeof(results[0]) + i]);
+  }
+
+  free(data);
+  unlink(path);
+}
+
+static void test_unclosed(void **ts) {
+  char path[64];
+  result_u64_t results[10];
+  struct result_file_writer_s *writer;
+  struct result_file_s file;
+
+  const struct result_file_layout_s layout = result_file_layout(
+    result_u64_t, TYPE_U64, TYPE_ERRNO
+  );
+
+  temp_path(path);
+  fill(results, w_array_size(results));
+
+  assert_true(result_is_ok(result_file_create(&writer, path, &layout, 0)));
+  assert_true(result_is_ok(result_file_write(writer, results, 10)));
+  result_file_abort(writer);
+
+  result_file_status_t st = result_file_open(&file, path, &layout);
+  assert_true(result_is_err(st));
+  assert_int_equal(EBADMSG, result_unwrap_err_unchecked(st));
+
+  unlink(path);
+}
+
+static void test_bad_files(void **ts) {
+  char path[64];
+  result_u64_t results[10];
+  struct result_file_s file;
+  uint8_t *data;
+  size_t size;
+
+  const struct result_file_layout_s layout = result_file_layout(
+    result_u64_t, TYPE_U64, TYPE_ERRNO
+  );
+
+  const struct result_file_layout_s other = result_file_layout(
+    result_u64_t, TYPE_POINT, TYPE_ERRNO
+  );
+
+  result_file_status_t st = result_file_open(
+    &file, "/nonexistent/result_file", &layout
+  );
+
+  assert_int_equal(ENOENT, result_unwrap_err_unchecked(st));
+
+  temp_path(path);
+  fill(results, w_array_size(results));
+  write_results(path, results, w_array_size(results), RESULT_FILE_OK_BITMAP);
+
+  st = result_file_open(&file, path, &other);
+  assert_int_equal(EPROTOTYPE, result_unwrap_err_unchecked(st));
+
+  // cut off in the middle of the elements
+  read_file(path, &data, &size);
+  write_file(path, data, RESULT_FILE_HEADER_SIZE + 5 * sizeof(results[0]));
+
+  st = result_file_open(&file, path, &layout);
+  assert_int_equal(EBADMSG, result_unwrap_err_unchecked(st));
+
+  // from the future
+  ((struct result_file_header_s *) data)->version = RESULT_FILE_VERSION + 1;
+  write_file(path, data, size);
+
+  st = result_file_open(&file, path, &layout);
+  assert_int_equal(ENOTSUP, result_unwrap_err_unchecked(st));
+
+  free(data);
+  unlink(path);
+}
+
+static void test_other_byte_order(void **ts) {
+  char path[64];
+  result_u64_t results[1000];
+  struct result_file_s file;
+  uint8_t *data;
+  size_t size;
+
+  const struct result_file_layout_s layout = result_file_layout(
+    result_u64_t, TYPE_U64, TYPE_ERRNO
+  );
+
+  temp_path(path);
+  fill(results, w_array_size(results));
+  write_results(path, results, w_array_size(results), RESULT_FILE_OK_BITMAP);
+  read_file(path, &data, &size);
+
+  // as a machine with the other byte order would have written it
+  struct result_file_header_s *header = (struct result_file_header_s *) data;
+  uint8_t *elements = data + header->data_offset;
+
+  for (size_t i = 0; i < w_array_size(results); i++) {
+    uint8_t *element = elements + i * sizeof(results[0]);
+
+    swap(element + sizeof(void *), element[0] ? 8 : 4);
+  }
+
+  swap(&header->byte_order, sizeof(header->byte_order));
+  swap(&header->version, sizeof(header->version));
+  swap(&header->flags, sizeof(header->flags));
+  swap(&header->header_size, sizeof(header->header_size));
+  swap(&header->element_size, sizeof(header->element_size));
+  swap(&header->body_offset, sizeof(header->body_offset));
+  swap(&header->ok_size, sizeof(header->ok_size));
+  swap(&header->err_size, sizeof(header->err_size));
+  swap(&header->ok_type_id, sizeof(header->ok_type_id));
+  swap(&header->err_type_id, sizeof(header->err_type_id));
+  swap(&header->len, sizeof(header->len));
+  swap(&header->data_offset, sizeof(header->data_offset));
+  swap(&header->bitmap_offset, sizeof(header->bitmap_offset));
+
+  write_file(path, data, size);
+
+  assert_true(result_is_ok(result_file_open(&file, path, &layout)));
+  assert_false(result_file_is_mapped(&file));
+  assert_int_equal(w_array_size(results), file.len);
+
+  check_results(
+    results,
+    result_file_data(&file, result_u64_t),
+    w_array_size(results)
+  );
+
+  assert_int_equal(3, result_file_next_err(&file, 0));
+
+  result_file_unmap(&file);
+  free(data);
+  unlink(path);
+}
+
+static void test_other_pointer_size(void **ts) {
+  char path[64];
+  result_u64_t results[100];
+  struct result_file_s file;
+  uint8_t *data;
+  size_t size;
+
+  const struct result_file_layout_s layout = result_file_layout(
+    result_u64_t, TYPE_U64, TYPE_ERRNO
+  );
+
+  // as a 32-bit machine would have written it: 4 bytes of header, then
+  // u64 aligned to 8, so 16 bytes in all
+  fill(results, w_array_size(results));
+  size = RESULT_FILE_HEADER_SIZE + 16 * w_array_size(results);
+  data = calloc(1, size);
+
+  struct result_file_header_s *header = (struct result_file_header_s *) data;
+
+  *header = (struct result_file_header_s) {
+    .magic = "RESULTS",
+    .byte_order = RESULT_FILE_BYTE_ORDER,
+    .version = RESULT_FILE_VERSION,
+    .header_size = RESULT_FILE_HEADER_SIZE,
+    .element_size = 16,
+    .body_offset = 4,
+    .ok_size = 8,
+    .err_size = 4,
+    .ok_type_id = TYPE_U64,
+    .err_type_id = TYPE_ERRNO,
+    .len = w_array_size(results),
+    .data_offset = RESULT_FILE_HEADER_SIZE,
+  };
+
+  for (size_t i = 0; i < w_array_size(results); i++) {
+    uint8_t *element = data + RESULT_FILE_HEADER_SIZE + i * 16;
+
+    element[0] = result_is_ok(results[i]);
+    memcpy(element + 4, &results[i].body, element[0] ? 8 : 4);
+  }
+
+  temp_path(path);
+  write_file(path, data, size);
+
+  assert_true(result_is_ok(result_file_open(&file, path, &layout)));
+  assert_false(result_file_is_mapped(&file));
+
+  check_results(
+    results,
+    result_file_data(&file, result_u64_t),
+    w_array_size(results)
+  );
+
+  result_file_unmap(&file);
+  free(data);
+  unlink(path);
+}
+
+static void test_struct_other_byte_order(void **ts) {
+  char path[64];
+  result_point_t results[4] = { 0 };
+  struct result_file_writer_s *writer;
+  struct result_file_s file;
+  uint8_t *data;
+  size_t size;
+
+  const struct result_file_layout_s layout = result_file_layout(
+    result_point_t, TYPE_POINT, TYPE_ERRNO
+  );
+
+  assert_false(layout.ok_is_scalar);
+  assert_true(layout.err_is_scalar);
+
+  temp_path(path);
+  assert_true(result_is_ok(result_file_create(&writer, path, &layout, 0)));
+  assert_true(result_is_ok(result_file_write(writer, results, 4)));
+  assert_true(result_is_ok(result_file_close(writer)));
+
+  // mapped as is
+  assert_true(result_is_ok(result_file_open(&file, path, &layout)));
+  assert_true(result_file_is_mapped(&file));
+  result_file_unmap(&file);
+
+  // but there's no telling how to swap a struct
+  read_file(path, &data, &size);
+  swap(&((struct result_file_header_s *) data)->byte_order, 4);
+  swap(&((struct result_file_header_s *) data)->version, 2);
+  swap(&((struct result_file_header_s *) data)->header_size, 4);
+  swap(&((struct result_file_header_s *) data)->element_size, 4);
+  swap(&((struct result_file_header_s *) data)->body_offset, 4);
+  swap(&((struct result_file_header_s *) data)->ok_size, 4);
+  swap(&((struct result_file_header_s *) data)->err_size, 4);
+  swap(&((struct result_file_header_s *) data)->ok_type_id, 4);
+  swap(&((struct result_file_header_s *) data)->err_type_id, 4);
+  swap(&((struct result_file_header_s *) data)->len, 8);
+  swap(&((struct result_file_header_s *) data)->data_offset, 8);
+  write_file(path, data, size);
+
+  result_file_status_t st = result_file_open(&file, path, &layout);
+  assert_int_equal(ENOTSUP, result_unwrap_err_unchecked(st));
+
+  free(data);
+  unlink(path);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_round_trip),
+    cmocka_unit_test(test_empty),
+    cmocka_unit_test(test_without_bitmap),
+    cmocka_unit_test(test_padding_is_zeroed),
+    cmocka_unit_test(test_unclosed),
+    cmocka_unit_test(test_bad_files),
+    cmocka_unit_test(test_other_byte_order),
+    cmocka_unit_test(test_other_pointer_size),
+    cmocka_unit_test(test_struct_other_byte_order),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,133 @@
+#include "result_future.h"
+
+#include <limits.h>
+#include <time.h>
+
+#if defined(__linux__)
+  #include <linux/futex.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#else
+  #include <sched.h>
+#endif
+
+// Waiters spin this many times before parking. Handing a result over usually
+// takes less than a syscall, so a short spin avoids most sleeps on idle cores.
+#define SPIN_LIMIT 128
+
+/*sublime-c-static-fn-hoist-start*/
+static bool spin(uint32_t *state);
+static bool announce(uint32_t *state);
+static uint64_t now_ns(void);
+static void park(uint32_t *state, const struct timespec *deadline);
+/*sublime-c-static-fn-hoist-end*/
+
+static bool spin(uint32_t *state) {
+  for (int i = 0; i < SPIN_LIMIT; i++) {
+    if (result_future_poll(state)) {
+      return true;
+    }
+
+    #if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+    #endif
+  }
+
+  return false;
+}
+
+// Marks the future as having a waiter. Returns true if it's ready instead.
+static bool announce(uint32_t *state) {
+  uint32_t expected = RESULT_FUTURE_EMPTY;
+
+  __atomic_compare_exchange_n(
+    state,
+    &expected,
+    RESULT_FUTURE_WAITING,
+    false,
+    __ATOMIC_ACQUIRE,
+    __ATOMIC_ACQUIRE
+  );
+
+  return expected == RESULT_FUTURE_READY;
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+// Sleeps while the state is RESULT_FUTURE_WAITING, until woken or until
+// `deadline` (CLOCK_MONOTONIC) if there is one. Spurious returns are fine, the
+// callers check the state again.
+static void park(uint32_t *state, const struct timespec *deadline) {
+  #if defined(__linux__)
+    syscall(
+      SYS_futex,
+      state,
+      FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG,
+      RESULT_FUTURE_WAITING,
+      deadline,
+      NULL,
+      FUTEX_BITSET_MATCH_ANY
+    );
+  #else
+    (void) state;
+    (void) deadline;
+    sched_yield();
+  #endif
+}
+
+void result_future_wake(uint32_t *state) {
+  #if defined(__linux__)
+    syscall(SYS_futex, state, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, INT_MAX);
+  #else
+    (void) state;
+  #endif
+}
+
+void result_future_block(uint32_t *state) {
+  if (spin(state)) {
+    return;
+  }
+
+  while (!announce(state)) {
+    park(state, NULL);
+  }
+}
+
+bool result_future_block_for(uint32_t *state, uint64_t timeout_ns) {
+  if (timeout_ns == 0) {
+    return result_future_poll(state);
+  }
+
+  uint64_t start = now_ns();
+
+  if (spin(state)) {
+    return true;
+  }
+
+  uint64_t deadline_ns = start + timeout_ns;
+
+  // saturate instead of wrapping around to the past
+  if (deadline_ns < start) {
+    deadline_ns = UINT64_MAX;
+  }
+
+  struct timespec deadline = {
+    .tv_sec = (time_t) (deadline_ns / 1000000000),
+    .tv_nsec = (long) (deadline_ns % 1000000000),
+  };
+
+  while (!announce(state)) {
+    if (now_ns() >= deadline_ns) {
+      return false;
+    }
+
+    park(state, &deadline);
+  }
+
+  return true;
+}
@@ -0,0 +1,174 @@
+#ifndef __result_future_h__
+#define __result_future_h__
+
+#include "core/defs.h"
+#include "result.h"
+
+//
+// One-shot future/promise that carries a result from one thread to another.
+//
+//   typedef result_t(int, int) result_int_t;
+//   result_future_of_t(result_int_t) future = { 0 };
+//
+//   // worker
+//   result_future_fulfill_ok(&future, 42);
+//
+//   // requester
+//   result_int_t res = result_future_wait(&future);
+//
+//   {result_with_ok(res, value) {
+//     ...
+//   }}
+//
+// The delivered value is the plain result the future was declared with, so
+// everything in result.h works on it. result_future_t(T, E) is a shorthand for
+// a future of an anonymous result_t(T, E).
+//
+// When the value is already there, waiting costs one atomic load, and
+// fulfilling costs one atomic exchange. Threads only park in futex(2) when
+// they actually have to block, and the fulfiller only makes a syscall when
+// someone is parked.
+//
+// A zeroed future is empty. Fulfill it exactly once; fulfilling a future that
+// is already fulfilled is a bug, just like with std::promise. Once every
+// waiter is done with it, result_future_reset() makes it reusable. Futures are
+// private to the process (FUTEX_PRIVATE_FLAG), so they can't live in memory
+// shared between processes.
+//
+
+enum result_future_state_e {
+  RESULT_FUTURE_EMPTY,
+  RESULT_FUTURE_WAITING,
+  RESULT_FUTURE_READY,
+};
+
+#define result_future_of_t(_result_type) \
+  struct result_future_of_d(_result_type)
+
+#define result_future_of_d(_result_type) { \
+  uint32_t state; \
+  _result_type result; \
+}
+
+#define result_future_t(_type, _err_type) \
+  result_future_of_t(result_t(_type, _err_type))
+
+// The result goes last and variadic: result_init_ok() and result_init_err()
+// expand to braced initializers, whose commas would split it into arguments
+// when it's passed on.
+#define result_future_fulfill(_future, ...) \
+  result_future_fulfill_(result_unique(result_future), _future, __VA_ARGS__)
+
+#define result_future_fulfill_(_self, _future, ...) ({ \
+  __typeof(&*(_future)) _self = (_future); \
+  _self->result = (__VA_ARGS__); \
+  result_future_publish(&_self->state); \
+})
+
+#define result_future_fulfill_ok(_future, _value) \
+  result_future_fulfill_ok_(_future, _value, result_unique(result_future))
+
+#define result_future_fulfill_ok_(_future, _value, _self) ({ \
+  __typeof(&*(_future)) _self = (_future); \
+  result_set_ok(_self->result, (_value)); \
+  result_future_publish(&_self->state); \
+})
+
+#define result_future_fulfill_err(_future, _err) \
+  result_future_fulfill_err_(_future, _err, result_unique(result_future))
+
+#define result_future_fulfill_err_(_future, _err, _self) ({ \
+  __typeof(&*(_future)) _self = (_future); \
+  result_set_err(_self->result, (_err)); \
+  result_future_publish(&_self->state); \
+})
+
+#define result_future_is_ready(_future) \
+  result_future_poll(&(_future)->state)
+
+// Copies the result to `*_out` and returns true if it's there, otherwise
+// returns false right away.
+#define result_future_try_get(_future, _out) result_future_try_get_( \
+  _future, _out, result_unique(result_future), \
+  result_unique(result_future_ready) \
+)
+
+#define result_future_try_get_(_future, _out, _self, _ready) ({ \
+  __typeof(&*(_future)) _self = (_future); \
+  bool _ready = result_future_poll(&_self->state); \
+  \
+  if (_ready) { \
+    *(_out) = _self->result; \
+  } \
+  \
+  _ready; \
+})
+
+// Blocks until the result is there and evaluates to (a copy of) it.
+#define result_future_wait(_future) \
+  result_future_wait_(_future, result_unique(result_future))
+
+#define result_future_wait_(_future, _self) ({ \
+  __typeof(&*(_future)) _self = (_future); \
+  \
+  if (!result_future_poll(&_self->state)) { \
+    result_future_block(&_self->state); \
+  } \
+  \
+  _self->result; \
+})
+
+// Like result_future_try_get() but waits up to `_timeout_ns` nanoseconds.
+#define result_future_wait_timeout(_future, _timeout_ns, _out) \
+  result_future_wait_timeout_( \
+    _future, _timeout_ns, _out, result_unique(result_future), \
+    result_unique(result_future_ready) \
+  )
+
+#define result_future_wait_timeout_(_future, _timeout_ns, _out, _self, _ready) \
+  ({ \
+    __typeof(&*(_future)) _self = (_future); \
+    \
+    bool _ready = \
+      result_future_poll(&_self->state) \
+      || result_future_block_for(&_self->state, (_timeout_ns)); \
+    \
+    if (_ready) { \
+      *(_out) = _self->result; \
+    } \
+    \
+    _ready; \
+  })
+
+#define result_future_reset(_future) \
+  __atomic_store_n(&(_future)->state, RESULT_FUTURE_EMPTY, __ATOMIC_RELAXED)
+
+//
+// Used by the macros above
+//
+
+extern void result_future_wake(uint32_t *state);
+extern void result_future_block(uint32_t *state);
+extern bool result_future_block_for(uint32_t *state, uint64_t timeout_ns);
+
+static inline __attribute__((always_inline, unused))
+bool result_future_poll(uint32_t *state) {
+  return __atomic_load_n(state, __ATOMIC_ACQUIRE) == RESULT_FUTURE_READY;
+}
+
+static inline __attribute__((always_inline, unused))
+void result_future_publish(uint32_t *state) {
+  uint32_t previous = __atomic_exchange_n(
+    state,
+    RESULT_FUTURE_READY,
+    __ATOMIC_RELEASE
+  );
+
+  assert(previous != RESULT_FUTURE_READY);
+
+  if (w_unlikely(previous == RESULT_FUTURE_WAITING)) {
+    result_future_wake(state);
+  }
+}
+
+#endif // __result_future_h__
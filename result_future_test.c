@@ -0,0 +1,344 @@
+#include "core/defs.h"
+#include "result_future.h"
+
+#include <pthread.h>
+
+typedef result_t(int, int) result_int_t;
+typedef result_future_of_t(result_int_t) future_int_t;
+
+struct relay_s {
+  future_int_t request;
+  future_int_t response;
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static void *fulfill_later(void *arg);
+static void *wait_and_echo(void *arg);
+static void *fulfill_stripe(void *arg);
+static void *wait_for_42(void *arg);
+static void test_empty(void **ts);
+static void test_fulfill_ok(void **ts);
+static void test_fulfill_err(void **ts);
+static void test_fulfill_result(void **ts);
+static void test_anonymous_type(void **ts);
+static void test_wait_timeout_expires(void **ts);
+static void test_wait_timeout_zero(void **ts);
+static void test_wait_blocks(void **ts);
+static void test_wait_timeout_blocks(void **ts);
+static void test_many_waiters(void **ts);
+static void test_ping_pong(void **ts);
+static void test_fan_in(void **ts);
+static void test_reset(void **ts);
+static void test_relay(void **ts);
+/*sublime-c-static-fn-hoist-end*/
+
+#define THREADS 4
+#define ROUNDS 2000
+#define FAN_IN 4096
+
+static void *fulfill_later(void *arg) {
+  future_int_t *future = arg;
+  struct timespec delay = { .tv_nsec = 20 * 1000 * 1000 };
+
+  nanosleep(&delay, NULL);
+  result_future_fulfill_ok(future, 42);
+
+  return NULL;
+}
+
+static void *wait_and_echo(void *arg) {
+  struct relay_s *relay = arg;
+
+  for (int i = 0; i < ROUNDS; i++) {
+    result_int_t res = result_future_wait(&relay->request);
+    result_future_reset(&relay->request);
+
+    {result_with_ok(res, value) {
+      result_future_fulfill_ok(&relay->response, value + 1);
+    }
+
+    else {
+      result_future_fulfill(&relay->response, res);
+    }}
+  }
+
+  return NULL;
+}
+
+static void *fulfill_stripe(void *arg) {
+  future_int_t *futures = arg;
+
+  for (int i = 0; i < FAN_IN; i++) {
+    if (i % 7 == 0) {
+      result_future_fulfill_err(&futures[i], -i);
+    } else {
+      result_future_fulfill_ok(&futures[i], i);
+    }
+  }
+
+  return NULL;
+}
+
+static void *wait_for_42(void *arg) {
+  future_int_t *future = arg;
+  result_int_t res = result_future_wait(future);
+
+  return (void *) (intptr_t) result_unwrap_unchecked(res);
+}
+
+static void test_empty(void **ts) {
+  future_int_t future = { 0 };
+  result_int_t res = result_init_ok(-1);
+
+  assert_false(result_future_is_ready(&future));
+  assert_false(result_future_try_get(&future, &res));
+
+  // untouched
+  assert_int_equal(-1, result_unwrap_unchecked(res));
+}
+
+static void test_fulfill_ok(void **ts) {
+  future_int_t future = { 0 };
+  result_int_t res = result_init_err(-1);
+
+  result_future_fulfill_ok(&future, 7);
+
+  assert_true(result_future_is_ready(&future));
+  assert_true(result_future_try_get(&future, &res));
+  assert_true(result_is_ok(res));
+  assert_int_equal(7, result_unwrap_unchecked(res));
+
+  res = result_future_wait(&future);
+  assert_int_equal(7, result_unwrap_unchecked(res));
+
+  // reading doesn't consume
+  res = result_future_wait(&future);
+  assert_int_equal(7, result_unwrap_unchecked(res));
+}
+
+static void test_fulfill_err(void **ts) {
+  future_int_t future = { 0 };
+
+  result_future_fulfill_err(&future, 13);
+
+  result_int_t res = result_future_wait(&future);
+  assert_true(result_is_err(res));
+  assert_int_equal(13, result_unwrap_err_unchecked(res));
+}
+
+static void test_fulfill_result(void **ts) {
+  future_int_t future = { 0 };
+
+  result_future_fulfill(&future, (result_int_t) result_init_err(3));
+
+  result_int_t res = result_future_wait(&future);
+  assert_int_equal(3, result_unwrap_err_unchecked(res));
+}
+
+static void test_anonymous_type(void **ts) {
+  result_future_t(uint64_t, const char *) future = { 0 };
+
+  result_future_fulfill_ok(&future, UINT64_MAX);
+
+  __typeof(future.result) res = result_future_wait(&future);
+  bool seen = false;
+
+  {result_with_ok(res, value) {
+    assert_true(value == UINT64_MAX);
+    seen = true;
+  }}
+
+  assert_true(seen);
+}
+
+static void test_wait_timeout_expires(void **ts) {
+  future_int_t future = { 0 };
+  result_int_t res = result_init_ok(-1);
+
+  uint64_t timeout_ns = 10 * 1000 * 1000;
+  struct timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  bool ready = result_future_wait_timeout(&future, timeout_ns, &res);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  int64_t elapsed_ns = (end.tv_sec - start.tv_sec) * 1000000000
+    + (end.tv_nsec - start.tv_nsec);
+
+  assert_false(ready);
+  assert_true(elapsed_ns >= (int64_t) timeout_ns);
+  assert_int_equal(-1, result_unwrap_unchecked(res));
+
+  // a waiter that gave up doesn't keep the future from being fulfilled
+  result_future_fulfill_ok(&future, 5);
+  assert_true(result_future_wait_timeout(&future, timeout_ns, &res));
+  assert_int_equal(5, result_unwrap_unchecked(res));
+}
+
+static void test_wait_timeout_zero(void **ts) {
+  future_int_t future = { 0 };
+  result_int_t res = result_init_err(-1);
+
+  assert_false(result_future_wait_timeout(&future, 0, &res));
+
+  result_future_fulfill_ok(&future, 1);
+  assert_true(result_future_wait_timeout(&future, 0, &res));
+  assert_int_equal(1, result_unwrap_unchecked(res));
+}
+
+static void test_wait_blocks(void **ts) {
+  future_int_t future = { 0 };
+  pthread_t thread;
+
+  assert_int_equal(0, pthread_create(&thread, NULL, fulfill_later, &future));
+
+  result_int_t res = result_future_wait(&future);
+  assert_int_equal(42, result_unwrap_unchecked(res));
+
+  assert_int_equal(0, pthread_join(thread, NULL));
+}
+
+static void test_wait_timeout_blocks(void **ts) {
+  future_int_t future = { 0 };
+  result_int_t res = result_init_err(-1);
+  pthread_t thread;
+
+  assert_int_equal(0, pthread_create(&thread, NULL, fulfill_later, &future));
+
+  uint64_t timeout_ns = (uint64_t) 10 * 1000 * 1000 * 1000;
+  assert_true(result_future_wait_timeout(&future, timeout_ns, &res));
+  assert_int_equal(42, result_unwrap_unchecked(res));
+
+  assert_int_equal(0, pthread_join(thread, NULL));
+}
+
+static void test_many_waiters(void **ts) {
+  future_int_t future = { 0 };
+  pthread_t threads[THREADS];
+
+  for (size_t i = 0; i < THREADS; i++) {
+    int status = pthread_create(&threads[i], NULL, wait_for_42, &future);
+    assert_int_equal(0, status);
+  }
+
+  fulfill_later(&future);
+
+  for (size_t i = 0; i < THREADS; i++) {
+    void *value;
+
+    assert_int_equal(0, pthread_join(threads[i], &value));
+    assert_int_equal(42, (intptr_t) value);
+  }
+}
+
+static void test_ping_pong(void **ts) {
+  struct relay_s relay = { 0 };
+  pthread_t thread;
+
+  assert_int_equal(0, pthread_create(&thread, NULL, wait_and_echo, &relay));
+
+  for (int i = 0; i < ROUNDS; i++) {
+    result_future_reset(&relay.response);
+
+    if (i % 10 == 0) {
+      result_future_fulfill_err(&relay.request, i);
+    } else {
+      result_future_fulfill_ok(&relay.request, i);
+    }
+
+    result_int_t res = result_future_wait(&relay.response);
+
+    if (i % 10 == 0) {
+      assert_int_equal(i, result_unwrap_err_unchecked(res));
+    } else {
+      assert_int_equal(i + 1, result_unwrap_unchecked(res));
+    }
+  }
+
+  assert_int_equal(0, pthread_join(thread, NULL));
+}
+
+static void test_fan_in(void **ts) {
+  future_int_t *futures = calloc(THREADS * FAN_IN, sizeof(*futures));
+  pthread_t threads[THREADS];
+
+  assert_non_null(futures);
+
+  for (size_t i = 0; i < THREADS; i++) {
+    int status = pthread_create(
+      &threads[i],
+      NULL,
+      fulfill_stripe,
+      &futures[i * FAN_IN]
+    );
+
+    assert_int_equal(0, status);
+  }
+
+  for (size_t t = 0; t < THREADS; t++) {
+    for (int i = 0; i < FAN_IN; i++) {
+      result_int_t res = result_future_wait(&futures[t * FAN_IN + i]);
+
+      if (i % 7 == 0) {
+        assert_int_equal(-i, result_unwrap_err_unchecked(res));
+      } else {
+        assert_int_equal(i, result_unwrap_unchecked(res));
+      }
+    }
+  }
+
+  for (size_t i = 0; i < THREADS; i++) {
+    assert_int_equal(0, pthread_join(threads[i], NULL));
+  }
+
+  free(futures);
+}
+
+static void test_reset(void **ts) {
+  future_int_t future = { 0 };
+
+  result_future_fulfill_ok(&future, 1);
+  result_future_reset(&future);
+
+  assert_false(result_future_is_ready(&future));
+
+  result_future_fulfill_err(&future, 2);
+
+  result_int_t res = result_future_wait(&future);
+  assert_int_equal(2, result_unwrap_err_unchecked(res));
+}
+
+static void test_relay(void **ts) {
+  future_int_t from = { 0 };
+  future_int_t to = { 0 };
+
+  // named like the locals of the macros
+  future_int_t *result_future = &from;
+
+  result_future_fulfill_ok(result_future, 8);
+  result_future_fulfill(&to, result_future_wait(&from));
+
+  result_int_t res = result_future_wait(&to);
+  assert_int_equal(8, result_unwrap_unchecked(res));
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_empty),
+    cmocka_unit_test(test_fulfill_ok),
+    cmocka_unit_test(test_fulfill_err),
+    cmocka_unit_test(test_fulfill_result),
+    cmocka_unit_test(test_anonymous_type),
+    cmocka_unit_test(test_wait_timeout_expires),
+    cmocka_unit_test(test_wait_timeout_zero),
+    cmocka_unit_test(test_wait_blocks),
+    cmocka_unit_test(test_wait_timeout_blocks),
+    cmocka_unit_test(test_many_waiters),
+    cmocka_unit_test(test_ping_pong),
+    cmocka_unit_test(test_fan_in),
+    cmocka_unit_test(test_reset),
+    cmocka_unit_test(test_relay),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,306 @@
+#include <bit>
+#include <concepts>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// cmocka.h has no extern "C" of its own, and result.h includes it
+extern "C" {
+  #include <cmocka.h>
+}
+
+#include "result.hpp"
+
+typedef result_t(int, int) result_int_t;
+typedef result_t(double, int16_t) result_double_t;
+typedef result_t(uint8_t, uint64_t) result_small_t;
+
+// from result_hpp_test_abi.c
+extern "C" result_int_t result_hpp_parse(const char *text);
+extern "C" result_int_t result_hpp_negate(result_int_t res);
+
+// declared with the C++ type, the C side returns a result_double_t
+extern "C" wr::result<double, int16_t> result_hpp_half(int value);
+
+// Counts the instances alive, to catch leaks and double destruction.
+struct tracked_s {
+  static int alive;
+  int value;
+
+  explicit tracked_s(int initial) noexcept : value(initial) {
+    alive++;
+  }
+
+  tracked_s(const tracked_s &other) noexcept : value(other.value) {
+    alive++;
+  }
+
+  tracked_s(tracked_s &&other) noexcept : value(other.value) {
+    other.value = -1;
+    alive++;
+  }
+
+  tracked_s &operator=(const tracked_s &) = default;
+  tracked_s &operator=(tracked_s &&) = default;
+
+  ~tracked_s() {
+    alive--;
+  }
+};
+
+int tracked_s::alive = 0;
+
+static wr::result<int, int> parse_both(const char *a, const char *b);
+static wr::result<std::string, int> repeat(const char *text, int times);
+static wr::result<size_t, int> repeated_len(const char *text, int times);
+static void test_layout(void **ts);
+static void test_constexpr(void **ts);
+static void test_c_interop(void **ts);
+static void test_construct(void **ts);
+static void test_move(void **ts);
+static void test_assign(void **ts);
+static void test_map(void **ts);
+static void test_and_then(void **ts);
+static void test_try(void **ts);
+
+template <typename C, typename T, typename E>
+static void check_layout() {
+  using R = wr::result<T, E>;
+
+  static_assert(std::is_standard_layout_v<R>);
+  static_assert(std::is_trivially_copyable_v<R>);
+  static_assert(wr::c_result_of<C, T, E>);
+
+  assert_int_equal(sizeof(C), sizeof(R));
+  assert_int_equal(alignof(C), alignof(R));
+  assert_int_equal(offsetof(C, body), offsetof(R, body));
+  assert_int_equal(offsetof(C, header), offsetof(R, header));
+}
+
+static wr::result<int, int> parse_both(const char *a, const char *b) {
+  int x = wr_try(wr::result<int, int>::from_c(result_hpp_parse(a)));
+  int y = wr_try(wr::result<int, int>::from_c(result_hpp_parse(b)));
+
+  return x + y;
+}
+
+static wr::result<std::string, int> repeat(const char *text, int times) {
+  if (times < 0) {
+    return wr::err(times);
+  }
+
+  std::string out;
+
+  for (int i = 0; i < times; i++) {
+    out += text;
+  }
+
+  return out;
+}
+
+// The err converts into another result, the ok value moves out.
+static wr::result<size_t, int> repeated_len(const char *text, int times) {
+  std::string s = wr_try(repeat(text, times));
+
+  return s.size();
+}
+
+static void test_layout(void **ts) {
+  check_layout<result_int_t, int, int>();
+  check_layout<result_double_t, double, int16_t>();
+  check_layout<result_small_t, uint8_t, uint64_t>();
+}
+
+static void test_constexpr(void **ts) {
+  constexpr wr::result<int, int> a = 21;
+  constexpr wr::result<int, int> b = wr::err(5);
+
+  static_assert(a.is_ok() && *a == 21);
+  static_assert(b.is_err() && b.error() == 5);
+  static_assert(a.map([](int x) { return x * 2; }).value() == 42);
+  static_assert(b.value_or(7) == 7);
+
+  static_assert(
+    b.or_else([](int e) { return wr::result<int, int>(e + 1); }).value() == 6
+  );
+
+  constexpr auto c = wr::result<int, int>::from_c(result_int_t {
+    .body = { .ok = 3 },
+    .header = { .is_ok = true },
+  });
+
+  static_assert(c.value() == 3);
+}
+
+static void test_c_interop(void **ts) {
+  result_int_t res = result_hpp_parse("123");
+  auto wrapped = wr::result<int, int>::from_c(res);
+
+  assert_true(wrapped.is_ok());
+  assert_int_equal(123, *wrapped);
+
+  // and back
+  result_int_t negated = result_hpp_negate(wrapped.to_c<result_int_t>());
+  assert_true(result_unwrap_unchecked(negated) == -123);
+
+  auto err = wr::result<int, int>::from_c(result_hpp_parse("12x"));
+  assert_true(err.is_err());
+  assert_int_equal(2, err.error());
+
+  // returned by C, straight into the C++ type
+  wr::result<double, int16_t> half = result_hpp_half(7);
+  assert_true(half.is_err());
+  assert_int_equal(-1, half.error());
+
+  half = result_hpp_half(8);
+  assert_true(half.is_ok() && *half == 4.0);
+}
+
+static void test_construct(void **ts) {
+  wr::result<std::string, int> a(wr::in_place_ok, 3, 'x');
+  wr::result<std::string, int> b = wr::ok(std::string("ok"));
+  wr::result<std::string, int> c = wr::err(2);
+  wr::result<std::string, std::string> d(wr::in_place_err, "bad");
+
+  assert_string_equal("xxx", a->c_str());
+  assert_int_equal(3, a->size());
+  assert_string_equal("ok", b.value().c_str());
+  assert_false(c);
+  assert_int_equal(2, c.error());
+  assert_string_equal("bad", d.error().c_str());
+  assert_string_equal("fallback", d.value_or("fallback").c_str());
+}
+
+static void test_move(void **ts) {
+  {
+    wr::result<std::unique_ptr<int>, tracked_s> a(
+      wr::in_place_ok, std::make_unique<int>(7)
+    );
+
+    auto b = std::move(a);
+    assert_int_equal(7, **b);
+
+    wr::result<std::unique_ptr<int>, tracked_s> c(wr::in_place_err, 3);
+    assert_int_equal(1, tracked_s::alive);
+
+    auto d = std::move(c);
+    assert_int_equal(2, tracked_s::alive);
+    assert_int_equal(3, d.error().value);
+    assert_int_equal(-1, c.error().value);
+
+    std::unique_ptr<int> taken = std::move(b).value();
+    assert_int_equal(7, *taken);
+  }
+
+  assert_int_equal(0, tracked_s::alive);
+
+  static_assert(std::is_nothrow_move_constructible_v<
+    wr::result<std::unique_ptr<int>, tracked_s>
+  >);
+
+  static_assert(!std::is_copy_constructible_v<
+    wr::result<std::unique_ptr<int>, tracked_s>
+  >);
+}
+
+static void test_assign(void **ts) {
+  {
+    wr::result<tracked_s, std::string> a(wr::in_place_ok, 1);
+    wr::result<tracked_s, std::string> b(wr::in_place_err, "err");
+    wr::result<tracked_s, std::string> c(wr::in_place_ok, 2);
+
+    assert_int_equal(2, tracked_s::alive);
+
+    // ok to err and back
+    a = b;
+    assert_int_equal(1, tracked_s::alive);
+    assert_string_equal("err", a.error().c_str());
+
+    a = std::move(c);
+    assert_int_equal(2, tracked_s::alive);
+    assert_int_equal(2, a->value);
+
+    a = a;
+    assert_int_equal(2, a->value);
+  }
+
+  assert_int_equal(0, tracked_s::alive);
+}
+
+static void test_map(void **ts) {
+  wr::result<int, int> ok = 4;
+  wr::result<int, int> err = wr::err(9);
+
+  auto doubled = ok.map([](int x) { return x * 2.5; });
+  static_assert(std::is_same_v<decltype(doubled), wr::result<double, int>>);
+  assert_true(*doubled == 10.0);
+
+  auto described = err.map_err([](int e) { return std::to_string(e); });
+  assert_string_equal("9", described.error().c_str());
+  assert_int_equal(4, ok.map_err([](int e) { return e + 1; }).value());
+
+  // moves out of an rvalue
+  wr::result<std::unique_ptr<int>, int> owned(
+    wr::in_place_ok, std::make_unique<int>(5)
+  );
+
+  auto len = std::move(owned).map([](std::unique_ptr<int> p) { return *p; });
+  assert_int_equal(5, *len);
+}
+
+static void test_and_then(void **ts) {
+  auto half = [](int x) -> wr::result<int, int> {
+    if (x % 2) {
+      return wr::err(x);
+    }
+
+    return x / 2;
+  };
+
+  wr::result<int, int> start = 12;
+
+  assert_int_equal(3, start.and_then(half).and_then(half).value());
+  assert_int_equal(3, start.and_then(half).and_then(half).and_then(half).error());
+
+  auto recovered = start.and_then(half).and_then(half).and_then(half)
+    .or_else([](int e) -> wr::result<int, int> { return e * 100; });
+
+  assert_int_equal(300, *recovered);
+}
+
+static void test_try(void **ts) {
+  auto sum = parse_both("40", "2");
+  assert_true(sum.is_ok());
+  assert_int_equal(42, *sum);
+
+  auto bad = parse_both("40", "x2");
+  assert_true(bad.is_err());
+  assert_int_equal(0, bad.error());
+
+  assert_int_equal(300, repeated_len("abc", 100).value());
+  assert_int_equal(-1, repeated_len("abc", -1).error());
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_layout),
+    cmocka_unit_test(test_constexpr),
+    cmocka_unit_test(test_c_interop),
+    cmocka_unit_test(test_construct),
+    cmocka_unit_test(test_move),
+    cmocka_unit_test(test_assign),
+    cmocka_unit_test(test_map),
+    cmocka_unit_test(test_and_then),
+    cmocka_unit_test(test_try),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
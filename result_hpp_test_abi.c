@@ -0,0 +1,42 @@
+#include "result.h"
+
+// The C side of result_hpp_test.cpp: plain C functions taking and returning
+// results by value, which the C++ side calls through wr::result.
+
+typedef result_t(int, int) result_int_t;
+typedef result_t(double, int16_t) result_double_t;
+
+extern result_int_t result_hpp_parse(const char *text);
+extern result_int_t result_hpp_negate(result_int_t res);
+extern result_double_t result_hpp_half(int value);
+
+// Digits only, anything else is an err with its position.
+result_int_t result_hpp_parse(const char *text) {
+  int value = 0;
+
+  for (int i = 0; text[i]; i++) {
+    if (text[i] < '0' || text[i] > '9') {
+      return (result_int_t) result_init_err(i);
+    }
+
+    value = value * 10 + (text[i] - '0');
+  }
+
+  return (result_int_t) result_init_ok(value);
+}
+
+result_int_t result_hpp_negate(result_int_t res) {
+  if (result_is_ok(res)) {
+    return (result_int_t) result_init_ok(-result_unwrap_unchecked(res));
+  }
+
+  return res;
+}
+
+result_double_t result_hpp_half(int value) {
+  if (value % 2 != 0) {
+    return (result_double_t) result_init_err(-1);
+  }
+
+  return (result_double_t) result_init_ok(value / 2.0);
+}
@@ -0,0 +1,512 @@
+#include "result_io.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+// The kernel caps a single read or write at a bit less than 2 GiB anyway.
+#define MAX_LEN ((size_t) 0x7ffff000)
+
+// In the results of a ring submit until their completions come, which can't
+// hold it: the res of a completion is an __s32.
+#define NOT_REAPED ((ssize_t) INT32_MIN - 1)
+
+enum op_e {
+  OP_OPENAT,
+  OP_READ,
+  OP_WRITE,
+  OP_FSYNC,
+  OP_CLOSE,
+};
+
+struct op_s {
+  enum op_e op;
+  int fd;
+  int flags;
+  mode_t mode;
+  const char *path;
+  const void *data;
+  size_t len;
+  off_t offset;
+};
+
+// Only the fields the submit needs, pointing into the two mappings.
+struct ring_s {
+  int fd;
+  unsigned entries;
+
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+
+  void *map;
+  size_t map_size;
+  size_t sqes_size;
+};
+
+struct result_io_batch_s {
+  unsigned capacity;
+  unsigned len;
+  uint64_t syscalls;
+  bool has_ring;
+  struct ring_s ring;
+
+  struct op_s ops[];
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static result_io_t run(const struct op_s *op);
+static bool queue(struct result_io_batch_s *batch, struct op_s op);
+static void run_syscalls(
+  struct result_io_batch_s *batch,
+  result_io_t *results,
+  unsigned from
+);
+static bool ring_open(struct ring_s *ring, unsigned entries);
+static void ring_close(struct ring_s *ring);
+static void ring_prep(struct io_uring_sqe *sqe, const struct op_s *op);
+static unsigned ring_reap(struct ring_s *ring, result_io_t *results);
+static void ring_abandon(
+  struct result_io_batch_s *batch,
+  result_io_t *results,
+  int err
+);
+static void ring_submit(struct result_io_batch_s *batch, result_io_t *results);
+/*sublime-c-static-fn-hoist-end*/
+
+// The same syscall for one operation, with the same EINTR handling as the
+// synchronous calls.
+static result_io_t run(const struct op_s *op) {
+  switch (op->op) {
+    case OP_OPENAT:
+      return result_io_openat(op->fd, op->path, op->flags, op->mode);
+
+    case OP_READ:
+      return result_io_read(
+        op->fd, (struct fatptr_s) { { (void *) op->data }, op->len }, op->offset
+      );
+
+    case OP_WRITE:
+      return result_io_write(
+        op->fd, (struct const_fatptr_s) { { op->data }, op->len }, op->offset
+      );
+
+    case OP_FSYNC:
+      return result_io_fsync(op->fd);
+
+    case OP_CLOSE:
+      return result_io_close(op->fd);
+  }
+
+  return (result_io_t) result_init_err(-EINVAL);
+}
+
+result_io_t result_io_openat(
+  int dirfd,
+  const char *path,
+  int flags,
+  mode_t mode
+) {
+  int fd;
+
+  do {
+    fd = openat(dirfd, path, flags, mode);
+  } while (fd < 0 && errno == EINTR);
+
+  return result_io_from_errno(fd);
+}
+
+result_io_t result_io_read(int fd, struct fatptr_s buf, off_t offset) {
+  size_t len = w_min_2(buf.len, MAX_LEN);
+  ssize_t got;
+
+  do {
+    got = offset == RESULT_IO_AT_POSITION
+      ? read(fd, buf.data, len)
+      : pread(fd, buf.data, len, offset);
+  } while (got < 0 && errno == EINTR);
+
+  return result_io_from_errno(got);
+}
+
+result_io_t result_io_write(
+  int fd,
+  struct const_fatptr_s data,
+  off_t offset
+) {
+  size_t len = w_min_2(data.len, MAX_LEN);
+  ssize_t written;
+
+  do {
+    written = offset == RESULT_IO_AT_POSITION
+      ? write(fd, data.data, len)
+      : pwrite(fd, data.data, len, offset);
+  } while (written < 0 && errno == EINTR);
+
+  return result_io_from_errno(written);
+}
+
+result_io_t result_io_fsync(int fd) {
+  int ret;
+
+  do {
+    ret = fsync(fd);
+  } while (ret < 0 && errno == EINTR);
+
+  return result_io_from_errno(ret);
+}
+
+result_io_t result_io_close(int fd) {
+  return result_io_from_errno(close(fd));
+}
+
+result_io_status_t result_io_batch_create(
+  struct result_io_batch_s **batch,
+  unsigned capacity,
+  unsigned flags
+) {
+  struct result_io_batch_s *self = calloc(
+    1, sizeof(*self) + capacity * sizeof(self->ops[0])
+  );
+
+  *batch = NULL;
+
+  if (!self) {
+    return (result_io_status_t) result_init_err(ENOMEM);
+  }
+
+  self->capacity = capacity;
+
+  if (!(flags & RESULT_IO_SYSCALLS) && capacity > 0) {
+    self->has_ring = ring_open(&self->ring, capacity);
+  }
+
+  *batch = self;
+  return (result_io_status_t) result_init_ok(0);
+}
+
+void result_io_batch_destroy(struct result_io_batch_s *batch) {
+  if (!batch) {
+    return;
+  }
+
+  if (batch->has_ring) {
+    ring_close(&batch->ring);
+  }
+
+  free(batch);
+}
+
+bool result_io_batch_has_ring(const struct result_io_batch_s *batch) {
+  return batch->has_ring;
+}
+
+uint64_t result_io_batch_syscalls(const struct result_io_batch_s *batch) {
+  return batch->syscalls;
+}
+
+size_t result_io_batch_len(const struct result_io_batch_s *batch) {
+  return batch->len;
+}
+
+static bool queue(struct result_io_batch_s *batch, struct op_s op) {
+  if (batch->len >= batch->capacity) {
+    return false;
+  }
+
+  batch->ops[batch->len++] = op;
+  return true;
+}
+
+bool result_io_queue_openat(
+  struct result_io_batch_s *batch,
+  int dirfd,
+  const char *path,
+  int flags,
+  mode_t mode
+) {
+  return queue(batch, (struct op_s) {
+    .op = OP_OPENAT,
+    .fd = dirfd,
+    .path = path,
+    .flags = flags,
+    .mode = mode,
+  });
+}
+
+bool result_io_queue_read(
+  struct result_io_batch_s *batch,
+  int fd,
+  struct fatptr_s buf,
+  off_t offset
+) {
+  return queue(batch, (struct op_s) {
+    .op = OP_READ,
+    .fd = fd,
+    .data = buf.data,
+    .len = w_min_2(buf.len, MAX_LEN),
+    .offset = offset,
+  });
+}
+
+bool result_io_queue_write(
+  struct result_io_batch_s *batch,
+  int fd,
+  struct const_fatptr_s data,
+  off_t offset
+) {
+  return queue(batch, (struct op_s) {
+    .op = OP_WRITE,
+    .fd = fd,
+    .data = data.data,
+    .len = w_min_2(data.len, MAX_LEN),
+    .offset = offset,
+  });
+}
+
+bool result_io_queue_fsync(struct result_io_batch_s *batch, int fd) {
+  return queue(batch, (struct op_s) { .op = OP_FSYNC, .fd = fd });
+}
+
+bool result_io_queue_close(struct result_io_batch_s *batch, int fd) {
+  return queue(batch, (struct op_s) { .op = OP_CLOSE, .fd = fd });
+}
+
+static void run_syscalls(
+  struct result_io_batch_s *batch,
+  result_io_t *results,
+  unsigned from
+) {
+  for (unsigned i = from; i < batch->len; i++) {
+    results[i] = run(&batch->ops[i]);
+    batch->syscalls++;
+  }
+}
+
+size_t result_io_submit(
+  struct result_io_batch_s *batch,
+  result_io_t *results
+) {
+  size_t len = batch->len;
+
+  if (len == 0) {
+    return 0;
+  }
+
+  if (batch->has_ring) {
+    ring_submit(batch, results);
+  } else {
+    run_syscalls(batch, results, 0);
+  }
+
+  batch->len = 0;
+  return len;
+}
+
+// io_uring without liburing, it's only the setup, one mapping and the two
+// ring buffers.
+
+static bool ring_open(struct ring_s *ring, unsigned entries) {
+  struct io_uring_params params = { 0 };
+
+  ring->fd = (int) syscall(SYS_io_uring_setup, entries, &params);
+
+  if (ring->fd < 0) {
+    return false;
+  }
+
+  // One mapping for both rings is 5.4, IORING_OP_READ and friends 5.6, which
+  // is also when reads at the file position came in.
+  unsigned needed = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_RW_CUR_POS;
+
+  if ((params.features & needed) != needed) {
+    close(ring->fd);
+    return false;
+  }
+
+  size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  size_t cq_size = params.cq_off.cqes
+    + params.cq_entries * sizeof(struct io_uring_cqe);
+
+  ring->entries = params.sq_entries;
+  ring->map_size = w_max_2(sq_size, cq_size);
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  ring->map = mmap(
+    NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+    ring->fd, IORING_OFF_SQ_RING
+  );
+
+  if (ring->map == MAP_FAILED) {
+    close(ring->fd);
+    return false;
+  }
+
+  ring->sqes = mmap(
+    NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+    ring->fd, IORING_OFF_SQES
+  );
+
+  if (ring->sqes == MAP_FAILED) {
+    munmap(ring->map, ring->map_size);
+    close(ring->fd);
+    return false;
+  }
+
+  uint8_t *map = ring->map;
+
+  ring->sq_head = (unsigned *) (map + params.sq_off.head);
+  ring->sq_tail = (unsigned *) (map + params.sq_off.tail);
+  ring->sq_mask = (unsigned *) (map + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned *) (map + params.sq_off.array);
+
+  ring->cq_head = (unsigned *) (map + params.cq_off.head);
+  ring->cq_tail = (unsigned *) (map + params.cq_off.tail);
+  ring->cq_mask = (unsigned *) (map + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *) (map + params.cq_off.cqes);
+
+  return true;
+}
+
+static void ring_close(struct ring_s *ring) {
+  munmap(ring->sqes, ring->sqes_size);
+  munmap(ring->map, ring->map_size);
+  close(ring->fd);
+}
+
+static void ring_prep(struct io_uring_sqe *sqe, const struct op_s *op) {
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->fd = op->fd;
+
+  switch (op->op) {
+    case OP_OPENAT:
+      sqe->opcode = IORING_OP_OPENAT;
+      sqe->addr = (uintptr_t) op->path;
+      sqe->len = op->mode;
+      sqe->open_flags = (uint32_t) op->flags;
+      break;
+
+    case OP_READ:
+    case OP_WRITE:
+      sqe->opcode = op->op == OP_READ ? IORING_OP_READ : IORING_OP_WRITE;
+      sqe->addr = (uintptr_t) op->data;
+      sqe->len = (uint32_t) op->len;
+
+      // -1 is the file position, for both
+      sqe->off = (uint64_t) op->offset;
+      break;
+
+    case OP_FSYNC:
+      sqe->opcode = IORING_OP_FSYNC;
+      break;
+
+    case OP_CLOSE:
+      sqe->opcode = IORING_OP_CLOSE;
+      break;
+  }
+}
+
+// Moves every completion there is into `results`, by the index in user_data.
+static unsigned ring_reap(struct ring_s *ring, result_io_t *results) {
+  unsigned head = *ring->cq_head;
+  unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+  unsigned mask = *ring->cq_mask;
+  unsigned reaped = tail - head;
+
+  for (; head != tail; head++) {
+    const struct io_uring_cqe *cqe = &ring->cqes[head & mask];
+
+    results[cqe->user_data] = result_io_from_ret(cqe->res);
+  }
+
+  __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+  return reaped;
+}
+
+// When io_uring_enter(2) keeps failing while it waits, the operations it took
+// and didn't complete get its error. Their completions could still come, and
+// go to the results of a later submit, so the batch closes the ring and runs
+// syscalls from then on.
+static void ring_abandon(
+  struct result_io_batch_s *batch,
+  result_io_t *results,
+  int err
+) {
+  ring_reap(&batch->ring, results);
+
+  for (unsigned i = 0; i < batch->len; i++) {
+    if (results[i].body.ok == NOT_REAPED) {
+      results[i] = result_io_from_ret(-err);
+    }
+  }
+
+  ring_close(&batch->ring);
+  batch->has_ring = false;
+}
+
+// Everything queued goes into the submission queue at once (the ring has at
+// least `capacity` entries), then one io_uring_enter(2) submits it and waits
+// for all of it, unless it's interrupted.
+//
+// When io_uring_enter(2) fails it hasn't taken any of the entries it was
+// given, so they can be taken back and run as syscalls instead.
+static void ring_submit(struct result_io_batch_s *batch, result_io_t *results) {
+  struct ring_s *ring = &batch->ring;
+  unsigned len = batch->len;
+  unsigned tail = *ring->sq_tail;
+  unsigned mask = *ring->sq_mask;
+
+  for (unsigned i = 0; i < len; i++) {
+    unsigned slot = (tail + i) & mask;
+
+    ring_prep(&ring->sqes[slot], &batch->ops[i]);
+    ring->sqes[slot].user_data = i;
+    ring->sq_array[slot] = slot;
+    results[i] = result_io_from_ret(NOT_REAPED);
+  }
+
+  __atomic_store_n(ring->sq_tail, tail + len, __ATOMIC_RELEASE);
+
+  unsigned to_submit = len;
+  unsigned pending = len;
+
+  while (pending > 0) {
+    long submitted = syscall(
+      SYS_io_uring_enter, ring->fd, to_submit, pending,
+      IORING_ENTER_GETEVENTS, NULL, 0
+    );
+
+    batch->syscalls++;
+
+    if (submitted >= 0) {
+      to_submit -= (unsigned) submitted;
+    }
+
+    else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      if (to_submit == 0) {
+        ring_abandon(batch, results, errno);
+        return;
+      }
+
+      unsigned from = len - to_submit;
+
+      __atomic_store_n(ring->sq_tail, tail + from, __ATOMIC_RELEASE);
+
+      run_syscalls(batch, results, from);
+
+      pending -= to_submit;
+      to_submit = 0;
+    }
+
+    pending -= ring_reap(ring, results);
+  }
+}
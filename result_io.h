@@ -0,0 +1,173 @@
+#ifndef __result_io_h__
+#define __result_io_h__
+
+#include <errno.h>
+#include <sys/types.h>
+
+#include "core/defs.h"
+#include "result.h"
+
+//
+// File I/O that returns results instead of -1 and errno.
+//
+// One operation at a time, each one is exactly one syscall:
+//
+//   result_io_t fd = result_io_openat(AT_FDCWD, "config", O_RDONLY, 0);
+//
+//   if (result_is_err(fd)) {
+//     return -result_unwrap_err_unchecked(fd); // eg. ENOENT
+//   }
+//
+//   char buf[4096];
+//   result_io_t got = result_io_read(
+//     result_unwrap_unchecked(fd), (struct fatptr_s) { buf, sizeof(buf) }
+//   );
+//
+// Or many at once, through io_uring when the kernel has it:
+//
+//   struct result_io_batch_s *batch;
+//   result_io_status_t st = result_io_batch_create(&batch, 64, 0);
+//
+//   for (size_t i = 0; i < n; i++) {
+//     result_io_queue_read(batch, fds[i], bufs[i], 0);
+//   }
+//
+//   result_io_t results[64];
+//   result_io_submit(batch, results);
+//
+//   for (size_t i = 0; i < n; i++) {
+//     if (result_is_ok(results[i])) {
+//       // result_unwrap_unchecked(results[i]) bytes landed in bufs[i]
+//     }
+//   }
+//
+//   result_io_batch_destroy(batch);
+//
+// result_io_t is a result_nonneg_t: ok is what the syscall returned (a byte
+// count, an fd, 0), err is -errno, so it's a single register, and a
+// completion from io_uring, which uses the same convention, is already one.
+//
+// Reads and writes go straight to and from the caller's buffers, described by
+// a struct fatptr_s (const_fatptr_s for writes), both with the syscalls and
+// with io_uring. Like read(2) they can be short.
+//
+// The batch uses io_uring when io_uring_setup(2) works and the kernel is new
+// enough for the opcodes here (5.6), and the plain syscalls otherwise, eg.
+// when io_uring is disabled by sysctl or seccomp. Either way the results are
+// the same and come back in the order the operations were queued. Operations
+// in one batch may run in any order and concurrently, so a read of an fd that
+// is opened in the same batch has to go in the next one.
+//
+
+typedef result_nonneg_t(ssize_t) result_io_t;
+typedef result_status_t(int) result_io_status_t;
+
+// The offset for reads and writes at the file position, like read(2).
+#define RESULT_IO_AT_POSITION ((off_t) -1)
+
+enum result_io_flags_e {
+  // never use io_uring, for comparing the two
+  RESULT_IO_SYSCALLS = 1 << 0,
+};
+
+struct result_io_batch_s;
+
+// From a syscall that returns -1 and sets errno.
+#define result_io_from_errno(_ret) ({ \
+  ssize_t result_io_ret = (_ret); \
+  \
+  result_io_ret < 0 \
+    ? (result_io_t) result_init_err(-(ssize_t) errno) \
+    : (result_io_t) result_init_ok(result_io_ret); \
+})
+
+// From a return value that is already -errno on failure, like the raw kernel
+// interface and io_uring completions.
+#define result_io_from_ret(_ret) \
+  ((result_io_t) result_init_ok((ssize_t) (_ret)))
+
+// The synchronous calls retry on EINTR, except for close, where Linux has
+// already closed the fd by then.
+
+extern result_io_t result_io_openat(
+  int dirfd,
+  const char *path,
+  int flags,
+  mode_t mode
+);
+
+// `offset` is RESULT_IO_AT_POSITION or where to pread(2) from.
+extern result_io_t result_io_read(int fd, struct fatptr_s buf, off_t offset);
+
+// `offset` is RESULT_IO_AT_POSITION or where to pwrite(2) to.
+extern result_io_t result_io_write(
+  int fd,
+  struct const_fatptr_s data,
+  off_t offset
+);
+
+extern result_io_t result_io_fsync(int fd);
+extern result_io_t result_io_close(int fd);
+
+// A batch holds up to `capacity` operations between submits. `flags` are enum
+// result_io_flags_e.
+extern result_io_status_t result_io_batch_create(
+  struct result_io_batch_s **batch,
+  unsigned capacity,
+  unsigned flags
+);
+
+// Drops anything that was queued and not submitted.
+extern void result_io_batch_destroy(struct result_io_batch_s *batch);
+
+// Whether submits go through io_uring.
+extern bool result_io_batch_has_ring(const struct result_io_batch_s *batch);
+
+// How many syscalls the batch has made so far, io_uring_enter(2) included.
+extern uint64_t result_io_batch_syscalls(
+  const struct result_io_batch_s *batch
+);
+
+// How many operations are queued.
+extern size_t result_io_batch_len(const struct result_io_batch_s *batch);
+
+// Each of these returns false, and queues nothing, when the batch is full.
+// `path`, `buf` and `data` have to stay valid until the submit.
+
+extern bool result_io_queue_openat(
+  struct result_io_batch_s *batch,
+  int dirfd,
+  const char *path,
+  int flags,
+  mode_t mode
+);
+
+extern bool result_io_queue_read(
+  struct result_io_batch_s *batch,
+  int fd,
+  struct fatptr_s buf,
+  off_t offset
+);
+
+extern bool result_io_queue_write(
+  struct result_io_batch_s *batch,
+  int fd,
+  struct const_fatptr_s data,
+  off_t offset
+);
+
+extern bool result_io_queue_fsync(struct result_io_batch_s *batch, int fd);
+extern bool result_io_queue_close(struct result_io_batch_s *batch, int fd);
+
+// Runs everything that's queued and waits for all of it. The result of the
+// i-th queued operation goes to results[i], so `results` needs room for
+// result_io_batch_len() of them. Returns how many there were and leaves the
+// batch empty. Errors of the operations are in their results: if io_uring
+// itself fails, the operations it didn't take run as syscalls, and the ones it
+// took but can't wait for get its error (the batch stops using io_uring then).
+extern size_t result_io_submit(
+  struct result_io_batch_s *batch,
+  result_io_t *results
+);
+
+#endif // __result_io_h__
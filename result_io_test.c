@@ -0,0 +1,398 @@
+#include "core/defs.h"
+#include "result_io.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/*sublime-c-static-fn-hoist-start*/
+static void temp_path(char *path);
+static void write_file(const char *path, const char *text);
+static struct result_io_batch_s *create(unsigned capacity, unsigned flags);
+static void test_openat(void **ts);
+static void test_read_write(void **ts);
+static void test_read_at_position(void **ts);
+static void test_errors(void **ts);
+static void test_from_errno(void **ts);
+static void check_batch_files(unsigned flags);
+static void test_batch_files_ring(void **ts);
+static void test_batch_files_syscalls(void **ts);
+static void check_batch_errors(unsigned flags);
+static void test_batch_errors_ring(void **ts);
+static void test_batch_errors_syscalls(void **ts);
+static void check_batch_write(unsigned flags);
+static void test_batch_write_ring(void **ts);
+static void test_batch_write_syscalls(void **ts);
+static void test_batch_full(void **ts);
+static void test_batch_syscalls(void **ts);
+/*sublime-c-static-fn-hoist-end*/
+
+#define FILES 40
+
+static void temp_path(char *path) {
+  strcpy(path, "/tmp/result_io_test.XXXXXX");
+
+  int fd = mkstemp(path);
+
+  assert_true(fd >= 0);
+  close(fd);
+}
+
+static void write_file(const char *path, const char *text) {
+  int fd = open(path, O_WRONLY | O_TRUNC);
+
+  assert_true(fd >= 0);
+  assert_int_equal(strlen(text), write(fd, text, strlen(text)));
+  close(fd);
+}
+
+static struct result_io_batch_s *create(unsigned capacity, unsigned flags) {
+  struct result_io_batch_s *batch;
+
+  assert_true(result_is_ok(result_io_batch_create(&batch, capacity, flags)));
+
+  if (flags & RESULT_IO_SYSCALLS) {
+    assert_false(result_io_batch_has_ring(batch));
+  }
+
+  return batch;
+}
+
+static void test_openat(void **ts) {
+  char path[64];
+
+  temp_path(path);
+
+  result_io_t fd = result_io_openat(AT_FDCWD, path, O_RDONLY, 0);
+  assert_true(result_is_ok(fd));
+  assert_true(result_is_ok(result_io_close(result_unwrap_unchecked(fd))));
+
+  unlink(path);
+
+  fd = result_io_openat(AT_FDCWD, path, O_RDONLY, 0);
+  assert_true(result_is_err(fd));
+  assert_int_equal(-ENOENT, result_unwrap_err_unchecked(fd));
+}
+
+static void test_read_write(void **ts) {
+  char path[64];
+  char buf[16] = { 0 };
+
+  temp_path(path);
+
+  result_io_t fd = result_io_openat(AT_FDCWD, path, O_RDWR, 0);
+  int raw = (int) result_unwrap_unchecked(fd);
+
+  result_io_t written = result_io_write(
+    raw, (struct const_fatptr_s) { { "hello world" }, 11 }, 0
+  );
+
+  assert_int_equal(11, result_unwrap_unchecked(written));
+  assert_true(result_is_ok(result_io_fsync(raw)));
+
+  // straight into the caller's buffer, at an offset
+  result_io_t got = result_io_read(
+    raw, (struct fatptr_s) { { buf }, sizeof(buf) }, 6
+  );
+
+  assert_int_equal(5, result_unwrap_unchecked(got));
+  assert_string_equal("world", buf);
+
+  // short, at the end
+  got = result_io_read(raw, (struct fatptr_s) { { buf }, sizeof(buf) }, 11);
+  assert_true(result_is_ok(got));
+  assert_int_equal(0, result_unwrap_unchecked(got));
+
+  result_io_close(raw);
+  unlink(path);
+}
+
+static void test_read_at_position(void **ts) {
+  char path[64];
+  char buf[4] = { 0 };
+
+  temp_path(path);
+  write_file(path, "abcdef");
+
+  int fd = (int) result_unwrap_unchecked(
+    result_io_openat(AT_FDCWD, path, O_RDONLY, 0)
+  );
+
+  struct fatptr_s three = { { buf }, 3 };
+
+  assert_int_equal(
+    3, result_unwrap_unchecked(result_io_read(fd, three, RESULT_IO_AT_POSITION))
+  );
+
+  assert_string_equal("abc", buf);
+
+  assert_int_equal(
+    3, result_unwrap_unchecked(result_io_read(fd, three, RESULT_IO_AT_POSITION))
+  );
+
+  assert_string_equal("def", buf);
+
+  result_io_close(fd);
+  unlink(path);
+}
+
+static void test_errors(void **ts) {
+  char buf[4];
+
+  result_io_t res = result_io_read(
+    -1, (struct fatptr_s) { { buf }, sizeof(buf) }, 0
+  );
+
+  assert_int_equal(-EBADF, result_unwrap_err_unchecked(res));
+
+  res = result_io_write(-1, (struct const_fatptr_s) { { buf }, 1 }, 0);
+  assert_int_equal(-EBADF, result_unwrap_err_unchecked(res));
+
+  res = result_io_fsync(-1);
+  assert_int_equal(-EBADF, result_unwrap_err_unchecked(res));
+
+  res = result_io_close(-1);
+  assert_int_equal(-EBADF, result_unwrap_err_unchecked(res));
+}
+
+static void test_from_errno(void **ts) {
+  errno = EAGAIN;
+
+  result_io_t res = result_io_from_errno(-1);
+  assert_true(result_is_err(res));
+  assert_int_equal(-EAGAIN, result_unwrap_err_unchecked(res));
+
+  res = result_io_from_errno(7);
+  assert_true(result_is_ok(res));
+  assert_int_equal(7, result_unwrap_unchecked(res));
+
+  assert_true(result_is_err(result_io_from_ret(-EIO)));
+  assert_true(result_is_ok(result_io_from_ret(0)));
+
+  // one register
+  assert_int_equal(sizeof(ssize_t), sizeof(result_io_t));
+}
+
+// Opens, reads and closes FILES files in three submits, one of them missing.
+static void check_batch_files(unsigned flags) {
+  char paths[FILES][64];
+  char bufs[FILES][32];
+  int fds[FILES];
+  result_io_t results[FILES];
+  struct result_io_batch_s *batch = create(FILES, flags);
+
+  for (size_t i = 0; i < FILES; i++) {
+    char text[32];
+
+    temp_path(paths[i]);
+    snprintf(text, sizeof(text), "file %zu", i);
+    write_file(paths[i], text);
+  }
+
+  unlink(paths[7]);
+
+  for (size_t i = 0; i < FILES; i++) {
+    assert_true(
+      result_io_queue_openat(batch, AT_FDCWD, paths[i], O_RDONLY, 0)
+    );
+  }
+
+  assert_int_equal(FILES, result_io_batch_len(batch));
+  assert_int_equal(FILES, result_io_submit(batch, results));
+  assert_int_equal(0, result_io_batch_len(batch));
+
+  for (size_t i = 0; i < FILES; i++) {
+    if (i == 7) {
+      assert_int_equal(-ENOENT, result_unwrap_err_unchecked(results[i]));
+      fds[i] = -1;
+    } else {
+      assert_true(result_is_ok(results[i]));
+      fds[i] = (int) result_unwrap_unchecked(results[i]);
+    }
+  }
+
+  for (size_t i = 0; i < FILES; i++) {
+    memset(bufs[i], 0, sizeof(bufs[i]));
+
+    assert_true(result_io_queue_read(
+      batch, fds[i], (struct fatptr_s) { { bufs[i] }, sizeof(bufs[i]) - 1 }, 0
+    ));
+  }
+
+  assert_int_equal(FILES, result_io_submit(batch, results));
+
+  for (size_t i = 0; i < FILES; i++) {
+    char text[32];
+
+    if (i == 7) {
+      assert_int_equal(-EBADF, result_unwrap_err_unchecked(results[i]));
+      continue;
+    }
+
+    snprintf(text, sizeof(text), "file %zu", i);
+    assert_int_equal(strlen(text), result_unwrap_unchecked(results[i]));
+    assert_string_equal(text, bufs[i]);
+  }
+
+  for (size_t i = 0; i < FILES; i++) {
+    if (fds[i] >= 0) {
+      assert_true(result_io_queue_close(batch, fds[i]));
+    }
+  }
+
+  assert_int_equal(FILES - 1, result_io_submit(batch, results));
+
+  for (size_t i = 0; i < FILES - 1; i++) {
+    assert_true(result_is_ok(results[i]));
+  }
+
+  for (size_t i = 0; i < FILES; i++) {
+    unlink(paths[i]);
+  }
+
+  result_io_batch_destroy(batch);
+}
+
+static void test_batch_files_ring(void **ts) {
+  check_batch_files(0);
+}
+
+static void test_batch_files_syscalls(void **ts) {
+  check_batch_files(RESULT_IO_SYSCALLS);
+}
+
+static void check_batch_errors(unsigned flags) {
+  char buf[8];
+  result_io_t results[4];
+  struct result_io_batch_s *batch = create(4, flags);
+
+  result_io_queue_read(batch, -1, (struct fatptr_s) { { buf }, 8 }, 0);
+  result_io_queue_fsync(batch, -1);
+  result_io_queue_openat(batch, AT_FDCWD, "/nonexistent/x", O_RDONLY, 0);
+  result_io_queue_close(batch, -1);
+
+  assert_int_equal(4, result_io_submit(batch, results));
+  assert_int_equal(-EBADF, result_unwrap_err_unchecked(results[0]));
+  assert_int_equal(-EBADF, result_unwrap_err_unchecked(results[1]));
+  assert_int_equal(-ENOENT, result_unwrap_err_unchecked(results[2]));
+  assert_int_equal(-EBADF, result_unwrap_err_unchecked(results[3]));
+
+  result_io_batch_destroy(batch);
+}
+
+static void test_batch_errors_ring(void **ts) {
+  check_batch_errors(0);
+}
+
+static void test_batch_errors_syscalls(void **ts) {
+  check_batch_errors(RESULT_IO_SYSCALLS);
+}
+
+// Writes at offsets in one submit, fsyncs in the next.
+static void check_batch_write(unsigned flags) {
+  char path[64];
+  char buf[16] = { 0 };
+  result_io_t results[3];
+  struct result_io_batch_s *batch = create(3, flags);
+
+  temp_path(path);
+
+  int fd = (int) result_unwrap_unchecked(
+    result_io_openat(AT_FDCWD, path, O_RDWR, 0)
+  );
+
+  result_io_queue_write(batch, fd, (struct const_fatptr_s) { { "abc" }, 3 }, 0);
+  result_io_queue_write(batch, fd, (struct const_fatptr_s) { { "xyz" }, 3 }, 6);
+  result_io_queue_write(batch, fd, (struct const_fatptr_s) { { "---" }, 3 }, 3);
+
+  assert_int_equal(3, result_io_submit(batch, results));
+
+  for (size_t i = 0; i < 3; i++) {
+    assert_int_equal(3, result_unwrap_unchecked(results[i]));
+  }
+
+  result_io_queue_fsync(batch, fd);
+  assert_int_equal(1, result_io_submit(batch, results));
+  assert_true(result_is_ok(results[0]));
+
+  assert_int_equal(9, pread(fd, buf, sizeof(buf), 0));
+  assert_string_equal("abc---xyz", buf);
+
+  result_io_close(fd);
+  unlink(path);
+  result_io_batch_destroy(batch);
+}
+
+static void test_batch_write_ring(void **ts) {
+  check_batch_write(0);
+}
+
+static void test_batch_write_syscalls(void **ts) {
+  check_batch_write(RESULT_IO_SYSCALLS);
+}
+
+static void test_batch_full(void **ts) {
+  struct result_io_batch_s *batch = create(2, 0);
+  result_io_t results[2];
+
+  assert_true(result_io_queue_close(batch, -1));
+  assert_true(result_io_queue_close(batch, -1));
+  assert_false(result_io_queue_close(batch, -1));
+  assert_false(result_io_queue_fsync(batch, -1));
+  assert_int_equal(2, result_io_batch_len(batch));
+
+  assert_int_equal(2, result_io_submit(batch, results));
+  assert_int_equal(0, result_io_submit(batch, results));
+
+  // and dropped unsubmitted
+  assert_true(result_io_queue_close(batch, -1));
+  result_io_batch_destroy(batch);
+}
+
+// One syscall per operation without the ring, one per submit with it.
+static void test_batch_syscalls(void **ts) {
+  struct result_io_batch_s *batch = create(16, RESULT_IO_SYSCALLS);
+  result_io_t results[16];
+
+  for (size_t i = 0; i < 16; i++) {
+    result_io_queue_fsync(batch, -1);
+  }
+
+  result_io_submit(batch, results);
+  assert_int_equal(16, result_io_batch_syscalls(batch));
+  result_io_batch_destroy(batch);
+
+  batch = create(16, 0);
+
+  for (size_t i = 0; i < 16; i++) {
+    result_io_queue_fsync(batch, -1);
+  }
+
+  result_io_submit(batch, results);
+
+  assert_int_equal(
+    result_io_batch_has_ring(batch) ? 1 : 16,
+    result_io_batch_syscalls(batch)
+  );
+
+  result_io_batch_destroy(batch);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_openat),
+    cmocka_unit_test(test_read_write),
+    cmocka_unit_test(test_read_at_position),
+    cmocka_unit_test(test_errors),
+    cmocka_unit_test(test_from_errno),
+    cmocka_unit_test(test_batch_files_ring),
+    cmocka_unit_test(test_batch_files_syscalls),
+    cmocka_unit_test(test_batch_errors_ring),
+    cmocka_unit_test(test_batch_errors_syscalls),
+    cmocka_unit_test(test_batch_write_ring),
+    cmocka_unit_test(test_batch_write_syscalls),
+    cmocka_unit_test(test_batch_full),
+    cmocka_unit_test(test_batch_syscalls),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,361 @@
+#ifndef __result_iter_h__
+#define __result_iter_h__
+
+#include "core/defs.h"
+#include "result.h"
+
+//
+// Lazy pipelines over streams of results, fused into a single loop.
+//
+// A pipeline is a terminal macro given a source and up to 8 stages:
+//
+//   typedef result_t(uint64_t, int) result_u64_t;
+//
+//   static result_u64_t parse(struct row_s row);
+//   static uint64_t scale(uint64_t x) { return x * 3; }
+//   static bool is_even(uint64_t x) { return (x & 1) == 0; }
+//   static uint64_t add(uint64_t acc, uint64_t x) { return acc + x; }
+//
+//   result_u64_t total = result_iter_try_fold(
+//     result_u64_t, 0, add,
+//     result_iter_array(rows, len),
+//     result_iter_and_then(parse),
+//     result_iter_map(scale),
+//     result_iter_filter_ok(is_even)
+//   );
+//
+// Stages are not functions that get called with each element. Each one is
+// expanded into a few statements in the body of the source's loop, so the
+// elements go through all of them one at a time, without any intermediate
+// storage: the above is the loop you'd write by hand. Filtered elements
+// `continue` to the next one and stopping `break`s out of the loop, so a
+// generator isn't called again once the pipeline is done with it.
+//
+// Sources:
+//
+//   - result_iter_array(_results, _len): `_len` results from an array
+//   - result_iter_generate(_type, _next, _ctx): results of type `_type` from
+//     `bool _next(ctx, _type *out)`, until it returns false
+//
+// Stages, from an element `res` to the next:
+//
+//   - result_iter_map(_fn): `_fn(ok)` for oks, errs go through
+//   - result_iter_map_err(_fn): `_fn(err)` for errs, oks go through
+//   - result_iter_and_then(_fn): `_fn(ok)`, which returns a result, for oks;
+//     errs go through (converted to `_fn`'s result type)
+//   - result_iter_filter_ok(_pred): drops oks for which `_pred(ok)` is false
+//   - result_iter_take_while_ok(): stops at the first err, without it
+//
+// Stages can change the ok and err types. The results between stages are
+// result_t, whatever the source's results are.
+//
+// Terminals:
+//
+//   - result_iter_fold(_init, _fn, ...): `acc = _fn(acc, ok)` for all oks,
+//     starting with `_init`; errs are skipped. Returns `acc`.
+//   - result_iter_collect_ok(_out, _cap, ...): writes oks to `_out` until
+//     there are `_cap` of them; errs are skipped. Returns how many it wrote.
+//
+// and their try-modes, which stop at the first err that gets to the end of
+// the pipeline and return it, like result_try_as, as a `_return_type`:
+//
+//   - result_iter_try_fold(_return_type, _init, _fn, ...): ok(acc)
+//   - result_iter_try_collect(_return_type, _out, _cap, ...): ok(count)
+//
+// Functions given to stages and terminals should be visible to the compiler
+// (static, or inline in a header) to be inlined into the loop. They're used
+// by name, so they can be function-like macros too.
+//
+// Everything here uses GNU extensions. Macros evaluate their arguments once;
+// stage functions are called once per element that gets to them.
+//
+
+#define result_iter_array(_results, _len) (array, _results, _len)
+
+#define result_iter_generate(_type, _next, _ctx) \
+  (generate, _type, _next, _ctx)
+
+#define result_iter_map(_fn) (map, _fn)
+#define result_iter_map_err(_fn) (map_err, _fn)
+#define result_iter_and_then(_fn) (and_then, _fn)
+#define result_iter_filter_ok(_pred) (filter_ok, _pred)
+#define result_iter_take_while_ok() (take_while_ok)
+
+#define result_iter_fold(_init, _fn, ...) ({ \
+  __typeof(_init) result_iter_acc = (_init); \
+  \
+  result_iter_loop((fold, result_iter_acc, _fn), __VA_ARGS__); \
+  result_iter_acc; \
+})
+
+#define result_iter_try_fold(_return_type, _init, _fn, ...) ({ \
+  __typeof(_init) result_iter_acc = (_init); \
+  _return_type result_iter_ret; \
+  bool result_iter_failed = false; \
+  \
+  result_iter_loop( \
+    (try_fold, _return_type, result_iter_acc, _fn), __VA_ARGS__ \
+  ); \
+  \
+  if (!result_iter_failed) { \
+    result_iter_ret = (_return_type) result_init_ok(result_iter_acc); \
+  } \
+  \
+  result_iter_ret; \
+})
+
+#define result_iter_collect_ok(_out, _cap, ...) ({ \
+  __typeof(&(_out)[0]) result_iter_out = (_out); \
+  size_t result_iter_cap = (_cap); \
+  size_t result_iter_count = 0; \
+  \
+  if (result_iter_cap > 0) { \
+    result_iter_loop((collect_ok), __VA_ARGS__); \
+  } \
+  \
+  result_iter_count; \
+})
+
+#define result_iter_try_collect(_return_type, _out, _cap, ...) ({ \
+  __typeof(&(_out)[0]) result_iter_out = (_out); \
+  size_t result_iter_cap = (_cap); \
+  size_t result_iter_count = 0; \
+  _return_type result_iter_ret; \
+  bool result_iter_failed = false; \
+  \
+  if (result_iter_cap > 0) { \
+    result_iter_loop((try_collect, _return_type), __VA_ARGS__); \
+  } \
+  \
+  if (!result_iter_failed) { \
+    result_iter_ret = (_return_type) result_init_ok(result_iter_count); \
+  } \
+  \
+  result_iter_ret; \
+})
+
+//
+// Expansion: the source opens the loop and declares the first element, each
+// stage declares the next one from the one before, and the terminal's sink
+// consumes the last one and closes the loop. The tuples made by the macros
+// above are `(kind, args...)` and expand to `result_iter_<what>_<kind>(args...,
+// elements...)`.
+//
+
+#define result_iter_loop(_sink, ...) \
+  result_iter_loop_(result_iter_count_args(__VA_ARGS__), _sink, __VA_ARGS__)
+
+#define result_iter_loop_(_n, _sink, ...) \
+  result_iter_loop__(_n, _sink, __VA_ARGS__)
+
+#define result_iter_loop__(_n, _sink, ...) \
+  result_iter_loop_##_n(_sink, __VA_ARGS__)
+
+#define result_iter_count_args(...) \
+  result_iter_count_args_(__VA_ARGS__, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+
+#define result_iter_count_args_( \
+  _1, _2, _3, _4, _5, _6, _7, _8, _9, _n, ... \
+) _n
+
+#define result_iter_expand(...) __VA_ARGS__
+
+#define result_iter_call(_what, _tuple, ...) \
+  result_iter_call_(_what, result_iter_expand _tuple, __VA_ARGS__)
+
+#define result_iter_call_(...) result_iter_call__(__VA_ARGS__)
+
+#define result_iter_call__(_what, _kind, ...) \
+  result_iter_##_what##_##_kind(__VA_ARGS__)
+
+#define result_iter_source(_source, _v) \
+  result_iter_call(source, _source, _v)
+
+#define result_iter_stage(_stage, _in, _out) \
+  result_iter_call(stage, _stage, _in, _out)
+
+#define result_iter_sink(_sink, _v) \
+  result_iter_call(sink, _sink, _v) \
+  }
+
+#define result_iter_loop_1(_sink, _source) \
+  result_iter_source(_source, result_iter_v0) \
+  result_iter_sink(_sink, result_iter_v0)
+
+#define result_iter_loop_2(_sink, _source, _s1) \
+  result_iter_source(_source, result_iter_v0) \
+  result_iter_stage(_s1, result_iter_v0, result_iter_v1) \
+  result_iter_sink(_sink, result_iter_v1)
+
+#define result_iter_loop_3(_sink, _source, _s1, _s2) \
+  result_iter_source(_source, result_iter_v0) \
+  result_iter_stage(_s1, result_iter_v0, result_iter_v1) \
+  result_iter_stage(_s2, result_iter_v1, result_iter_v2) \
+  result_iter_sink(_sink, result_iter_v2)
+
+#define result_iter_loop_4(_sink, _source, _s1, _s2, _s3) \
+  result_iter_source(_source, result_iter_v0) \
+  result_iter_stage(_s1, result_iter_v0, result_iter_v1) \
+  result_iter_stage(_s2, result_iter_v1, result_iter_v2) \
+  result_iter_stage(_s3, result_iter_v2, result_iter_v3) \
+  result_iter_sink(_sink, result_iter_v3)
+
+#define result_iter_loop_5(_sink, _source, _s1, _s2, _s3, _s4) \
+  result_iter_source(_source, result_iter_v0) \
+  result_iter_stage(_s1, result_iter_v0, result_iter_v1) \
+  result_iter_stage(_s2, result_iter_v1, result_iter_v2) \
+  result_iter_stage(_s3, result_iter_v2, result_iter_v3) \
+  result_iter_stage(_s4, result_iter_v3, result_iter_v4) \
+  result_iter_sink(_sink, result_iter_v4)
+
+#define result_iter_loop_6(_sink, _source, _s1, _s2, _s3, _s4, _s5) \
+  result_iter_source(_source, result_iter_v0) \
+  result_iter_stage(_s1, result_iter_v0, result_iter_v1) \
+  result_iter_stage(_s2, result_iter_v1, result_iter_v2) \
+  result_iter_stage(_s3, result_iter_v2, result_iter_v3) \
+  result_iter_stage(_s4, result_iter_v3, result_iter_v4) \
+  result_iter_stage(_s5, result_iter_v4, result_iter_v5) \
+  result_iter_sink(_sink, result_iter_v5)
+
+#define result_iter_loop_7(_sink, _source, _s1, _s2, _s3, _s4, _s5, _s6) \
+  result_iter_source(_source, result_iter_v0) \
+  result_iter_stage(_s1, result_iter_v0, result_iter_v1) \
+  result_iter_stage(_s2, result_iter_v1, result_iter_v2) \
+  result_iter_stage(_s3, result_iter_v2, result_iter_v3) \
+  result_iter_stage(_s4, result_iter_v3, result_iter_v4) \
+  result_iter_stage(_s5, result_iter_v4, result_iter_v5) \
+  result_iter_stage(_s6, result_iter_v5, result_iter_v6) \
+  result_iter_sink(_sink, result_iter_v6)
+
+#define result_iter_loop_8( \
+  _sink, _source, _s1, _s2, _s3, _s4, _s5, _s6, _s7 \
+) \
+  result_iter_source(_source, result_iter_v0) \
+  result_iter_stage(_s1, result_iter_v0, result_iter_v1) \
+  result_iter_stage(_s2, result_iter_v1, result_iter_v2) \
+  result_iter_stage(_s3, result_iter_v2, result_iter_v3) \
+  result_iter_stage(_s4, result_iter_v3, result_iter_v4) \
+  result_iter_stage(_s5, result_iter_v4, result_iter_v5) \
+  result_iter_stage(_s6, result_iter_v5, result_iter_v6) \
+  result_iter_stage(_s7, result_iter_v6, result_iter_v7) \
+  result_iter_sink(_sink, result_iter_v7)
+
+#define result_iter_loop_9( \
+  _sink, _source, _s1, _s2, _s3, _s4, _s5, _s6, _s7, _s8 \
+) \
+  result_iter_source(_source, result_iter_v0) \
+  result_iter_stage(_s1, result_iter_v0, result_iter_v1) \
+  result_iter_stage(_s2, result_iter_v1, result_iter_v2) \
+  result_iter_stage(_s3, result_iter_v2, result_iter_v3) \
+  result_iter_stage(_s4, result_iter_v3, result_iter_v4) \
+  result_iter_stage(_s5, result_iter_v4, result_iter_v5) \
+  result_iter_stage(_s6, result_iter_v5, result_iter_v6) \
+  result_iter_stage(_s7, result_iter_v6, result_iter_v7) \
+  result_iter_stage(_s8, result_iter_v7, result_iter_v8) \
+  result_iter_sink(_sink, result_iter_v8)
+
+//
+// Sources: open the loop (the brace is closed by result_iter_sink) and
+// declare `_v`.
+//
+
+#define result_iter_source_array(_results, _len, _v) \
+  __typeof(&(_results)[0]) result_iter_items = (_results); \
+  size_t result_iter_len = (_len); \
+  \
+  for (size_t result_iter_i = 0; result_iter_i < result_iter_len; \
+    result_iter_i++) { \
+    __typeof(result_iter_items[0]) _v = result_iter_items[result_iter_i];
+
+#define result_iter_source_generate(_type, _next, _ctx, _v) \
+  __typeof(_ctx) result_iter_ctx = (_ctx); \
+  \
+  for (;;) { \
+    _type _v; \
+    \
+    if (!_next(result_iter_ctx, &_v)) { \
+      break; \
+    }
+
+//
+// Stages: declare `_out` from `_in`.
+//
+
+#define result_iter_stage_map(_fn, _in, _out) \
+  result_t( \
+    __typeof(_fn((_in).body.ok)), __typeof((_in).body.err) \
+  ) _out = result_is_ok(_in) \
+    ? (__typeof(_out)) result_init_ok(_fn(result_unwrap_unchecked(_in))) \
+    : (__typeof(_out)) result_init_err(result_unwrap_err_unchecked(_in));
+
+#define result_iter_stage_map_err(_fn, _in, _out) \
+  result_t( \
+    __typeof((_in).body.ok), __typeof(_fn((_in).body.err)) \
+  ) _out = result_is_ok(_in) \
+    ? (__typeof(_out)) result_init_ok(result_unwrap_unchecked(_in)) \
+    : (__typeof(_out)) result_init_err(_fn(result_unwrap_err_unchecked(_in)));
+
+#define result_iter_stage_and_then(_fn, _in, _out) \
+  __typeof(_fn((_in).body.ok)) _out = result_is_ok(_in) \
+    ? _fn(result_unwrap_unchecked(_in)) \
+    : (__typeof(_out)) result_init_err(result_unwrap_err_unchecked(_in));
+
+#define result_iter_stage_filter_ok(_pred, _in, _out) \
+  if (result_is_ok(_in) && !_pred(result_unwrap_unchecked(_in))) { \
+    continue; \
+  } \
+  \
+  __typeof(_in) _out = _in;
+
+#define result_iter_stage_take_while_ok(_in, _out) \
+  if (result_is_err(_in)) { \
+    break; \
+  } \
+  \
+  __typeof(_in) _out = _in;
+
+//
+// Sinks: consume `_v`, with the terminal's variables.
+//
+
+#define result_iter_sink_fold(_acc, _fn, _v) \
+  if (result_is_ok(_v)) { \
+    _acc = _fn(_acc, result_unwrap_unchecked(_v)); \
+  }
+
+#define result_iter_sink_try_fold(_return_type, _acc, _fn, _v) \
+  if (w_unlikely(result_is_err(_v))) { \
+    result_iter_ret = (_return_type) result_init_err( \
+      result_unwrap_err_unchecked(_v) \
+    ); \
+    result_iter_failed = true; \
+    break; \
+  } \
+  \
+  _acc = _fn(_acc, result_unwrap_unchecked(_v));
+
+#define result_iter_sink_collect_ok(_v) \
+  if (result_is_ok(_v)) { \
+    result_iter_out[result_iter_count++] = result_unwrap_unchecked(_v); \
+    \
+    if (result_iter_count == result_iter_cap) { \
+      break; \
+    } \
+  }
+
+#define result_iter_sink_try_collect(_return_type, _v) \
+  if (w_unlikely(result_is_err(_v))) { \
+    result_iter_ret = (_return_type) result_init_err( \
+      result_unwrap_err_unchecked(_v) \
+    ); \
+    result_iter_failed = true; \
+    break; \
+  } \
+  \
+  result_iter_out[result_iter_count++] = result_unwrap_unchecked(_v); \
+  \
+  if (result_iter_count == result_iter_cap) { \
+    break; \
+  }
+
+#endif // __result_iter_h__
@@ -0,0 +1,389 @@
+#include "core/defs.h"
+#include "result_iter.h"
+
+/*sublime-c-static-fn-hoist-start*/
+static void test_folds_oks_and_skips_errs(void **ts);
+static void test_maps_oks_and_errs(void **ts);
+static void test_and_then_chains_results(void **ts);
+static void test_filters_oks(void **ts);
+static void test_takes_while_ok(void **ts);
+static void test_try_fold_stops_at_first_err(void **ts);
+static void test_collects_oks_up_to_cap(void **ts);
+static void test_try_collect_stops_at_first_err(void **ts);
+static void test_generates_lazily(void **ts);
+static void test_runs_eight_stages(void **ts);
+static void test_evaluates_arguments_once(void **ts);
+/*sublime-c-static-fn-hoist-end*/
+
+typedef result_t(int, int) result_int_t;
+typedef result_t(int64_t, const char *) result_i64_t;
+typedef result_t(size_t, int) result_size_t;
+
+struct counter_s {
+  int next;
+  int end;
+  int calls;
+};
+
+static int calls;
+
+static int twice(int x) {
+  calls++;
+  return x * 2;
+}
+
+static int negate(int x) {
+  return -x;
+}
+
+static int64_t widen(int x) {
+  return (int64_t) x;
+}
+
+static const char *describe(int code) {
+  return code == 7 ? "seven" : "other";
+}
+
+static result_int_t halve(int x) {
+  if (x % 2 != 0) {
+    return (result_int_t) result_init_err(x);
+  }
+
+  return (result_int_t) result_init_ok(x / 2);
+}
+
+static bool is_even(int x) {
+  return x % 2 == 0;
+}
+
+static int add(int acc, int x) {
+  return acc + x;
+}
+
+static int64_t add_i64(int64_t acc, int64_t x) {
+  return acc + x;
+}
+
+// 0, 1, ... end - 1, with an err instead of every fifth one.
+static bool count_up(struct counter_s *counter, result_int_t *out) {
+  counter->calls++;
+
+  if (counter->next == counter->end) {
+    return false;
+  }
+
+  int i = counter->next++;
+
+  *out = i % 5 == 4
+    ? (result_int_t) result_init_err(i)
+    : (result_int_t) result_init_ok(i);
+
+  return true;
+}
+
+#define plus_one(_x) ((_x) + 1)
+
+static const result_int_t mixed[] = {
+  result_init_ok(1),
+  result_init_ok(2),
+  result_init_err(3),
+  result_init_ok(4),
+  result_init_err(5),
+  result_init_ok(6),
+};
+
+static void test_folds_oks_and_skips_errs(void **ts) {
+  assert_int_equal(
+    13, result_iter_fold(0, add, result_iter_array(mixed, 6))
+  );
+
+  assert_int_equal(
+    100, result_iter_fold(100, add, result_iter_array(mixed, 0))
+  );
+}
+
+static void test_maps_oks_and_errs(void **ts) {
+  calls = 0;
+
+  // twice is only called for oks, and the types change along the way
+  int64_t total = result_iter_fold(
+    (int64_t) 0, add_i64,
+    result_iter_array(mixed, 6),
+    result_iter_map(twice),
+    result_iter_map(widen),
+    result_iter_map(plus_one)
+  );
+
+  assert_int_equal(30, total);
+  assert_int_equal(4, calls);
+
+  result_i64_t failed = result_iter_try_fold(
+    result_i64_t, (int64_t) 0, add_i64,
+    result_iter_array(mixed, 6),
+    result_iter_map(widen),
+    result_iter_map_err(negate),
+    result_iter_map_err(describe)
+  );
+
+  assert_true(result_is_err(failed));
+  assert_string_equal("other", result_unwrap_err_unchecked(failed));
+}
+
+static void test_and_then_chains_results(void **ts) {
+  static const result_int_t values[] = {
+    result_init_ok(8), result_init_ok(6), result_init_err(7),
+  };
+  int out[4];
+
+  // 8 -> 4 -> 2, 6 -> 3 -> err(3), err(7)
+  size_t n = result_iter_collect_ok(
+    out, 4,
+    result_iter_array(values, 3),
+    result_iter_and_then(halve),
+    result_iter_and_then(halve)
+  );
+
+  assert_int_equal(1, n);
+  assert_int_equal(2, out[0]);
+
+  result_int_t first = result_iter_try_fold(
+    result_int_t, 0, add,
+    result_iter_array(values, 3),
+    result_iter_and_then(halve),
+    result_iter_and_then(halve)
+  );
+
+  assert_true(result_is_err(first));
+  assert_int_equal(3, result_unwrap_err_unchecked(first));
+}
+
+static void test_filters_oks(void **ts) {
+  int out[6];
+
+  size_t n = result_iter_collect_ok(
+    out, 6,
+    result_iter_array(mixed, 6),
+    result_iter_filter_ok(is_even)
+  );
+
+  assert_int_equal(3, n);
+  assert_int_equal(2, out[0]);
+  assert_int_equal(4, out[1]);
+  assert_int_equal(6, out[2]);
+
+  // errs get through the filter
+  result_int_t first = result_iter_try_fold(
+    result_int_t, 0, add,
+    result_iter_array(mixed, 6),
+    result_iter_filter_ok(is_even)
+  );
+
+  assert_int_equal(3, result_unwrap_err_unchecked(first));
+}
+
+static void test_takes_while_ok(void **ts) {
+  calls = 0;
+
+  int total = result_iter_fold(
+    0, add,
+    result_iter_array(mixed, 6),
+    result_iter_take_while_ok(),
+    result_iter_map(twice)
+  );
+
+  assert_int_equal(6, total);
+  assert_int_equal(2, calls);
+
+  // with the errs gone, try-modes are always ok
+  result_int_t sum = result_iter_try_fold(
+    result_int_t, 0, add,
+    result_iter_array(mixed, 6),
+    result_iter_take_while_ok()
+  );
+
+  assert_true(result_is_ok(sum));
+  assert_int_equal(3, result_unwrap_unchecked(sum));
+}
+
+static void test_try_fold_stops_at_first_err(void **ts) {
+  calls = 0;
+
+  result_int_t res = result_iter_try_fold(
+    result_int_t, 0, add,
+    result_iter_array(mixed, 6),
+    result_iter_map(twice)
+  );
+
+  assert_true(result_is_err(res));
+  assert_int_equal(3, result_unwrap_err_unchecked(res));
+  assert_int_equal(2, calls);
+
+  res = result_iter_try_fold(
+    result_int_t, 0, add,
+    result_iter_array(mixed, 2),
+    result_iter_map(twice)
+  );
+
+  assert_true(result_is_ok(res));
+  assert_int_equal(6, result_unwrap_unchecked(res));
+}
+
+static void test_collects_oks_up_to_cap(void **ts) {
+  int out[6] = { 0 };
+
+  assert_int_equal(
+    4, result_iter_collect_ok(out, 6, result_iter_array(mixed, 6))
+  );
+
+  assert_int_equal(1, out[0]);
+  assert_int_equal(6, out[3]);
+
+  // stops as soon as the buffer is full
+  calls = 0;
+
+  assert_int_equal(
+    2,
+    result_iter_collect_ok(
+      out, 2,
+      result_iter_array(mixed, 6),
+      result_iter_map(twice)
+    )
+  );
+
+  assert_int_equal(2, calls);
+  assert_int_equal(4, out[1]);
+
+  assert_int_equal(
+    0, result_iter_collect_ok(out, 0, result_iter_array(mixed, 6))
+  );
+}
+
+static void test_try_collect_stops_at_first_err(void **ts) {
+  int out[6] = { 0 };
+
+  result_size_t res = result_iter_try_collect(
+    result_size_t, out, 6, result_iter_array(mixed, 6)
+  );
+
+  assert_true(result_is_err(res));
+  assert_int_equal(3, result_unwrap_err_unchecked(res));
+  assert_int_equal(2, out[1]);
+  assert_int_equal(0, out[2]);
+
+  res = result_iter_try_collect(
+    result_size_t, out, 6,
+    result_iter_array(mixed, 6),
+    result_iter_filter_ok(is_even),
+    result_iter_take_while_ok()
+  );
+
+  assert_true(result_is_ok(res));
+  assert_int_equal(1, result_unwrap_unchecked(res));
+}
+
+static void test_generates_lazily(void **ts) {
+  struct counter_s counter = { .end = 100 };
+  int out[3];
+
+  size_t n = result_iter_collect_ok(
+    out, 3,
+    result_iter_generate(result_int_t, count_up, &counter),
+    result_iter_filter_ok(is_even)
+  );
+
+  // 0, 1, 2, 3, 4 was an err, 5, 6 fills the buffer
+  assert_int_equal(3, n);
+  assert_int_equal(0, out[0]);
+  assert_int_equal(6, out[2]);
+  assert_int_equal(7, counter.calls);
+
+  // not called again after the first err
+  counter = (struct counter_s) { .end = 100 };
+
+  result_int_t res = result_iter_try_fold(
+    result_int_t, 0, add,
+    result_iter_generate(result_int_t, count_up, &counter)
+  );
+
+  assert_int_equal(4, result_unwrap_err_unchecked(res));
+  assert_int_equal(5, counter.calls);
+
+  // until it returns false, with one more call
+  counter = (struct counter_s) { .end = 4 };
+
+  res = result_iter_try_fold(
+    result_int_t, 0, add,
+    result_iter_generate(result_int_t, count_up, &counter)
+  );
+
+  assert_int_equal(6, result_unwrap_unchecked(res));
+  assert_int_equal(5, counter.calls);
+}
+
+static void test_runs_eight_stages(void **ts) {
+  struct counter_s counter = { .end = 20 };
+
+  // 0..19 without 4, 9, 14, 19, even ones, plus one, twice, minus one, back
+  // to int64_t
+  int64_t total = result_iter_fold(
+    (int64_t) 0, add_i64,
+    result_iter_generate(result_int_t, count_up, &counter),
+    result_iter_map_err(negate),
+    result_iter_filter_ok(is_even),
+    result_iter_map(plus_one),
+    result_iter_map(twice),
+    result_iter_map(negate),
+    result_iter_map(plus_one),
+    result_iter_map(negate),
+    result_iter_map(widen)
+  );
+
+  // sum of 2 * (x + 1) - 1 for x in 0, 2, 6, 8, 10, 12, 16, 18
+  assert_int_equal(2 * (72 + 8) - 8, total);
+}
+
+static void test_evaluates_arguments_once(void **ts) {
+  const result_int_t *items = mixed;
+  size_t len = 6;
+  int out[6];
+  int *dest = out;
+  int init = 0;
+  struct counter_s counter = { .end = 3 };
+  struct counter_s *counters = &counter;
+
+  int total = result_iter_fold(
+    init++, add, result_iter_array(items++, len++)
+  );
+
+  assert_int_equal(13, total);
+  assert_ptr_equal(mixed + 1, items);
+  assert_int_equal(7, len);
+  assert_int_equal(1, init);
+
+  size_t n = result_iter_collect_ok(
+    dest++, len--, result_iter_generate(result_int_t, count_up, counters++)
+  );
+
+  assert_int_equal(3, n);
+  assert_ptr_equal(out + 1, dest);
+  assert_int_equal(6, len);
+  assert_ptr_equal(&counter + 1, counters);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_folds_oks_and_skips_errs),
+    cmocka_unit_test(test_maps_oks_and_errs),
+    cmocka_unit_test(test_and_then_chains_results),
+    cmocka_unit_test(test_filters_oks),
+    cmocka_unit_test(test_takes_while_ok),
+    cmocka_unit_test(test_try_fold_stops_at_first_err),
+    cmocka_unit_test(test_collects_oks_up_to_cap),
+    cmocka_unit_test(test_try_collect_stops_at_first_err),
+    cmocka_unit_test(test_generates_lazily),
+    cmocka_unit_test(test_runs_eight_stages),
+    cmocka_unit_test(test_evaluates_arguments_once),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
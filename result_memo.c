@@ -0,0 +1,652 @@
+#include "result_memo.h"
+#include "result_future.h"
+
+#include <pthread.h>
+
+#define NONE UINT32_MAX
+#define DEFAULT_SHARDS 16
+#define MIN_SHARD_CAPACITY 8
+
+// Followed by the key and the result, each padded to 8 bytes.
+struct entry_s {
+  uint64_t hash;
+  uint64_t expires_at;
+
+  // next entry in the bucket, or in the free list of the pool
+  uint32_t next;
+
+  bool used;
+  bool referenced;
+};
+
+// Entries [first, first + capacity) of a shard, for either ok or err results.
+struct pool_s {
+  uint32_t first;
+  uint32_t capacity;
+  uint32_t len;
+  uint32_t hand;
+  uint32_t free;
+  uint64_t ttl_ns;
+};
+
+struct result_memo_flight_s {
+  struct result_memo_flight_s *next;
+  uint64_t hash;
+  uint32_t state;
+  uint32_t refs;
+  struct shard_s *shard;
+
+  // published without a result, see result_memo_abandon()
+  bool abandoned;
+
+  // the key and then the result
+  uint64_t data[];
+};
+
+struct shard_s {
+  pthread_mutex_t mutex;
+  uint32_t *buckets;
+  uint32_t mask;
+  char *entries;
+
+  // indexed by is_ok
+  struct pool_s pools[2];
+
+  struct result_memo_flight_s *flights;
+  struct result_memo_stats_s stats;
+} __attribute__((aligned(64)));
+
+struct result_memo_s {
+  size_t key_size;
+  size_t result_size;
+  size_t key_stride;
+  size_t stride;
+
+  struct shard_s *shards;
+  size_t shards_len;
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static uint64_t now_ns(void);
+static uint64_t hash_bytes(const void *data, size_t len);
+static size_t round_up(size_t size);
+static struct shard_s *shard_of(
+  const struct result_memo_s *memo,
+  uint64_t hash
+);
+static struct entry_s *entry_at(
+  const struct result_memo_s *memo,
+  const struct shard_s *shard,
+  uint32_t index
+);
+static void *key_of(struct entry_s *entry);
+static void *result_of(
+  const struct result_memo_s *memo,
+  struct entry_s *entry
+);
+static void unlink_entry(
+  const struct result_memo_s *memo,
+  struct shard_s *shard,
+  uint32_t index
+);
+static uint32_t find(
+  const struct result_memo_s *memo,
+  struct shard_s *shard,
+  uint64_t hash,
+  const void *key,
+  uint64_t now
+);
+static uint32_t make_room(
+  const struct result_memo_s *memo,
+  struct shard_s *shard,
+  bool is_ok
+);
+static void insert(
+  const struct result_memo_s *memo,
+  struct shard_s *shard,
+  uint64_t hash,
+  const void *key,
+  const void *result,
+  bool is_ok,
+  uint64_t now
+);
+static bool init_shard(
+  const struct result_memo_s *memo,
+  struct shard_s *shard,
+  const struct result_memo_options_s *options,
+  size_t ok_capacity,
+  size_t err_capacity
+);
+static void release_flight(struct result_memo_flight_s *flight);
+static void unlink_flight(struct result_memo_flight_s *flight);
+/*sublime-c-static-fn-hoist-end*/
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  #if defined(CLOCK_MONOTONIC_COARSE)
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  #else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+  #endif
+
+  return (uint64_t) ts.tv_sec * RESULT_MEMO_SECOND + (uint64_t) ts.tv_nsec;
+}
+
+static uint64_t hash_bytes(const void *data, size_t len) {
+  const unsigned char *bytes = data;
+  uint64_t hash = 0x9e3779b97f4a7c15u ^ len;
+  uint64_t word;
+
+  for (; len >= 8; bytes += 8, len -= 8) {
+    memcpy(&word, bytes, 8);
+    hash = (hash ^ word) * 0xbf58476d1ce4e5b9u;
+    hash ^= hash >> 31;
+  }
+
+  if (len > 0) {
+    word = 0;
+    memcpy(&word, bytes, len);
+    hash = (hash ^ word) * 0x94d049bb133111ebu;
+    hash ^= hash >> 29;
+  }
+
+  hash *= 0xd6e8feb86659fd93u;
+  return hash ^ (hash >> 32);
+}
+
+static size_t round_up(size_t size) {
+  return (size + 7) & ~(size_t) 7;
+}
+
+static struct shard_s *shard_of(
+  const struct result_memo_s *memo,
+  uint64_t hash
+) {
+  // the low bits pick the bucket
+  return &memo->shards[(hash >> 48) & (memo->shards_len - 1)];
+}
+
+static struct entry_s *entry_at(
+  const struct result_memo_s *memo,
+  const struct shard_s *shard,
+  uint32_t index
+) {
+  return (struct entry_s *) (shard->entries + index * memo->stride);
+}
+
+static void *key_of(struct entry_s *entry) {
+  return entry + 1;
+}
+
+static void *result_of(
+  const struct result_memo_s *memo,
+  struct entry_s *entry
+) {
+  return (char *) (entry + 1) + memo->key_stride;
+}
+
+// Takes the entry out of its bucket and gives it back to its pool.
+static void unlink_entry(
+  const struct result_memo_s *memo,
+  struct shard_s *shard,
+  uint32_t index
+) {
+  struct entry_s *entry = entry_at(memo, shard, index);
+  uint32_t *link = &shard->buckets[entry->hash & shard->mask];
+
+  while (*link != index) {
+    link = &entry_at(memo, shard, *link)->next;
+  }
+
+  *link = entry->next;
+
+  struct pool_s *pool = &shard->pools[index >= shard->pools[1].first];
+
+  entry->used = false;
+  entry->next = pool->free;
+  pool->free = index;
+  pool->len--;
+}
+
+// Index of the live entry for `key`, or NONE. Drops the entry if it expired.
+static uint32_t find(
+  const struct result_memo_s *memo,
+  struct shard_s *shard,
+  uint64_t hash,
+  const void *key,
+  uint64_t now
+) {
+  uint32_t index = shard->buckets[hash & shard->mask];
+
+  while (index != NONE) {
+    struct entry_s *entry = entry_at(memo, shard, index);
+
+    if (
+      entry->hash == hash
+      && memcmp(key_of(entry), key, memo->key_size) == 0
+    ) {
+      if (entry->expires_at != 0 && now >= entry->expires_at) {
+        unlink_entry(memo, shard, index);
+        shard->stats.expirations++;
+        return NONE;
+      }
+
+      return index;
+    }
+
+    index = entry->next;
+  }
+
+  return NONE;
+}
+
+// A free entry of the pool, evicting one with CLOCK if there's none.
+static uint32_t make_room(
+  const struct result_memo_s *memo,
+  struct shard_s *shard,
+  bool is_ok
+) {
+  struct pool_s *pool = &shard->pools[is_ok];
+
+  while (pool->free == NONE) {
+    uint32_t index = pool->first + pool->hand;
+    struct entry_s *entry = entry_at(memo, shard, index);
+
+    pool->hand = pool->hand + 1 == pool->capacity ? 0 : pool->hand + 1;
+
+    if (entry->referenced) {
+      entry->referenced = false;
+      continue;
+    }
+
+    unlink_entry(memo, shard, index);
+    shard->stats.evictions++;
+  }
+
+  uint32_t index = pool->free;
+  pool->free = entry_at(memo, shard, index)->next;
+  pool->len++;
+
+  return index;
+}
+
+static void insert(
+  const struct result_memo_s *memo,
+  struct shard_s *shard,
+  uint64_t hash,
+  const void *key,
+  const void *result,
+  bool is_ok,
+  uint64_t now
+) {
+  struct pool_s *pool = &shard->pools[is_ok];
+
+  if (pool->capacity == 0) {
+    return;
+  }
+
+  // forgotten and computed again while its flight was running
+  uint32_t existing = find(memo, shard, hash, key, now);
+
+  if (existing != NONE) {
+    unlink_entry(memo, shard, existing);
+  }
+
+  uint32_t index = make_room(memo, shard, is_ok);
+  struct entry_s *entry = entry_at(memo, shard, index);
+  uint32_t *bucket = &shard->buckets[hash & shard->mask];
+
+  entry->hash = hash;
+  entry->expires_at = pool->ttl_ns == 0 ? 0 : now + pool->ttl_ns;
+  entry->used = true;
+  entry->referenced = false;
+  entry->next = *bucket;
+  *bucket = index;
+
+  memcpy(key_of(entry), key, memo->key_size);
+  memcpy(result_of(memo, entry), result, memo->result_size);
+}
+
+static bool init_shard(
+  const struct result_memo_s *memo,
+  struct shard_s *shard,
+  const struct result_memo_options_s *options,
+  size_t ok_capacity,
+  size_t err_capacity
+) {
+  size_t capacity = ok_capacity + err_capacity;
+  size_t buckets = 1;
+
+  while (buckets < capacity) {
+    buckets *= 2;
+  }
+
+  pthread_mutex_init(&shard->mutex, NULL);
+
+  shard->mask = (uint32_t) buckets - 1;
+  shard->buckets = malloc(buckets * sizeof(*shard->buckets));
+  shard->entries = calloc(w_max_2(capacity, (size_t) 1), memo->stride);
+
+  if (!shard->buckets || !shard->entries) {
+    return false;
+  }
+
+  memset(shard->buckets, 0xff, buckets * sizeof(*shard->buckets));
+
+  shard->pools[false] = (struct pool_s) {
+    .first = 0,
+    .capacity = (uint32_t) err_capacity,
+    .ttl_ns = options->err_ttl_ns,
+  };
+
+  shard->pools[true] = (struct pool_s) {
+    .first = (uint32_t) err_capacity,
+    .capacity = (uint32_t) ok_capacity,
+    .ttl_ns = options->ok_ttl_ns,
+  };
+
+  for (size_t p = 0; p < 2; p++) {
+    struct pool_s *pool = &shard->pools[p];
+
+    pool->free = NONE;
+
+    for (uint32_t i = pool->capacity; i > 0; i--) {
+      entry_at(memo, shard, pool->first + i - 1)->next = pool->free;
+      pool->free = pool->first + i - 1;
+    }
+  }
+
+  return true;
+}
+
+struct result_memo_s *result_memo_new(
+  const struct result_memo_options_s *options
+) {
+  size_t largest = w_max_2(options->ok_capacity, options->err_capacity);
+  size_t shards = options->shards;
+
+  if (shards == 0) {
+    shards = w_min_2(
+      (size_t) DEFAULT_SHARDS,
+      w_max_2(largest / MIN_SHARD_CAPACITY, (size_t) 1)
+    );
+  }
+
+  // a power of two
+  while (shards & (shards - 1)) {
+    shards &= shards - 1;
+  }
+
+  size_t ok_capacity = (options->ok_capacity + shards - 1) / shards;
+  size_t err_capacity = (options->err_capacity + shards - 1) / shards;
+
+  if (ok_capacity + err_capacity >= NONE) {
+    return NULL;
+  }
+
+  struct result_memo_s *memo = calloc(1, sizeof(*memo));
+
+  if (!memo) {
+    return NULL;
+  }
+
+  memo->key_size = options->key_size;
+  memo->result_size = options->result_size;
+  memo->key_stride = round_up(options->key_size);
+
+  memo->stride = sizeof(struct entry_s)
+    + memo->key_stride
+    + round_up(options->result_size);
+
+  memo->shards_len = shards;
+  memo->shards = aligned_alloc(64, shards * sizeof(*memo->shards));
+
+  if (!memo->shards) {
+    free(memo);
+    return NULL;
+  }
+
+  memset(memo->shards, 0, shards * sizeof(*memo->shards));
+
+  for (size_t i = 0; i < shards; i++) {
+    struct shard_s *shard = &memo->shards[i];
+
+    if (!init_shard(memo, shard, options, ok_capacity, err_capacity)) {
+      result_memo_delete(memo);
+      return NULL;
+    }
+  }
+
+  return memo;
+}
+
+void result_memo_delete(struct result_memo_s *memo) {
+  if (!memo) {
+    return;
+  }
+
+  for (size_t i = 0; i < memo->shards_len; i++) {
+    struct shard_s *shard = &memo->shards[i];
+
+    free(shard->buckets);
+    free(shard->entries);
+    pthread_mutex_destroy(&shard->mutex);
+  }
+
+  free(memo->shards);
+  free(memo);
+}
+
+bool result_memo_lookup(
+  struct result_memo_s *memo,
+  const void *key,
+  void *out
+) {
+  uint64_t hash = hash_bytes(key, memo->key_size);
+  struct shard_s *shard = shard_of(memo, hash);
+
+  pthread_mutex_lock(&shard->mutex);
+
+  uint32_t index = find(memo, shard, hash, key, now_ns());
+
+  if (index != NONE) {
+    struct entry_s *entry = entry_at(memo, shard, index);
+
+    entry->referenced = true;
+    memcpy(out, result_of(memo, entry), memo->result_size);
+    shard->stats.hits++;
+  }
+
+  pthread_mutex_unlock(&shard->mutex);
+  return index != NONE;
+}
+
+bool result_memo_remove(struct result_memo_s *memo, const void *key) {
+  uint64_t hash = hash_bytes(key, memo->key_size);
+  struct shard_s *shard = shard_of(memo, hash);
+
+  pthread_mutex_lock(&shard->mutex);
+
+  uint32_t index = find(memo, shard, hash, key, now_ns());
+
+  if (index != NONE) {
+    unlink_entry(memo, shard, index);
+  }
+
+  pthread_mutex_unlock(&shard->mutex);
+  return index != NONE;
+}
+
+static void release_flight(struct result_memo_flight_s *flight) {
+  if (__atomic_sub_fetch(&flight->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    free(flight);
+  }
+}
+
+static void unlink_flight(struct result_memo_flight_s *flight) {
+  struct result_memo_flight_s **link = &flight->shard->flights;
+
+  while (*link != flight) {
+    link = &(*link)->next;
+  }
+
+  *link = flight->next;
+}
+
+enum result_memo_begin_e result_memo_begin(
+  struct result_memo_s *memo,
+  const void *key,
+  void *out,
+  struct result_memo_flight_s **flight_out
+) {
+  uint64_t hash = hash_bytes(key, memo->key_size);
+  struct shard_s *shard = shard_of(memo, hash);
+  bool retrying = false;
+
+  for (;;) {
+    pthread_mutex_lock(&shard->mutex);
+
+    // the last wait was for a flight that was abandoned, and wasn't a hit
+    if (retrying) {
+      shard->stats.hits--;
+    }
+
+    uint32_t index = find(memo, shard, hash, key, now_ns());
+
+    if (index != NONE) {
+      struct entry_s *entry = entry_at(memo, shard, index);
+
+      entry->referenced = true;
+      memcpy(out, result_of(memo, entry), memo->result_size);
+      shard->stats.hits++;
+
+      pthread_mutex_unlock(&shard->mutex);
+      return RESULT_MEMO_HIT;
+    }
+
+    struct result_memo_flight_s *flight = shard->flights;
+
+    while (
+      flight
+      && (
+        flight->hash != hash
+        || memcmp(flight->data, key, memo->key_size) != 0
+      )
+    ) {
+      flight = flight->next;
+    }
+
+    if (!flight) {
+      break;
+    }
+
+    // someone else is already computing it
+    flight->refs++;
+    shard->stats.hits++;
+    shard->stats.waits++;
+    pthread_mutex_unlock(&shard->mutex);
+
+    if (!result_future_poll(&flight->state)) {
+      result_future_block(&flight->state);
+    }
+
+    retrying = flight->abandoned;
+
+    if (!retrying) {
+      memcpy(
+        out,
+        (char *) flight->data + memo->key_stride,
+        memo->result_size
+      );
+    }
+
+    release_flight(flight);
+
+    if (!retrying) {
+      return RESULT_MEMO_HIT;
+    }
+  }
+
+  // still holding the mutex
+  struct result_memo_flight_s *flight = malloc(
+    sizeof(*flight) + memo->key_stride + memo->result_size
+  );
+
+  shard->stats.misses++;
+
+  // not much we can do but compute it without deduplication
+  if (!flight) {
+    pthread_mutex_unlock(&shard->mutex);
+    return RESULT_MEMO_MISS_UNTRACKED;
+  }
+
+  *flight = (struct result_memo_flight_s) {
+    .next = shard->flights,
+    .hash = hash,
+    .state = RESULT_FUTURE_EMPTY,
+    .refs = 1,
+    .shard = shard,
+  };
+
+  memcpy(flight->data, key, memo->key_size);
+  shard->flights = flight;
+
+  pthread_mutex_unlock(&shard->mutex);
+  *flight_out = flight;
+  return RESULT_MEMO_MISS;
+}
+
+void result_memo_finish(
+  struct result_memo_s *memo,
+  struct result_memo_flight_s *flight,
+  const void *result,
+  bool is_ok
+) {
+  struct shard_s *shard = flight->shard;
+
+  memcpy((char *) flight->data + memo->key_stride, result, memo->result_size);
+
+  pthread_mutex_lock(&shard->mutex);
+  unlink_flight(flight);
+  insert(memo, shard, flight->hash, flight->data, result, is_ok, now_ns());
+  pthread_mutex_unlock(&shard->mutex);
+
+  result_future_publish(&flight->state);
+  release_flight(flight);
+}
+
+void result_memo_abandon(struct result_memo_flight_s *flight) {
+  struct shard_s *shard = flight->shard;
+
+  pthread_mutex_lock(&shard->mutex);
+  unlink_flight(flight);
+  pthread_mutex_unlock(&shard->mutex);
+
+  // published with release semantics, so the waiters see it
+  flight->abandoned = true;
+  result_future_publish(&flight->state);
+  release_flight(flight);
+}
+
+struct result_memo_stats_s result_memo_sum_stats(struct result_memo_s *memo) {
+  struct result_memo_stats_s stats = { 0 };
+
+  for (size_t i = 0; i < memo->shards_len; i++) {
+    struct shard_s *shard = &memo->shards[i];
+
+    pthread_mutex_lock(&shard->mutex);
+
+    stats.hits += shard->stats.hits;
+    stats.misses += shard->stats.misses;
+    stats.waits += shard->stats.waits;
+    stats.evictions += shard->stats.evictions;
+    stats.expirations += shard->stats.expirations;
+    stats.ok_len += shard->pools[true].len;
+    stats.err_len += shard->pools[false].len;
+
+    pthread_mutex_unlock(&shard->mutex);
+  }
+
+  return stats;
+}
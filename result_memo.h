@@ -0,0 +1,235 @@
+#ifndef __result_memo_h__
+#define __result_memo_h__
+
+#include "core/defs.h"
+#include "result.h"
+
+//
+// Concurrent memo cache for functions that return results, errs included.
+//
+//   typedef result_padded_t(struct user_s, int) result_user_t;
+//   result_memo_t(uint64_t, result_user_t) users;
+//
+//   bool ok = result_memo_init(
+//     &users,
+//     .ok_capacity = 100000,
+//     .ok_ttl_ns = 60 * RESULT_MEMO_SECOND,
+//     .err_capacity = 10000,
+//     .err_ttl_ns = 5 * RESULT_MEMO_SECOND,
+//   );
+//
+//   // lookup_user() only runs on a miss
+//   result_user_t res = result_memo_call(&users, &id, lookup_user(id));
+//
+//   result_memo_free(&users);
+//
+// Keys are hashed and compared as bytes, so a key type must not have padding
+// that could be left uninitialized (zero such keys with memset() before
+// filling them in). Whole results are stored as bytes too, which is what
+// result_padded_t was made for: entries of it can be compared with memcmp().
+//
+// Ok and err results have their own capacity and time to live, so that a
+// burst of failing keys can't evict the working set, and errs can be retried
+// sooner. A capacity of 0 doesn't cache that kind of result at all, a TTL of
+// 0 keeps entries until they're evicted. Each kind is evicted with CLOCK: an
+// entry that was hit since the hand last passed it gets a second chance.
+//
+// Concurrent misses on the same key are computed once: the first caller
+// computes the result while the others park (in futex(2), like
+// result_future_wait) until it's there. The cache is split into shards with a
+// mutex each, by hash. Capacities are split evenly over the shards, so a shard
+// can start evicting a little before the cache as a whole is full.
+//
+// Expiry uses CLOCK_MONOTONIC_COARSE where available, so TTLs are only
+// accurate to a few milliseconds.
+//
+
+#define RESULT_MEMO_SECOND ((uint64_t) 1000000000)
+
+struct result_memo_s;
+struct result_memo_flight_s;
+
+struct result_memo_options_s {
+  size_t ok_capacity;
+  size_t err_capacity;
+  uint64_t ok_ttl_ns;
+  uint64_t err_ttl_ns;
+
+  // rounded down to a power of two, 0 picks one from the capacities
+  size_t shards;
+
+  // set by result_memo_init()
+  size_t key_size;
+  size_t result_size;
+};
+
+struct result_memo_stats_s {
+  uint64_t hits;
+  uint64_t misses;
+
+  // hits that waited for another thread to compute the result
+  uint64_t waits;
+
+  uint64_t evictions;
+  uint64_t expirations;
+
+  size_t ok_len;
+  size_t err_len;
+};
+
+#define result_memo_t(_key_type, _result_type) \
+  struct result_memo_d(_key_type, _result_type)
+
+#define result_memo_d(_key_type, _result_type) { \
+  struct result_memo_s *memo; \
+  _key_type key[0]; \
+  _result_type result[0]; \
+}
+
+// Takes the fields of struct result_memo_options_s as designated
+// initializers. Returns false if out of memory.
+#define result_memo_init(_memo, ...) ({ \
+  __typeof(&*(_memo)) result_memo_self = (_memo); \
+  struct result_memo_options_s result_memo_options = { __VA_ARGS__ }; \
+  \
+  result_memo_options.key_size = sizeof(result_memo_self->key[0]); \
+  result_memo_options.result_size = sizeof(result_memo_self->result[0]); \
+  result_memo_self->memo = result_memo_new(&result_memo_options); \
+  \
+  result_memo_self->memo != NULL; \
+})
+
+#define result_memo_free(_memo) ({ \
+  __typeof(&*(_memo)) result_memo_self = (_memo); \
+  \
+  result_memo_delete(result_memo_self->memo); \
+  result_memo_self->memo = NULL; \
+})
+
+// Evaluates to the cached result for `*_key`, or evaluates `_expr` (once per
+// key, across all threads), caches and evaluates to that.
+//
+// `_expr` may leave early (a `return`, or result_try on an err): the flight
+// is then abandoned when the macro's scope ends, and the threads waiting for
+// it go back to the cache, one of them computing the result instead. Nothing
+// is cached for that call. Like any __attribute__((cleanup)), this doesn't
+// happen on longjmp(3) or thread cancellation, which leave the waiters
+// blocked.
+#define result_memo_call(_memo, _key, _expr) ({ \
+  __typeof(&*(_memo)) result_memo_self = (_memo); \
+  __typeof(result_memo_self->key[0]) const *result_memo_key = (_key); \
+  __typeof(result_memo_self->result[0]) result_memo_res; \
+  __attribute__((cleanup(result_memo_abandon_at))) \
+    struct result_memo_flight_s *result_memo_flight = NULL; \
+  \
+  enum result_memo_begin_e result_memo_found = result_memo_begin( \
+    result_memo_self->memo, \
+    result_memo_key, \
+    &result_memo_res, \
+    &result_memo_flight \
+  ); \
+  \
+  if (result_memo_found != RESULT_MEMO_HIT) { \
+    result_memo_res = (_expr); \
+  } \
+  \
+  if (result_memo_found == RESULT_MEMO_MISS) { \
+    result_memo_finish( \
+      result_memo_self->memo, \
+      result_memo_flight, \
+      &result_memo_res, \
+      result_is_ok(result_memo_res) \
+    ); \
+    \
+    result_memo_flight = NULL; \
+  } \
+  \
+  result_memo_res; \
+})
+
+// Copies the cached result for `*_key` to `*_out` and returns true, or returns
+// false without computing anything.
+#define result_memo_get(_memo, _key, _out) ({ \
+  __typeof(&*(_memo)) result_memo_self = (_memo); \
+  __typeof(result_memo_self->key[0]) const *result_memo_key = (_key); \
+  __typeof(result_memo_self->result[0]) *result_memo_out = (_out); \
+  \
+  result_memo_lookup( \
+    result_memo_self->memo, \
+    result_memo_key, \
+    result_memo_out \
+  ); \
+})
+
+// Drops the entry for `*_key`. Returns false if there wasn't one.
+#define result_memo_forget(_memo, _key) ({ \
+  __typeof(&*(_memo)) result_memo_self = (_memo); \
+  __typeof(result_memo_self->key[0]) const *result_memo_key = (_key); \
+  \
+  result_memo_remove(result_memo_self->memo, result_memo_key); \
+})
+
+#define result_memo_stats(_memo) result_memo_sum_stats((_memo)->memo)
+
+//
+// Used by the macros above
+//
+
+extern struct result_memo_s *result_memo_new(
+  const struct result_memo_options_s *options
+);
+
+extern void result_memo_delete(struct result_memo_s *memo);
+
+extern bool result_memo_lookup(
+  struct result_memo_s *memo,
+  const void *key,
+  void *out
+);
+
+extern bool result_memo_remove(struct result_memo_s *memo, const void *key);
+
+// What result_memo_begin() found for a key.
+enum result_memo_begin_e {
+  // `*out` is the result, cached or computed by another thread
+  RESULT_MEMO_HIT,
+
+  // the caller computes the result and passes it to result_memo_finish()
+  // with `*flight`, or abandons `*flight`
+  RESULT_MEMO_MISS,
+
+  // out of memory for a flight: the caller computes the result, which isn't
+  // cached or shared with other callers
+  RESULT_MEMO_MISS_UNTRACKED,
+};
+
+extern enum result_memo_begin_e result_memo_begin(
+  struct result_memo_s *memo,
+  const void *key,
+  void *out,
+  struct result_memo_flight_s **flight
+);
+
+extern void result_memo_finish(
+  struct result_memo_s *memo,
+  struct result_memo_flight_s *flight,
+  const void *result,
+  bool is_ok
+);
+
+// Gives up on a flight without a result: the threads waiting for it look
+// the key up again.
+extern void result_memo_abandon(struct result_memo_flight_s *flight);
+
+static inline __attribute__((unused))
+void result_memo_abandon_at(struct result_memo_flight_s **flight) {
+  if (*flight) {
+    result_memo_abandon(*flight);
+  }
+}
+
+extern struct result_memo_stats_s result_memo_sum_stats(
+  struct result_memo_s *memo
+);
+
+#endif // __result_memo_h__
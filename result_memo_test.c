@@ -0,0 +1,407 @@
+#include "core/defs.h"
+#include "result_memo.h"
+
+#include <pthread.h>
+#include <time.h>
+
+typedef result_padded_t(uint64_t, int) result_u64_t;
+typedef result_memo_t(uint64_t, result_u64_t) memo_u64_t;
+
+struct key_s {
+  uint32_t id;
+  uint16_t kind;
+  uint16_t flags;
+  char name[12];
+};
+
+struct call_s {
+  memo_u64_t *memo;
+  uint64_t key;
+  result_u64_t result;
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static result_u64_t compute(uint64_t key);
+static result_u64_t compute_slowly(uint64_t key);
+static void sleep_ms(long ms);
+static void *call_in_thread(void *arg);
+static result_u64_t give_up_slowly(memo_u64_t *memo, uint64_t key);
+static void *give_up_in_thread(void *arg);
+static void test_hit_and_miss(void **ts);
+static void test_errs_are_cached(void **ts);
+static void test_errs_have_own_capacity(void **ts);
+static void test_zero_capacity(void **ts);
+static void test_ttl(void **ts);
+static void test_second_chance(void **ts);
+static void test_forget(void **ts);
+static void test_struct_keys(void **ts);
+static void test_single_flight(void **ts);
+static void test_abandoned_flight(void **ts);
+/*sublime-c-static-fn-hoist-end*/
+
+#define THREADS 8
+
+static uint64_t calls;
+
+// Odd keys are errs.
+static result_u64_t compute(uint64_t key) {
+  __atomic_fetch_add(&calls, 1, __ATOMIC_RELAXED);
+
+  if (key % 2 == 1) {
+    return (result_u64_t) result_init_err((int) key);
+  }
+
+  return (result_u64_t) result_init_ok(key * 10);
+}
+
+static result_u64_t compute_slowly(uint64_t key) {
+  sleep_ms(50);
+  return compute(key);
+}
+
+static void sleep_ms(long ms) {
+  struct timespec ts = { .tv_sec = 0, .tv_nsec = ms * 1000000 };
+
+  nanosleep(&ts, NULL);
+}
+
+static void *call_in_thread(void *arg) {
+  struct call_s *call = arg;
+
+  call->result = result_memo_call(
+    call->memo,
+    &call->key,
+    compute_slowly(call->key)
+  );
+
+  return NULL;
+}
+
+// Returns from inside result_memo_call(), without a result to cache.
+static result_u64_t give_up_slowly(memo_u64_t *memo, uint64_t key) {
+  result_u64_t failed = result_init_err(-1);
+
+  result_u64_t res = result_memo_call(memo, &key, ({
+    sleep_ms(50);
+    (result_u64_t) result_init_ok(result_try(failed));
+  }));
+
+  return res;
+}
+
+static void *give_up_in_thread(void *arg) {
+  struct call_s *call = arg;
+
+  call->result = give_up_slowly(call->memo, call->key);
+  return NULL;
+}
+
+static void test_hit_and_miss(void **ts) {
+  memo_u64_t memo;
+  uint64_t key = 42;
+  result_u64_t out;
+
+  assert_true(result_memo_init(&memo, .ok_capacity = 64));
+  calls = 0;
+
+  assert_false(result_memo_get(&memo, &key, &out));
+
+  result_u64_t res = result_memo_call(&memo, &key, compute(key));
+  assert_true(result_is_ok(res));
+  assert_int_equal(420, result_unwrap_unchecked(res));
+  assert_int_equal(1, calls);
+
+  res = result_memo_call(&memo, &key, compute(key));
+  assert_int_equal(420, result_unwrap_unchecked(res));
+  assert_int_equal(1, calls);
+
+  assert_true(result_memo_get(&memo, &key, &out));
+  assert_int_equal(420, result_unwrap_unchecked(out));
+
+  struct result_memo_stats_s stats = result_memo_stats(&memo);
+  assert_int_equal(2, stats.hits);
+  assert_int_equal(1, stats.misses);
+  assert_int_equal(1, stats.ok_len);
+  assert_int_equal(0, stats.err_len);
+
+  result_memo_free(&memo);
+  assert_null(memo.memo);
+}
+
+static void test_errs_are_cached(void **ts) {
+  memo_u64_t memo;
+  uint64_t key = 7;
+
+  assert_true(result_memo_init(&memo, .ok_capacity = 64, .err_capacity = 64));
+  calls = 0;
+
+  for (size_t i = 0; i < 3; i++) {
+    result_u64_t res = result_memo_call(&memo, &key, compute(key));
+
+    assert_true(result_is_err(res));
+    assert_int_equal(7, result_unwrap_err_unchecked(res));
+  }
+
+  assert_int_equal(1, calls);
+
+  struct result_memo_stats_s stats = result_memo_stats(&memo);
+  assert_int_equal(0, stats.ok_len);
+  assert_int_equal(1, stats.err_len);
+
+  result_memo_free(&memo);
+}
+
+static void test_errs_have_own_capacity(void **ts) {
+  memo_u64_t memo;
+
+  assert_true(result_memo_init(
+    &memo,
+    .ok_capacity = 16,
+    .err_capacity = 4,
+    .shards = 1
+  ));
+
+  for (uint64_t key = 0; key < 16; key += 2) {
+    result_memo_call(&memo, &key, compute(key));
+  }
+
+  // a burst of errs only evicts other errs
+  for (uint64_t key = 1; key < 1000; key += 2) {
+    result_memo_call(&memo, &key, compute(key));
+  }
+
+  struct result_memo_stats_s stats = result_memo_stats(&memo);
+  assert_int_equal(8, stats.ok_len);
+  assert_int_equal(4, stats.err_len);
+  assert_int_equal(500 - 4, stats.evictions);
+
+  calls = 0;
+
+  for (uint64_t key = 0; key < 16; key += 2) {
+    result_memo_call(&memo, &key, compute(key));
+  }
+
+  assert_int_equal(0, calls);
+  result_memo_free(&memo);
+}
+
+static void test_zero_capacity(void **ts) {
+  memo_u64_t memo;
+  uint64_t ok_key = 2;
+  uint64_t err_key = 3;
+
+  // errs aren't cached at all
+  assert_true(result_memo_init(&memo, .ok_capacity = 8));
+  calls = 0;
+
+  for (size_t i = 0; i < 3; i++) {
+    result_memo_call(&memo, &ok_key, compute(ok_key));
+    result_memo_call(&memo, &err_key, compute(err_key));
+  }
+
+  assert_int_equal(4, calls);
+  assert_int_equal(0, result_memo_stats(&memo).err_len);
+
+  result_memo_free(&memo);
+}
+
+static void test_ttl(void **ts) {
+  memo_u64_t memo;
+  uint64_t ok_key = 2;
+  uint64_t err_key = 3;
+
+  assert_true(result_memo_init(
+    &memo,
+    .ok_capacity = 8,
+    .err_capacity = 8,
+    .err_ttl_ns = 20 * RESULT_MEMO_SECOND / 1000
+  ));
+
+  calls = 0;
+
+  result_memo_call(&memo, &ok_key, compute(ok_key));
+  result_memo_call(&memo, &err_key, compute(err_key));
+  result_memo_call(&memo, &err_key, compute(err_key));
+  assert_int_equal(2, calls);
+
+  // well past the coarse clock's resolution
+  sleep_ms(60);
+
+  result_memo_call(&memo, &ok_key, compute(ok_key));
+  result_memo_call(&memo, &err_key, compute(err_key));
+  assert_int_equal(3, calls);
+  assert_int_equal(1, result_memo_stats(&memo).expirations);
+
+  result_memo_free(&memo);
+}
+
+static void test_second_chance(void **ts) {
+  memo_u64_t memo;
+  uint64_t hot = 0;
+  result_u64_t out;
+
+  assert_true(result_memo_init(&memo, .ok_capacity = 4, .shards = 1));
+
+  for (uint64_t key = 0; key < 8; key += 2) {
+    result_memo_call(&memo, &key, compute(key));
+  }
+
+  // the hot key is referenced, so the hand skips it once
+  assert_true(result_memo_get(&memo, &hot, &out));
+
+  for (uint64_t key = 100; key < 106; key += 2) {
+    result_memo_call(&memo, &key, compute(key));
+  }
+
+  assert_true(result_memo_get(&memo, &hot, &out));
+  assert_int_equal(0, result_unwrap_unchecked(out));
+  assert_int_equal(3, result_memo_stats(&memo).evictions);
+
+  result_memo_free(&memo);
+}
+
+static void test_forget(void **ts) {
+  memo_u64_t memo;
+  uint64_t key = 4;
+  result_u64_t out;
+
+  assert_true(result_memo_init(&memo, .ok_capacity = 8));
+  calls = 0;
+
+  assert_false(result_memo_forget(&memo, &key));
+
+  result_memo_call(&memo, &key, compute(key));
+  assert_true(result_memo_forget(&memo, &key));
+  assert_false(result_memo_get(&memo, &key, &out));
+
+  result_memo_call(&memo, &key, compute(key));
+  assert_int_equal(2, calls);
+  assert_int_equal(1, result_memo_stats(&memo).ok_len);
+
+  result_memo_free(&memo);
+}
+
+static void test_struct_keys(void **ts) {
+  result_memo_t(struct key_s, result_u64_t) memo;
+  struct key_s a;
+  struct key_s b;
+  result_u64_t out;
+
+  memset(&a, 0, sizeof(a));
+  memset(&b, 0, sizeof(b));
+
+  a.id = b.id = 1;
+  strcpy(a.name, "left");
+  strcpy(b.name, "right");
+
+  assert_true(result_memo_init(&memo, .ok_capacity = 8));
+
+  result_u64_t res = result_memo_call(
+    &memo,
+    &a,
+    (result_u64_t) result_init_ok(100)
+  );
+
+  assert_false(result_memo_get(&memo, &b, &out));
+  assert_true(result_memo_get(&memo, &a, &out));
+
+  // padded results come back byte for byte
+  assert_memory_equal(&res, &out, sizeof(res));
+
+  result_memo_free(&memo);
+}
+
+static void test_single_flight(void **ts) {
+  memo_u64_t memo;
+  pthread_t threads[THREADS];
+  struct call_s calls_in[THREADS];
+
+  assert_true(result_memo_init(&memo, .ok_capacity = 64, .err_capacity = 64));
+
+  for (uint64_t key = 10; key < 12; key++) {
+    calls = 0;
+
+    for (size_t i = 0; i < THREADS; i++) {
+      calls_in[i] = (struct call_s) { .memo = &memo, .key = key };
+
+      assert_int_equal(
+        0,
+        pthread_create(&threads[i], NULL, call_in_thread, &calls_in[i])
+      );
+    }
+
+    for (size_t i = 0; i < THREADS; i++) {
+      assert_int_equal(0, pthread_join(threads[i], NULL));
+
+      assert_memory_equal(
+        &calls_in[0].result,
+        &calls_in[i].result,
+        sizeof(calls_in[0].result)
+      );
+    }
+
+    assert_int_equal(1, calls);
+    assert_true(result_is_ok(calls_in[0].result) == (key % 2 == 0));
+  }
+
+  struct result_memo_stats_s stats = result_memo_stats(&memo);
+  assert_int_equal(2, stats.misses);
+  assert_int_equal(2 * (THREADS - 1), stats.hits);
+
+  result_memo_free(&memo);
+}
+
+static void test_abandoned_flight(void **ts) {
+  memo_u64_t memo;
+  pthread_t first;
+  pthread_t second;
+  uint64_t key = 20;
+  result_u64_t out;
+
+  assert_true(result_memo_init(&memo, .ok_capacity = 64, .err_capacity = 64));
+  calls = 0;
+
+  struct call_s gives_up = { .memo = &memo, .key = key };
+  struct call_s waits = { .memo = &memo, .key = key };
+
+  assert_int_equal(
+    0, pthread_create(&first, NULL, give_up_in_thread, &gives_up)
+  );
+
+  sleep_ms(10);
+  assert_int_equal(0, pthread_create(&second, NULL, call_in_thread, &waits));
+  assert_int_equal(0, pthread_join(first, NULL));
+  assert_int_equal(0, pthread_join(second, NULL));
+
+  // the waiter computed it once the first call gave up
+  assert_int_equal(-1, result_unwrap_err_unchecked(gives_up.result));
+  assert_int_equal(200, result_unwrap_unchecked(waits.result));
+  assert_int_equal(1, calls);
+
+  struct result_memo_stats_s stats = result_memo_stats(&memo);
+  assert_int_equal(2, stats.misses);
+  assert_int_equal(0, stats.hits);
+  assert_int_equal(1, stats.waits);
+
+  assert_true(result_memo_get(&memo, &key, &out));
+  assert_memory_equal(&waits.result, &out, sizeof(out));
+
+  result_memo_free(&memo);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_hit_and_miss),
+    cmocka_unit_test(test_errs_are_cached),
+    cmocka_unit_test(test_errs_have_own_capacity),
+    cmocka_unit_test(test_zero_capacity),
+    cmocka_unit_test(test_ttl),
+    cmocka_unit_test(test_second_chance),
+    cmocka_unit_test(test_forget),
+    cmocka_unit_test(test_struct_keys),
+    cmocka_unit_test(test_single_flight),
+    cmocka_unit_test(test_abandoned_flight),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
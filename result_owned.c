@@ -0,0 +1,303 @@
+#include "result_owned.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SLAB_SIZE ((size_t) 64 * 1024)
+#define MIN_BLOCK 16
+#define CLASSES 7
+#define LARGE CLASSES
+#define LINE 64
+
+_Static_assert(
+  MIN_BLOCK << (CLASSES - 1) == RESULT_OWNED_MAX_BLOCK,
+  "one class per power of two up to RESULT_OWNED_MAX_BLOCK"
+);
+
+// In front of every block, keeps what's after it aligned like malloc(3).
+struct header_s {
+  union {
+    struct {
+      // the pool the block came from, where it goes back to when freed; the
+      // free list link goes over it
+      struct pool_s *owner;
+      uint32_t size_class;
+    };
+
+    // max_align_t is C11
+    long double align_long_double;
+    long long align_long_long;
+    void *align_pointer;
+  };
+};
+
+struct free_block_s {
+  struct free_block_s *next;
+};
+
+struct class_s {
+  struct free_block_s *free;
+
+  // what's left of the newest slab
+  uint8_t *bump;
+  uint8_t *end;
+};
+
+// A thread's blocks. It outlives the thread: when the thread exits, the pool
+// is put on the orphans list for the next thread to take over, with its
+// slabs, free lists and the blocks still out.
+struct pool_s {
+  struct class_s classes[CLASSES];
+  struct result_owned_stats_s stats;
+  struct pool_s *next_orphan;
+
+  // blocks freed by other threads, pushed one at a time with a CAS and taken
+  // all at once by the owner, on a line of their own
+  struct free_block_s *remote __attribute__((aligned(LINE)));
+  size_t remote_frees;
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static void make_key(void);
+static void orphan(void *pool);
+static struct pool_s *adopt(void);
+static unsigned class_of(size_t size);
+static size_t block_size(unsigned size_class);
+static bool take_remote(struct pool_s *pool);
+static bool refill(struct pool_s *pool, unsigned size_class);
+/*sublime-c-static-fn-hoist-end*/
+
+static __thread struct pool_s *self;
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t key;
+static bool key_made;
+
+static pthread_mutex_t orphans_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct pool_s *orphans;
+
+static void make_key(void) {
+  key_made = pthread_key_create(&key, orphan) == 0;
+}
+
+// The key's destructor, when a thread with a pool exits.
+static void orphan(void *pool) {
+  struct pool_s *dead = pool;
+
+  pthread_mutex_lock(&orphans_mutex);
+  dead->next_orphan = orphans;
+  orphans = dead;
+  pthread_mutex_unlock(&orphans_mutex);
+}
+
+// This thread's first allocation: an orphan if there is one, or a new pool.
+static struct pool_s *adopt(void) {
+  pthread_once(&key_once, make_key);
+  pthread_mutex_lock(&orphans_mutex);
+
+  struct pool_s *pool = orphans;
+
+  if (pool) {
+    orphans = pool->next_orphan;
+    pool->next_orphan = NULL;
+  }
+
+  pthread_mutex_unlock(&orphans_mutex);
+
+  if (!pool) {
+    void *memory;
+
+    if (posix_memalign(&memory, LINE, sizeof(*pool)) != 0) {
+      return NULL;
+    }
+
+    pool = memset(memory, 0, sizeof(*pool));
+  }
+
+  // without the key, the pool isn't reused when the thread exits
+  if (key_made) {
+    pthread_setspecific(key, pool);
+  }
+
+  self = pool;
+  return pool;
+}
+
+static unsigned class_of(size_t size) {
+  if (size <= MIN_BLOCK) {
+    return 0;
+  }
+
+  // the smallest power of two that holds `size`, from MIN_BLOCK up
+  unsigned bits = 64u - (unsigned) __builtin_clzll((uint64_t) size - 1);
+  return bits - (unsigned) __builtin_ctz(MIN_BLOCK);
+}
+
+static size_t block_size(unsigned size_class) {
+  return sizeof(struct header_s) + ((size_t) MIN_BLOCK << size_class);
+}
+
+// Moves the blocks other threads freed to the free lists. Returns false if
+// there weren't any.
+static bool take_remote(struct pool_s *pool) {
+  if (!__atomic_load_n(&pool->remote, __ATOMIC_RELAXED)) {
+    return false;
+  }
+
+  struct free_block_s *block = __atomic_exchange_n(
+    &pool->remote,
+    NULL,
+    __ATOMIC_ACQUIRE
+  );
+
+  while (block) {
+    struct free_block_s *next = block->next;
+    struct class_s *class = &pool->classes[
+      ((struct header_s *) block)->size_class
+    ];
+
+    block->next = class->free;
+    class->free = block;
+    block = next;
+  }
+
+  return true;
+}
+
+// Slabs are never freed, a pool's blocks may be anywhere.
+static bool refill(struct pool_s *pool, unsigned size_class) {
+  struct class_s *class = &pool->classes[size_class];
+  uint8_t *slab = malloc(SLAB_SIZE);
+
+  if (!slab) {
+    return false;
+  }
+
+  pool->stats.slabs++;
+  class->bump = slab;
+  class->end = slab + SLAB_SIZE - SLAB_SIZE % block_size(size_class);
+  return true;
+}
+
+void *result_owned_alloc(size_t size) {
+  struct pool_s *pool = self;
+
+  if (w_unlikely(!pool) && !(pool = adopt())) {
+    return NULL;
+  }
+
+  if (w_unlikely(size > RESULT_OWNED_MAX_BLOCK)) {
+    struct header_s *header = malloc(sizeof(*header) + size);
+
+    if (!header) {
+      return NULL;
+    }
+
+    header->owner = pool;
+    header->size_class = LARGE;
+    pool->stats.large++;
+    pool->stats.in_use++;
+    return header + 1;
+  }
+
+  unsigned size_class = class_of(size);
+  struct class_s *class = &pool->classes[size_class];
+  struct header_s *header;
+
+  if (w_unlikely(!class->free)) {
+    take_remote(pool);
+  }
+
+  if (class->free) {
+    header = (struct header_s *) class->free;
+    class->free = class->free->next;
+  } else {
+    if (w_unlikely(class->bump == class->end) && !refill(pool, size_class)) {
+      return NULL;
+    }
+
+    header = (struct header_s *) class->bump;
+    class->bump += block_size(size_class);
+  }
+
+  header->owner = pool;
+  header->size_class = size_class;
+  pool->stats.in_use++;
+  return header + 1;
+}
+
+void result_owned_free(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+
+  struct header_s *header = (struct header_s *) ptr - 1;
+  struct pool_s *owner = header->owner;
+  unsigned size_class = header->size_class;
+
+  if (w_unlikely(owner != self)) {
+    __atomic_fetch_add(&owner->remote_frees, 1, __ATOMIC_RELAXED);
+
+    if (size_class == LARGE) {
+      free(header);
+      return;
+    }
+
+    // back to the owner, which takes it when it runs out of that class
+    struct free_block_s *block = (struct free_block_s *) header;
+
+    block->next = __atomic_load_n(&owner->remote, __ATOMIC_RELAXED);
+
+    while (!__atomic_compare_exchange_n(
+      &owner->remote,
+      &block->next,
+      block,
+      true,
+      __ATOMIC_RELEASE,
+      __ATOMIC_RELAXED
+    )) {}
+
+    return;
+  }
+
+  owner->stats.in_use--;
+
+  if (w_unlikely(size_class == LARGE)) {
+    free(header);
+    return;
+  }
+
+  // the free list link goes over the owner, which is set again on the next
+  // alloc
+  struct free_block_s *block = (struct free_block_s *) header;
+  struct class_s *class = &owner->classes[size_class];
+
+  block->next = class->free;
+  class->free = block;
+}
+
+char *result_owned_strdup(const char *string) {
+  size_t size = strlen(string) + 1;
+  char *copy = result_owned_alloc(size);
+
+  if (copy) {
+    memcpy(copy, string, size);
+  }
+
+  return copy;
+}
+
+struct result_owned_stats_s result_owned_stats(void) {
+  struct result_owned_stats_s stats = { 0 };
+
+  if (self) {
+    stats = self->stats;
+    stats.in_use -= (ptrdiff_t) __atomic_load_n(
+      &self->remote_frees,
+      __ATOMIC_RELAXED
+    );
+  }
+
+  return stats;
+}
@@ -0,0 +1,154 @@
+#ifndef __result_owned_h__
+#define __result_owned_h__
+
+#include <stddef.h>
+
+#include "core/defs.h"
+#include "result.h"
+
+//
+// Results that own their payload and release it when they go out of scope.
+//
+// RESULT_OWNED_DECLARE names the type and says how to release each side,
+// with a function (or macro) that is given a pointer to the payload:
+//
+//   struct parse_error_s {
+//     int line;
+//     w_heap char *detail;
+//   };
+//
+//   static void parse_error_drop(struct parse_error_s *err) {
+//     result_owned_free(err->detail);
+//   }
+//
+//   RESULT_OWNED_DECLARE(
+//     result_doc, struct doc_s *, doc_free,
+//     struct parse_error_s, parse_error_drop
+//   )
+//
+// A variable declared with result_owned() releases whichever side is active
+// when the scope ends, on every path out of it, unless it has been moved out
+// of with result_owned_move() (the whole result) or result_owned_take_ok() /
+// result_owned_take_err() (the payload):
+//
+//   w_move result_doc_t load(const char *path) {
+//     result_owned(result_doc) res = parse(path);
+//
+//     if (result_is_ok(res) && !is_valid(result_unwrap_unchecked(res))) {
+//       // the doc in res is released on the way out
+//       return (result_doc_t) result_init_err(invalid_doc_error());
+//     }
+//
+//     return result_owned_move(res); // the caller owns it now
+//   }
+//
+// The result is result_t with a `moved` flag next to is_ok, so every result.h
+// macro works on it, and a result straight from result_init_ok/err owns its
+// payload. Sides that own nothing take result_owned_no_drop. Like any
+// __attribute__((cleanup)), the release doesn't run on longjmp(3) or thread
+// cancellation, and a copy made with `=` is a second owner: use
+// result_owned_move() instead.
+//
+// result_owned_alloc() and result_owned_free() are for the payloads. Sizes up
+// to RESULT_OWNED_MAX_BLOCK come from per-thread free lists, one per power of
+// two, carved out of 64 KiB slabs, so once a thread has warmed up, creating
+// and releasing an err payload doesn't call malloc(3) or take a lock. A block
+// freed on another thread goes back to the thread it came from, on a list that
+// thread takes over when it runs out of blocks of that size, so a producer
+// whose payloads are released by a consumer reuses them instead of carving new
+// slabs. When a thread exits, its blocks are kept for the next thread that
+// allocates, slabs are never returned to malloc. Bigger sizes go to malloc(3)
+// directly.
+//
+
+#define RESULT_OWNED_MAX_BLOCK 1024
+
+#define result_owned_t(_type, _err_type) \
+  struct result_owned_d(_type, _err_type)
+
+#define result_owned_d(_type, _err_type) { \
+  union { _type ok; _err_type err; } body; \
+  struct { bool is_ok; bool moved; } header; \
+}
+
+#define RESULT_OWNED_DECLARE(_name, _type, _ok_drop, _err_type, _err_drop) \
+  typedef struct _name##_s result_owned_d(_type, _err_type) _name##_t; \
+  \
+  static inline __attribute__((unused)) \
+  void _name##_drop(_name##_t *result) { \
+    if (result->header.moved) { \
+      return; \
+    } \
+    \
+    if (result->header.is_ok) { \
+      _ok_drop(&result->body.ok); \
+    } else { \
+      _err_drop(&result->body.err); \
+    } \
+    \
+    result->header.moved = true; \
+  }
+
+// For sides that don't own anything.
+#define result_owned_no_drop (void)
+
+// A variable of the type declared as `_name` that is released at the end of
+// its scope.
+#define result_owned(_name) \
+  __attribute__((cleanup(_name##_drop))) _name##_t
+
+// Releases now, eg. before reusing the variable.
+#define result_owned_drop(_name, _result) \
+  _name##_drop(&(_result))
+
+// The result, which the variable no longer owns.
+#define result_owned_move(_result) ({ \
+  __typeof(_result) *result_owned_self = &(_result); \
+  __typeof(_result) result_owned_moved = *result_owned_self; \
+  \
+  result_owned_self->header.moved = true; \
+  result_owned_moved; \
+})
+
+// The ok or err payload, which the variable no longer owns. Doesn't check
+// which side is active.
+#define result_owned_take_ok(_result) ({ \
+  __typeof(_result) *result_owned_self = &(_result); \
+  \
+  result_owned_self->header.moved = true; \
+  result_owned_self->body.ok; \
+})
+
+#define result_owned_take_err(_result) ({ \
+  __typeof(_result) *result_owned_self = &(_result); \
+  \
+  result_owned_self->header.moved = true; \
+  result_owned_self->body.err; \
+})
+
+struct result_owned_stats_s {
+  // malloc(3) calls for slabs, and for blocks too big for a slab
+  size_t slabs;
+  size_t large;
+
+  // blocks this thread handed out and not freed yet, on any thread
+  ptrdiff_t in_use;
+};
+
+// Aligned like malloc(3). NULL when out of memory.
+extern w_move void *result_owned_alloc(size_t size);
+
+// Anything from result_owned_alloc(), on any thread, or NULL.
+extern void result_owned_free(w_move void *ptr);
+
+#define result_owned_new(_type) \
+  ((_type *) result_owned_alloc(sizeof(_type)))
+
+// A copy of `string` in a block, eg. for an error message.
+extern w_move char *result_owned_strdup(const char *string);
+
+// This thread's counters, all zeros before its first allocation. A thread
+// that takes over the blocks of one that exited carries on with its counters.
+extern struct result_owned_stats_s result_owned_stats(void);
+
+#endif // __result_owned_h__
@@ -0,0 +1,429 @@
+#include "core/defs.h"
+#include "result_owned.h"
+
+#include <pthread.h>
+
+struct error_s {
+  int code;
+  w_heap char *detail;
+};
+
+struct counted_s {
+  int value;
+};
+
+static void error_drop(struct error_s *err);
+static void counted_drop(struct counted_s **ok);
+
+RESULT_OWNED_DECLARE(
+  result_counted, struct counted_s *, counted_drop,
+  struct error_s, error_drop
+)
+
+RESULT_OWNED_DECLARE(
+  result_plain, int, result_owned_no_drop,
+  struct error_s, error_drop
+)
+
+/*sublime-c-static-fn-hoist-start*/
+static struct counted_s *counted_new(int value);
+static result_counted_t make_ok(int value);
+static result_counted_t make_err(int code);
+static void reset_drops(void);
+static void test_drop_ok_on_scope_exit(void **ts);
+static void test_drop_err_on_scope_exit(void **ts);
+static int early_return(bool fail);
+static void test_drop_on_every_return(void **ts);
+static result_counted_t pass_through(bool fail);
+static void test_move(void **ts);
+static void test_take(void **ts);
+static void test_drop_now(void **ts);
+static void test_no_drop(void **ts);
+static void test_result_macros(void **ts);
+static void test_alloc_reuses_blocks(void **ts);
+static void test_alloc_sizes(void **ts);
+static void test_alloc_large(void **ts);
+static void test_strdup(void **ts);
+static void *free_on_thread(void *arg);
+static void test_free_on_other_thread(void **ts);
+static void *free_all_on_thread(void *arg);
+static void test_producer_consumer(void **ts);
+static void *alloc_on_thread(void *arg);
+static void test_thread_exit(void **ts);
+static void test_no_malloc_after_warmup(void **ts);
+/*sublime-c-static-fn-hoist-end*/
+
+static int ok_drops;
+static int err_drops;
+
+static void error_drop(struct error_s *err) {
+  result_owned_free(err->detail);
+  err_drops++;
+}
+
+static void counted_drop(struct counted_s **ok) {
+  result_owned_free(*ok);
+  ok_drops++;
+}
+
+static struct counted_s *counted_new(int value) {
+  struct counted_s *counted = result_owned_new(struct counted_s);
+
+  counted->value = value;
+  return counted;
+}
+
+static result_counted_t make_ok(int value) {
+  return (result_counted_t) result_init_ok(counted_new(value));
+}
+
+static result_counted_t make_err(int code) {
+  return (result_counted_t) result_init_err(((struct error_s) {
+    .code = code,
+    .detail = result_owned_strdup("it broke"),
+  }));
+}
+
+static void reset_drops(void) {
+  ok_drops = 0;
+  err_drops = 0;
+}
+
+static void test_drop_ok_on_scope_exit(void **ts) {
+  reset_drops();
+
+  {
+    result_owned(result_counted) res = make_ok(1);
+    assert_int_equal(1, result_unwrap_unchecked(res)->value);
+  }
+
+  assert_int_equal(1, ok_drops);
+  assert_int_equal(0, err_drops);
+  assert_int_equal(0, result_owned_stats().in_use);
+}
+
+static void test_drop_err_on_scope_exit(void **ts) {
+  reset_drops();
+
+  {
+    result_owned(result_counted) res = make_err(5);
+    assert_int_equal(5, result_unwrap_err_unchecked(res).code);
+  }
+
+  assert_int_equal(0, ok_drops);
+  assert_int_equal(1, err_drops);
+  assert_int_equal(0, result_owned_stats().in_use);
+}
+
+static int early_return(bool fail) {
+  result_owned(result_counted) res = fail ? make_err(1) : make_ok(2);
+
+  if (result_is_err(res)) {
+    return -1;
+  }
+
+  for (int i = 0; i < 10; i++) {
+    if (i == 3) {
+      return result_unwrap_unchecked(res)->value;
+    }
+  }
+
+  return 0;
+}
+
+static void test_drop_on_every_return(void **ts) {
+  reset_drops();
+
+  assert_int_equal(-1, early_return(true));
+  assert_int_equal(2, early_return(false));
+
+  assert_int_equal(1, ok_drops);
+  assert_int_equal(1, err_drops);
+  assert_int_equal(0, result_owned_stats().in_use);
+}
+
+static result_counted_t pass_through(bool fail) {
+  result_owned(result_counted) res = fail ? make_err(7) : make_ok(8);
+  return result_owned_move(res);
+}
+
+static void test_move(void **ts) {
+  reset_drops();
+
+  {
+    result_owned(result_counted) res = pass_through(true);
+
+    // not dropped by pass_through
+    assert_int_equal(0, err_drops);
+    assert_false(res.header.moved);
+    assert_int_equal(7, result_unwrap_err_unchecked(res).code);
+    assert_string_equal("it broke", result_unwrap_err_unchecked(res).detail);
+  }
+
+  assert_int_equal(1, err_drops);
+
+  {
+    result_owned(result_counted) res = pass_through(false);
+    assert_int_equal(8, result_unwrap_unchecked(res)->value);
+  }
+
+  assert_int_equal(1, ok_drops);
+  assert_int_equal(0, result_owned_stats().in_use);
+}
+
+static void test_take(void **ts) {
+  struct counted_s *counted;
+  struct error_s err;
+
+  reset_drops();
+
+  {
+    result_owned(result_counted) res = make_ok(3);
+    counted = result_owned_take_ok(res);
+  }
+
+  {
+    result_owned(result_counted) res = make_err(4);
+    err = result_owned_take_err(res);
+  }
+
+  assert_int_equal(0, ok_drops);
+  assert_int_equal(0, err_drops);
+  assert_int_equal(3, counted->value);
+  assert_int_equal(4, err.code);
+
+  // the caller owns them now
+  assert_int_equal(2, result_owned_stats().in_use);
+  counted_drop(&counted);
+  error_drop(&err);
+  assert_int_equal(0, result_owned_stats().in_use);
+}
+
+static void test_drop_now(void **ts) {
+  reset_drops();
+
+  {
+    result_owned(result_counted) res = make_ok(1);
+
+    result_owned_drop(result_counted, res);
+    assert_int_equal(1, ok_drops);
+
+    // and only once
+    result_owned_drop(result_counted, res);
+    assert_int_equal(1, ok_drops);
+
+    res = make_err(2);
+  }
+
+  assert_int_equal(1, ok_drops);
+  assert_int_equal(1, err_drops);
+}
+
+static void test_no_drop(void **ts) {
+  reset_drops();
+
+  {
+    result_owned(result_plain) res = result_init_ok(1);
+    assert_int_equal(1, result_unwrap_unchecked(res));
+  }
+
+  assert_int_equal(0, err_drops);
+
+  {
+    result_owned(result_plain) res = result_init_err(((struct error_s) {
+      .detail = result_owned_strdup("x"),
+    }));
+
+    assert_true(result_is_err(res));
+  }
+
+  assert_int_equal(1, err_drops);
+  assert_int_equal(0, result_owned_stats().in_use);
+}
+
+static void test_result_macros(void **ts) {
+  result_owned(result_plain) res = result_init_ok(5);
+
+  assert_true(result_is_ok(res));
+  assert_int_equal(5, result_unwrap_or(res, 0));
+
+  result_with_ok(res, value) {
+    assert_int_equal(5, value);
+  }
+}
+
+static void test_alloc_reuses_blocks(void **ts) {
+  void *a = result_owned_alloc(24);
+  void *b = result_owned_alloc(24);
+
+  assert_ptr_not_equal(a, b);
+
+  result_owned_free(a);
+  assert_ptr_equal(a, result_owned_alloc(20));
+
+  result_owned_free(b);
+  result_owned_free(a);
+  result_owned_free(NULL);
+  assert_int_equal(0, result_owned_stats().in_use);
+}
+
+static void test_alloc_sizes(void **ts) {
+  void *blocks[RESULT_OWNED_MAX_BLOCK + 1];
+
+  for (size_t size = 0; size <= RESULT_OWNED_MAX_BLOCK; size++) {
+    blocks[size] = result_owned_alloc(size);
+
+    assert_non_null(blocks[size]);
+    assert_int_equal(0, (uintptr_t) blocks[size] % 16);
+
+    // all of it is usable
+    memset(blocks[size], 0xaa, size);
+  }
+
+  for (size_t size = 0; size <= RESULT_OWNED_MAX_BLOCK; size++) {
+    result_owned_free(blocks[size]);
+  }
+
+  assert_int_equal(0, result_owned_stats().in_use);
+}
+
+static void test_alloc_large(void **ts) {
+  size_t large = result_owned_stats().large;
+  char *big = result_owned_alloc(RESULT_OWNED_MAX_BLOCK + 1);
+
+  memset(big, 0, RESULT_OWNED_MAX_BLOCK + 1);
+  assert_int_equal(large + 1, result_owned_stats().large);
+
+  result_owned_free(big);
+  assert_int_equal(0, result_owned_stats().in_use);
+}
+
+static void test_strdup(void **ts) {
+  char *copy = result_owned_strdup("hello");
+
+  assert_string_equal("hello", copy);
+  result_owned_free(copy);
+}
+
+static void *free_on_thread(void *arg) {
+  result_owned_free(arg);
+  return (void *) (intptr_t) result_owned_stats().in_use;
+}
+
+static void test_free_on_other_thread(void **ts) {
+  pthread_t thread;
+  void *in_use;
+  void *block = result_owned_alloc(64);
+
+  assert_int_equal(0, pthread_create(&thread, NULL, free_on_thread, block));
+  assert_int_equal(0, pthread_join(thread, &in_use));
+
+  // counted where it came from
+  assert_int_equal(0, (intptr_t) in_use);
+  assert_int_equal(0, result_owned_stats().in_use);
+}
+
+#define BATCH 4096
+
+static void *free_all_on_thread(void *arg) {
+  void **blocks = arg;
+
+  for (int i = 0; i < BATCH; i++) {
+    result_owned_free(blocks[i]);
+  }
+
+  return NULL;
+}
+
+static void test_producer_consumer(void **ts) {
+  static void *blocks[BATCH];
+  size_t slabs = 0;
+
+  for (int round = 0; round < 8; round++) {
+    pthread_t thread;
+
+    for (int i = 0; i < BATCH; i++) {
+      blocks[i] = result_owned_alloc(100);
+    }
+
+    assert_int_equal(0, pthread_create(
+      &thread, NULL, free_all_on_thread, blocks
+    ));
+
+    assert_int_equal(0, pthread_join(thread, NULL));
+    assert_int_equal(0, result_owned_stats().in_use);
+
+    // the consumer's frees are reused, no new slabs for the next batch
+    if (round == 0) {
+      slabs = result_owned_stats().slabs;
+    } else {
+      assert_int_equal(slabs, result_owned_stats().slabs);
+    }
+  }
+}
+
+static void *alloc_on_thread(void *arg) {
+  void *block = result_owned_alloc(200);
+
+  (void) arg;
+  result_owned_free(block);
+  return block;
+}
+
+static void test_thread_exit(void **ts) {
+  pthread_t thread;
+  void *first;
+  void *second;
+
+  assert_int_equal(0, pthread_create(&thread, NULL, alloc_on_thread, NULL));
+  assert_int_equal(0, pthread_join(thread, &first));
+
+  // the second thread takes over the blocks of the first
+  assert_int_equal(0, pthread_create(&thread, NULL, alloc_on_thread, NULL));
+  assert_int_equal(0, pthread_join(thread, &second));
+
+  assert_ptr_equal(first, second);
+}
+
+static void test_no_malloc_after_warmup(void **ts) {
+  for (int i = 0; i < 16; i++) {
+    result_owned(result_counted) res = make_err(i);
+    (void) res;
+  }
+
+  struct result_owned_stats_s before = result_owned_stats();
+
+  for (int i = 0; i < 100000; i++) {
+    result_owned(result_counted) res = i % 2 ? make_err(i) : make_ok(i);
+    (void) res;
+  }
+
+  struct result_owned_stats_s after = result_owned_stats();
+
+  assert_int_equal(before.slabs, after.slabs);
+  assert_int_equal(before.large, after.large);
+  assert_int_equal(before.in_use, after.in_use);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_drop_ok_on_scope_exit),
+    cmocka_unit_test(test_drop_err_on_scope_exit),
+    cmocka_unit_test(test_drop_on_every_return),
+    cmocka_unit_test(test_move),
+    cmocka_unit_test(test_take),
+    cmocka_unit_test(test_drop_now),
+    cmocka_unit_test(test_no_drop),
+    cmocka_unit_test(test_result_macros),
+    cmocka_unit_test(test_alloc_reuses_blocks),
+    cmocka_unit_test(test_alloc_sizes),
+    cmocka_unit_test(test_alloc_large),
+    cmocka_unit_test(test_strdup),
+    cmocka_unit_test(test_free_on_other_thread),
+    cmocka_unit_test(test_producer_consumer),
+    cmocka_unit_test(test_thread_exit),
+    cmocka_unit_test(test_no_malloc_after_warmup),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
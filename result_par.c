@@ -0,0 +1,423 @@
+#include "result_par.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define LINE 64
+#define CHUNKS_PER_THREAD 16
+#define MIN_CHUNK 256
+
+// A share of chunks [next, end), packed into one word so that the owner and
+// the thieves can both update it with a single CAS.
+struct share_s {
+  uint64_t range __attribute__((aligned(LINE)));
+};
+
+struct job_s {
+  result_par_kernel_fn kernel;
+  const void *in;
+  void *out;
+  size_t n;
+  bool stop_at_err;
+
+  // chunk c is [chunk_begin(c), chunk_begin(c + 1)), all but the first one
+  // start at a multiple of `chunk` past `aligned`
+  size_t aligned;
+  size_t chunk;
+  size_t chunks;
+
+  struct share_s *shares;
+  size_t participants;
+
+  size_t first_err __attribute__((aligned(LINE)));
+  size_t errs;
+};
+
+struct pool_s {
+  pthread_mutex_t mutex;
+  pthread_cond_t work;
+  pthread_cond_t done;
+
+  pthread_t *threads;
+  struct share_s *shares;
+  size_t workers;
+  size_t requested;
+  bool started;
+  bool stopping;
+
+  // bumped for every job, workers run the job when it changes
+  uint64_t generation;
+  uint64_t started_at;
+  struct job_s *job;
+  size_t active;
+  bool busy;
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static uint64_t pack(uint64_t next, uint64_t end);
+static size_t chunk_begin(const struct job_s *job, uint64_t chunk);
+static void plan(struct job_s *job, size_t out_size);
+static bool take(struct job_s *job, size_t self, uint64_t *chunk);
+static bool steal(struct job_s *job, size_t self, uint64_t *chunk);
+static void run(struct job_s *job, size_t self);
+static void *work(void *arg);
+static bool start(void);
+static bool claim(struct job_s *job);
+/*sublime-c-static-fn-hoist-end*/
+
+static struct pool_s pool = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .work = PTHREAD_COND_INITIALIZER,
+  .done = PTHREAD_COND_INITIALIZER,
+};
+
+// Set on pool threads, and on the caller while it helps with its job, so that
+// maps from inside a kernel don't wait for the pool they're running on.
+static __thread bool in_pool;
+
+static uint64_t pack(uint64_t next, uint64_t end) {
+  return next | (end << 32);
+}
+
+static size_t chunk_begin(const struct job_s *job, uint64_t chunk) {
+  if (chunk == 0) {
+    return 0;
+  }
+
+  return w_min_2(job->n, job->aligned + chunk * job->chunk);
+}
+
+static void plan(struct job_s *job, size_t out_size) {
+  // chunk boundaries at multiples of `step` results past `aligned` are at the
+  // start of a cache line
+  size_t step = LINE;
+
+  while (step > 1 && (out_size * (step / 2)) % LINE == 0) {
+    step /= 2;
+  }
+
+  job->aligned = 0;
+
+  for (size_t i = 0; i < step; i++) {
+    if (((uintptr_t) job->out + i * out_size) % LINE == 0) {
+      job->aligned = i;
+      break;
+    }
+  }
+
+  size_t target = job->n / (job->participants * CHUNKS_PER_THREAD) + 1;
+  size_t chunk = w_max_2(target, (size_t) MIN_CHUNK);
+
+  job->chunk = (chunk + step - 1) / step * step;
+
+  job->chunks = job->n <= job->aligned
+    ? 1
+    : (job->n - job->aligned + job->chunk - 1) / job->chunk;
+
+  for (size_t p = 0; p < job->participants; p++) {
+    uint64_t next = job->chunks * p / job->participants;
+    uint64_t end = job->chunks * (p + 1) / job->participants;
+
+    __atomic_store_n(&job->shares[p].range, pack(next, end), __ATOMIC_RELAXED);
+  }
+}
+
+static bool take(struct job_s *job, size_t self, uint64_t *chunk) {
+  uint64_t *range = &job->shares[self].range;
+  uint64_t current = __atomic_load_n(range, __ATOMIC_ACQUIRE);
+
+  for (;;) {
+    uint64_t next = current & UINT32_MAX;
+    uint64_t end = current >> 32;
+
+    if (next >= end) {
+      return false;
+    }
+
+    if (__atomic_compare_exchange_n(
+      range,
+      &current,
+      pack(next + 1, end),
+      true,
+      __ATOMIC_ACQ_REL,
+      __ATOMIC_ACQUIRE
+    )) {
+      *chunk = next;
+      return true;
+    }
+  }
+}
+
+// Takes the back half of the first share that isn't empty, keeps one chunk
+// and makes the rest its own share.
+static bool steal(struct job_s *job, size_t self, uint64_t *chunk) {
+  for (size_t i = 1; i < job->participants; i++) {
+    uint64_t *range = &job->shares[(self + i) % job->participants].range;
+    uint64_t current = __atomic_load_n(range, __ATOMIC_ACQUIRE);
+
+    for (;;) {
+      uint64_t next = current & UINT32_MAX;
+      uint64_t end = current >> 32;
+
+      if (next >= end) {
+        break;
+      }
+
+      uint64_t stolen = (end - next + 1) / 2;
+
+      if (__atomic_compare_exchange_n(
+        range,
+        &current,
+        pack(next, end - stolen),
+        true,
+        __ATOMIC_ACQ_REL,
+        __ATOMIC_ACQUIRE
+      )) {
+        *chunk = end - stolen;
+
+        __atomic_store_n(
+          &job->shares[self].range,
+          pack(end - stolen + 1, end),
+          __ATOMIC_RELEASE
+        );
+
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+static void run(struct job_s *job, size_t self) {
+  size_t errs = 0;
+  uint64_t chunk;
+
+  while (take(job, self, &chunk) || steal(job, self, &chunk)) {
+    size_t begin = chunk_begin(job, chunk);
+    size_t end = chunk_begin(job, chunk + 1);
+
+    // there's an earlier err already, the chunk wouldn't change the outcome
+    if (
+      job->stop_at_err
+      && begin > __atomic_load_n(&job->first_err, __ATOMIC_RELAXED)
+    ) {
+      continue;
+    }
+
+    size_t first_err = job->kernel(
+      job->in,
+      job->out,
+      begin,
+      end,
+      job->stop_at_err,
+      &errs
+    );
+
+    if (first_err < end) {
+      size_t current = __atomic_load_n(&job->first_err, __ATOMIC_RELAXED);
+
+      while (first_err < current && !__atomic_compare_exchange_n(
+        &job->first_err,
+        &current,
+        first_err,
+        true,
+        __ATOMIC_RELAXED,
+        __ATOMIC_RELAXED
+      )) {}
+    }
+  }
+
+  if (errs > 0) {
+    __atomic_fetch_add(&job->errs, errs, __ATOMIC_RELAXED);
+  }
+}
+
+static void *work(void *arg) {
+  size_t self = (size_t) (uintptr_t) arg;
+
+  in_pool = true;
+  pthread_mutex_lock(&pool.mutex);
+
+  uint64_t seen = pool.started_at;
+
+  for (;;) {
+    while (!pool.stopping && pool.generation == seen) {
+      pthread_cond_wait(&pool.work, &pool.mutex);
+    }
+
+    if (pool.stopping) {
+      break;
+    }
+
+    seen = pool.generation;
+    struct job_s *job = pool.job;
+
+    pthread_mutex_unlock(&pool.mutex);
+    run(job, self);
+    pthread_mutex_lock(&pool.mutex);
+
+    if (--pool.active == 0) {
+      pthread_cond_signal(&pool.done);
+    }
+  }
+
+  pthread_mutex_unlock(&pool.mutex);
+  return NULL;
+}
+
+// Called with the mutex held.
+static bool start(void) {
+  size_t threads = pool.requested;
+
+  if (threads == 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = online > 0 ? (size_t) online : 1;
+  }
+
+  pool.started = true;
+  pool.started_at = pool.generation;
+  pool.workers = 0;
+  pool.threads = calloc(threads, sizeof(*pool.threads));
+  pool.shares = aligned_alloc(LINE, threads * sizeof(*pool.shares));
+
+  // runs everything on the calling threads until the next restart
+  if (!pool.threads || !pool.shares) {
+    free(pool.threads);
+    free(pool.shares);
+
+    pool.threads = NULL;
+    pool.shares = NULL;
+    return false;
+  }
+
+  for (size_t i = 1; i < threads; i++) {
+    int status = pthread_create(
+      &pool.threads[pool.workers],
+      NULL,
+      work,
+      (void *) (uintptr_t) i
+    );
+
+    if (status != 0) {
+      break;
+    }
+
+    pool.workers++;
+  }
+
+  return true;
+}
+
+// Hands the job to the pool, unless the pool is already busy with another one
+// or there's no pool.
+static bool claim(struct job_s *job) {
+  pthread_mutex_lock(&pool.mutex);
+
+  if (!pool.started) {
+    start();
+  }
+
+  if (pool.busy || pool.workers == 0) {
+    pthread_mutex_unlock(&pool.mutex);
+    return false;
+  }
+
+  pool.busy = true;
+  job->shares = pool.shares;
+  job->participants = pool.workers + 1;
+
+  pthread_mutex_unlock(&pool.mutex);
+  return true;
+}
+
+struct result_par_s result_par_map_raw(
+  result_par_kernel_fn kernel,
+  const void *in,
+  void *out,
+  size_t n,
+  size_t out_size,
+  enum result_par_mode_e mode
+) {
+  struct job_s job = {
+    .kernel = kernel,
+    .in = in,
+    .out = out,
+    .n = n,
+    .stop_at_err = mode == RESULT_PAR_FIRST_ERR,
+    .first_err = n,
+  };
+
+  if (n < 2 * MIN_CHUNK || in_pool || !claim(&job)) {
+    job.first_err = kernel(in, out, 0, n, job.stop_at_err, &job.errs);
+
+    return (struct result_par_s) {
+      .first_err = job.first_err,
+      .errs = job.errs,
+    };
+  }
+
+  plan(&job, out_size);
+
+  pthread_mutex_lock(&pool.mutex);
+  pool.job = &job;
+  pool.active = pool.workers;
+  pool.generation++;
+  pthread_cond_broadcast(&pool.work);
+  pthread_mutex_unlock(&pool.mutex);
+
+  in_pool = true;
+  run(&job, 0);
+  in_pool = false;
+
+  pthread_mutex_lock(&pool.mutex);
+
+  while (pool.active > 0) {
+    pthread_cond_wait(&pool.done, &pool.mutex);
+  }
+
+  pool.job = NULL;
+  pool.busy = false;
+  pthread_mutex_unlock(&pool.mutex);
+
+  return (struct result_par_s) {
+    .first_err = job.first_err,
+    .errs = job.errs,
+  };
+}
+
+size_t result_par_threads(void) {
+  pthread_mutex_lock(&pool.mutex);
+
+  if (!pool.started) {
+    start();
+  }
+
+  size_t threads = pool.workers + 1;
+  pthread_mutex_unlock(&pool.mutex);
+
+  return threads;
+}
+
+void result_par_restart(size_t threads) {
+  pthread_mutex_lock(&pool.mutex);
+  pool.stopping = true;
+  pthread_cond_broadcast(&pool.work);
+  pthread_mutex_unlock(&pool.mutex);
+
+  for (size_t i = 0; i < pool.workers; i++) {
+    pthread_join(pool.threads[i], NULL);
+  }
+
+  pthread_mutex_lock(&pool.mutex);
+  free(pool.threads);
+  free(pool.shares);
+
+  pool.threads = NULL;
+  pool.shares = NULL;
+  pool.workers = 0;
+  pool.requested = threads;
+  pool.started = false;
+  pool.stopping = false;
+  pthread_mutex_unlock(&pool.mutex);
+}
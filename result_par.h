@@ -0,0 +1,154 @@
+#ifndef __result_par_h__
+#define __result_par_h__
+
+#include "core/defs.h"
+#include "result.h"
+
+//
+// Parallel map of a result-returning function over an array.
+//
+//   typedef result_t(int64_t, int) result_i64_t;
+//   result_i64_t parse(const char *text);
+//
+//   // at file scope, once per function and element type
+//   result_par_kernel(parse_all, parse, const char *, result_i64_t)
+//
+//   struct result_par_s par = result_par_map(
+//     texts, out, n, parse_all, RESULT_PAR_FIRST_ERR
+//   );
+//
+//   if (par.first_err < n) {
+//     // out[par.first_err] is the err, just like a sequential loop would
+//     // have stopped at
+//   }
+//
+// Modes:
+//
+//   - RESULT_PAR_FIRST_ERR: stops at the err with the lowest index. Chunks
+//     past an err that has been found are skipped, so the work is cancelled
+//     promptly, but chunks before it still run because they could contain an
+//     earlier err. Slots after `first_err` are unspecified.
+//   - RESULT_PAR_COLLECT_ALL: maps every element. `errs` is the number of
+//     errs, `first_err` the index of the first one.
+//
+// The array is cut into chunks and each thread starts with an equal share of
+// them. A thread takes chunks from the front of its share and, once it's out
+// of work, steals the back half of another thread's remaining share. Chunk
+// boundaries fall on cache line boundaries of `_out`, so two threads never
+// write to the same cache line of results.
+//
+// The pool is started on first use with one thread per online CPU (the
+// calling thread is one of them). Calls from inside a kernel, and calls made
+// while another thread's map is running, run on the calling thread alone.
+//
+
+enum result_par_mode_e {
+  RESULT_PAR_FIRST_ERR,
+  RESULT_PAR_COLLECT_ALL,
+};
+
+struct result_par_s {
+  // index of the first err, or n if there's none
+  size_t first_err;
+
+  // number of errs, only exact with RESULT_PAR_COLLECT_ALL
+  size_t errs;
+};
+
+// Maps `in[begin, end)` to `out[begin, end)`. Returns the index of the first
+// err, or `end`, and adds the number of errs to `*errs`. With `stop_at_err`,
+// it stops right after the first err.
+typedef size_t (*result_par_kernel_fn)(
+  const void *in,
+  void *out,
+  size_t begin,
+  size_t end,
+  bool stop_at_err,
+  size_t *errs
+);
+
+// Defines a kernel called `_name` that stores `_fn(in[i])` to `out[i]`, where
+// `in` is an array of `_in_type` and `out` an array of `_result_type`.
+#define result_par_kernel(_name, _fn, _in_type, _result_type) \
+  static __attribute__((unused)) const struct { \
+    _in_type in; \
+    _result_type out; \
+  } *const _name##_types = NULL; \
+  \
+  static size_t _name( \
+    const void *result_par_in, \
+    void *result_par_out, \
+    size_t result_par_begin, \
+    size_t result_par_end, \
+    bool result_par_stop_at_err, \
+    size_t *result_par_errs \
+  ) { \
+    __typeof(_in_type) const *result_par_typed_in = result_par_in; \
+    _result_type *result_par_typed_out = result_par_out; \
+    size_t result_par_first_err = result_par_end; \
+    \
+    for ( \
+      size_t result_par_i = result_par_begin; \
+      result_par_i < result_par_end; \
+      result_par_i++ \
+    ) { \
+      result_par_typed_out[result_par_i] = \
+        _fn(result_par_typed_in[result_par_i]); \
+      \
+      if (w_unlikely(!result_is_ok(result_par_typed_out[result_par_i]))) { \
+        result_par_first_err = w_min_2(result_par_first_err, result_par_i); \
+        ++*result_par_errs; \
+        \
+        if (result_par_stop_at_err) { \
+          break; \
+        } \
+      } \
+    } \
+    \
+    return result_par_first_err; \
+  }
+
+#define result_par_map(_in, _out, _n, _kernel, _mode) ({ \
+  __typeof(&*(_in)) result_par_in = (_in); \
+  __typeof(&*(_out)) result_par_out = (_out); \
+  \
+  _Static_assert( \
+    __builtin_types_compatible_p( \
+      __typeof(*result_par_in), \
+      __typeof(_kernel##_types->in) \
+    ) \
+    && __builtin_types_compatible_p( \
+      __typeof(*result_par_out), \
+      __typeof(_kernel##_types->out) \
+    ), \
+    "the arrays don't match the types of the kernel" \
+  ); \
+  \
+  result_par_map_raw( \
+    _kernel, \
+    result_par_in, \
+    result_par_out, \
+    (_n), \
+    sizeof(*result_par_out), \
+    (_mode) \
+  ); \
+})
+
+extern struct result_par_s result_par_map_raw(
+  result_par_kernel_fn kernel,
+  const void *in,
+  void *out,
+  size_t n,
+  size_t out_size,
+  enum result_par_mode_e mode
+);
+
+// Number of threads (including the caller) a map runs on.
+extern size_t result_par_threads(void);
+
+// Stops the pool. The next map starts it again with `threads` threads, or
+// one per online CPU if `threads` is 0. Must not be called while a map is
+// running.
+extern void result_par_restart(size_t threads);
+
+#endif // __result_par_h__
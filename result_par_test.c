@@ -0,0 +1,312 @@
+#include "core/defs.h"
+#include "result_par.h"
+
+#include <pthread.h>
+
+typedef result_t(int64_t, int) result_i64_t;
+
+/*sublime-c-static-fn-hoist-start*/
+static result_i64_t square(int32_t value);
+static result_i64_t sum_below(int32_t value);
+static void fill(int32_t *in, size_t n);
+static void check_squares(const int32_t *in, const result_i64_t *out, size_t n);
+static void *map_in_thread(void *arg);
+static void test_threads(void **ts);
+static void test_empty(void **ts);
+static void test_small(void **ts);
+static void test_collect_all(void **ts);
+static void test_collect_all_errs(void **ts);
+static void test_first_err(void **ts);
+static void test_first_err_is_lowest(void **ts);
+static void test_unaligned_out(void **ts);
+static void test_nested(void **ts);
+static void test_concurrent_callers(void **ts);
+/*sublime-c-static-fn-hoist-end*/
+
+#define THREADS 4
+#define LARGE 200003
+
+// Negative values are errs.
+static result_i64_t square(int32_t value) {
+  if (value < 0) {
+    return (result_i64_t) result_init_err(value);
+  }
+
+  return (result_i64_t) result_init_ok((int64_t) value * value);
+}
+
+result_par_kernel(square_all, square, int32_t, result_i64_t)
+
+// Maps again, from inside a kernel.
+static result_i64_t sum_below(int32_t value) {
+  int32_t in[1024];
+  result_i64_t out[1024];
+  int64_t sum = 0;
+
+  for (int32_t i = 0; i < 1024; i++) {
+    in[i] = i < value ? i : 0;
+  }
+
+  struct result_par_s par = result_par_map(
+    in, out, w_array_size(in), square_all, RESULT_PAR_COLLECT_ALL
+  );
+
+  if (par.errs > 0) {
+    return (result_i64_t) result_init_err(-1);
+  }
+
+  for (size_t i = 0; i < w_array_size(out); i++) {
+    sum += result_unwrap_unchecked(out[i]);
+  }
+
+  return (result_i64_t) result_init_ok(sum);
+}
+
+result_par_kernel(sum_below_all, sum_below, int32_t, result_i64_t)
+
+static void fill(int32_t *in, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    in[i] = (int32_t) (i % 46000);
+  }
+}
+
+static void check_squares(
+  const int32_t *in,
+  const result_i64_t *out,
+  size_t n
+) {
+  for (size_t i = 0; i < n; i++) {
+    if (in[i] < 0) {
+      assert_true(result_is_err(out[i]));
+      assert_int_equal(in[i], result_unwrap_err_unchecked(out[i]));
+    } else {
+      assert_true(result_is_ok(out[i]));
+      assert_true(
+        (int64_t) in[i] * in[i] == result_unwrap_unchecked(out[i])
+      );
+    }
+  }
+}
+
+static void *map_in_thread(void *arg) {
+  int32_t *in = arg;
+  result_i64_t *out = calloc(LARGE, sizeof(*out));
+
+  struct result_par_s par = result_par_map(
+    in, out, LARGE, square_all, RESULT_PAR_COLLECT_ALL
+  );
+
+  check_squares(in, out, LARGE);
+  free(out);
+
+  return (void *) (uintptr_t) par.errs;
+}
+
+static void test_threads(void **ts) {
+  assert_int_equal(THREADS, result_par_threads());
+}
+
+static void test_empty(void **ts) {
+  int32_t in[1] = { 0 };
+  result_i64_t out[1];
+
+  struct result_par_s par = result_par_map(
+    in, out, 0, square_all, RESULT_PAR_FIRST_ERR
+  );
+
+  assert_int_equal(0, par.first_err);
+  assert_int_equal(0, par.errs);
+}
+
+static void test_small(void **ts) {
+  int32_t in[] = { 1, 2, -3, 4, -5 };
+  result_i64_t out[w_array_size(in)];
+
+  struct result_par_s par = result_par_map(
+    in, out, w_array_size(in), square_all, RESULT_PAR_COLLECT_ALL
+  );
+
+  assert_int_equal(2, par.first_err);
+  assert_int_equal(2, par.errs);
+  check_squares(in, out, w_array_size(in));
+
+  par = result_par_map(
+    in, out, w_array_size(in), square_all, RESULT_PAR_FIRST_ERR
+  );
+
+  assert_int_equal(2, par.first_err);
+  assert_int_equal(1, par.errs);
+}
+
+static void test_collect_all(void **ts) {
+  int32_t *in = calloc(LARGE, sizeof(*in));
+  result_i64_t *out = calloc(LARGE, sizeof(*out));
+
+  fill(in, LARGE);
+
+  struct result_par_s par = result_par_map(
+    in, out, LARGE, square_all, RESULT_PAR_COLLECT_ALL
+  );
+
+  assert_int_equal(LARGE, par.first_err);
+  assert_int_equal(0, par.errs);
+  check_squares(in, out, LARGE);
+
+  free(in);
+  free(out);
+}
+
+static void test_collect_all_errs(void **ts) {
+  int32_t *in = calloc(LARGE, sizeof(*in));
+  result_i64_t *out = calloc(LARGE, sizeof(*out));
+  size_t errs = 0;
+
+  fill(in, LARGE);
+
+  for (size_t i = 1000; i < LARGE; i += 997) {
+    in[i] = -(int32_t) i;
+    errs++;
+  }
+
+  struct result_par_s par = result_par_map(
+    in, out, LARGE, square_all, RESULT_PAR_COLLECT_ALL
+  );
+
+  assert_int_equal(1000, par.first_err);
+  assert_int_equal(errs, par.errs);
+  check_squares(in, out, LARGE);
+
+  free(in);
+  free(out);
+}
+
+static void test_first_err(void **ts) {
+  int32_t *in = calloc(LARGE, sizeof(*in));
+  result_i64_t *out = calloc(LARGE, sizeof(*out));
+
+  fill(in, LARGE);
+  in[LARGE - 10] = -1;
+
+  struct result_par_s par = result_par_map(
+    in, out, LARGE, square_all, RESULT_PAR_FIRST_ERR
+  );
+
+  assert_int_equal(LARGE - 10, par.first_err);
+  assert_true(par.errs >= 1);
+
+  // everything up to and including the err is there
+  check_squares(in, out, LARGE - 9);
+
+  free(in);
+  free(out);
+}
+
+static void test_first_err_is_lowest(void **ts) {
+  int32_t *in = calloc(LARGE, sizeof(*in));
+  result_i64_t *out = calloc(LARGE, sizeof(*out));
+
+  for (size_t round = 0; round < 20; round++) {
+    size_t first = (round * 9973) % LARGE;
+
+    fill(in, LARGE);
+
+    // errs all over the place after the first one
+    for (size_t i = first; i < LARGE; i += 1 + (i % 5000)) {
+      in[i] = -1;
+    }
+
+    struct result_par_s par = result_par_map(
+      in, out, LARGE, square_all, RESULT_PAR_FIRST_ERR
+    );
+
+    assert_int_equal(first, par.first_err);
+    check_squares(in, out, first + 1);
+  }
+
+  free(in);
+  free(out);
+}
+
+static void test_unaligned_out(void **ts) {
+  int32_t *in = calloc(LARGE, sizeof(*in));
+  result_i64_t *out = calloc(LARGE + 1, sizeof(*out));
+
+  fill(in, LARGE);
+
+  struct result_par_s par = result_par_map(
+    in, out + 1, LARGE, square_all, RESULT_PAR_COLLECT_ALL
+  );
+
+  assert_int_equal(0, par.errs);
+  check_squares(in, out + 1, LARGE);
+
+  free(in);
+  free(out);
+}
+
+static void test_nested(void **ts) {
+  int32_t in[2048];
+  result_i64_t out[2048];
+
+  for (int32_t i = 0; i < 2048; i++) {
+    in[i] = i % 100;
+  }
+
+  struct result_par_s par = result_par_map(
+    in, out, w_array_size(in), sum_below_all, RESULT_PAR_COLLECT_ALL
+  );
+
+  assert_int_equal(0, par.errs);
+
+  for (size_t i = 0; i < w_array_size(in); i++) {
+    int64_t n = in[i];
+    int64_t expected = (n - 1) * n * (2 * n - 1) / 6;
+
+    assert_true(expected == result_unwrap_unchecked(out[i]));
+  }
+}
+
+static void test_concurrent_callers(void **ts) {
+  int32_t *in = calloc(LARGE, sizeof(*in));
+  pthread_t threads[THREADS];
+
+  fill(in, LARGE);
+  in[12345] = -1;
+
+  for (size_t i = 0; i < THREADS; i++) {
+    assert_int_equal(0, pthread_create(&threads[i], NULL, map_in_thread, in));
+  }
+
+  for (size_t i = 0; i < THREADS; i++) {
+    void *errs;
+
+    assert_int_equal(0, pthread_join(threads[i], &errs));
+    assert_int_equal(1, (uintptr_t) errs);
+  }
+
+  free(in);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_threads),
+    cmocka_unit_test(test_empty),
+    cmocka_unit_test(test_small),
+    cmocka_unit_test(test_collect_all),
+    cmocka_unit_test(test_collect_all_errs),
+    cmocka_unit_test(test_first_err),
+    cmocka_unit_test(test_first_err_is_lowest),
+    cmocka_unit_test(test_unaligned_out),
+    cmocka_unit_test(test_nested),
+    cmocka_unit_test(test_concurrent_callers),
+  };
+
+  // more threads than this machine may have cores, so that there's always
+  // someone to steal from
+  result_par_restart(THREADS);
+
+  int failed = cmocka_run_group_tests(tests, NULL, NULL);
+
+  result_par_restart(0);
+  return failed;
+}
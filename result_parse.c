@@ -0,0 +1,822 @@
+#include "result_parse.h"
+#include "result_simd.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define RESULT_PARSE_X86 1
+#else
+  #define RESULT_PARSE_X86 0
+#endif
+
+// Eight '0's, the padding that doesn't change the value of a number.
+#define ZEROS 0x3030303030303030ull
+
+// Significant digits that can decide how a double rounds: a number halfway
+// between two of them has at most 767. After those, it only matters whether
+// any of the rest isn't '0'.
+#define STRTOD_DIGITS 800
+
+// The copy given to strtod(3): the text itself when it fits, otherwise its
+// significant digits up to STRTOD_DIGITS, and an exponent.
+#define STRTOD_COPY (STRTOD_DIGITS + 32)
+
+// Far past where every double is 0 or inf, and no text is long enough to
+// bring it back, so an exponent can stop growing there without overflowing.
+#define MAX_EXPONENT 1000000000000000ll
+
+// Most digits a mantissa can have without overflowing 64 bits.
+#define MANTISSA_DIGITS 19
+
+/*sublime-c-static-fn-hoist-start*/
+static inline struct result_parse_err_s parse_err(
+  enum result_parse_err_e kind,
+  size_t offset
+);
+static inline uint64_t load_8(const uint8_t *p);
+static inline uint64_t load_upto_8(const uint8_t *p, size_t n);
+static inline size_t first_non_digit(uint64_t w);
+static inline uint32_t eight_digits(uint64_t w);
+static inline uint32_t first_digits(uint64_t w, size_t k);
+static inline bool has_sse2(void);
+static size_t parse_digits(
+  const uint8_t *p,
+  size_t n,
+  uint64_t *value,
+  bool *overflow
+);
+static inline size_t scan_digits(
+  const uint8_t *p,
+  size_t n,
+  uint64_t *mantissa,
+  size_t *digits
+);
+static inline size_t find_delim(
+  const uint8_t *p,
+  size_t n,
+  uint8_t delim,
+  bool sse2
+);
+static inline result_parse_u64_t parse_u64(
+  const uint8_t *p,
+  size_t n,
+  size_t base
+);
+static inline result_parse_f64_t parse_f64(
+  const uint8_t *p,
+  size_t n,
+  size_t base
+);
+static void shorten_f64(char *copy, const uint8_t *p, size_t n);
+static result_parse_f64_t parse_f64_slow(
+  const uint8_t *p,
+  size_t n,
+  size_t base,
+  size_t start
+);
+static inline unsigned hex_value(uint8_t c);
+/*sublime-c-static-fn-hoist-end*/
+
+static const uint64_t powers_of_ten_u64[] = {
+  1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+  10000000ull, 100000000ull,
+};
+
+// Exact as doubles, which is what makes the fast path correctly rounded.
+static const double powers_of_ten[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+  1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static inline struct result_parse_err_s parse_err(
+  enum result_parse_err_e kind,
+  size_t offset
+) {
+  return (struct result_parse_err_s) {
+    .kind = kind,
+    .offset = (uint32_t) w_min_2(offset, (size_t) UINT32_MAX),
+  };
+}
+
+//
+// SWAR: 8 characters in a uint64_t, the first one in the low byte
+//
+
+static inline uint64_t load_8(const uint8_t *p) {
+  uint64_t w;
+
+  memcpy(&w, p, 8);
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  w = __builtin_bswap64(w);
+#endif
+
+  return w;
+}
+
+// The `n` (1 to 8) bytes at `p`, zeros after them, without reading past them:
+// two loads that overlap in the middle.
+static inline uint64_t load_upto_8(const uint8_t *p, size_t n) {
+  if (n == 8) {
+    return load_8(p);
+  }
+
+  if (n >= 4) {
+    uint32_t lo;
+    uint32_t hi;
+
+    memcpy(&lo, p, 4);
+    memcpy(&hi, p + n - 4, 4);
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    lo = __builtin_bswap32(lo);
+    hi = __builtin_bswap32(hi);
+#endif
+
+    return lo | (uint64_t) hi << (8 * (n - 4));
+  }
+
+  if (n >= 2) {
+    return p[0] | (uint64_t) p[n - 2] << (8 * (n - 2))
+      | (uint64_t) p[n - 1] << (8 * (n - 1));
+  }
+
+  return p[0];
+}
+
+// Where the first byte that isn't a decimal digit is, or 8. Only the first one
+// is exact: adding 6 to the bytes after it may carry into the next.
+static inline size_t first_non_digit(uint64_t w) {
+  uint64_t non_digits = ((w & 0xf0f0f0f0f0f0f0f0ull)
+    | (((w + 0x0606060606060606ull) & 0xf0f0f0f0f0f0f0f0ull) >> 4))
+    ^ 0x3333333333333333ull;
+
+  return non_digits ? (size_t) __builtin_ctzll(non_digits) / 8 : 8;
+}
+
+// The value of 8 digits, the first one most significant: pairs, then quads,
+// then the two halves, three multiplications in all.
+static inline uint32_t eight_digits(uint64_t w) {
+  w -= ZEROS;
+  w = w * 10 + (w >> 8);
+
+  return (uint32_t) (
+    (
+      (w & 0x000000ff000000ffull) * (100 + (1000000ull << 32))
+        + ((w >> 16) & 0x000000ff000000ffull) * (1 + (10000ull << 32))
+    ) >> 32
+  );
+}
+
+// The value of the first `k` (1 to 8) digits, with the ones after them
+// shifted out and '0's shifted in in front.
+static inline uint32_t first_digits(uint64_t w, size_t k) {
+  size_t pad = 8 - k;
+
+  return eight_digits(
+    w << (8 * pad) | (ZEROS & ~(UINT64_MAX << (8 * pad)))
+  );
+}
+
+#if RESULT_PARSE_X86
+
+//
+// SSE2, 16 characters per vector
+//
+
+#define SSE2 __attribute__((target("sse2")))
+
+// Converts 16 digits to `*value`, or returns where the first non-digit is.
+SSE2 static size_t sse2_sixteen_digits(const uint8_t *p, uint64_t *value) {
+  __m128i nine = _mm_set1_epi8(9);
+  __m128i zero = _mm_setzero_si128();
+  __m128i d = _mm_sub_epi8(
+    _mm_loadu_si128((const __m128i *) p),
+    _mm_set1_epi8('0')
+  );
+
+  unsigned non_digits = ~(unsigned) _mm_movemask_epi8(
+    _mm_cmpeq_epi8(_mm_max_epu8(d, nine), nine)
+  ) & 0xffff;
+
+  if (non_digits) {
+    return (size_t) __builtin_ctz(non_digits);
+  }
+
+  // bytes to 16 bits, then pairs of lanes multiply-added into the lane twice
+  // as wide, which holds twice as many digits: 2, 4, then 8
+  __m128i tens = _mm_set_epi16(1, 10, 1, 10, 1, 10, 1, 10);
+  __m128i hundreds = _mm_set_epi16(1, 100, 1, 100, 1, 100, 1, 100);
+  __m128i ten_thousands = _mm_set_epi16(
+    1, 10000, 1, 10000, 1, 10000, 1, 10000
+  );
+
+  __m128i twos = _mm_packs_epi32(
+    _mm_madd_epi16(_mm_unpacklo_epi8(d, zero), tens),
+    _mm_madd_epi16(_mm_unpackhi_epi8(d, zero), tens)
+  );
+
+  __m128i fours = _mm_madd_epi16(twos, hundreds);
+  __m128i eights = _mm_madd_epi16(
+    _mm_packs_epi32(fours, fours),
+    ten_thousands
+  );
+
+  uint64_t hi = (uint32_t) _mm_cvtsi128_si32(eights);
+  uint64_t lo = (uint32_t) _mm_cvtsi128_si32(_mm_srli_si128(eights, 4));
+
+  *value = hi * 100000000 + lo;
+  return 16;
+}
+
+// Where the first `delim` is, or where fewer than 16 bytes are left.
+SSE2 static size_t sse2_find_delim(
+  const uint8_t *p,
+  size_t n,
+  uint8_t delim,
+  bool *found
+) {
+  __m128i needle = _mm_set1_epi8((char) delim);
+  size_t i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    unsigned hits = (unsigned) _mm_movemask_epi8(
+      _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + i)), needle)
+    );
+
+    if (hits) {
+      *found = true;
+      return i + (size_t) __builtin_ctz(hits);
+    }
+  }
+
+  *found = false;
+  return i;
+}
+
+#undef SSE2
+
+#endif
+
+static inline bool has_sse2(void) {
+#if RESULT_PARSE_X86
+  return result_simd_level() >= RESULT_SIMD_SSE2;
+#else
+  return false;
+#endif
+}
+
+// Converts the `n` (> 0) digits at `p`, setting `*overflow` if they don't fit.
+// Returns where the first non-digit is, or `n`.
+//
+// The first 1 to 8 digits go first, so that the rest are whole blocks of 8,
+// and of 16 when there are at least that many left and the CPU has SSE2,
+// which only happens past 16 digits, and checking the CPU is left for then.
+static size_t parse_digits(
+  const uint8_t *p,
+  size_t n,
+  uint64_t *value,
+  bool *overflow
+) {
+  size_t head = (n - 1) % 8 + 1;
+  uint64_t w = load_upto_8(p, head);
+  size_t k = first_non_digit(w);
+
+  if (k < head) {
+    return k;
+  }
+
+  uint64_t v = first_digits(w, head);
+  bool over = false;
+  size_t i = head;
+
+#if RESULT_PARSE_X86
+  if (w_unlikely(n - i >= 16) && has_sse2()) {
+    for (; n - i >= 16; i += 16) {
+      uint64_t sixteen;
+      size_t bad = sse2_sixteen_digits(p + i, &sixteen);
+
+      if (bad < 16) {
+        return i + bad;
+      }
+
+      over = over
+        || __builtin_mul_overflow(v, 10000000000000000ull, &v)
+        || __builtin_add_overflow(v, sixteen, &v);
+    }
+  }
+#endif
+
+  for (; i < n; i += 8) {
+    w = load_8(p + i);
+    k = first_non_digit(w);
+
+    if (k < 8) {
+      return i + k;
+    }
+
+    over = over
+      || __builtin_mul_overflow(v, 100000000ull, &v)
+      || __builtin_add_overflow(v, eight_digits(w), &v);
+  }
+
+  *value = v;
+  *overflow = over;
+
+  return n;
+}
+
+// Consumes the run of digits at `p`, adding them to `*mantissa` and their
+// count to `*digits`. Once there are more than MANTISSA_DIGITS, they're only
+// counted. Returns how many there were.
+static inline size_t scan_digits(
+  const uint8_t *p,
+  size_t n,
+  uint64_t *mantissa,
+  size_t *digits
+) {
+  size_t i = 0;
+
+  while (i < n) {
+    uint64_t w = n - i >= 8 ? load_8(p + i) : load_upto_8(p + i, n - i);
+
+    // the zeros after a short load aren't digits, so k stops there
+    size_t k = first_non_digit(w);
+
+    if (k == 0) {
+      break;
+    }
+
+    if (*digits + k <= MANTISSA_DIGITS) {
+      *mantissa = *mantissa * powers_of_ten_u64[k] + first_digits(w, k);
+    }
+
+    *digits += k;
+    i += k;
+
+    if (k < 8) {
+      break;
+    }
+  }
+
+  return i;
+}
+
+// Where the first `delim` is, or `n`.
+static inline size_t find_delim(
+  const uint8_t *p,
+  size_t n,
+  uint8_t delim,
+  bool sse2
+) {
+  size_t i = 0;
+
+#if RESULT_PARSE_X86
+  if (sse2) {
+    bool found;
+
+    i = sse2_find_delim(p, n, delim, &found);
+
+    if (found) {
+      return i;
+    }
+  }
+#else
+  (void) sse2;
+#endif
+
+  // zero bytes of w ^ needles: the lowest bit set by the subtraction is exact,
+  // the borrow only spills into the bytes after it
+  uint64_t needles = 0x0101010101010101ull * delim;
+
+  for (; i + 8 <= n; i += 8) {
+    uint64_t x = load_8(p + i) ^ needles;
+    uint64_t hits = (x - 0x0101010101010101ull) & ~x & 0x8080808080808080ull;
+
+    if (hits) {
+      return i + (size_t) __builtin_ctzll(hits) / 8;
+    }
+  }
+
+  for (; i < n; i++) {
+    if (p[i] == delim) {
+      return i;
+    }
+  }
+
+  return n;
+}
+
+static inline result_parse_u64_t parse_u64(
+  const uint8_t *p,
+  size_t n,
+  size_t base
+) {
+  uint64_t value = 0;
+  bool overflow = false;
+
+  if (w_unlikely(n == 0)) {
+    return (result_parse_u64_t) result_init_err(
+      parse_err(RESULT_PARSE_EMPTY, base)
+    );
+  }
+
+  size_t bad = parse_digits(p, n, &value, &overflow);
+
+  if (w_unlikely(bad < n)) {
+    return (result_parse_u64_t) result_init_err(
+      parse_err(RESULT_PARSE_INVALID, base + bad)
+    );
+  }
+
+  if (w_unlikely(overflow)) {
+    return (result_parse_u64_t) result_init_err(
+      parse_err(RESULT_PARSE_OVERFLOW, base)
+    );
+  }
+
+  return (result_parse_u64_t) result_init_ok(value);
+}
+
+result_parse_u64_t result_parse_u64(struct const_fatptr_s text) {
+  return parse_u64(text.data, text.len, 0);
+}
+
+result_parse_i64_t result_parse_i64(struct const_fatptr_s text) {
+  const uint8_t *p = text.data;
+  size_t n = text.len;
+  size_t i = 0;
+  bool negative = false;
+  uint64_t value = 0;
+  bool overflow = false;
+
+  if (n > 0 && (p[0] == '-' || p[0] == '+')) {
+    negative = p[0] == '-';
+    i = 1;
+  }
+
+  if (w_unlikely(i == n)) {
+    return (result_parse_i64_t) result_init_err(
+      parse_err(RESULT_PARSE_EMPTY, i)
+    );
+  }
+
+  size_t bad = parse_digits(p + i, n - i, &value, &overflow);
+
+  if (w_unlikely(bad < n - i)) {
+    return (result_parse_i64_t) result_init_err(
+      parse_err(RESULT_PARSE_INVALID, i + bad)
+    );
+  }
+
+  // one more on the negative side
+  if (w_unlikely(overflow || value > (uint64_t) INT64_MAX + negative)) {
+    return (result_parse_i64_t) result_init_err(
+      parse_err(RESULT_PARSE_OVERFLOW, i)
+    );
+  }
+
+  return (result_parse_i64_t) result_init_ok(
+    negative ? (int64_t) (0 - value) : (int64_t) value
+  );
+}
+
+static inline unsigned hex_value(uint8_t c) {
+  unsigned digit = (unsigned) c - '0';
+  unsigned letter = ((unsigned) c | 0x20) - 'a';
+
+  if (digit < 10) {
+    return digit;
+  }
+
+  return letter < 6 ? letter + 10 : 16;
+}
+
+result_parse_u64_t result_parse_hex(struct const_fatptr_s text) {
+  const uint8_t *p = text.data;
+  size_t n = text.len;
+  size_t i = 0;
+  uint64_t value = 0;
+  bool overflow = false;
+
+  if (n >= 2 && p[0] == '0' && (p[1] | 0x20) == 'x') {
+    i = 2;
+  }
+
+  size_t start = i;
+
+  if (w_unlikely(i == n)) {
+    return (result_parse_u64_t) result_init_err(
+      parse_err(RESULT_PARSE_EMPTY, i)
+    );
+  }
+
+  for (; i < n; i++) {
+    unsigned digit = hex_value(p[i]);
+
+    if (w_unlikely(digit > 15)) {
+      return (result_parse_u64_t) result_init_err(
+        parse_err(RESULT_PARSE_INVALID, i)
+      );
+    }
+
+    overflow |= value >> 60 != 0;
+    value = value << 4 | digit;
+  }
+
+  if (w_unlikely(overflow)) {
+    return (result_parse_u64_t) result_init_err(
+      parse_err(RESULT_PARSE_OVERFLOW, start)
+    );
+  }
+
+  return (result_parse_u64_t) result_init_ok(value);
+}
+
+static inline result_parse_f64_t parse_f64(
+  const uint8_t *p,
+  size_t n,
+  size_t base
+) {
+  size_t i = 0;
+  bool negative = false;
+  uint64_t mantissa = 0;
+  size_t digits = 0;
+  int64_t exponent = 0;
+
+  if (i < n && (p[i] == '-' || p[i] == '+')) {
+    negative = p[i] == '-';
+    i++;
+  }
+
+  size_t start = i;
+  size_t int_len = scan_digits(p + i, n - i, &mantissa, &digits);
+  size_t frac_len = 0;
+
+  i += int_len;
+
+  if (i < n && p[i] == '.') {
+    i++;
+    frac_len = scan_digits(p + i, n - i, &mantissa, &digits);
+    i += frac_len;
+  }
+
+  if (w_unlikely(int_len + frac_len == 0)) {
+    return (result_parse_f64_t) result_init_err(
+      parse_err(i == n ? RESULT_PARSE_EMPTY : RESULT_PARSE_INVALID, base + i)
+    );
+  }
+
+  if (i < n && (p[i] | 0x20) == 'e') {
+    bool exponent_negative = false;
+
+    i++;
+
+    if (i < n && (p[i] == '-' || p[i] == '+')) {
+      exponent_negative = p[i] == '-';
+      i++;
+    }
+
+    size_t exponent_start = i;
+
+    // far past where every double is 0 or inf, so it can't overflow
+    for (; i < n && (unsigned) p[i] - '0' < 10; i++) {
+      if (exponent < 100000) {
+        exponent = exponent * 10 + (p[i] - '0');
+      }
+    }
+
+    if (w_unlikely(i == exponent_start)) {
+      return (result_parse_f64_t) result_init_err(
+        parse_err(i == n ? RESULT_PARSE_EMPTY : RESULT_PARSE_INVALID, base + i)
+      );
+    }
+
+    if (exponent_negative) {
+      exponent = -exponent;
+    }
+  }
+
+  if (w_unlikely(i < n)) {
+    return (result_parse_f64_t) result_init_err(
+      parse_err(RESULT_PARSE_INVALID, base + i)
+    );
+  }
+
+  // Clinger's fast path: both the mantissa and the power of ten are exact
+  // doubles, so the one multiplication or division rounds correctly
+  int64_t power = exponent - (int64_t) frac_len;
+
+  if (w_likely(
+    digits <= MANTISSA_DIGITS
+      && mantissa <= 1ull << 53
+      && power >= -22
+      && power <= 22
+  )) {
+    double value = (double) mantissa;
+
+    value = power < 0
+      ? value / powers_of_ten[-power]
+      : value * powers_of_ten[power];
+
+    return (result_parse_f64_t) result_init_ok(negative ? -value : value);
+  }
+
+  return parse_f64_slow(p, n, base, start);
+}
+
+// The text is known to be a valid float by now, so strtod(3) reads all of it.
+// Writes a number too long for STRTOD_COPY that rounds to the same double,
+// with what's after the first STRTOD_DIGITS significant digits replaced by a
+// '1' if any of it isn't '0'. `p` has been checked by parse_f64() already.
+static void shorten_f64(char *copy, const uint8_t *p, size_t n) {
+  size_t i = 0;
+  size_t len = 0;
+
+  // of the last digit that's kept
+  int64_t exponent = 0;
+  bool fraction = false;
+  bool rest = false;
+
+  if (p[i] == '-' || p[i] == '+') {
+    copy[len++] = (char) p[i++];
+  }
+
+  size_t digits_start = len;
+
+  for (; i < n && (p[i] | 0x20) != 'e'; i++) {
+    if (p[i] == '.') {
+      fraction = true;
+      continue;
+    }
+
+    exponent -= fraction;
+
+    if (len == digits_start && p[i] == '0') {
+      continue;
+    }
+
+    if (len - digits_start < STRTOD_DIGITS) {
+      copy[len++] = (char) p[i];
+    } else {
+      exponent++;
+      rest |= p[i] != '0';
+    }
+  }
+
+  if (rest) {
+    copy[len++] = '1';
+    exponent--;
+  } else if (len == digits_start) {
+    copy[len++] = '0';
+  }
+
+  if (i < n) {
+    bool exponent_negative = false;
+    int64_t written = 0;
+
+    i++;
+
+    if (p[i] == '-' || p[i] == '+') {
+      exponent_negative = p[i] == '-';
+      i++;
+    }
+
+    for (; i < n; i++) {
+      if (written < MAX_EXPONENT) {
+        written = written * 10 + (p[i] - '0');
+      }
+    }
+
+    exponent += exponent_negative ? -written : written;
+  }
+
+  snprintf(copy + len, STRTOD_COPY - len, "e%" PRId64, exponent);
+}
+
+static result_parse_f64_t parse_f64_slow(
+  const uint8_t *p,
+  size_t n,
+  size_t base,
+  size_t start
+) {
+  char copy[STRTOD_COPY];
+
+  if (w_likely(n < STRTOD_COPY)) {
+    memcpy(copy, p, n);
+    copy[n] = '\0';
+  } else {
+    shorten_f64(copy, p, n);
+  }
+
+  double value = strtod(copy, NULL);
+
+  if (w_unlikely(__builtin_isinf(value))) {
+    return (result_parse_f64_t) result_init_err(
+      parse_err(RESULT_PARSE_OVERFLOW, base + start)
+    );
+  }
+
+  return (result_parse_f64_t) result_init_ok(value);
+}
+
+result_parse_f64_t result_parse_f64(struct const_fatptr_s text) {
+  return parse_f64(text.data, text.len, 0);
+}
+
+result_parse_bool_t result_parse_bool(struct const_fatptr_s text) {
+  const uint8_t *p = text.data;
+  size_t n = text.len;
+  const char *word;
+  bool value;
+
+  if (w_unlikely(n == 0)) {
+    return (result_parse_bool_t) result_init_err(
+      parse_err(RESULT_PARSE_EMPTY, 0)
+    );
+  }
+
+  switch (p[0]) {
+    case 't':
+      word = "true";
+      value = true;
+      break;
+
+    case 'f':
+      word = "false";
+      value = false;
+      break;
+
+    case '1':
+      word = "1";
+      value = true;
+      break;
+
+    case '0':
+      word = "0";
+      value = false;
+      break;
+
+    default:
+      return (result_parse_bool_t) result_init_err(
+        parse_err(RESULT_PARSE_INVALID, 0)
+      );
+  }
+
+  size_t len = strlen(word);
+  size_t i = 1;
+
+  while (i < n && i < len && p[i] == (uint8_t) word[i]) {
+    i++;
+  }
+
+  if (w_unlikely(i != len || i != n)) {
+    return (result_parse_bool_t) result_init_err(
+      parse_err(RESULT_PARSE_INVALID, i)
+    );
+  }
+
+  return (result_parse_bool_t) result_init_ok(value);
+}
+
+//
+// Batches: the last field is the one without a delimiter after it
+//
+
+#define define_fields(_name, _result_type, _parse) \
+  size_t _name( \
+    struct const_fatptr_s text, \
+    char delim, \
+    _result_type *out, \
+    size_t cap \
+  ) { \
+    const uint8_t *p = text.data; \
+    size_t n = text.len; \
+    size_t start = 0; \
+    size_t count = 0; \
+    bool sse2 = has_sse2(); \
+    \
+    if (n == 0) { \
+      return 0; \
+    } \
+    \
+    while (count < cap) { \
+      size_t len = find_delim(p + start, n - start, (uint8_t) delim, sse2); \
+      \
+      out[count++] = _parse(p + start, len, start); \
+      start += len + 1; \
+      \
+      if (start > n) { \
+        break; \
+      } \
+    } \
+    \
+    return count; \
+  }
+
+define_fields(result_parse_u64_fields, result_parse_u64_t, parse_u64)
+define_fields(result_parse_f64_fields, result_parse_f64_t, parse_f64)
@@ -0,0 +1,107 @@
+#ifndef __result_parse_h__
+#define __result_parse_h__
+
+#include "core/defs.h"
+#include "result.h"
+
+//
+// Parsers for numbers and booleans in slices of text, returning results.
+//
+//   struct const_fatptr_s field = { { line + start }, end - start };
+//   result_parse_u64_t id = result_parse_u64(field);
+//
+//   if (result_is_err(id)) {
+//     struct result_parse_err_s err = result_unwrap_err_unchecked(id);
+//
+//     // eg. RESULT_PARSE_INVALID at 3 for "123x"
+//     return report(err.kind, start + err.offset);
+//   }
+//
+// Unlike strtoull(3) and friends, the slice doesn't need a NUL after it, all
+// of it has to be the number (no whitespace, no trailing characters), and an
+// error says what went wrong and where:
+//
+//   - RESULT_PARSE_EMPTY: there were no digits, offset is where they were
+//     expected ("" at 0, "-" at 1, "0x" at 2)
+//   - RESULT_PARSE_INVALID: offset is the first character that can't be
+//     there, even if the digits before it would overflow
+//   - RESULT_PARSE_OVERFLOW: the number doesn't fit, offset is where it starts
+//     (after the sign)
+//
+// Offsets past UINT32_MAX are reported as UINT32_MAX.
+//
+// Integers are converted 8 digits at a time in a general purpose register
+// (SWAR), and 16 at a time with SSE2 when the CPU has it (see
+// result_simd_level()). Floats take the exact fast path when the digits fit
+// in 53 bits and the power of 10 is small enough for the product (or
+// quotient) to be rounded once, which covers nearly everything that's written
+// by people or printed with %.Ng for small N; the rest goes through strtod(3)
+// on a copy, so the result is always correctly rounded (as long as the locale
+// uses '.' for the decimal point, like the default "C" one). The copy is on
+// the stack: past the first 800 significant digits, which is more than can
+// decide the rounding, the digits are only checked for being all '0'.
+//
+// The batch functions split a buffer at a delimiter and parse every field,
+// finding the delimiters 16 bytes at a time with SSE2:
+//
+//   result_parse_u64_t ids[64];
+//   size_t n = result_parse_u64_fields(line, ',', ids, 64);
+//
+// Their error offsets are from the start of the buffer, not of the field.
+//
+
+enum result_parse_err_e {
+  RESULT_PARSE_EMPTY = 1,
+  RESULT_PARSE_INVALID,
+  RESULT_PARSE_OVERFLOW,
+};
+
+struct result_parse_err_s {
+  enum result_parse_err_e kind;
+  uint32_t offset;
+};
+
+typedef result_t(uint64_t, struct result_parse_err_s) result_parse_u64_t;
+typedef result_t(int64_t, struct result_parse_err_s) result_parse_i64_t;
+typedef result_t(double, struct result_parse_err_s) result_parse_f64_t;
+typedef result_t(bool, struct result_parse_err_s) result_parse_bool_t;
+
+// Decimal digits only.
+extern result_parse_u64_t result_parse_u64(struct const_fatptr_s text);
+
+// An optional '-' or '+', then decimal digits.
+extern result_parse_i64_t result_parse_i64(struct const_fatptr_s text);
+
+// Hexadecimal digits in either case, with an optional "0x" or "0X" first.
+extern result_parse_u64_t result_parse_hex(struct const_fatptr_s text);
+
+// An optional sign, digits with an optional '.' among them (at least one
+// digit on either side), and an optional exponent: 'e' or 'E', an optional
+// sign and digits. No whitespace, hex floats, inf or nan. Numbers too small
+// for a double are rounded (to 0 eventually) and are not an error, too large
+// ones are RESULT_PARSE_OVERFLOW.
+extern result_parse_f64_t result_parse_f64(struct const_fatptr_s text);
+
+// "true", "false", "1" or "0". A prefix of one of them, like "tru", is
+// RESULT_PARSE_INVALID at its end.
+extern result_parse_bool_t result_parse_bool(struct const_fatptr_s text);
+
+// Parses up to `cap` fields of `text` separated by `delim` into `out` and
+// returns how many it parsed. An empty `text` has no fields, otherwise there's
+// one more than there are delimiters, so "1,,2," has four fields, two of them
+// RESULT_PARSE_EMPTY.
+extern size_t result_parse_u64_fields(
+  struct const_fatptr_s text,
+  char delim,
+  result_parse_u64_t *out,
+  size_t cap
+);
+
+extern size_t result_parse_f64_fields(
+  struct const_fatptr_s text,
+  char delim,
+  result_parse_f64_t *out,
+  size_t cap
+);
+
+#endif // __result_parse_h__
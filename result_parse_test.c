@@ -0,0 +1,416 @@
+#include "core/defs.h"
+#include "result_parse.h"
+#include "result_simd.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*sublime-c-static-fn-hoist-start*/
+static struct const_fatptr_s text_of(const char *s);
+static void each_level(void (*fn)(void));
+static void check_u64(void);
+static void check_u64_fields(void);
+static void test_parses_u64(void **ts);
+static void test_u64_errors(void **ts);
+static void test_parses_i64(void **ts);
+static void test_parses_hex(void **ts);
+static void test_parses_f64_like_strtod(void **ts);
+static void test_f64_errors(void **ts);
+static void test_parses_bool(void **ts);
+static void test_parses_u64_fields(void **ts);
+static void test_parses_f64_fields(void **ts);
+/*sublime-c-static-fn-hoist-end*/
+
+#define assert_parse_ok(_res, _value) { \
+  __typeof(_res) assert_res = (_res); \
+  assert_true(result_is_ok(assert_res)); \
+  assert_true(result_unwrap_unchecked(assert_res) == (_value)); \
+}
+
+#define assert_parse_err(_res, _kind, _offset) { \
+  __typeof(_res) assert_res = (_res); \
+  assert_true(result_is_err(assert_res)); \
+  assert_int_equal((_kind), result_unwrap_err_unchecked(assert_res).kind); \
+  assert_int_equal((_offset), result_unwrap_err_unchecked(assert_res).offset); \
+}
+
+static struct const_fatptr_s text_of(const char *s) {
+  return (struct const_fatptr_s) { { s }, strlen(s) };
+}
+
+// Runs `fn` with SSE2 if the CPU has it, then without.
+static void each_level(void (*fn)(void)) {
+  enum result_simd_level_e levels[] = {
+    RESULT_SIMD_AVX512,
+    RESULT_SIMD_SCALAR,
+  };
+
+  for (size_t i = 0; i < w_array_size(levels); i++) {
+    result_simd_force_level(levels[i]);
+    fn();
+  }
+
+  result_simd_force_level(RESULT_SIMD_AVX512);
+}
+
+static void check_u64(void) {
+  static const char *numbers[] = {
+    "0", "7", "42", "123", "9999", "12345", "123456", "1234567", "12345678",
+    "123456789", "1234567890123456", "12345678901234567",
+    "98765432109876543", "18446744073709551615", "10000000000000000000",
+  };
+
+  for (size_t i = 0; i < w_array_size(numbers); i++) {
+    assert_parse_ok(
+      result_parse_u64(text_of(numbers[i])), strtoull(numbers[i], NULL, 10)
+    );
+  }
+
+  // every length, through the 8 and 16 digit blocks
+  char buf[32];
+
+  for (uint64_t x = 1, n = 1; n <= 20; x = x * 10 + n % 10, n++) {
+    snprintf(buf, sizeof(buf), "%" PRIu64, x);
+    assert_parse_ok(result_parse_u64(text_of(buf)), x);
+  }
+
+  assert_parse_ok(
+    result_parse_u64(text_of("00000000000000000000000000000042")), 42
+  );
+
+  assert_parse_err(
+    result_parse_u64(text_of("18446744073709551616")),
+    RESULT_PARSE_OVERFLOW, 0
+  );
+
+  assert_parse_err(
+    result_parse_u64(text_of("100000000000000000000000000000000")),
+    RESULT_PARSE_OVERFLOW, 0
+  );
+
+  // an invalid character anywhere beats overflow
+  assert_parse_err(
+    result_parse_u64(text_of("1000000000000000000000000000000x")),
+    RESULT_PARSE_INVALID, 31
+  );
+
+  assert_parse_err(
+    result_parse_u64(text_of("123456789012345678:")),
+    RESULT_PARSE_INVALID, 18
+  );
+}
+
+static void check_u64_fields(void) {
+  const char *line = "1,22,,333,x4,18446744073709551616,"
+    "12345678901234567890,7";
+  result_parse_u64_t out[16];
+
+  size_t n = result_parse_u64_fields(text_of(line), ',', out, 16);
+
+  assert_int_equal(8, n);
+  assert_parse_ok(out[0], 1);
+  assert_parse_ok(out[1], 22);
+  assert_parse_err(out[2], RESULT_PARSE_EMPTY, 5);
+  assert_parse_ok(out[3], 333);
+  assert_parse_err(out[4], RESULT_PARSE_INVALID, 10);
+  assert_parse_err(out[5], RESULT_PARSE_OVERFLOW, 13);
+  assert_parse_ok(out[6], 12345678901234567890ull);
+  assert_parse_ok(out[7], 7);
+}
+
+static void test_parses_u64(void **ts) {
+  each_level(check_u64);
+
+  // no NUL needed, only `len` bytes are read
+  const char digits[] = { '1', '2', '3', '4', '5' };
+
+  assert_parse_ok(
+    result_parse_u64((struct const_fatptr_s) { { digits }, 5 }), 12345
+  );
+
+  assert_parse_ok(
+    result_parse_u64((struct const_fatptr_s) { { "98765,4" }, 3 }), 987
+  );
+}
+
+static void test_u64_errors(void **ts) {
+  assert_parse_err(result_parse_u64(text_of("")), RESULT_PARSE_EMPTY, 0);
+  assert_parse_err(result_parse_u64(text_of("12a4")), RESULT_PARSE_INVALID, 2);
+  assert_parse_err(result_parse_u64(text_of(" 1")), RESULT_PARSE_INVALID, 0);
+  assert_parse_err(result_parse_u64(text_of("1 ")), RESULT_PARSE_INVALID, 1);
+  assert_parse_err(result_parse_u64(text_of("-1")), RESULT_PARSE_INVALID, 0);
+  assert_parse_err(result_parse_u64(text_of("+1")), RESULT_PARSE_INVALID, 0);
+
+  assert_parse_err(
+    result_parse_u64(text_of("123456789x")), RESULT_PARSE_INVALID, 9
+  );
+
+  // bytes that only look like digits to a careless check
+  assert_parse_err(result_parse_u64(text_of("1/")), RESULT_PARSE_INVALID, 1);
+  assert_parse_err(result_parse_u64(text_of("1:")), RESULT_PARSE_INVALID, 1);
+
+  assert_parse_err(
+    result_parse_u64(text_of("12345678\xff")), RESULT_PARSE_INVALID, 8
+  );
+}
+
+static void test_parses_i64(void **ts) {
+  assert_parse_ok(result_parse_i64(text_of("0")), 0);
+  assert_parse_ok(result_parse_i64(text_of("-0")), 0);
+  assert_parse_ok(result_parse_i64(text_of("+5")), 5);
+  assert_parse_ok(result_parse_i64(text_of("-123456789")), -123456789);
+
+  assert_parse_ok(
+    result_parse_i64(text_of("9223372036854775807")), INT64_MAX
+  );
+
+  assert_parse_ok(
+    result_parse_i64(text_of("-9223372036854775808")), INT64_MIN
+  );
+
+  assert_parse_err(
+    result_parse_i64(text_of("9223372036854775808")), RESULT_PARSE_OVERFLOW, 0
+  );
+
+  assert_parse_err(
+    result_parse_i64(text_of("-9223372036854775809")),
+    RESULT_PARSE_OVERFLOW, 1
+  );
+
+  assert_parse_err(result_parse_i64(text_of("")), RESULT_PARSE_EMPTY, 0);
+  assert_parse_err(result_parse_i64(text_of("-")), RESULT_PARSE_EMPTY, 1);
+  assert_parse_err(result_parse_i64(text_of("-x")), RESULT_PARSE_INVALID, 1);
+  assert_parse_err(result_parse_i64(text_of("--1")), RESULT_PARSE_INVALID, 1);
+}
+
+static void test_parses_hex(void **ts) {
+  assert_parse_ok(result_parse_hex(text_of("0")), 0);
+  assert_parse_ok(result_parse_hex(text_of("ff")), 255);
+  assert_parse_ok(result_parse_hex(text_of("0xDEADbeef")), 0xdeadbeef);
+  assert_parse_ok(result_parse_hex(text_of("0X10")), 16);
+  assert_parse_ok(result_parse_hex(text_of("ffffffffffffffff")), UINT64_MAX);
+  assert_parse_ok(result_parse_hex(text_of("0x00000000000000000001")), 1);
+
+  assert_parse_err(
+    result_parse_hex(text_of("0x10000000000000000")), RESULT_PARSE_OVERFLOW, 2
+  );
+
+  assert_parse_err(result_parse_hex(text_of("")), RESULT_PARSE_EMPTY, 0);
+  assert_parse_err(result_parse_hex(text_of("0x")), RESULT_PARSE_EMPTY, 2);
+  assert_parse_err(result_parse_hex(text_of("fg")), RESULT_PARSE_INVALID, 1);
+  assert_parse_err(result_parse_hex(text_of("0xx1")), RESULT_PARSE_INVALID, 2);
+  assert_parse_err(result_parse_hex(text_of("x1")), RESULT_PARSE_INVALID, 0);
+}
+
+static void test_parses_f64_like_strtod(void **ts) {
+  static const char *numbers[] = {
+    "0", "-0", "1", "1.5", "-2.25", "+7", ".5", "5.", "3.14159", "0.1",
+    "1e10", "1E-5", "1e+22", "1e-22", "123.456e3", "0.000001",
+    "9007199254740992", "9007199254740993", "1e23", "8.5e-23",
+    "123456789012345678901234567890", "0.30000000000000004",
+    "2.2250738585072014e-308", "4.9e-324", "1e-400", "-1e-400",
+    "1.7976931348623157e308", "179769313486231580793728971405301e276",
+    "0000000000000000000000000001.5",
+  };
+
+  for (size_t i = 0; i < w_array_size(numbers); i++) {
+    double expected = strtod(numbers[i], NULL);
+    result_parse_f64_t res = result_parse_f64(text_of(numbers[i]));
+
+    assert_true(result_is_ok(res));
+    assert_memory_equal(
+      &expected, &res.body.ok, sizeof(expected)
+    );
+  }
+
+  // longer than the copy for strtod, with digits that decide the rounding
+  // far past the ones it keeps
+  static char big[4096];
+  static const char *fills[][4] = {
+    // prefix, digit repeated, last digit, suffix
+    { "0.", "0", "3", "e3990" },
+    { "9007199254740993.", "0", "", "" },
+    { "9007199254740993.", "0", "1", "" },
+    { "-9007199254740995", "0", "1", "e-3984" },
+    { "1", "7", "", "e-3900" },
+    { "", "3", ".5", "e-3800" },
+    { "1", "0", "", "e-4400" },
+    { "1", "0", "", "e-4000" },
+    { "0.", "0", "1", "e4100" },
+  };
+
+  for (size_t i = 0; i < w_array_size(fills); i++) {
+    size_t len = strlen(fills[i][0]);
+
+    memcpy(big, fills[i][0], len);
+    memset(big + len, fills[i][1][0], 4000 - len);
+    snprintf(big + 4000, sizeof(big) - 4000, "%s%s", fills[i][2], fills[i][3]);
+
+    double expected = strtod(big, NULL);
+    result_parse_f64_t res = result_parse_f64(text_of(big));
+
+    assert_true(result_is_ok(res));
+    assert_memory_equal(
+      &expected, &res.body.ok, sizeof(expected)
+    );
+  }
+
+  // what printf prints, both ways to the fast path and off it
+  char buf[64];
+  uint64_t state = 0x9e3779b97f4a7c15ull;
+
+  for (size_t i = 0; i < 4000; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    double x = (double) (state >> 11) / (double) (1ull << 53)
+      * (double) (1ull << (state % 40));
+
+    switch (i % 4) {
+      case 0:
+        snprintf(buf, sizeof(buf), "%.17g", x);
+        break;
+
+      case 1:
+        snprintf(buf, sizeof(buf), "%.6g", x);
+        break;
+
+      case 2:
+        snprintf(buf, sizeof(buf), "%.3f", x);
+        break;
+
+      default:
+        snprintf(buf, sizeof(buf), "%.10e", x);
+    }
+
+    double expected = strtod(buf, NULL);
+    result_parse_f64_t res = result_parse_f64(text_of(buf));
+
+    assert_true(result_is_ok(res));
+    assert_memory_equal(
+      &expected, &res.body.ok, sizeof(expected)
+    );
+  }
+}
+
+static void test_f64_errors(void **ts) {
+  assert_parse_err(result_parse_f64(text_of("")), RESULT_PARSE_EMPTY, 0);
+  assert_parse_err(result_parse_f64(text_of("-")), RESULT_PARSE_EMPTY, 1);
+  assert_parse_err(result_parse_f64(text_of(".")), RESULT_PARSE_EMPTY, 1);
+  assert_parse_err(result_parse_f64(text_of("1e")), RESULT_PARSE_EMPTY, 2);
+  assert_parse_err(result_parse_f64(text_of("1e+")), RESULT_PARSE_EMPTY, 3);
+  assert_parse_err(result_parse_f64(text_of("1ex")), RESULT_PARSE_INVALID, 2);
+  assert_parse_err(result_parse_f64(text_of(".e1")), RESULT_PARSE_INVALID, 1);
+  assert_parse_err(result_parse_f64(text_of("1.2.3")), RESULT_PARSE_INVALID, 3);
+  assert_parse_err(result_parse_f64(text_of("x")), RESULT_PARSE_INVALID, 0);
+  assert_parse_err(result_parse_f64(text_of("inf")), RESULT_PARSE_INVALID, 0);
+  assert_parse_err(result_parse_f64(text_of("nan")), RESULT_PARSE_INVALID, 0);
+  assert_parse_err(result_parse_f64(text_of("0x1p3")), RESULT_PARSE_INVALID, 1);
+  assert_parse_err(result_parse_f64(text_of(" 1")), RESULT_PARSE_INVALID, 0);
+  assert_parse_err(result_parse_f64(text_of("1 ")), RESULT_PARSE_INVALID, 1);
+
+  assert_parse_err(
+    result_parse_f64(text_of("1e400")), RESULT_PARSE_OVERFLOW, 0
+  );
+
+  assert_parse_err(
+    result_parse_f64(text_of("-1e400")), RESULT_PARSE_OVERFLOW, 1
+  );
+}
+
+static void test_parses_bool(void **ts) {
+  assert_parse_ok(result_parse_bool(text_of("true")), true);
+  assert_parse_ok(result_parse_bool(text_of("false")), false);
+  assert_parse_ok(result_parse_bool(text_of("1")), true);
+  assert_parse_ok(result_parse_bool(text_of("0")), false);
+
+  assert_parse_err(result_parse_bool(text_of("")), RESULT_PARSE_EMPTY, 0);
+  assert_parse_err(result_parse_bool(text_of("tru")), RESULT_PARSE_INVALID, 3);
+
+  assert_parse_err(
+    result_parse_bool(text_of("truex")), RESULT_PARSE_INVALID, 4
+  );
+
+  assert_parse_err(
+    result_parse_bool(text_of("fAlse")), RESULT_PARSE_INVALID, 1
+  );
+
+  assert_parse_err(result_parse_bool(text_of("yes")), RESULT_PARSE_INVALID, 0);
+  assert_parse_err(result_parse_bool(text_of("01")), RESULT_PARSE_INVALID, 1);
+}
+
+static void test_parses_u64_fields(void **ts) {
+  each_level(check_u64_fields);
+
+  result_parse_u64_t out[4];
+
+  assert_int_equal(0, result_parse_u64_fields(text_of(""), ',', out, 4));
+
+  // a delimiter at the end makes an empty field
+  assert_int_equal(3, result_parse_u64_fields(text_of("1,2,"), ',', out, 4));
+  assert_parse_ok(out[1], 2);
+  assert_parse_err(out[2], RESULT_PARSE_EMPTY, 4);
+
+  // stops at `cap`
+  assert_int_equal(
+    2, result_parse_u64_fields(text_of("5\n6\n7"), '\n', out, 2)
+  );
+
+  assert_parse_ok(out[0], 5);
+  assert_parse_ok(out[1], 6);
+
+  // a long line, where the delimiters are found 16 bytes at a time
+  char line[8192];
+  result_parse_u64_t many[512];
+  size_t len = 0;
+
+  for (uint64_t i = 0; i < 512; i++) {
+    len += (size_t) snprintf(
+      line + len, sizeof(line) - len, "%s%" PRIu64, i ? "|" : "",
+      i * i * i * 7919
+    );
+  }
+
+  assert_int_equal(
+    512,
+    result_parse_u64_fields(
+      (struct const_fatptr_s) { { line }, len }, '|', many, 512
+    )
+  );
+
+  for (uint64_t i = 0; i < 512; i++) {
+    assert_parse_ok(many[i], i * i * i * 7919);
+  }
+}
+
+static void test_parses_f64_fields(void **ts) {
+  result_parse_f64_t out[8];
+
+  size_t n = result_parse_f64_fields(
+    text_of("1.5\t-2e3\t\t0.1\tx"), '\t', out, 8
+  );
+
+  assert_int_equal(5, n);
+  assert_parse_ok(out[0], 1.5);
+  assert_parse_ok(out[1], -2e3);
+  assert_parse_err(out[2], RESULT_PARSE_EMPTY, 9);
+  assert_parse_ok(out[3], 0.1);
+  assert_parse_err(out[4], RESULT_PARSE_INVALID, 14);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_parses_u64),
+    cmocka_unit_test(test_u64_errors),
+    cmocka_unit_test(test_parses_i64),
+    cmocka_unit_test(test_parses_hex),
+    cmocka_unit_test(test_parses_f64_like_strtod),
+    cmocka_unit_test(test_f64_errors),
+    cmocka_unit_test(test_parses_bool),
+    cmocka_unit_test(test_parses_u64_fields),
+    cmocka_unit_test(test_parses_f64_fields),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
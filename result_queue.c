@@ -0,0 +1,48 @@
+#include "result_queue.h"
+
+// Keeps the indices well away from wrapping and the allocations sane.
+#define MAX_CAPACITY ((size_t) 1 << 32)
+
+bool result_queue_init(
+  struct result_queue_s *queue,
+  size_t capacity,
+  size_t slot_size,
+  bool is_mpsc
+) {
+  *queue = (struct result_queue_s) { 0 };
+
+  if (capacity > MAX_CAPACITY || slot_size > SIZE_MAX / MAX_CAPACITY) {
+    return false;
+  }
+
+  size_t rounded = 2;
+
+  while (rounded < capacity) {
+    rounded *= 2;
+  }
+
+  // whole cache lines, so the neighbours of the ring never share one with it
+  size_t size = (rounded * slot_size + RESULT_QUEUE_LINE - 1)
+    & ~((size_t) RESULT_QUEUE_LINE - 1);
+
+  queue->slots = aligned_alloc(RESULT_QUEUE_LINE, size);
+
+  if (is_mpsc) {
+    queue->ready = calloc(rounded, sizeof(*queue->ready));
+  }
+
+  if (!queue->slots || (is_mpsc && !queue->ready)) {
+    result_queue_free(queue);
+    return false;
+  }
+
+  queue->mask = rounded - 1;
+  return true;
+}
+
+void result_queue_free(struct result_queue_s *queue) {
+  free(queue->slots);
+  free(queue->ready);
+
+  *queue = (struct result_queue_s) { 0 };
+}
@@ -0,0 +1,473 @@
+#ifndef __result_queue_h__
+#define __result_queue_h__
+
+#include "core/defs.h"
+#include "result.h"
+
+//
+// Bounded lock-free ring queues of results, for pipelines whose stages hand
+// results to each other:
+//
+//   - result_spsc_t: one producer thread, one consumer thread
+//   - result_mpsc_t: any number of producer threads, one consumer thread
+//
+//   typedef result_t(struct record_s, int) result_record_t;
+//   result_spsc_t(result_record_t) parsed;
+//
+//   if (!result_spsc_init(&parsed, 1024)) {
+//     // out of memory
+//   }
+//
+//   // parse stage
+//   if (!result_spsc_push(&parsed, res)) {
+//     // full
+//   }
+//
+//   // validate stage
+//   result_record_t batch[32];
+//   size_t n = result_spsc_pop_n(&parsed, batch, w_array_size(batch));
+//
+//   result_spsc_free(&parsed);
+//
+// Neither kind of queue blocks: push returns false when the queue is full and
+// pop returns false when it's empty, and what to do then (spin, yield, park)
+// is up to the caller. The _n variants move as many results as they can, up
+// to `_n`, and return how many they moved.
+//
+// The producer and consumer indices live on separate cache lines, and each
+// side caches the other side's index so it only touches the other cache line
+// when the queue looks full (or empty). Results are stored contiguously, so a
+// batch is one or two memcpy()s. The MPSC queue additionally has a publication
+// mark per slot: producers claim a range of slots with one CAS, fill it, and
+// the consumer reads slots as soon as they're marked.
+//
+// Error side channel: result_spsc_pop_ok_n / result_mpsc_pop_ok_n pop like
+// pop_n but write only the ok values, unwrapped, to `_ok`. Errs go to the
+// `_errs` MPSC queue instead, in order, so stages that only transform ok
+// values never see them and the last stage (or whoever reports errors) can
+// pick them up directly. Several stages can share one error queue.
+//
+
+#define RESULT_QUEUE_LINE 64
+
+struct result_queue_s {
+  // written by producers
+  uint64_t tail __attribute__((aligned(RESULT_QUEUE_LINE)));
+  uint64_t head_cache;
+
+  // written by the consumer
+  uint64_t head __attribute__((aligned(RESULT_QUEUE_LINE)));
+  uint64_t tail_cache;
+
+  // read-only after init
+  uint64_t mask __attribute__((aligned(RESULT_QUEUE_LINE)));
+  uint64_t *ready;
+  void *slots;
+};
+
+#define result_spsc_t(_result_type) \
+  struct result_spsc_d(_result_type)
+
+#define result_spsc_d(_result_type) { \
+  struct result_queue_s queue; \
+  char spsc[0]; \
+  _result_type slot[0]; \
+}
+
+#define result_mpsc_t(_result_type) \
+  struct result_mpsc_d(_result_type)
+
+#define result_mpsc_d(_result_type) { \
+  struct result_queue_s queue; \
+  char mpsc[0]; \
+  _result_type slot[0]; \
+}
+
+// Allocates room for at least `_capacity` results (rounded up to a power of
+// two). Returns false if out of memory or if the capacity is too large.
+#define result_spsc_init(_spsc, _capacity) ({ \
+  __typeof(&*(_spsc)) result_queue_self = (_spsc); \
+  (void) result_queue_self->spsc; \
+  \
+  result_queue_init( \
+    &result_queue_self->queue, \
+    (_capacity), \
+    sizeof(result_queue_self->slot[0]), \
+    false \
+  ); \
+})
+
+#define result_mpsc_init(_mpsc, _capacity) ({ \
+  __typeof(&*(_mpsc)) result_queue_self = (_mpsc); \
+  (void) result_queue_self->mpsc; \
+  \
+  result_queue_init( \
+    &result_queue_self->queue, \
+    (_capacity), \
+    sizeof(result_queue_self->slot[0]), \
+    true \
+  ); \
+})
+
+#define result_spsc_free(_spsc) result_queue_free(&(_spsc)->queue)
+#define result_mpsc_free(_mpsc) result_queue_free(&(_mpsc)->queue)
+
+#define result_spsc_capacity(_spsc) ((size_t) (_spsc)->queue.mask + 1)
+#define result_mpsc_capacity(_mpsc) ((size_t) (_mpsc)->queue.mask + 1)
+
+// Number of results in the queue. Only a snapshot while other threads are
+// pushing or popping.
+#define result_spsc_len(_spsc) result_queue_len(&(_spsc)->queue)
+#define result_mpsc_len(_mpsc) result_queue_len(&(_mpsc)->queue)
+
+#define result_spsc_push_n(_spsc, _results, _n) ({ \
+  __typeof(&*(_spsc)) result_queue_self = (_spsc); \
+  const __typeof(result_queue_self->slot[0]) *result_queue_src = (_results); \
+  (void) result_queue_self->spsc; \
+  \
+  result_spsc_push_raw( \
+    &result_queue_self->queue, \
+    result_queue_src, \
+    (_n), \
+    sizeof(result_queue_self->slot[0]) \
+  ); \
+})
+
+#define result_mpsc_push_n(_mpsc, _results, _n) ({ \
+  __typeof(&*(_mpsc)) result_queue_self = (_mpsc); \
+  const __typeof(result_queue_self->slot[0]) *result_queue_src = (_results); \
+  (void) result_queue_self->mpsc; \
+  \
+  result_mpsc_push_raw( \
+    &result_queue_self->queue, \
+    result_queue_src, \
+    (_n), \
+    sizeof(result_queue_self->slot[0]) \
+  ); \
+})
+
+#define result_spsc_pop_n(_spsc, _results, _n) ({ \
+  __typeof(&*(_spsc)) result_queue_self = (_spsc); \
+  __typeof(result_queue_self->slot[0]) *result_queue_dst = (_results); \
+  (void) result_queue_self->spsc; \
+  \
+  result_queue_pop_raw( \
+    &result_queue_self->queue, \
+    result_queue_dst, \
+    (_n), \
+    sizeof(result_queue_self->slot[0]), \
+    false \
+  ); \
+})
+
+#define result_mpsc_pop_n(_mpsc, _results, _n) ({ \
+  __typeof(&*(_mpsc)) result_queue_self = (_mpsc); \
+  __typeof(result_queue_self->slot[0]) *result_queue_dst = (_results); \
+  (void) result_queue_self->mpsc; \
+  \
+  result_queue_pop_raw( \
+    &result_queue_self->queue, \
+    result_queue_dst, \
+    (_n), \
+    sizeof(result_queue_self->slot[0]), \
+    true \
+  ); \
+})
+
+#define result_spsc_push(_spsc, _result) ({ \
+  __typeof((_spsc)->slot[0]) result_queue_res = (_result); \
+  result_spsc_push_n((_spsc), &result_queue_res, 1) == 1; \
+})
+
+#define result_mpsc_push(_mpsc, _result) ({ \
+  __typeof((_mpsc)->slot[0]) result_queue_res = (_result); \
+  result_mpsc_push_n((_mpsc), &result_queue_res, 1) == 1; \
+})
+
+// Pops one result into `*_out`. Returns false if the queue is empty.
+#define result_spsc_pop(_spsc, _out) \
+  (result_spsc_pop_n((_spsc), (_out), 1) == 1)
+
+#define result_mpsc_pop(_mpsc, _out) \
+  (result_mpsc_pop_n((_mpsc), (_out), 1) == 1)
+
+// Pops up to `_n` results, writing the ok values to the array `_ok` and
+// pushing the errs to the MPSC queue `_errs` (of the same result type).
+// Returns the number of ok values written. Stops early at an err that doesn't
+// fit in `_errs`, leaving it in the queue.
+#define result_spsc_pop_ok_n(_spsc, _ok, _n, _errs) \
+  result_queue_pop_ok_n(spsc, false, (_spsc), (_ok), (_n), (_errs))
+
+#define result_mpsc_pop_ok_n(_mpsc, _ok, _n, _errs) \
+  result_queue_pop_ok_n(mpsc, true, (_mpsc), (_ok), (_n), (_errs))
+
+#define result_queue_pop_ok_n(_kind, _is_mpsc, _queue, _ok, _n, _errs) ({ \
+  __typeof(&*(_queue)) result_queue_self = (_queue); \
+  __typeof(result_queue_self->slot[0].body.ok) *result_queue_ok = (_ok); \
+  size_t result_queue_want = (_n); \
+  __typeof(&*(_errs)) result_queue_errs = (_errs); \
+  size_t result_queue_ok_len = 0; \
+  size_t result_queue_done = 0; \
+  bool result_queue_blocked = false; \
+  (void) result_queue_self->_kind; \
+  (void) result_queue_errs->mpsc; \
+  \
+  _Static_assert( \
+    sizeof(result_queue_self->slot[0]) == sizeof(result_queue_errs->slot[0]), \
+    "the error queue must hold the same result type" \
+  ); \
+  \
+  while (!result_queue_blocked && result_queue_done < result_queue_want) { \
+    void *result_queue_peeked_at; \
+    \
+    size_t result_queue_peeked = result_queue_peek( \
+      &result_queue_self->queue, \
+      &result_queue_peeked_at, \
+      result_queue_want - result_queue_done, \
+      sizeof(result_queue_self->slot[0]), \
+      (_is_mpsc) \
+    ); \
+    \
+    __typeof(result_queue_self->slot[0]) *result_queue_slots = \
+      result_queue_peeked_at; \
+    \
+    if (result_queue_peeked == 0) { \
+      break; \
+    } \
+    \
+    size_t result_queue_i = 0; \
+    \
+    for (; result_queue_i < result_queue_peeked; result_queue_i++) { \
+      if (result_is_ok(result_queue_slots[result_queue_i])) { \
+        result_queue_ok[result_queue_ok_len++] = \
+          result_unwrap_unchecked(result_queue_slots[result_queue_i]); \
+      } \
+      \
+      else if (!result_mpsc_push_raw( \
+        &result_queue_errs->queue, \
+        &result_queue_slots[result_queue_i], \
+        1, \
+        sizeof(result_queue_self->slot[0]) \
+      )) { \
+        result_queue_blocked = true; \
+        break; \
+      } \
+    } \
+    \
+    result_queue_release(&result_queue_self->queue, result_queue_i); \
+    result_queue_done += result_queue_i; \
+  } \
+  \
+  result_queue_ok_len; \
+})
+
+//
+// Used by the macros above
+//
+
+extern bool result_queue_init(
+  struct result_queue_s *queue,
+  size_t capacity,
+  size_t slot_size,
+  bool is_mpsc
+);
+
+extern void result_queue_free(struct result_queue_s *queue);
+
+static inline __attribute__((always_inline, unused))
+size_t result_queue_len(struct result_queue_s *queue) {
+  uint64_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+  uint64_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+
+  // a producer may have claimed slots it hasn't published yet
+  return tail > head ? (size_t) (tail - head) : 0;
+}
+
+static inline __attribute__((always_inline, unused))
+void result_queue_copy_in(
+  struct result_queue_s *queue,
+  uint64_t position,
+  const void *src,
+  size_t n,
+  size_t slot_size
+) {
+  size_t start = (size_t) (position & queue->mask);
+  char *slots = queue->slots;
+
+  if (n == 1) {
+    memcpy(slots + start * slot_size, src, slot_size);
+    return;
+  }
+
+  size_t first = w_min_2(n, (size_t) queue->mask + 1 - start);
+
+  memcpy(slots + start * slot_size, src, first * slot_size);
+  memcpy(slots, (const char *) src + first * slot_size, (n - first) * slot_size);
+}
+
+// Free slots for a producer at `tail`, refreshing the cached consumer index if
+// there aren't `wanted` of them.
+static inline __attribute__((always_inline, unused))
+size_t result_queue_room(
+  struct result_queue_s *queue,
+  uint64_t tail,
+  size_t wanted
+) {
+  uint64_t capacity = queue->mask + 1;
+  uint64_t head = __atomic_load_n(&queue->head_cache, __ATOMIC_ACQUIRE);
+
+  // with several producers the cache can lag behind a tail that has already
+  // moved past it by more than a lap
+  if (tail - head >= capacity || capacity - (tail - head) < wanted) {
+    head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&queue->head_cache, head, __ATOMIC_RELEASE);
+  }
+
+  uint64_t used = tail - head;
+  return used < capacity ? (size_t) (capacity - used) : 0;
+}
+
+static inline __attribute__((always_inline, unused))
+size_t result_spsc_push_raw(
+  struct result_queue_s *queue,
+  const void *src,
+  size_t n,
+  size_t slot_size
+) {
+  uint64_t tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+  size_t count = w_min_2(n, result_queue_room(queue, tail, n));
+
+  if (count > 0) {
+    result_queue_copy_in(queue, tail, src, count, slot_size);
+    __atomic_store_n(&queue->tail, tail + count, __ATOMIC_RELEASE);
+  }
+
+  return count;
+}
+
+static inline __attribute__((always_inline, unused))
+size_t result_mpsc_push_raw(
+  struct result_queue_s *queue,
+  const void *src,
+  size_t n,
+  size_t slot_size
+) {
+  uint64_t tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+  size_t count;
+
+  do {
+    count = w_min_2(n, result_queue_room(queue, tail, n));
+
+    if (count == 0) {
+      return 0;
+    }
+  } while (!__atomic_compare_exchange_n(
+    &queue->tail,
+    &tail,
+    tail + count,
+    true,
+    __ATOMIC_RELAXED,
+    __ATOMIC_RELAXED
+  ));
+
+  result_queue_copy_in(queue, tail, src, count, slot_size);
+
+  for (size_t i = 0; i < count; i++) {
+    uint64_t position = tail + i;
+
+    __atomic_store_n(
+      &queue->ready[position & queue->mask],
+      position + 1,
+      __ATOMIC_RELEASE
+    );
+  }
+
+  return count;
+}
+
+// Points `*slots` at up to `n` results that are ready to be read, contiguous
+// in memory, and returns how many there are. They stay in the queue until
+// result_queue_release().
+static inline __attribute__((always_inline, unused))
+size_t result_queue_peek(
+  struct result_queue_s *queue,
+  void **slots,
+  size_t n,
+  size_t slot_size,
+  bool is_mpsc
+) {
+  uint64_t head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+  size_t start = (size_t) (head & queue->mask);
+  size_t limit = w_min_2(n, (size_t) queue->mask + 1 - start);
+  size_t count = 0;
+
+  if (is_mpsc) {
+    while (
+      count < limit
+      && __atomic_load_n(&queue->ready[start + count], __ATOMIC_ACQUIRE)
+        == head + count + 1
+    ) {
+      count++;
+    }
+  }
+
+  else {
+    uint64_t tail = queue->tail_cache;
+
+    if (tail - head < limit) {
+      tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+      queue->tail_cache = tail;
+    }
+
+    count = w_min_2(limit, (size_t) (tail - head));
+  }
+
+  *slots = (char *) queue->slots + start * slot_size;
+  return count;
+}
+
+static inline __attribute__((always_inline, unused))
+void result_queue_release(struct result_queue_s *queue, size_t n) {
+  uint64_t head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+  __atomic_store_n(&queue->head, head + n, __ATOMIC_RELEASE);
+}
+
+static inline __attribute__((always_inline, unused))
+size_t result_queue_pop_raw(
+  struct result_queue_s *queue,
+  void *dst,
+  size_t n,
+  size_t slot_size,
+  bool is_mpsc
+) {
+  size_t count = 0;
+
+  // at most twice, when the results wrap around the end of the ring
+  while (count < n) {
+    void *slots;
+    size_t peeked = result_queue_peek(
+      queue,
+      &slots,
+      n - count,
+      slot_size,
+      is_mpsc
+    );
+
+    if (peeked == 0) {
+      break;
+    }
+
+    if (n == 1) {
+      memcpy(dst, slots, slot_size);
+    } else {
+      memcpy((char *) dst + count * slot_size, slots, peeked * slot_size);
+    }
+
+    result_queue_release(queue, peeked);
+    count += peeked;
+  }
+
+  return count;
+}
+
+#endif // __result_queue_h__
@@ -0,0 +1,445 @@
+#include "core/defs.h"
+#include "result_queue.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+typedef result_t(uint32_t, int32_t) result_u32_t;
+typedef result_spsc_t(result_u32_t) spsc_u32_t;
+typedef result_mpsc_t(result_u32_t) mpsc_u32_t;
+
+struct producer_s {
+  mpsc_u32_t *queue;
+  uint32_t id;
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static result_u32_t make(uint32_t i);
+static void *produce_spsc(void *arg);
+static void *produce_mpsc(void *arg);
+static void test_init(void **ts);
+static void test_spsc_push_pop(void **ts);
+static void test_spsc_full(void **ts);
+static void test_spsc_batches_wrap(void **ts);
+static void test_mpsc_push_pop(void **ts);
+static void test_mpsc_batches_wrap(void **ts);
+static void test_pop_ok_n(void **ts);
+static void test_pop_ok_n_blocked(void **ts);
+static void test_spsc_threads(void **ts);
+static void test_mpsc_threads(void **ts);
+/*sublime-c-static-fn-hoist-end*/
+
+#define PRODUCERS 4
+#define PER_PRODUCER 20000
+#define BATCH 7
+
+// Every 5th result is an err.
+static result_u32_t make(uint32_t i) {
+  if (i % 5 == 4) {
+    return (result_u32_t) result_init_err(-(int32_t) i);
+  }
+
+  return (result_u32_t) result_init_ok(i);
+}
+
+static void *produce_spsc(void *arg) {
+  spsc_u32_t *queue = arg;
+  result_u32_t batch[BATCH];
+  uint32_t i = 0;
+
+  while (i < PER_PRODUCER) {
+    size_t n = w_min_2((size_t) BATCH, (size_t) (PER_PRODUCER - i));
+
+    for (size_t j = 0; j < n; j++) {
+      batch[j] = make(i + (uint32_t) j);
+    }
+
+    size_t pushed = 0;
+
+    while (pushed < n) {
+      pushed += result_spsc_push_n(queue, &batch[pushed], n - pushed);
+      sched_yield();
+    }
+
+    i += (uint32_t) n;
+  }
+
+  return NULL;
+}
+
+// Producer `id` pushes id * PER_PRODUCER + [0, PER_PRODUCER).
+static void *produce_mpsc(void *arg) {
+  struct producer_s *producer = arg;
+  uint32_t base = producer->id * PER_PRODUCER;
+
+  for (uint32_t i = 0; i < PER_PRODUCER; i++) {
+    if (i % 3 == 0 && i + BATCH <= PER_PRODUCER) {
+      result_u32_t batch[BATCH];
+
+      for (size_t j = 0; j < BATCH; j++) {
+        batch[j] = (result_u32_t) result_init_ok(base + i + (uint32_t) j);
+      }
+
+      size_t pushed = 0;
+
+      while (pushed < BATCH) {
+        pushed += result_mpsc_push_n(
+          producer->queue,
+          &batch[pushed],
+          BATCH - pushed
+        );
+
+        sched_yield();
+      }
+
+      i += BATCH - 1;
+      continue;
+    }
+
+    while (!result_mpsc_push(
+      producer->queue,
+      (result_u32_t) result_init_ok(base + i)
+    )) {
+      sched_yield();
+    }
+  }
+
+  return NULL;
+}
+
+static void test_init(void **ts) {
+  spsc_u32_t spsc;
+  mpsc_u32_t mpsc;
+
+  assert_true(result_spsc_init(&spsc, 5));
+  assert_int_equal(8, result_spsc_capacity(&spsc));
+  assert_int_equal(0, result_spsc_len(&spsc));
+  assert_true((uintptr_t) spsc.queue.slots % RESULT_QUEUE_LINE == 0);
+  result_spsc_free(&spsc);
+
+  assert_true(result_mpsc_init(&mpsc, 0));
+  assert_int_equal(2, result_mpsc_capacity(&mpsc));
+  assert_non_null(mpsc.queue.ready);
+  result_mpsc_free(&mpsc);
+
+  assert_false(result_mpsc_init(&mpsc, SIZE_MAX));
+  assert_null(mpsc.queue.slots);
+
+  // the indices of each side are on their own cache line
+  assert_true(
+    __builtin_offsetof(struct result_queue_s, head)
+      - __builtin_offsetof(struct result_queue_s, tail)
+      >= RESULT_QUEUE_LINE
+  );
+}
+
+static void test_spsc_push_pop(void **ts) {
+  spsc_u32_t queue;
+  result_u32_t res = result_init_err(0);
+
+  assert_true(result_spsc_init(&queue, 4));
+  assert_false(result_spsc_pop(&queue, &res));
+
+  for (uint32_t i = 0; i < 100; i++) {
+    assert_true(result_spsc_push(&queue, make(i)));
+    assert_int_equal(1, result_spsc_len(&queue));
+    assert_true(result_spsc_pop(&queue, &res));
+
+    if (i % 5 == 4) {
+      assert_int_equal(-(int32_t) i, result_unwrap_err_unchecked(res));
+    } else {
+      assert_int_equal(i, result_unwrap_unchecked(res));
+    }
+  }
+
+  assert_false(result_spsc_pop(&queue, &res));
+  result_spsc_free(&queue);
+}
+
+static void test_spsc_full(void **ts) {
+  spsc_u32_t queue;
+  result_u32_t res;
+
+  assert_true(result_spsc_init(&queue, 4));
+
+  for (uint32_t i = 0; i < 4; i++) {
+    assert_true(result_spsc_push(&queue, make(i)));
+  }
+
+  assert_false(result_spsc_push(&queue, make(4)));
+  assert_int_equal(4, result_spsc_len(&queue));
+
+  assert_true(result_spsc_pop(&queue, &res));
+  assert_int_equal(0, result_unwrap_unchecked(res));
+  assert_true(result_spsc_push(&queue, make(4)));
+
+  for (uint32_t i = 1; i <= 4; i++) {
+    assert_true(result_spsc_pop(&queue, &res));
+    assert_int_equal(i % 5 == 4, result_is_err(res));
+  }
+
+  result_spsc_free(&queue);
+}
+
+static void test_spsc_batches_wrap(void **ts) {
+  spsc_u32_t queue;
+  result_u32_t in[16];
+  result_u32_t out[16];
+  uint32_t next_in = 0;
+  uint32_t next_out = 0;
+
+  assert_true(result_spsc_init(&queue, 8));
+
+  for (int round = 0; round < 50; round++) {
+    size_t want = (size_t) (round % 11) + 1;
+
+    for (size_t j = 0; j < want; j++) {
+      in[j] = make(next_in + (uint32_t) j);
+    }
+
+    size_t pushed = result_spsc_push_n(&queue, in, want);
+    assert_true(pushed <= want);
+    next_in += (uint32_t) pushed;
+
+    size_t popped = result_spsc_pop_n(&queue, out, (size_t) (round % 5) + 1);
+
+    for (size_t j = 0; j < popped; j++) {
+      result_u32_t expected = make(next_out++);
+
+      assert_int_equal(result_is_ok(expected), result_is_ok(out[j]));
+      assert_memory_equal(&expected.body, &out[j].body, sizeof(out[j].body));
+    }
+  }
+
+  // everything that went in comes out, in order
+  size_t popped;
+
+  while ((popped = result_spsc_pop_n(&queue, out, w_array_size(out)))) {
+    for (size_t j = 0; j < popped; j++) {
+      result_u32_t expected = make(next_out++);
+      assert_memory_equal(&expected.body, &out[j].body, sizeof(out[j].body));
+    }
+  }
+
+  assert_int_equal(next_in, next_out);
+  result_spsc_free(&queue);
+}
+
+static void test_mpsc_push_pop(void **ts) {
+  mpsc_u32_t queue;
+  result_u32_t res = result_init_err(0);
+
+  assert_true(result_mpsc_init(&queue, 4));
+  assert_false(result_mpsc_pop(&queue, &res));
+
+  for (uint32_t i = 0; i < 4; i++) {
+    assert_true(result_mpsc_push(&queue, make(i)));
+  }
+
+  assert_false(result_mpsc_push(&queue, make(4)));
+
+  for (uint32_t i = 0; i < 4; i++) {
+    assert_true(result_mpsc_pop(&queue, &res));
+    assert_int_equal(i, result_unwrap_unchecked(res));
+  }
+
+  assert_false(result_mpsc_pop(&queue, &res));
+  result_mpsc_free(&queue);
+}
+
+static void test_mpsc_batches_wrap(void **ts) {
+  mpsc_u32_t queue;
+  result_u32_t in[16];
+  result_u32_t out[16];
+  uint32_t next_in = 0;
+  uint32_t next_out = 0;
+
+  assert_true(result_mpsc_init(&queue, 16));
+
+  for (int round = 0; round < 50; round++) {
+    size_t want = (size_t) (round % 13) + 1;
+
+    for (size_t j = 0; j < want; j++) {
+      in[j] = make(next_in + (uint32_t) j);
+    }
+
+    next_in += (uint32_t) result_mpsc_push_n(&queue, in, want);
+
+    size_t popped = result_mpsc_pop_n(&queue, out, (size_t) (round % 7) + 1);
+
+    for (size_t j = 0; j < popped; j++) {
+      result_u32_t expected = make(next_out++);
+      assert_memory_equal(&expected.body, &out[j].body, sizeof(out[j].body));
+    }
+  }
+
+  result_mpsc_free(&queue);
+}
+
+static void test_pop_ok_n(void **ts) {
+  spsc_u32_t queue;
+  mpsc_u32_t errs;
+  uint32_t ok[32];
+
+  assert_true(result_spsc_init(&queue, 32));
+  assert_true(result_mpsc_init(&errs, 32));
+
+  for (uint32_t i = 0; i < 20; i++) {
+    assert_true(result_spsc_push(&queue, make(i)));
+  }
+
+  size_t n = result_spsc_pop_ok_n(&queue, ok, 12, &errs);
+
+  // 0..11 minus the errs at 4 and 9
+  assert_int_equal(10, n);
+  assert_int_equal(8, result_spsc_len(&queue));
+
+  for (size_t i = 0, expected = 0; i < n; i++, expected++) {
+    if (expected % 5 == 4) {
+      expected++;
+    }
+
+    assert_int_equal(expected, ok[i]);
+  }
+
+  n = result_spsc_pop_ok_n(&queue, ok, w_array_size(ok), &errs);
+  assert_int_equal(6, n);
+  assert_int_equal(18, ok[5]);
+
+  // the errs are in the side channel, in order
+  result_u32_t err = result_init_err(0);
+
+  for (int32_t expected = 4; expected < 20; expected += 5) {
+    assert_true(result_mpsc_pop(&errs, &err));
+    assert_int_equal(-expected, result_unwrap_err_unchecked(err));
+  }
+
+  assert_false(result_mpsc_pop(&errs, &err));
+
+  result_spsc_free(&queue);
+  result_mpsc_free(&errs);
+}
+
+static void test_pop_ok_n_blocked(void **ts) {
+  mpsc_u32_t queue;
+  mpsc_u32_t errs;
+  uint32_t ok[32];
+  result_u32_t res = result_init_err(0);
+
+  assert_true(result_mpsc_init(&queue, 32));
+  assert_true(result_mpsc_init(&errs, 2));
+
+  for (uint32_t i = 0; i < 20; i++) {
+    assert_true(result_mpsc_push(&queue, make(i)));
+  }
+
+  // the third err (14) doesn't fit and stays in the queue
+  size_t n = result_mpsc_pop_ok_n(&queue, ok, w_array_size(ok), &errs);
+  assert_int_equal(12, n);
+  assert_int_equal(13, ok[n - 1]);
+
+  assert_true(result_mpsc_pop(&queue, &res));
+  assert_int_equal(-14, result_unwrap_err_unchecked(res));
+
+  assert_int_equal(2, result_mpsc_len(&errs));
+
+  result_mpsc_free(&queue);
+  result_mpsc_free(&errs);
+}
+
+static void test_spsc_threads(void **ts) {
+  spsc_u32_t queue;
+  pthread_t thread;
+  result_u32_t out[BATCH + 2];
+  uint32_t next = 0;
+
+  assert_true(result_spsc_init(&queue, 64));
+  assert_int_equal(0, pthread_create(&thread, NULL, produce_spsc, &queue));
+
+  while (next < PER_PRODUCER) {
+    size_t n = result_spsc_pop_n(&queue, out, w_array_size(out));
+
+    if (n == 0) {
+      sched_yield();
+    }
+
+    for (size_t j = 0; j < n; j++) {
+      result_u32_t expected = make(next++);
+
+      assert_int_equal(result_is_ok(expected), result_is_ok(out[j]));
+      assert_memory_equal(&expected.body, &out[j].body, sizeof(out[j].body));
+    }
+  }
+
+  assert_int_equal(0, pthread_join(thread, NULL));
+  result_spsc_free(&queue);
+}
+
+static void test_mpsc_threads(void **ts) {
+  mpsc_u32_t queue;
+  pthread_t threads[PRODUCERS];
+  struct producer_s producers[PRODUCERS];
+  uint32_t next[PRODUCERS] = { 0 };
+  result_u32_t out[16];
+  size_t total = 0;
+
+  assert_true(result_mpsc_init(&queue, 256));
+
+  for (uint32_t i = 0; i < PRODUCERS; i++) {
+    producers[i] = (struct producer_s) { .queue = &queue, .id = i };
+
+    int status = pthread_create(
+      &threads[i],
+      NULL,
+      produce_mpsc,
+      &producers[i]
+    );
+
+    assert_int_equal(0, status);
+  }
+
+  while (total < PRODUCERS * PER_PRODUCER) {
+    size_t n = result_mpsc_pop_n(&queue, out, w_array_size(out));
+
+    if (n == 0) {
+      sched_yield();
+    }
+
+    // each producer's results arrive in the order it pushed them
+    for (size_t j = 0; j < n; j++) {
+      uint32_t value = result_unwrap_unchecked(out[j]);
+      uint32_t id = value / PER_PRODUCER;
+
+      assert_true(id < PRODUCERS);
+      assert_int_equal(next[id], value % PER_PRODUCER);
+      next[id]++;
+    }
+
+    total += n;
+  }
+
+  for (size_t i = 0; i < PRODUCERS; i++) {
+    assert_int_equal(0, pthread_join(threads[i], NULL));
+    assert_int_equal(PER_PRODUCER, next[i]);
+  }
+
+  assert_int_equal(0, result_mpsc_len(&queue));
+  result_mpsc_free(&queue);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_init),
+    cmocka_unit_test(test_spsc_push_pop),
+    cmocka_unit_test(test_spsc_full),
+    cmocka_unit_test(test_spsc_batches_wrap),
+    cmocka_unit_test(test_mpsc_push_pop),
+    cmocka_unit_test(test_mpsc_batches_wrap),
+    cmocka_unit_test(test_pop_ok_n),
+    cmocka_unit_test(test_pop_ok_n_blocked),
+    cmocka_unit_test(test_spsc_threads),
+    cmocka_unit_test(test_mpsc_threads),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,1081 @@
+#include "result_simd.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define RESULT_SIMD_X86 1
+#else
+  #define RESULT_SIMD_X86 0
+#endif
+
+//
+// All vector paths share one trick: they first shuffle a block of elements
+// into "normalized" 64-bit lanes, one per element, with the ok value (if it is
+// 4 bytes) in the low dword and the dword holding the tag in the high dword.
+// After that the tag test, blend and compaction are the same no matter which
+// layout the elements came from.
+//
+
+struct plan_s {
+  size_t stride;
+  size_t tag_offset;
+  size_t ok_offset;
+  size_t ok_size;
+
+  // dword indices within an element, and the tag's bit position within its
+  // dword
+  unsigned tag_dword;
+  unsigned tag_shift;
+  unsigned ok_dword;
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static struct plan_s plan_of(struct result_layout_s layout);
+static enum result_simd_level_e plan_level(
+  const struct plan_s *plan,
+  bool needs_values,
+  bool needs_compress
+);
+static enum result_simd_level_e detect_level(void);
+static inline bool scalar_is_ok(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t i
+);
+static size_t scalar_count_err(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t i,
+  size_t len
+);
+static inline void scalar_copy(void *dst, const void *src, size_t size);
+/*sublime-c-static-fn-hoist-end*/
+
+static enum result_simd_level_e forced_level = RESULT_SIMD_AVX512;
+
+enum result_simd_level_e result_simd_level(void) {
+  static int detected = -1;
+
+  // racing threads all detect the same thing, so this needs no locking, only
+  // atomic loads and stores
+  int level = __atomic_load_n(&detected, __ATOMIC_RELAXED);
+
+  if (level < 0) {
+    level = (int) detect_level();
+    __atomic_store_n(&detected, level, __ATOMIC_RELAXED);
+  }
+
+  enum result_simd_level_e forced = __atomic_load_n(
+    &forced_level,
+    __ATOMIC_RELAXED
+  );
+
+  return w_min_2((enum result_simd_level_e) level, forced);
+}
+
+enum result_simd_level_e result_simd_force_level(
+  enum result_simd_level_e level
+) {
+  __atomic_store_n(&forced_level, level, __ATOMIC_RELAXED);
+  return result_simd_level();
+}
+
+static enum result_simd_level_e detect_level(void) {
+#if RESULT_SIMD_X86
+  __builtin_cpu_init();
+
+  // every CPU with AVX2 has popcnt too, but check anyway since the kernels
+  // are compiled to use it
+  bool has_popcnt = __builtin_cpu_supports("popcnt");
+
+  if (has_popcnt && __builtin_cpu_supports("avx512f")) {
+    return RESULT_SIMD_AVX512;
+  }
+
+  if (has_popcnt && __builtin_cpu_supports("avx2")) {
+    return RESULT_SIMD_AVX2;
+  }
+
+  if (__builtin_cpu_supports("sse2")) {
+    return RESULT_SIMD_SSE2;
+  }
+#endif
+
+  return RESULT_SIMD_SCALAR;
+}
+
+static struct plan_s plan_of(struct result_layout_s layout) {
+  return (struct plan_s) {
+    .stride = layout.stride,
+    .tag_offset = layout.tag_offset,
+    .ok_offset = layout.ok_offset,
+    .ok_size = layout.ok_size,
+    .tag_dword = (unsigned) (layout.tag_offset / 4),
+    .tag_shift = (unsigned) (layout.tag_offset % 4) * 8,
+    .ok_dword = (unsigned) (layout.ok_offset / 4),
+  };
+}
+
+// Highest level that has a kernel for this layout.
+static enum result_simd_level_e plan_level(
+  const struct plan_s *plan,
+  bool needs_values,
+  bool needs_compress
+) {
+  enum result_simd_level_e level = result_simd_level();
+
+  if (plan->stride != 8 && plan->stride != 16) {
+    return RESULT_SIMD_SCALAR;
+  }
+
+  if (needs_values && (plan->ok_size != 4 || plan->ok_offset % 4 != 0)) {
+    return RESULT_SIMD_SCALAR;
+  }
+
+  if (level == RESULT_SIMD_SSE2) {
+    // SSE2 has no variable shuffles, so it only handles the common layouts:
+    // result_t(4 bytes, 4 bytes) and result_padded_t(4 bytes, ...)
+    bool is_common = plan->stride == 8
+      ? plan->tag_dword == 1 && (!needs_values || plan->ok_dword == 0)
+      : plan->tag_dword == 0 && (!needs_values || plan->ok_dword == 2);
+
+    if (!is_common || needs_compress) {
+      return RESULT_SIMD_SCALAR;
+    }
+  }
+
+  return level;
+}
+
+//
+// scalar
+//
+
+static inline bool scalar_is_ok(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t i
+) {
+  return array[i * plan->stride + plan->tag_offset] != 0;
+}
+
+static size_t scalar_count_err(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t i,
+  size_t len
+) {
+  size_t count = 0;
+
+  for (; i < len; i++) {
+    count += !scalar_is_ok(plan, array, i);
+  }
+
+  return count;
+}
+
+// memcpy(3) with the common sizes spelled out so they compile to plain moves.
+static inline void scalar_copy(void *dst, const void *src, size_t size) {
+  switch (size) {
+    case 1: memcpy(dst, src, 1); break;
+    case 2: memcpy(dst, src, 2); break;
+    case 4: memcpy(dst, src, 4); break;
+    case 8: memcpy(dst, src, 8); break;
+    case 16: memcpy(dst, src, 16); break;
+    default: memcpy(dst, src, size); break;
+  }
+}
+
+// The scalar loops are always inlined into a switch over the common sizes, so
+// each case gets a copy where `size` is a constant.
+
+#define SCALAR static inline __attribute__((always_inline))
+
+SCALAR void scalar_unwrap_or(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t i,
+  size_t len,
+  const void *default_value,
+  uint8_t *out,
+  size_t size
+) {
+  for (; i < len; i++) {
+    const void *src = scalar_is_ok(plan, array, i)
+      ? array + i * plan->stride + plan->ok_offset
+      : default_value;
+
+    scalar_copy(out + i * size, src, size);
+  }
+}
+
+SCALAR size_t scalar_compact_ok(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t i,
+  size_t len,
+  uint8_t *out,
+  size_t n,
+  size_t size
+) {
+  // write unconditionally and only advance on ok, which keeps the loop free
+  // of unpredictable branches
+  for (; i < len; i++) {
+    scalar_copy(out + n * size, array + i * plan->stride + plan->ok_offset, size);
+    n += scalar_is_ok(plan, array, i);
+  }
+
+  return n;
+}
+
+SCALAR void scalar_partition(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t i,
+  size_t len,
+  uint8_t *ok_out,
+  uint8_t *err_out,
+  size_t stride
+) {
+  for (; i < len; i++) {
+    bool is_ok = scalar_is_ok(plan, array, i);
+
+    scalar_copy(is_ok ? ok_out : err_out, array + i * stride, stride);
+    ok_out += is_ok * stride;
+    err_out += !is_ok * stride;
+  }
+}
+
+#undef SCALAR
+
+#if RESULT_SIMD_X86
+
+//
+// SSE2, 2 elements per vector
+//
+
+#define SSE2 __attribute__((target("sse2")))
+
+SSE2 static inline __m128i sse2_load(const struct plan_s *plan, const uint8_t *p) {
+  if (plan->stride == 8) {
+    return _mm_loadu_si128((const __m128i *) p);
+  }
+
+  // [tag, pad, value, pad] per element -> [value, tag]
+  __m128i a = _mm_loadu_si128((const __m128i *) p);
+  __m128i b = _mm_loadu_si128((const __m128i *) (p + 16));
+
+  a = _mm_shuffle_epi32(a, _MM_SHUFFLE(0, 2, 0, 2));
+  b = _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 2, 0, 2));
+
+  return _mm_unpacklo_epi64(a, b);
+}
+
+// Lanes of errs all ones.
+SSE2 static inline __m128i sse2_err_lanes(__m128i lanes, __m128i tag_mask) {
+  __m128i eq = _mm_cmpeq_epi32(
+    _mm_and_si128(lanes, tag_mask),
+    _mm_setzero_si128()
+  );
+
+  // the tag compare only means something in the high dword of each lane
+  return _mm_shuffle_epi32(eq, _MM_SHUFFLE(3, 3, 1, 1));
+}
+
+SSE2 static inline __m128i sse2_tag_mask(const struct plan_s *plan) {
+  return _mm_set1_epi64x((long long) (0xffull << (32 + plan->tag_shift)));
+}
+
+SSE2 static inline unsigned sse2_err_bits(__m128i err) {
+  return (unsigned) _mm_movemask_pd(_mm_castsi128_pd(err));
+}
+
+SSE2 static size_t sse2_count_err(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t len,
+  size_t *done
+) {
+  __m128i tag_mask = sse2_tag_mask(plan);
+  __m128i counts = _mm_setzero_si128();
+  uint64_t lane_counts[2];
+  size_t i = 0;
+
+  // no popcnt in SSE2, so count in the lanes instead: an err lane is -1
+  for (; i + 2 <= len; i += 2) {
+    __m128i lanes = sse2_load(plan, array + i * plan->stride);
+    counts = _mm_sub_epi64(counts, sse2_err_lanes(lanes, tag_mask));
+  }
+
+  _mm_storeu_si128((__m128i *) lane_counts, counts);
+
+  *done = i;
+  return lane_counts[0] + lane_counts[1];
+}
+
+SSE2 static bool sse2_any_err(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t len,
+  size_t *done
+) {
+  __m128i tag_mask = sse2_tag_mask(plan);
+  size_t i = 0;
+
+  for (; i + 8 <= len; i += 8) {
+    __m128i err = _mm_setzero_si128();
+
+    for (size_t j = 0; j < 8; j += 2) {
+      __m128i lanes = sse2_load(plan, array + (i + j) * plan->stride);
+      err = _mm_or_si128(err, sse2_err_lanes(lanes, tag_mask));
+    }
+
+    if (sse2_err_bits(err)) {
+      *done = i;
+      return true;
+    }
+  }
+
+  *done = i;
+  return false;
+}
+
+SSE2 static void sse2_unwrap_or(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t len,
+  int32_t default_value,
+  int32_t *out,
+  size_t *done
+) {
+  __m128i tag_mask = sse2_tag_mask(plan);
+  __m128i defaults = _mm_set1_epi32(default_value);
+  size_t i = 0;
+
+  for (; i + 2 <= len; i += 2) {
+    __m128i lanes = sse2_load(plan, array + i * plan->stride);
+    __m128i err = sse2_err_lanes(lanes, tag_mask);
+
+    __m128i values = _mm_or_si128(
+      _mm_and_si128(err, defaults),
+      _mm_andnot_si128(err, lanes)
+    );
+
+    values = _mm_shuffle_epi32(values, _MM_SHUFFLE(2, 0, 2, 0));
+    _mm_storel_epi64((__m128i *) (out + i), values);
+  }
+
+  *done = i;
+}
+
+#undef SSE2
+
+//
+// AVX2, 4 elements per vector
+//
+
+#define AVX2 __attribute__((target("avx2,popcnt")))
+
+// Permutation that gathers [value, tag] dwords into the low half of a vector
+// of two 16 byte elements, or all four lanes for 8 byte elements.
+AVX2 static inline __m256i avx2_normalize_index(const struct plan_s *plan) {
+  unsigned dwords_per_element = (unsigned) plan->stride / 4;
+  unsigned elements = 4 / (dwords_per_element / 2);
+  int32_t permute[8] = { 0 };
+
+  for (unsigned e = 0; e < elements; e++) {
+    unsigned base = e * dwords_per_element;
+
+    permute[2 * e] = (int32_t) (base + plan->ok_dword);
+    permute[2 * e + 1] = (int32_t) (base + plan->tag_dword);
+  }
+
+  return _mm256_loadu_si256((const __m256i *) permute);
+}
+
+AVX2 static inline __m256i avx2_load(
+  const struct plan_s *plan,
+  __m256i permute,
+  const uint8_t *p
+) {
+  __m256i a = _mm256_permutevar8x32_epi32(
+    _mm256_loadu_si256((const __m256i *) p),
+    permute
+  );
+
+  if (plan->stride == 8) {
+    return a;
+  }
+
+  __m256i b = _mm256_permutevar8x32_epi32(
+    _mm256_loadu_si256((const __m256i *) (p + 32)),
+    permute
+  );
+
+  return _mm256_permute2x128_si256(a, b, 0x20);
+}
+
+AVX2 static inline __m256i avx2_tag_mask(const struct plan_s *plan) {
+  return _mm256_set1_epi64x((long long) (0xffull << (32 + plan->tag_shift)));
+}
+
+AVX2 static inline __m256i avx2_err_lanes(__m256i lanes, __m256i tag_mask) {
+  return _mm256_cmpeq_epi64(
+    _mm256_and_si256(lanes, tag_mask),
+    _mm256_setzero_si256()
+  );
+}
+
+AVX2 static inline unsigned avx2_err_bits(__m256i err) {
+  return (unsigned) _mm256_movemask_pd(_mm256_castsi256_pd(err));
+}
+
+// Dword permutations that move the lanes set in the mask to the front.
+AVX2 static void avx2_compress_table(__m256i table[16]) {
+  for (unsigned mask = 0; mask < 16; mask++) {
+    int32_t permute[8] = { 0 };
+    unsigned n = 0;
+
+    for (unsigned lane = 0; lane < 4; lane++) {
+      if (mask & (1u << lane)) {
+        permute[2 * n] = (int32_t) (2 * lane);
+        permute[2 * n + 1] = (int32_t) (2 * lane + 1);
+        n++;
+      }
+    }
+
+    table[mask] = _mm256_loadu_si256((const __m256i *) permute);
+  }
+}
+
+AVX2 static size_t avx2_count_err(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t len,
+  size_t *done
+) {
+  __m256i permute = avx2_normalize_index(plan);
+  __m256i tag_mask = avx2_tag_mask(plan);
+  size_t count = 0;
+  size_t i = 0;
+
+  for (; i + 4 <= len; i += 4) {
+    __m256i lanes = avx2_load(plan, permute, array + i * plan->stride);
+    count += __builtin_popcount(avx2_err_bits(avx2_err_lanes(lanes, tag_mask)));
+  }
+
+  *done = i;
+  return count;
+}
+
+AVX2 static bool avx2_any_err(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t len,
+  size_t *done
+) {
+  __m256i permute = avx2_normalize_index(plan);
+  __m256i tag_mask = avx2_tag_mask(plan);
+  size_t i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    __m256i err = _mm256_setzero_si256();
+
+    for (size_t j = 0; j < 16; j += 4) {
+      __m256i lanes = avx2_load(plan, permute, array + (i + j) * plan->stride);
+      err = _mm256_or_si256(err, avx2_err_lanes(lanes, tag_mask));
+    }
+
+    if (avx2_err_bits(err)) {
+      *done = i;
+      return true;
+    }
+  }
+
+  *done = i;
+  return false;
+}
+
+AVX2 static void avx2_unwrap_or(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t len,
+  int32_t default_value,
+  int32_t *out,
+  size_t *done
+) {
+  __m256i permute = avx2_normalize_index(plan);
+  __m256i tag_mask = avx2_tag_mask(plan);
+  __m256i defaults = _mm256_set1_epi32(default_value);
+  __m256i low_dwords = _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0);
+  size_t i = 0;
+
+  for (; i + 4 <= len; i += 4) {
+    __m256i lanes = avx2_load(plan, permute, array + i * plan->stride);
+    __m256i err = avx2_err_lanes(lanes, tag_mask);
+    __m256i values = _mm256_blendv_epi8(lanes, defaults, err);
+
+    values = _mm256_permutevar8x32_epi32(values, low_dwords);
+    _mm_storeu_si128((__m128i *) (out + i), _mm256_castsi256_si128(values));
+  }
+
+  *done = i;
+}
+
+AVX2 static size_t avx2_compact_ok(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t len,
+  int32_t *out,
+  size_t *done
+) {
+  __m256i permute = avx2_normalize_index(plan);
+  __m256i tag_mask = avx2_tag_mask(plan);
+  __m256i compress[16];
+  size_t n = 0;
+  size_t i = 0;
+
+  avx2_compress_table(compress);
+
+  for (; i + 4 <= len; i += 4) {
+    __m256i lanes = avx2_load(plan, permute, array + i * plan->stride);
+    unsigned ok = ~avx2_err_bits(avx2_err_lanes(lanes, tag_mask)) & 0xf;
+
+    // the ok values end up in the even dwords of the low half; n <= i so the
+    // 16 byte store stays within the first i + 4 values of `out`
+    __m256i values = _mm256_permutevar8x32_epi32(
+      _mm256_permutevar8x32_epi32(lanes, compress[ok]),
+      _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0)
+    );
+
+    _mm_storeu_si128((__m128i *) (out + n), _mm256_castsi256_si128(values));
+    n += (size_t) __builtin_popcount(ok);
+  }
+
+  *done = i;
+  return n;
+}
+
+AVX2 static void avx2_partition(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t len,
+  uint8_t **ok_cursor,
+  uint8_t **err_cursor,
+  size_t *done
+) {
+  __m256i permute = avx2_normalize_index(plan);
+  __m256i tag_mask = avx2_tag_mask(plan);
+  __m256i lane_ids = _mm256_setr_epi64x(0, 1, 2, 3);
+  __m256i compress[16];
+  uint8_t *ok_out = *ok_cursor;
+  uint8_t *err_out = *err_cursor;
+  size_t i = 0;
+
+  avx2_compress_table(compress);
+
+  for (; i + 4 <= len; i += 4) {
+    const uint8_t *p = array + i * plan->stride;
+    __m256i lanes = avx2_load(plan, permute, p);
+    unsigned err = avx2_err_bits(avx2_err_lanes(lanes, tag_mask));
+
+    if (plan->stride == 8) {
+      // the two destinations can be next to each other, so only store the
+      // lanes that belong there
+      __m256i elements = _mm256_loadu_si256((const __m256i *) p);
+      unsigned ok = ~err & 0xf;
+      int ok_count = __builtin_popcount(ok);
+
+      _mm256_maskstore_epi64(
+        (long long *) ok_out,
+        _mm256_cmpgt_epi64(_mm256_set1_epi64x(ok_count), lane_ids),
+        _mm256_permutevar8x32_epi32(elements, compress[ok])
+      );
+
+      _mm256_maskstore_epi64(
+        (long long *) err_out,
+        _mm256_cmpgt_epi64(_mm256_set1_epi64x(4 - ok_count), lane_ids),
+        _mm256_permutevar8x32_epi32(elements, compress[err])
+      );
+
+      ok_out += 8 * (size_t) ok_count;
+      err_out += 8 * (size_t) (4 - ok_count);
+      continue;
+    }
+
+    for (unsigned e = 0; e < 4; e++) {
+      bool is_err = err & (1u << e);
+
+      _mm_storeu_si128(
+        (__m128i *) (is_err ? err_out : ok_out),
+        _mm_loadu_si128((const __m128i *) (p + 16 * e))
+      );
+
+      ok_out += !is_err * 16;
+      err_out += is_err * 16;
+    }
+  }
+
+  *ok_cursor = ok_out;
+  *err_cursor = err_out;
+  *done = i;
+}
+
+#undef AVX2
+
+//
+// AVX-512, 8 elements per vector
+//
+
+#define AVX512 __attribute__((target("avx512f,popcnt")))
+
+AVX512 static inline __m512i avx512_normalize_index(const struct plan_s *plan) {
+  unsigned dwords_per_element = (unsigned) plan->stride / 4;
+  int32_t permute[16];
+
+  for (unsigned e = 0; e < 8; e++) {
+    // with 16 byte elements the second half comes from the second vector,
+    // which permutex2var permutees as 16..31
+    unsigned base = e * dwords_per_element;
+
+    permute[2 * e] = (int32_t) (base + plan->ok_dword);
+    permute[2 * e + 1] = (int32_t) (base + plan->tag_dword);
+  }
+
+  return _mm512_loadu_si512(permute);
+}
+
+AVX512 static inline __m512i avx512_load(
+  const struct plan_s *plan,
+  __m512i permute,
+  const uint8_t *p
+) {
+  __m512i a = _mm512_loadu_si512(p);
+
+  if (plan->stride == 8) {
+    return _mm512_permutexvar_epi32(permute, a);
+  }
+
+  return _mm512_permutex2var_epi32(a, permute, _mm512_loadu_si512(p + 64));
+}
+
+AVX512 static inline __mmask8 avx512_err_mask(
+  const struct plan_s *plan,
+  __m512i lanes
+) {
+  __m512i tag_mask = _mm512_set1_epi64(
+    (long long) (0xffull << (32 + plan->tag_shift))
+  );
+
+  return _mm512_testn_epi64_mask(lanes, tag_mask);
+}
+
+AVX512 static size_t avx512_count_err(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t len,
+  size_t *done
+) {
+  __m512i permute = avx512_normalize_index(plan);
+  size_t count = 0;
+  size_t i = 0;
+
+  for (; i + 8 <= len; i += 8) {
+    __m512i lanes = avx512_load(plan, permute, array + i * plan->stride);
+    count += __builtin_popcount(avx512_err_mask(plan, lanes));
+  }
+
+  *done = i;
+  return count;
+}
+
+AVX512 static bool avx512_any_err(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t len,
+  size_t *done
+) {
+  __m512i permute = avx512_normalize_index(plan);
+  size_t i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    unsigned err = 0;
+
+    for (size_t j = 0; j < 32; j += 8) {
+      __m512i lanes = avx512_load(plan, permute, array + (i + j) * plan->stride);
+      err |= avx512_err_mask(plan, lanes);
+    }
+
+    if (err) {
+      *done = i;
+      return true;
+    }
+  }
+
+  *done = i;
+  return false;
+}
+
+AVX512 static void avx512_unwrap_or(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t len,
+  int32_t default_value,
+  int32_t *out,
+  size_t *done
+) {
+  __m512i permute = avx512_normalize_index(plan);
+  __m512i defaults = _mm512_set1_epi64(default_value);
+  size_t i = 0;
+
+  for (; i + 8 <= len; i += 8) {
+    __m512i lanes = avx512_load(plan, permute, array + i * plan->stride);
+    __mmask8 err = avx512_err_mask(plan, lanes);
+    __m512i values = _mm512_mask_mov_epi64(lanes, err, defaults);
+
+    _mm256_storeu_si256(
+      (__m256i *) (out + i),
+      _mm512_cvtepi64_epi32(values)
+    );
+  }
+
+  *done = i;
+}
+
+AVX512 static size_t avx512_compact_ok(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t len,
+  int32_t *out,
+  size_t *done
+) {
+  __m512i permute = avx512_normalize_index(plan);
+  size_t n = 0;
+  size_t i = 0;
+
+  for (; i + 8 <= len; i += 8) {
+    __m512i lanes = avx512_load(plan, permute, array + i * plan->stride);
+    __mmask8 ok = (__mmask8) ~avx512_err_mask(plan, lanes);
+
+    _mm512_mask_compressstoreu_epi32(
+      out + n,
+      ok,
+      _mm512_castsi256_si512(_mm512_cvtepi64_epi32(lanes))
+    );
+
+    n += (size_t) __builtin_popcount(ok);
+  }
+
+  *done = i;
+  return n;
+}
+
+// Stores the first `count` 64-bit lanes of `lanes`.
+AVX512 static inline void avx512_store_lanes(
+  uint8_t *dst,
+  __m512i lanes,
+  unsigned count
+) {
+  _mm512_mask_storeu_epi64(dst, (__mmask8) ((1u << count) - 1), lanes);
+}
+
+// Every bit of `mask` twice, for moving 16 byte elements as pairs of lanes.
+static inline __mmask8 avx512_double_bits(unsigned mask) {
+  unsigned doubled = 0;
+
+  for (unsigned bit = 0; bit < 4; bit++) {
+    doubled |= ((mask >> bit) & 1u) * (3u << (2 * bit));
+  }
+
+  return (__mmask8) doubled;
+}
+
+AVX512 static void avx512_partition(
+  const struct plan_s *plan,
+  const uint8_t *array,
+  size_t len,
+  uint8_t **ok_cursor,
+  uint8_t **err_cursor,
+  size_t *done
+) {
+  __m512i permute = avx512_normalize_index(plan);
+  uint8_t *ok_out = *ok_cursor;
+  uint8_t *err_out = *err_cursor;
+  size_t i = 0;
+
+  for (; i + 8 <= len; i += 8) {
+    const uint8_t *p = array + i * plan->stride;
+    __m512i lanes = avx512_load(plan, permute, p);
+    unsigned err = avx512_err_mask(plan, lanes);
+    unsigned ok = ~err & 0xff;
+
+    // compressing straight to memory is microcoded on a lot of CPUs, so
+    // compress in registers and do a masked store of just the packed lanes
+    if (plan->stride == 8) {
+      __m512i elements = _mm512_loadu_si512(p);
+      unsigned ok_count = (unsigned) __builtin_popcount(ok);
+
+      avx512_store_lanes(
+        ok_out, _mm512_maskz_compress_epi64((__mmask8) ok, elements), ok_count
+      );
+
+      avx512_store_lanes(
+        err_out, _mm512_maskz_compress_epi64((__mmask8) err, elements), 8 - ok_count
+      );
+    } else {
+      __m512i low = _mm512_loadu_si512(p);
+      __m512i high = _mm512_loadu_si512(p + 64);
+      unsigned ok_low = (unsigned) __builtin_popcount(ok & 0xf);
+      unsigned ok_high = (unsigned) __builtin_popcount(ok >> 4);
+
+      avx512_store_lanes(
+        ok_out,
+        _mm512_maskz_compress_epi64(avx512_double_bits(ok), low),
+        2 * ok_low
+      );
+
+      avx512_store_lanes(
+        err_out,
+        _mm512_maskz_compress_epi64(avx512_double_bits(err), low),
+        2 * (4 - ok_low)
+      );
+
+      avx512_store_lanes(
+        ok_out + 16 * ok_low,
+        _mm512_maskz_compress_epi64(avx512_double_bits(ok >> 4), high),
+        2 * ok_high
+      );
+
+      avx512_store_lanes(
+        err_out + 16 * (4 - ok_low),
+        _mm512_maskz_compress_epi64(avx512_double_bits(err >> 4), high),
+        2 * (4 - ok_high)
+      );
+    }
+
+    ok_out += plan->stride * (size_t) __builtin_popcount(ok);
+    err_out += plan->stride * (size_t) __builtin_popcount(err);
+  }
+
+  *ok_cursor = ok_out;
+  *err_cursor = err_out;
+  *done = i;
+}
+
+#undef AVX512
+
+#endif // RESULT_SIMD_X86
+
+//
+// dispatch
+//
+
+bool result_simd_any_err(
+  struct result_layout_s layout,
+  const void *array,
+  size_t len
+) {
+  struct plan_s plan = plan_of(layout);
+  size_t i = 0;
+
+  switch (plan_level(&plan, false, false)) {
+#if RESULT_SIMD_X86
+    case RESULT_SIMD_AVX512:
+      if (avx512_any_err(&plan, array, len, &i)) {
+        return true;
+      }
+
+      break;
+
+    case RESULT_SIMD_AVX2:
+      if (avx2_any_err(&plan, array, len, &i)) {
+        return true;
+      }
+
+      break;
+
+    case RESULT_SIMD_SSE2:
+      if (sse2_any_err(&plan, array, len, &i)) {
+        return true;
+      }
+
+      break;
+#endif
+
+    default:
+      break;
+  }
+
+  for (; i < len; i++) {
+    if (!scalar_is_ok(&plan, array, i)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+size_t result_simd_count_err(
+  struct result_layout_s layout,
+  const void *array,
+  size_t len
+) {
+  struct plan_s plan = plan_of(layout);
+  size_t count = 0;
+  size_t i = 0;
+
+  switch (plan_level(&plan, false, false)) {
+#if RESULT_SIMD_X86
+    case RESULT_SIMD_AVX512:
+      count = avx512_count_err(&plan, array, len, &i);
+      break;
+
+    case RESULT_SIMD_AVX2:
+      count = avx2_count_err(&plan, array, len, &i);
+      break;
+
+    case RESULT_SIMD_SSE2:
+      count = sse2_count_err(&plan, array, len, &i);
+      break;
+#endif
+
+    default:
+      break;
+  }
+
+  return count + scalar_count_err(&plan, array, i, len);
+}
+
+void result_simd_unwrap_or(
+  struct result_layout_s layout,
+  const void *array,
+  size_t len,
+  const void *default_value,
+  void *out
+) {
+  struct plan_s plan = plan_of(layout);
+  size_t i = 0;
+
+#if RESULT_SIMD_X86
+  int32_t default_dword = 0;
+
+  if (plan.ok_size == 4) {
+    memcpy(&default_dword, default_value, 4);
+  }
+#endif
+
+  switch (plan_level(&plan, true, false)) {
+#if RESULT_SIMD_X86
+    case RESULT_SIMD_AVX512:
+      avx512_unwrap_or(&plan, array, len, default_dword, out, &i);
+      break;
+
+    case RESULT_SIMD_AVX2:
+      avx2_unwrap_or(&plan, array, len, default_dword, out, &i);
+      break;
+
+    case RESULT_SIMD_SSE2:
+      sse2_unwrap_or(&plan, array, len, default_dword, out, &i);
+      break;
+#endif
+
+    default:
+      break;
+  }
+
+  switch (plan.ok_size) {
+    case 4:
+      scalar_unwrap_or(&plan, array, i, len, default_value, out, 4);
+      break;
+
+    case 8:
+      scalar_unwrap_or(&plan, array, i, len, default_value, out, 8);
+      break;
+
+    default:
+      scalar_unwrap_or(&plan, array, i, len, default_value, out, plan.ok_size);
+      break;
+  }
+}
+
+size_t result_simd_compact_ok(
+  struct result_layout_s layout,
+  const void *array,
+  size_t len,
+  void *out
+) {
+  struct plan_s plan = plan_of(layout);
+  size_t n = 0;
+  size_t i = 0;
+
+  switch (plan_level(&plan, true, true)) {
+#if RESULT_SIMD_X86
+    case RESULT_SIMD_AVX512:
+      n = avx512_compact_ok(&plan, array, len, out, &i);
+      break;
+
+    case RESULT_SIMD_AVX2:
+      n = avx2_compact_ok(&plan, array, len, out, &i);
+      break;
+#endif
+
+    default:
+      break;
+  }
+
+  switch (plan.ok_size) {
+    case 4:
+      return scalar_compact_ok(&plan, array, i, len, out, n, 4);
+
+    case 8:
+      return scalar_compact_ok(&plan, array, i, len, out, n, 8);
+
+    default:
+      return scalar_compact_ok(&plan, array, i, len, out, n, plan.ok_size);
+  }
+}
+
+size_t result_simd_partition(
+  struct result_layout_s layout,
+  const void *array,
+  size_t len,
+  void *out
+) {
+  struct plan_s plan = plan_of(layout);
+  size_t ok_count = len - result_simd_count_err(layout, array, len);
+  uint8_t *ok_out = out;
+  uint8_t *err_out = ok_out + ok_count * plan.stride;
+  size_t i = 0;
+
+  switch (plan_level(&plan, false, true)) {
+#if RESULT_SIMD_X86
+    case RESULT_SIMD_AVX512:
+      avx512_partition(&plan, array, len, &ok_out, &err_out, &i);
+      break;
+
+    case RESULT_SIMD_AVX2:
+      avx2_partition(&plan, array, len, &ok_out, &err_out, &i);
+      break;
+#endif
+
+    default:
+      break;
+  }
+
+  switch (plan.stride) {
+    case 8:
+      scalar_partition(&plan, array, i, len, ok_out, err_out, 8);
+      break;
+
+    case 16:
+      scalar_partition(&plan, array, i, len, ok_out, err_out, 16);
+      break;
+
+    default:
+      scalar_partition(&plan, array, i, len, ok_out, err_out, plan.stride);
+      break;
+  }
+
+  return ok_count;
+}
@@ -0,0 +1,161 @@
+#ifndef __result_simd_h__
+#define __result_simd_h__
+
+#include "core/defs.h"
+#include "result.h"
+
+//
+// Bulk operations over plain arrays of results, vectorized with SSE2, AVX2 or
+// AVX-512 depending on what the CPU supports (checked once at runtime), with
+// a scalar fallback for everything else.
+//
+//   result_t(int32_t, int32_t) results[1000];
+//   int32_t values[1000];
+//
+//   if (result_any_err(results, 1000)) {
+//     size_t n = result_compact_ok(results, 1000, values);
+//     ...
+//   }
+//
+// The kernels read the interleaved layout of the array in place, so they work
+// on result_t, result_padded_t and result_packed_t alike. The vector paths
+// cover 8 and 16 byte elements, eg. result_t(int32_t, int32_t),
+// result_t(float, int) and result_padded_t(int32_t, int32_t); the ones that
+// read values also need a 4 byte ok type. Anything else takes the scalar
+// path, which works for every layout.
+//
+// Niche-optimized results are not supported since they have no tag byte.
+//
+
+enum result_simd_level_e {
+  RESULT_SIMD_SCALAR,
+  RESULT_SIMD_SSE2,
+  RESULT_SIMD_AVX2,
+  RESULT_SIMD_AVX512,
+};
+
+// Where the tag and the ok value live within each element.
+struct result_layout_s {
+  size_t stride;
+  size_t tag_offset;
+  size_t ok_offset;
+  size_t ok_size;
+};
+
+#define result_layout_of(_array) ((struct result_layout_s) { \
+  .stride = sizeof(*(_array)), \
+  .tag_offset = __builtin_offsetof(__typeof(*(_array)), header.is_ok), \
+  .ok_offset = __builtin_offsetof(__typeof(*(_array)), body.ok), \
+  .ok_size = sizeof((_array)->body.ok), \
+})
+
+#define result_simd_with_layout(_array, _fn, ...) ({ \
+  __typeof(&*(_array)) result_simd_array = (_array); \
+  \
+  _Static_assert( \
+    __builtin_types_compatible_p( \
+      __typeof(result_simd_array->header.is_ok), \
+      bool \
+    ), \
+    "niche-optimized results are not supported" \
+  ); \
+  \
+  _fn(result_layout_of(result_simd_array), result_simd_array, __VA_ARGS__); \
+})
+
+#define result_all_ok(_array, _len) \
+  (!result_any_err(_array, _len))
+
+#define result_any_err(_array, _len) \
+  result_simd_with_layout(_array, result_simd_any_err, (_len))
+
+#define result_count_err(_array, _len) \
+  result_simd_with_layout(_array, result_simd_count_err, (_len))
+
+// Writes the ok value of every element to `_out`, or `_default` for errs.
+// `_out` must have room for `_len` values.
+#define result_unwrap_or_array(_array, _len, _default, _out) ({ \
+  __typeof((_array)->body.ok) result_simd_default = (_default); \
+  \
+  _Static_assert( \
+    sizeof(*(_out)) == sizeof((_array)->body.ok), \
+    "_out must be an array of the ok type" \
+  ); \
+  \
+  result_simd_with_layout( \
+    _array, \
+    result_simd_unwrap_or, \
+    (_len), \
+    &result_simd_default, \
+    (_out) \
+  ); \
+})
+
+// Writes the ok values, in order, densely to `_out`. Returns how many there
+// were. `_out` must have room for `_len` values.
+#define result_compact_ok(_array, _len, _out) ({ \
+  _Static_assert( \
+    sizeof(*(_out)) == sizeof((_array)->body.ok), \
+    "_out must be an array of the ok type" \
+  ); \
+  \
+  result_simd_with_layout(_array, result_simd_compact_ok, (_len), (_out)); \
+})
+
+// Stable partition: copies the ok elements to the start of `_out` and the
+// errs after them, both in their original order. Returns the number of ok
+// elements. `_out` is an array of the same type as `_array` with room for
+// `_len` elements, and must not overlap it.
+#define result_partition(_array, _len, _out) ({ \
+  _Static_assert( \
+    sizeof(*(_out)) == sizeof(*(_array)), \
+    "_out must be an array of the same type as _array" \
+  ); \
+  \
+  result_simd_with_layout(_array, result_simd_partition, (_len), (_out)); \
+})
+
+// Best level the CPU supports, or whatever was forced.
+extern enum result_simd_level_e result_simd_level(void);
+
+// Use at most `level` (for testing and benchmarking). Returns the level that
+// will actually be used.
+extern enum result_simd_level_e result_simd_force_level(
+  enum result_simd_level_e level
+);
+
+extern bool result_simd_any_err(
+  struct result_layout_s layout,
+  const void *array,
+  size_t len
+);
+
+extern size_t result_simd_count_err(
+  struct result_layout_s layout,
+  const void *array,
+  size_t len
+);
+
+extern void result_simd_unwrap_or(
+  struct result_layout_s layout,
+  const void *array,
+  size_t len,
+  const void *default_value,
+  void *out
+);
+
+extern size_t result_simd_compact_ok(
+  struct result_layout_s layout,
+  const void *array,
+  size_t len,
+  void *out
+);
+
+extern size_t result_simd_partition(
+  struct result_layout_s layout,
+  const void *array,
+  size_t len,
+  void *out
+);
+
+#endif // __result_simd_h__
@@ -0,0 +1,206 @@
+#include "core/defs.h"
+#include "result_simd.h"
+
+/*sublime-c-static-fn-hoist-start*/
+static uint32_t next_random(uint32_t *state);
+static void test_force_level_is_capped_by_the_cpu(void **ts);
+static void test_matches_scalar_for_int_results(void **ts);
+static void test_matches_scalar_for_float_results(void **ts);
+static void test_matches_scalar_for_padded_results(void **ts);
+static void test_matches_scalar_for_other_layouts(void **ts);
+static void test_finds_err_at_every_position(void **ts);
+/*sublime-c-static-fn-hoist-end*/
+
+#define MAX_LEN 300
+#define DEFAULT_VALUE 42
+
+static uint32_t next_random(uint32_t *state) {
+  *state = *state * 1103515245u + 12345u;
+  return *state >> 16;
+}
+
+// Fills the padding with garbage too, so the kernels must only look at the
+// tag byte.
+#define fill_array(_array, _len, _percent_err, _seed) { \
+  uint32_t state = (_seed); \
+  memset((_array), 0xa5, sizeof(_array)); \
+  \
+  for (size_t i = 0; i < (_len); i++) { \
+    if (next_random(&state) % 100 < (_percent_err)) { \
+      result_set_err((_array)[i], (int8_t) (i + 1)); \
+    } else { \
+      result_set_ok((_array)[i], (int8_t) (i * 3 + 1)); \
+    } \
+  } \
+}
+
+// Compares every kernel, at every level, against the scalar result.h macros.
+#define assert_matches_scalar(_array, _len) { \
+  __typeof((_array)->body.ok) expected[MAX_LEN]; \
+  __typeof((_array)->body.ok) actual[MAX_LEN]; \
+  __typeof(*(_array)) expected_elements[MAX_LEN]; \
+  __typeof(*(_array)) actual_elements[MAX_LEN]; \
+  \
+  for (int level = 0; level <= RESULT_SIMD_AVX512; level++) { \
+    result_simd_force_level((enum result_simd_level_e) level); \
+    \
+    size_t errs = 0; \
+    \
+    for (size_t i = 0; i < (_len); i++) { \
+      errs += result_is_err((_array)[i]); \
+    } \
+    \
+    assert_int_equal(errs, result_count_err((_array), (_len))); \
+    assert_int_equal(errs > 0, result_any_err((_array), (_len))); \
+    assert_int_equal(errs == 0, result_all_ok((_array), (_len))); \
+    \
+    for (size_t i = 0; i < (_len); i++) { \
+      expected[i] = result_unwrap_or((_array)[i], DEFAULT_VALUE); \
+    } \
+    \
+    memset(actual, 0, sizeof(actual)); \
+    result_unwrap_or_array((_array), (_len), DEFAULT_VALUE, actual); \
+    assert_memory_equal(expected, actual, (_len) * sizeof(*expected)); \
+    \
+    size_t n = 0; \
+    \
+    for (size_t i = 0; i < (_len); i++) { \
+      if (result_is_ok((_array)[i])) { \
+        expected[n++] = result_unwrap_unchecked((_array)[i]); \
+      } \
+    } \
+    \
+    memset(actual, 0, sizeof(actual)); \
+    assert_int_equal(n, result_compact_ok((_array), (_len), actual)); \
+    assert_memory_equal(expected, actual, n * sizeof(*expected)); \
+    \
+    n = 0; \
+    \
+    for (size_t i = 0; i < (_len); i++) { \
+      if (result_is_ok((_array)[i])) { \
+        memcpy(&expected_elements[n++], &(_array)[i], sizeof(*(_array))); \
+      } \
+    } \
+    \
+    for (size_t i = 0; i < (_len); i++) { \
+      if (result_is_err((_array)[i])) { \
+        memcpy(&expected_elements[n++], &(_array)[i], sizeof(*(_array))); \
+      } \
+    } \
+    \
+    memset(actual_elements, 0, sizeof(actual_elements)); \
+    \
+    assert_int_equal( \
+      (_len) - errs, \
+      result_partition((_array), (_len), actual_elements) \
+    ); \
+    \
+    assert_memory_equal( \
+      expected_elements, \
+      actual_elements, \
+      (_len) * sizeof(*(_array)) \
+    ); \
+  } \
+  \
+  result_simd_force_level(RESULT_SIMD_AVX512); \
+}
+
+// Every tail length up to a few vectors, some longer arrays, and error rates
+// from none to all.
+#define assert_matches_scalar_for_type(_type) { \
+  static _type array[MAX_LEN]; \
+  const unsigned rates[] = { 0, 1, 50, 100 }; \
+  \
+  for (size_t r = 0; r < w_array_size(rates); r++) { \
+    for (size_t len = 0; len <= MAX_LEN; len += len < 70 ? 1 : 23) { \
+      fill_array(array, len, rates[r], (uint32_t) (len * 7 + r)); \
+      assert_matches_scalar(array, len); \
+    } \
+  } \
+}
+
+static void test_force_level_is_capped_by_the_cpu(void **ts) {
+  enum result_simd_level_e best = result_simd_force_level(RESULT_SIMD_AVX512);
+
+  assert_int_equal(RESULT_SIMD_SCALAR, result_simd_force_level(RESULT_SIMD_SCALAR));
+  assert_int_equal(RESULT_SIMD_SCALAR, result_simd_level());
+
+  assert_int_equal(
+    w_min_2(best, RESULT_SIMD_AVX2),
+    result_simd_force_level(RESULT_SIMD_AVX2)
+  );
+
+  assert_int_equal(best, result_simd_force_level(RESULT_SIMD_AVX512));
+}
+
+static void test_matches_scalar_for_int_results(void **ts) {
+  typedef result_t(int32_t, int32_t) result_i32_t;
+  assert_int_equal(8, sizeof(result_i32_t));
+  assert_matches_scalar_for_type(result_i32_t);
+}
+
+static void test_matches_scalar_for_float_results(void **ts) {
+  typedef result_t(float, int) result_float_t;
+  assert_int_equal(8, sizeof(result_float_t));
+  assert_matches_scalar_for_type(result_float_t);
+}
+
+static void test_matches_scalar_for_padded_results(void **ts) {
+  typedef result_padded_t(int32_t, int32_t) result_padded_i32_t;
+  assert_int_equal(16, sizeof(result_padded_i32_t));
+  assert_matches_scalar_for_type(result_padded_i32_t);
+}
+
+static void test_matches_scalar_for_other_layouts(void **ts) {
+  // vectorized tag checks, scalar values
+  typedef result_t(int64_t, int8_t) result_i64_t;
+  typedef result_padded_t(int8_t, int8_t) result_padded_i8_t;
+
+  // scalar only
+  typedef result_packed_t(int32_t, int8_t) result_packed_i32_t;
+  typedef result_t(int16_t, int16_t) result_i16_t;
+  typedef result_t(uint8_t, int8_t) result_u8_t;
+
+  assert_matches_scalar_for_type(result_i64_t);
+  assert_matches_scalar_for_type(result_padded_i8_t);
+  assert_matches_scalar_for_type(result_packed_i32_t);
+  assert_matches_scalar_for_type(result_i16_t);
+  assert_matches_scalar_for_type(result_u8_t);
+}
+
+static void test_finds_err_at_every_position(void **ts) {
+  typedef result_t(int32_t, int32_t) result_i32_t;
+  static result_i32_t array[MAX_LEN];
+
+  for (int level = 0; level <= RESULT_SIMD_AVX512; level++) {
+    result_simd_force_level((enum result_simd_level_e) level);
+
+    for (size_t err = 0; err < 100; err++) {
+      for (size_t i = 0; i < MAX_LEN; i++) {
+        result_set_ok(array[i], (int32_t) i);
+      }
+
+      result_set_err(array[err], 1);
+
+      assert_true(result_any_err(array, 100));
+      assert_false(result_any_err(array, err));
+      assert_false(result_all_ok(array, err + 1));
+      assert_int_equal(1, result_count_err(array, MAX_LEN));
+    }
+  }
+
+  result_simd_force_level(RESULT_SIMD_AVX512);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_force_level_is_capped_by_the_cpu),
+    cmocka_unit_test(test_matches_scalar_for_int_results),
+    cmocka_unit_test(test_matches_scalar_for_float_results),
+    cmocka_unit_test(test_matches_scalar_for_padded_results),
+    cmocka_unit_test(test_matches_scalar_for_other_layouts),
+    cmocka_unit_test(test_finds_err_at_every_position),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,203 @@
+#include "result_sites.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Provided by the linker for any section whose name is a valid C identifier.
+// Weak so that a program without a single callsite still links.
+extern const struct result_site_s __stop_result_sites[] __attribute__((weak));
+
+struct shard_s {
+  struct shard_s *next;
+
+  // on the idle list, after its thread exited
+  struct shard_s *next_idle;
+  uint64_t counts[];
+};
+
+/*sublime-c-static-fn-hoist-start*/
+static void make_key(void);
+static void retire(void *shard);
+static struct shard_s *reuse(void);
+static int compare_by_site(const void *a, const void *b);
+static int compare_by_count(const void *a, const void *b);
+/*sublime-c-static-fn-hoist-end*/
+
+// Every shard ever created, pushed without locks. Shards are never removed.
+static struct shard_s *shards;
+
+// The shards of exited threads, which the next new threads count into, so
+// there are never more shards than threads alive at once.
+static pthread_mutex_t idle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct shard_s *idle;
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t key;
+static bool key_made;
+
+__thread uint64_t *result_sites_shard;
+
+static void make_key(void) {
+  key_made = pthread_key_create(&key, retire) == 0;
+}
+
+// The key's destructor, when a thread that counted something exits. Its
+// counts stay in the shard.
+static void retire(void *shard) {
+  struct shard_s *done = shard;
+
+  // an err in a destructor that runs after this one gets a shard again
+  result_sites_shard = NULL;
+
+  pthread_mutex_lock(&idle_mutex);
+  done->next_idle = idle;
+  idle = done;
+  pthread_mutex_unlock(&idle_mutex);
+}
+
+static struct shard_s *reuse(void) {
+  pthread_mutex_lock(&idle_mutex);
+
+  struct shard_s *shard = idle;
+
+  if (shard) {
+    idle = shard->next_idle;
+  }
+
+  pthread_mutex_unlock(&idle_mutex);
+  return shard;
+}
+
+size_t result_sites_count(void) {
+  if (!__start_result_sites || !__stop_result_sites) {
+    return 0;
+  }
+
+  return (size_t) (__stop_result_sites - __start_result_sites);
+}
+
+uint64_t *result_sites_shard_init(void) {
+  pthread_once(&key_once, make_key);
+
+  struct shard_s *shard = reuse();
+
+  if (!shard) {
+    size_t count = result_sites_count();
+
+    shard = calloc(
+      1,
+      sizeof(*shard) + w_max_2(count, (size_t) 1) * sizeof(shard->counts[0])
+    );
+
+    if (!shard) {
+      // there's no way to report this from inside result_init_err()
+      fprintf(stderr, "result_sites: could not allocate counters\n");
+      abort();
+    }
+
+    shard->next = __atomic_load_n(&shards, __ATOMIC_RELAXED);
+
+    while (!__atomic_compare_exchange_n(
+      &shards,
+      &shard->next,
+      shard,
+      true,
+      __ATOMIC_RELEASE,
+      __ATOMIC_RELAXED
+    )) {}
+  }
+
+  // without the key, the shard isn't reused when the thread exits
+  if (key_made) {
+    pthread_setspecific(key, shard);
+  }
+
+  result_sites_shard = shard->counts;
+  return shard->counts;
+}
+
+static int compare_by_site(const void *a, const void *b) {
+  const struct result_site_count_s *x = a;
+  const struct result_site_count_s *y = b;
+  int order = strcmp(x->file, y->file);
+
+  if (order != 0) {
+    return order;
+  }
+
+  return (x->line > y->line) - (x->line < y->line);
+}
+
+static int compare_by_count(const void *a, const void *b) {
+  const struct result_site_count_s *x = a;
+  const struct result_site_count_s *y = b;
+
+  if (x->count != y->count) {
+    return x->count < y->count ? 1 : -1;
+  }
+
+  return compare_by_site(a, b);
+}
+
+size_t result_sites_snapshot(
+  struct result_site_count_s *out,
+  size_t capacity
+) {
+  size_t count = result_sites_count();
+
+  if (count == 0) {
+    return 0;
+  }
+
+  struct result_site_count_s *sites = calloc(count, sizeof(*sites));
+
+  if (!sites) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    const struct result_site_s *site = &__start_result_sites[i];
+
+    sites[i] = (struct result_site_count_s) {
+      .file = site->file,
+      .function = site->function,
+      .macro = site->macro,
+      .line = site->line,
+    };
+  }
+
+  for (
+    const struct shard_s *shard = __atomic_load_n(&shards, __ATOMIC_ACQUIRE);
+    shard;
+    shard = shard->next
+  ) {
+    for (size_t i = 0; i < count; i++) {
+      sites[i].count += __atomic_load_n(&shard->counts[i], __ATOMIC_RELAXED);
+    }
+  }
+
+  // merge duplicates of the same site and drop the ones that never fired
+  qsort(sites, count, sizeof(*sites), compare_by_site);
+
+  size_t n = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    if (n > 0 && compare_by_site(&sites[n - 1], &sites[i]) == 0) {
+      sites[n - 1].count += sites[i].count;
+    } else if (sites[i].count > 0) {
+      sites[n++] = sites[i];
+    }
+  }
+
+  qsort(sites, n, sizeof(*sites), compare_by_count);
+
+  if (capacity > 0) {
+    memcpy(out, sites, w_min_2(n, capacity) * sizeof(*sites));
+  }
+
+  free(sites);
+
+  return n;
+}
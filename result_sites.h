@@ -0,0 +1,116 @@
+#ifndef __result_sites_h__
+#define __result_sites_h__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/defs.h"
+
+//
+// Per-callsite error counters.
+//
+// Compile with -D RESULT_SITE_COUNTERS and every result_init_err,
+// result_set_err and result_err counts how often it runs, keyed by its file
+// and line:
+//
+//   struct result_site_count_s top[10];
+//   size_t n = result_sites_snapshot(top, w_array_size(top));
+//
+//   for (size_t i = 0; i < w_min_2(n, w_array_size(top)); i++) {
+//     printf("%s:%u %" PRIu64 "\n", top[i].file, top[i].line, top[i].count);
+//   }
+//
+// Each callsite is a static struct in the "result_sites" linker section, so
+// the sites are known without any registration at startup: a site's index is
+// just its position in the section. Every thread counts into its own shard
+// with plain loads and stores, no atomic read-modify-writes. A thread's shard
+// is allocated and linked into the global list the first time it constructs
+// an err. When the thread exits, the shard and its counts are kept, and the
+// next new thread counts into it instead of allocating another one.
+//
+// Without RESULT_SITE_COUNTERS the macros in result.h are exactly what they
+// would be without this file.
+//
+// Caveats: the macros can no longer be used in initializers at file scope, and
+// sites are per executable or shared object (whichever contains the
+// result_sites.c that is linked in).
+//
+
+struct result_site_s {
+  const char *file;
+  const char *function;
+  const char *macro;
+  uint32_t line;
+} __attribute__((aligned(32)));
+
+struct result_site_count_s {
+  const char *file;
+  const char *function;
+  const char *macro;
+  uint32_t line;
+  uint64_t count;
+};
+
+// Sums the counters of all threads, sorted by count (highest first). Sites
+// with the same file and line, eg. from a static inline function included in
+// several translation units, are merged. Writes at most `capacity` entries and
+// returns the number of sites that have a non-zero count.
+extern size_t result_sites_snapshot(
+  struct result_site_count_s *out,
+  size_t capacity
+);
+
+// Total number of callsites in the section, whether they have fired or not.
+extern size_t result_sites_count(void);
+
+//
+// Used by the result.h macros
+//
+
+extern const struct result_site_s __start_result_sites[] __attribute__((weak));
+extern __thread uint64_t *result_sites_shard;
+
+extern uint64_t *result_sites_shard_init(void);
+
+static inline __attribute__((always_inline, unused))
+void result_sites_hit(const struct result_site_s *site) {
+  uint64_t *shard = result_sites_shard;
+
+  if (w_unlikely(!shard)) {
+    shard = result_sites_shard_init();
+  }
+
+  // only this thread ever writes here, the relaxed atomics just keep the
+  // concurrent reads in result_sites_snapshot() well defined; on x86 and ARM
+  // this is a plain load, add and store
+  uint64_t *counter = &shard[site - __start_result_sites];
+  __atomic_store_n(counter, *counter + 1, __ATOMIC_RELAXED);
+}
+
+#if defined(__has_attribute)
+  #if __has_attribute(retain)
+    #define result_sites_retain retain,
+  #endif
+#endif
+
+#ifndef result_sites_retain
+  #define result_sites_retain
+#endif
+
+#define result_site_count(_macro) ({ \
+  static const struct result_site_s result_site __attribute__(( \
+    result_sites_retain \
+    used, \
+    section("result_sites") \
+  )) = { \
+    .file = __FILE__, \
+    .function = __func__, \
+    .macro = (_macro), \
+    .line = __LINE__, \
+  }; \
+  \
+  result_sites_hit(&result_site); \
+})
+
+#endif // __result_sites_h__
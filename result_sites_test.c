@@ -0,0 +1,245 @@
+#include "core/defs.h"
+#include "result.h"
+
+#include <pthread.h>
+
+typedef result_t(int, int) result_int_t;
+
+/*sublime-c-static-fn-hoist-start*/
+static uint64_t count_at(int line);
+static result_int_t fail_with_init_err(int err);
+static result_int_t fail_with_set_err(int err);
+static result_int_t fail_with_err(int err);
+static void *fail_in_thread(void *arg);
+static void test_is_enabled(void **ts);
+static void test_counts_each_site(void **ts);
+static void test_records_where_and_how(void **ts);
+static void test_sorts_by_count(void **ts);
+static void test_aggregates_threads(void **ts);
+static void *shard_of_thread(void *arg);
+static void test_reuses_shards(void **ts);
+static void test_respects_capacity(void **ts);
+/*sublime-c-static-fn-hoist-end*/
+
+#ifndef RESULT_SITE_COUNTERS
+  #error "result_sites_test must be built with RESULT_SITE_COUNTERS"
+#endif
+
+#define MAX_SITES 64
+#define THREADS 4
+#define HITS_PER_THREAD 1000
+
+static int init_err_line;
+static int set_err_line;
+static int err_line;
+
+// Current count of the site on `line` of this file.
+static uint64_t count_at(int line) {
+  struct result_site_count_s sites[MAX_SITES];
+  size_t n = result_sites_snapshot(sites, MAX_SITES);
+
+  assert_true(n <= MAX_SITES);
+
+  for (size_t i = 0; i < n; i++) {
+    bool is_here = strcmp(sites[i].file, __FILE__) == 0;
+
+    if (is_here && sites[i].line == (uint32_t) line) {
+      return sites[i].count;
+    }
+  }
+
+  return 0;
+}
+
+static result_int_t fail_with_init_err(int err) {
+  init_err_line = __LINE__ + 1;
+  return (result_int_t) result_init_err(err);
+}
+
+static result_int_t fail_with_set_err(int err) {
+  result_int_t res = result_init_ok(0);
+
+  set_err_line = __LINE__ + 1;
+  result_set_err(res, err);
+
+  return res;
+}
+
+static result_int_t fail_with_err(int err) {
+  result_int_t res = result_init_ok(0);
+
+  err_line = __LINE__ + 1;
+  return result_err(res, err);
+}
+
+static void *fail_in_thread(void *arg) {
+  size_t *errs = arg;
+
+  for (int i = 0; i < HITS_PER_THREAD; i++) {
+    result_int_t res = fail_with_init_err(i);
+    *errs += result_is_err(res);
+  }
+
+  return NULL;
+}
+
+static void test_is_enabled(void **ts) {
+  fail_with_init_err(1);
+  fail_with_set_err(1);
+  fail_with_err(1);
+
+  assert_true(result_sites_count() >= 3);
+  assert_true(count_at(init_err_line) > 0);
+}
+
+static void test_counts_each_site(void **ts) {
+  fail_with_init_err(1);
+  fail_with_set_err(1);
+  fail_with_err(1);
+
+  uint64_t init_err = count_at(init_err_line);
+  uint64_t set_err = count_at(set_err_line);
+  uint64_t err = count_at(err_line);
+
+  for (int i = 0; i < 10; i++) {
+    fail_with_init_err(i);
+  }
+
+  for (int i = 0; i < 3; i++) {
+    fail_with_set_err(i);
+  }
+
+  fail_with_err(1);
+
+  assert_int_equal(init_err + 10, count_at(init_err_line));
+  assert_int_equal(set_err + 3, count_at(set_err_line));
+  assert_int_equal(err + 1, count_at(err_line));
+
+  // the value still comes through
+  result_int_t res = fail_with_init_err(77);
+  assert_true(result_is_err(res));
+  assert_int_equal(77, result_unwrap_err_unchecked(res));
+}
+
+static void test_records_where_and_how(void **ts) {
+  struct result_site_count_s sites[MAX_SITES];
+
+  fail_with_set_err(1);
+
+  size_t n = result_sites_snapshot(sites, MAX_SITES);
+  bool found = false;
+
+  for (size_t i = 0; i < n; i++) {
+    if (sites[i].line != (uint32_t) set_err_line) {
+      continue;
+    }
+
+    assert_string_equal(__FILE__, sites[i].file);
+    assert_string_equal("fail_with_set_err", sites[i].function);
+    assert_string_equal("result_set_err", sites[i].macro);
+    found = true;
+  }
+
+  assert_true(found);
+}
+
+static void test_sorts_by_count(void **ts) {
+  struct result_site_count_s sites[MAX_SITES];
+
+  for (int i = 0; i < 100; i++) {
+    fail_with_err(i);
+  }
+
+  size_t n = result_sites_snapshot(sites, MAX_SITES);
+
+  assert_true(n >= 3);
+
+  for (size_t i = 1; i < n; i++) {
+    assert_true(sites[i - 1].count >= sites[i].count);
+    assert_true(sites[i].count > 0);
+  }
+}
+
+static void test_aggregates_threads(void **ts) {
+  pthread_t threads[THREADS];
+  size_t errs[THREADS] = { 0 };
+
+  fail_with_init_err(1);
+
+  uint64_t before = count_at(init_err_line);
+
+  for (size_t i = 0; i < THREADS; i++) {
+    int status = pthread_create(&threads[i], NULL, fail_in_thread, &errs[i]);
+    assert_int_equal(0, status);
+  }
+
+  for (size_t i = 0; i < THREADS; i++) {
+    assert_int_equal(0, pthread_join(threads[i], NULL));
+    assert_int_equal(HITS_PER_THREAD, errs[i]);
+  }
+
+  // the threads are gone but their counts stay
+  assert_int_equal(
+    before + THREADS * HITS_PER_THREAD,
+    count_at(init_err_line)
+  );
+}
+
+static void *shard_of_thread(void *arg) {
+  fail_with_err(1);
+  return result_sites_shard;
+}
+
+static void test_reuses_shards(void **ts) {
+  pthread_t thread;
+  void *first;
+  void *second;
+
+  fail_with_err(1);
+
+  uint64_t before = count_at(err_line);
+
+  assert_int_equal(0, pthread_create(&thread, NULL, shard_of_thread, NULL));
+  assert_int_equal(0, pthread_join(thread, &first));
+
+  // the second thread counts into the shard of the first
+  assert_int_equal(0, pthread_create(&thread, NULL, shard_of_thread, NULL));
+  assert_int_equal(0, pthread_join(thread, &second));
+
+  assert_ptr_equal(first, second);
+  assert_int_equal(before + 2, count_at(err_line));
+}
+
+static void test_respects_capacity(void **ts) {
+  struct result_site_count_s sites[MAX_SITES];
+  struct result_site_count_s sentinel;
+
+  fail_with_init_err(1);
+  fail_with_set_err(1);
+  fail_with_err(1);
+
+  memset(sites, 0xa5, sizeof(sites));
+  memset(&sentinel, 0xa5, sizeof(sentinel));
+
+  size_t n = result_sites_snapshot(sites, 1);
+
+  assert_true(n >= 3);
+  assert_true(sites[0].count > 0);
+  assert_memory_equal(&sentinel, &sites[1], sizeof(sentinel));
+
+  assert_int_equal(n, result_sites_snapshot(NULL, 0));
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_is_enabled),
+    cmocka_unit_test(test_counts_each_site),
+    cmocka_unit_test(test_records_where_and_how),
+    cmocka_unit_test(test_sorts_by_count),
+    cmocka_unit_test(test_aggregates_threads),
+    cmocka_unit_test(test_reuses_shards),
+    cmocka_unit_test(test_respects_capacity),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
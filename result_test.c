@@ -2,7 +2,11 @@
 #include "core/w_stringify.h"
 #include "result.h"
 
+typedef result_t(int, int) result_eval_t;
+
 /*sublime-c-static-fn-hoist-start*/
+static result_eval_t count_eval(result_eval_t res);
+static result_eval_t *count_eval_ptr(result_eval_t *res);
 static void test_inits_ok_directly(void **ts);
 static void test_inits_err_directly(void **ts);
 static void test_updates_from_value_to_value(void **ts);
@@ -37,12 +41,55 @@ static void test_unwrap_or_else_with_ok_and_missing_else_block_returns_the_value
 static void test_unwrap_or_else_with_err_and_missing_else_block_returns_zeroed_value(void **ts);
 static void test_pads_to_multiple_of_pointer_size(void **ts);
 static void test_allows_forward_declaration(void **ts);
+static void test_auto_reuses_the_tail_padding_of_the_union(void **ts);
+static void test_auto_is_never_bigger_than_result_t(void **ts);
+static void test_auto_works_with_the_macros(void **ts);
 static void test_result_scoped_with_ok_for_err_does_nothing(void **ts);
 static void test_result_scoped_with_ok_for_ok_runs_block_with_value(void **ts);
 static void test_result_scoped_with_ok_or_else_for_err_does_not_run_block(void **ts);
 static void test_result_scoped_with_ok_or_else_for_err_runs_else_block(void **ts);
 static void test_result_scoped_with_ok_or_else_for_ok_runs_block_with_value(void **ts);
 static void test_result_scoped_with_ok_or_else_for_ok_does_not_run_else_block(void **ts);
+static void test_niche_results_are_as_big_as_their_payload(void **ts);
+static void test_nonnull_inits_ok_and_err(void **ts);
+static void test_nonnull_updates_via_set_and_compound_literals(void **ts);
+static void test_nonneg_treats_zero_as_ok_and_negative_as_err(void **ts);
+static void test_nonneg_works_with_unwrap_or_and_with(void **ts);
+static void test_status_treats_zero_as_ok(void **ts);
+static void test_status_works_with_with_err(void **ts);
+static void test_tagged_ptr_is_one_word(void **ts);
+static void test_tagged_ptr_inits_ok_and_err(void **ts);
+static void test_tagged_ptr_works_with_set_and_with(void **ts);
+static void test_try_yields_the_ok_value(void **ts);
+static void test_try_returns_the_err_early(void **ts);
+static void test_try_evaluates_its_argument_once(void **ts);
+static void test_try_nests(void **ts);
+static void test_try_as_returns_the_err_as_another_result_type(void **ts);
+static void test_try_map_err_converts_the_err(void **ts);
+static void test_is_ok_evaluates_its_argument_once_for_every_layout(void **ts);
+static void test_and_and_or_evaluate_their_first_argument_once(void **ts);
+static void test_unwrap_or_evaluates_its_argument_once(void **ts);
+static void test_unwrap_or_nests_in_itself(void **ts);
+static void test_unwrap_or_else_evaluates_its_argument_once(void **ts);
+static void test_unwrap_or_else_nests_in_its_block(void **ts);
+static void test_unwrap_or_else_ptr_evaluates_its_argument_once(void **ts);
+static void test_unwrap_err_or_else_ptr_evaluates_its_argument_once(void **ts);
+static void test_set_and_emplace_evaluate_their_result_once(void **ts);
+static void test_set_and_emplace_nest_in_themselves(void **ts);
+static void test_with_evaluates_its_argument_once(void **ts);
+static void test_result_scoped_with_evaluates_its_argument_once(void **ts);
+static void test_with_ok_ref_binds_into_the_body(void **ts);
+static void test_with_ok_ref_for_err_does_nothing(void **ts);
+static void test_with_err_ref_binds_into_the_body(void **ts);
+static void test_with_ok_ref_is_const_for_const_results(void **ts);
+static void test_unwrap_err_or_else_ptr_with_err_returns_the_err(void **ts);
+static void test_unwrap_err_or_else_ptr_with_ok_returns_null_and_runs_the_block(void **ts);
+static void test_emplace_ok_fills_the_body_in_place(void **ts);
+static void test_emplace_err_fills_the_body_in_place(void **ts);
+static void test_result_scoped_with_ok_ref_runs_block_with_pointer(void **ts);
+static void test_result_scoped_with_err_ref_for_ok_does_nothing(void **ts);
+static void test_result_scoped_with_ok_ref_or_else_for_err_runs_else_block(void **ts);
+static void test_result_scoped_with_err_ref_or_else_for_err_runs_block_with_pointer(void **ts);
 /*sublime-c-static-fn-hoist-end*/
 
 #define assert_ok(_result, _value) \
@@ -511,6 +558,89 @@ static void test_pads_to_multiple_of_pointer_size(void **ts) {
   assert_size_is_multiple_of(res_char_17, sizeof(void *));
 }
 
+typedef struct { char x[3]; } chars_3_t;
+typedef struct { char x[5]; } chars_5_t;
+typedef struct { char x[13]; } chars_13_t;
+
+#define assert_auto_size(_type, _err_type, _size, _has_tail) { \
+  assert_int_equal((_size), sizeof(result_auto_t(_type, _err_type))); \
+  assert_int_equal((_has_tail), result_auto_has_tail(_type, _err_type)); \
+}
+
+static void test_auto_reuses_the_tail_padding_of_the_union(void **ts) {
+  assert_auto_size(chars_5_t, int32_t, 8, true);
+  assert_auto_size(chars_3_t, uint16_t, 4, true);
+  assert_auto_size(chars_13_t, uint64_t, 16, true);
+  assert_auto_size(uint8_t, uint8_t, 2, false);
+  assert_auto_size(uint32_t, uint32_t, 8, false);
+  assert_auto_size(uint64_t, int, 16, false);
+
+  assert_int_equal(12, sizeof(result_t(chars_5_t, int32_t)));
+  assert_int_equal(6, sizeof(result_t(chars_3_t, uint16_t)));
+  assert_int_equal(24, sizeof(result_t(chars_13_t, uint64_t)));
+}
+
+#define assert_auto_fits(_type, _err_type) { \
+  typedef result_auto_t(_type, _err_type) auto_t; \
+  typedef result_t(_type, _err_type) natural_t; \
+  \
+  assert_true(sizeof(auto_t) <= sizeof(natural_t)); \
+  assert_int_equal(__alignof__(natural_t), __alignof__(auto_t)); \
+  assert_int_equal(0, sizeof(auto_t) % __alignof__(auto_t)); \
+  \
+  /* no padding: the header ends where the struct does */ \
+  assert_int_equal( \
+    sizeof(auto_t), \
+    offsetof(auto_t, header) + sizeof(((auto_t *) 0)->header) \
+  ); \
+}
+
+static void test_auto_is_never_bigger_than_result_t(void **ts) {
+  assert_auto_fits(uint8_t, uint8_t);
+  assert_auto_fits(uint16_t, uint8_t);
+  assert_auto_fits(uint32_t, uint16_t);
+  assert_auto_fits(uint64_t, uint32_t);
+  assert_auto_fits(void *, int);
+  assert_auto_fits(chars_3_t, uint8_t);
+  assert_auto_fits(chars_3_t, uint16_t);
+  assert_auto_fits(chars_5_t, uint32_t);
+  assert_auto_fits(chars_5_t, uint64_t);
+  assert_auto_fits(chars_13_t, uint32_t);
+  assert_auto_fits(chars_13_t, void *);
+}
+
+static void test_auto_works_with_the_macros(void **ts) {
+  typedef result_auto_t(chars_5_t, int32_t) result_chars_t;
+
+  result_chars_t res = result_init_ok(((chars_5_t) { "abcd" }));
+
+  assert_true(result_is_ok(res));
+  assert_string_equal("abcd", result_unwrap_unchecked(res).x);
+
+  result_set_err(res, -7);
+  assert_err(res, -7);
+
+  // the err write must not clobber the header in the tail
+  result_set_ok(res, ((chars_5_t) { "wxyz" }));
+  assert_true(result_is_ok(res));
+  assert_int_equal('z', result_unwrap_unchecked(res).x[3]);
+
+  res = result_err(res, 3);
+  assert_int_equal(3, result_unwrap_err_unchecked(res));
+  assert_int_equal('-', result_unwrap_or(res, (chars_5_t) { "----" }).x[0]);
+
+  result_chars_t array[4] = {
+    result_init_ok(((chars_5_t) { "0" })),
+    result_init_err(1),
+    result_init_ok(((chars_5_t) { "2" })),
+    result_init_err(3),
+  };
+
+  for (int i = 0; i < 4; i++) {
+    assert_int_equal(i % 2 == 0, result_is_ok(array[i]));
+  }
+}
+
 static void test_allows_forward_declaration(void **ts) {
   struct result_forward_decl_test_s;
   struct result_forward_decl_test_s result_d(int, int);
@@ -520,6 +650,615 @@ static void test_allows_forward_declaration(void **ts) {
   // no assertions because the point is to make sure the above compiles
 }
 
+static void test_niche_results_are_as_big_as_their_payload(void **ts) {
+  assert_int_equal(sizeof(void *), sizeof(result_nonnull_t(void *)));
+  assert_int_equal(sizeof(char *), sizeof(result_nonnull_t(char *)));
+  assert_int_equal(sizeof(int8_t), sizeof(result_nonneg_t(int8_t)));
+  assert_int_equal(sizeof(int), sizeof(result_nonneg_t(int)));
+  assert_int_equal(sizeof(ssize_t), sizeof(result_nonneg_t(ssize_t)));
+  assert_int_equal(sizeof(int), sizeof(result_status_t(int)));
+  assert_int_equal(sizeof(uint8_t), sizeof(result_status_t(uint8_t)));
+}
+
+static void test_nonnull_inits_ok_and_err(void **ts) {
+  int target = 111;
+
+  result_nonnull_t(int *) ok = result_init_ok(&target);
+  result_nonnull_t(int *) err = result_init_err(NULL);
+
+  assert_true(result_is_ok(ok));
+  assert_false(result_is_err(ok));
+  assert_ptr_equal(&target, result_unwrap_unchecked(ok));
+
+  assert_false(result_is_ok(err));
+  assert_true(result_is_err(err));
+  assert_null(result_unwrap_err_unchecked(err));
+}
+
+static void test_nonnull_updates_via_set_and_compound_literals(void **ts) {
+  int target = 111;
+
+  result_nonnull_t(int *) res = result_init_err(NULL);
+
+  result_set_ok(res, &target);
+  assert_ptr_equal(&target, result_unwrap_unchecked(res));
+
+  result_set_err(res, NULL);
+  assert_true(result_is_err(res));
+
+  res = result_ok(res, &target);
+  assert_ptr_equal(&target, result_unwrap_or(res, NULL));
+
+  res = result_err(res, NULL);
+  assert_null(result_unwrap_or(res, NULL));
+}
+
+static void test_nonneg_treats_zero_as_ok_and_negative_as_err(void **ts) {
+  typedef result_nonneg_t(int) result_nonneg_int_t;
+
+  result_nonneg_int_t zero = result_init_ok(0);
+  result_nonneg_int_t positive = result_init_ok(111);
+  result_nonneg_int_t negative = result_init_err(-111);
+
+  assert_ok(zero, 0);
+  assert_ok(positive, 111);
+  assert_err(negative, -111);
+
+  assert_ok(result_and(positive, zero), 0);
+  assert_err(result_and(negative, zero), -111);
+  assert_ok(result_or(negative, positive), 111);
+}
+
+static void test_nonneg_works_with_unwrap_or_and_with(void **ts) {
+  result_nonneg_t(ssize_t) res = result_init_err(-111);
+
+  assert_int_equal(222, result_unwrap_or(res, 222));
+
+  result_with_ok(res, value) {
+    (void) value;
+    fail();
+  }
+
+  int received_err = 0;
+
+  result_with_err(res, err) {
+    received_err = err;
+  }
+
+  assert_int_equal(-111, received_err);
+
+  res = result_ok(res, 333);
+
+  int unwrapped = result_unwrap_or_else(res) {
+    fail();
+  }
+
+  assert_int_equal(333, unwrapped);
+}
+
+static void test_status_treats_zero_as_ok(void **ts) {
+  result_status_t(int) ok = result_init_ok(0);
+  result_status_t(int) err = result_init_err(111);
+
+  assert_true(result_is_ok(ok));
+  assert_err(err, 111);
+
+  result_set_err(ok, -222);
+  assert_err(ok, -222);
+}
+
+static void test_status_works_with_with_err(void **ts) {
+  result_status_t(int) res = result_init_err(111);
+
+  int received_err = 0;
+
+  result_with_err(res, err) {
+    received_err = err;
+  }
+
+  else {
+    fail();
+  }
+
+  assert_int_equal(111, received_err);
+}
+
+enum tagged_err_e {
+  TAGGED_ERR_NONE,
+  TAGGED_ERR_MISSING,
+  TAGGED_ERR_BUSY,
+  TAGGED_ERR_GONE,
+};
+
+struct tagged_node_s {
+  uint32_t id;
+} __attribute__((aligned(4)));
+
+typedef result_tagged_ptr_t(
+  struct tagged_node_s,
+  enum tagged_err_e,
+  TAGGED_ERR_GONE
+) result_tagged_node_t;
+
+static void test_tagged_ptr_is_one_word(void **ts) {
+  assert_int_equal(sizeof(void *), sizeof(result_tagged_node_t));
+
+  result_tagged_node_t many[16];
+  assert_int_equal(16 * sizeof(void *), sizeof(many));
+}
+
+static void test_tagged_ptr_inits_ok_and_err(void **ts) {
+  struct tagged_node_s node = { .id = 111 };
+
+  result_tagged_node_t ok = result_init_ok(&node);
+  result_tagged_node_t null = result_init_ok(NULL);
+  result_tagged_node_t err = result_init_err(TAGGED_ERR_BUSY);
+
+  assert_true(result_is_ok(ok));
+  assert_ptr_equal(&node, result_unwrap_unchecked(ok));
+  assert_int_equal(111, result_unwrap_unchecked(ok)->id);
+
+  assert_true(result_is_ok(null));
+  assert_null(result_unwrap_unchecked(null));
+
+  assert_err(err, TAGGED_ERR_BUSY);
+}
+
+static void test_tagged_ptr_works_with_set_and_with(void **ts) {
+  struct tagged_node_s node = { .id = 111 };
+
+  result_tagged_node_t res = result_init_ok(&node);
+
+  result_set_err(res, TAGGED_ERR_GONE);
+  assert_err(res, TAGGED_ERR_GONE);
+
+  res = result_ok(res, &node);
+
+  uint32_t received_id = 0;
+
+  result_with_ok(res, value) {
+    received_id = value->id;
+  }
+
+  assert_int_equal(111, received_id);
+
+  res = result_err(res, TAGGED_ERR_MISSING);
+  assert_null(result_unwrap_or(res, NULL));
+}
+
+typedef result_t(int, int) result_try_int_t;
+typedef result_t(const char *, int) result_try_str_t;
+typedef result_t(const char *, const char *) result_try_msg_t;
+
+static int try_calls = 0;
+static int try_reached_end = 0;
+
+static result_try_int_t try_half(int value) {
+  try_calls++;
+
+  if (value % 2) {
+    return (result_try_int_t) result_init_err(value);
+  }
+
+  return (result_try_int_t) result_init_ok(value / 2);
+}
+
+static result_try_int_t try_quarter(int value) {
+  int half = result_try(try_half(value));
+  int quarter = result_try(try_half(half));
+
+  try_reached_end++;
+  return (result_try_int_t) result_init_ok(quarter);
+}
+
+static result_try_int_t try_eighth(int value) {
+  int eighth = result_try(try_half(result_try(try_quarter(value))));
+
+  try_reached_end++;
+  return (result_try_int_t) result_init_ok(eighth);
+}
+
+static result_try_str_t try_describe(int value) {
+  int half = result_try_as(result_try_str_t, try_half(value));
+
+  try_reached_end++;
+  return (result_try_str_t) result_init_ok(half > 10 ? "big" : "small");
+}
+
+static result_try_msg_t try_msg_from_err(int err) {
+  return (result_try_msg_t) result_init_err(err == 3 ? "three" : "odd");
+}
+
+static result_try_msg_t try_describe_msg(int value) {
+  int half = result_try_map_err(try_half(value), try_msg_from_err);
+
+  try_reached_end++;
+  return (result_try_msg_t) result_init_ok(half > 10 ? "big" : "small");
+}
+
+static void test_try_yields_the_ok_value(void **ts) {
+  try_reached_end = 0;
+
+  result_try_int_t res = try_quarter(12);
+
+  assert_ok(res, 3);
+  assert_int_equal(1, try_reached_end);
+}
+
+static void test_try_returns_the_err_early(void **ts) {
+  try_reached_end = 0;
+
+  result_try_int_t odd = try_quarter(11);
+  result_try_int_t odd_half = try_quarter(6);
+
+  assert_err(odd, 11);
+  assert_err(odd_half, 3);
+  assert_int_equal(0, try_reached_end);
+}
+
+static void test_try_evaluates_its_argument_once(void **ts) {
+  try_calls = 0;
+  try_quarter(12);
+  assert_int_equal(2, try_calls);
+
+  try_calls = 0;
+  try_quarter(11);
+  assert_int_equal(1, try_calls);
+}
+
+static void test_try_nests(void **ts) {
+  try_reached_end = 0;
+
+  result_try_int_t res = try_eighth(24);
+  result_try_int_t inner_err = try_eighth(6);
+  result_try_int_t outer_err = try_eighth(12);
+
+  assert_ok(res, 3);
+  assert_err(inner_err, 3);
+  assert_err(outer_err, 3);
+  assert_int_equal(3, try_reached_end);
+}
+
+static void test_try_as_returns_the_err_as_another_result_type(void **ts) {
+  try_reached_end = 0;
+
+  result_try_str_t ok = try_describe(40);
+  result_try_str_t err = try_describe(7);
+
+  assert_true(result_is_ok(ok));
+  assert_string_equal("big", result_unwrap_unchecked(ok));
+  assert_err(err, 7);
+  assert_int_equal(1, try_reached_end);
+}
+
+static void test_try_map_err_converts_the_err(void **ts) {
+  try_reached_end = 0;
+
+  result_try_msg_t ok = try_describe_msg(4);
+  result_try_msg_t err = try_describe_msg(3);
+
+  assert_true(result_is_ok(ok));
+  assert_string_equal("small", result_unwrap_unchecked(ok));
+  assert_true(result_is_err(err));
+  assert_string_equal("three", result_unwrap_err_unchecked(err));
+  assert_int_equal(1, try_reached_end);
+}
+
+struct big_s {
+  int words[64];
+};
+
+static void test_with_ok_ref_binds_into_the_body(void **ts) {
+  result_t(struct big_s, int) res = result_init_ok((struct big_s) { { 1 } });
+
+  result_with_ok_ref(res, big) {
+    big->words[0]++;
+    big->words[63] = 5;
+  }
+
+  else {
+    fail();
+  }
+
+  assert_int_equal(2, result_unwrap_unchecked(res).words[0]);
+  assert_int_equal(5, result_unwrap_unchecked(res).words[63]);
+}
+
+static void test_with_ok_ref_for_err_does_nothing(void **ts) {
+  result_t(struct big_s, int) res = result_init_err(111);
+
+  result_with_ok_ref(res, big) {
+    (void) big;
+    fail();
+  }
+}
+
+static void test_with_err_ref_binds_into_the_body(void **ts) {
+  result_t(int, struct big_s) res = result_init_err((struct big_s) { { 3 } });
+
+  result_with_err_ref(res, big) {
+    assert_ptr_equal(&res.body.err, big);
+    big->words[1] = 4;
+  }
+
+  assert_int_equal(3, result_unwrap_err_unchecked(res).words[0]);
+  assert_int_equal(4, result_unwrap_err_unchecked(res).words[1]);
+}
+
+static void test_with_ok_ref_is_const_for_const_results(void **ts) {
+  const result_t(struct big_s, int) res = result_init_ok(
+    (struct big_s) { { 0 } }
+  );
+
+  result_with_ok_ref(res, big) {
+    assert_true(
+      __builtin_types_compatible_p(__typeof(big), const struct big_s *)
+    );
+  }
+}
+
+static void test_unwrap_err_or_else_ptr_with_err_returns_the_err(void **ts) {
+  result_t(int, struct big_s) res = result_init_err((struct big_s) { { 7 } });
+
+  struct big_s *big = result_unwrap_err_or_else_ptr(res) {
+    fail();
+  }
+
+  assert_ptr_equal(&res.body.err, big);
+  assert_int_equal(7, big->words[0]);
+}
+
+static void test_unwrap_err_or_else_ptr_with_ok_returns_null_and_runs_the_block(void **ts) {
+  result_t(int, struct big_s) res = result_init_ok(111);
+  bool block_was_run = false;
+
+  struct big_s *big = result_unwrap_err_or_else_ptr(res) {
+    block_was_run = true;
+  }
+
+  assert_null(big);
+  assert_true(block_was_run);
+}
+
+static void test_emplace_ok_fills_the_body_in_place(void **ts) {
+  result_t(struct big_s, int) res = result_init_err(111);
+  struct big_s *big = result_emplace_ok(res);
+
+  assert_ptr_equal(&res.body.ok, big);
+
+  for (int i = 0; i < 64; i++) {
+    big->words[i] = i;
+  }
+
+  assert_true(result_is_ok(res));
+  assert_int_equal(63, result_unwrap_unchecked(res).words[63]);
+}
+
+static void test_emplace_err_fills_the_body_in_place(void **ts) {
+  result_padded_t(int, struct big_s) res = result_init_ok(111);
+
+  result_emplace_err(res)->words[0] = 9;
+
+  assert_true(result_is_err(res));
+  assert_int_equal(9, result_unwrap_err_unchecked(res).words[0]);
+}
+
+static int evaluations;
+
+static result_eval_t count_eval(result_eval_t res) {
+  evaluations++;
+  return res;
+}
+
+static result_eval_t *count_eval_ptr(result_eval_t *res) {
+  evaluations++;
+  return res;
+}
+
+#define assert_evaluations(_expected, _expression) { \
+  evaluations = 0; \
+  (void) (_expression); \
+  assert_int_equal((_expected), evaluations); \
+}
+
+static void test_is_ok_evaluates_its_argument_once_for_every_layout(void **ts) {
+  int value = 1;
+  result_t(int, int) plain = result_init_ok(1);
+  result_padded_t(int, int) padded = result_init_ok(1);
+  result_nonnull_t(int *) nonnull = result_init_ok(&value);
+  result_nonneg_t(int) nonneg = result_init_ok(1);
+  result_status_t(int) status = result_init_err(1);
+  result_tagged_ptr_t(int, int, 3) tagged = result_init_err(2);
+
+  assert_evaluations(1, result_is_ok((evaluations++, plain)));
+  assert_evaluations(1, result_is_ok((evaluations++, padded)));
+  assert_evaluations(1, result_is_ok((evaluations++, nonnull)));
+  assert_evaluations(1, result_is_ok((evaluations++, nonneg)));
+  assert_evaluations(1, result_is_err((evaluations++, status)));
+  assert_evaluations(1, result_is_err((evaluations++, tagged)));
+}
+
+static void test_and_and_or_evaluate_their_first_argument_once(void **ts) {
+  result_eval_t ok = result_init_ok(1);
+  result_eval_t err = result_init_err(2);
+
+  assert_evaluations(2, result_and(count_eval(ok), count_eval(ok)));
+  assert_evaluations(1, result_and(count_eval(err), count_eval(ok)));
+  assert_evaluations(1, result_or(count_eval(ok), count_eval(err)));
+  assert_evaluations(2, result_or(count_eval(err), count_eval(err)));
+
+  assert_err(result_and(ok, result_and(ok, err)), 2);
+  assert_ok(result_or(err, result_or(err, ok)), 1);
+}
+
+static void test_unwrap_or_evaluates_its_argument_once(void **ts) {
+  result_eval_t ok = result_init_ok(1);
+  result_eval_t err = result_init_err(2);
+
+  assert_evaluations(1, result_unwrap_or(count_eval(ok), 0));
+  assert_evaluations(1, result_unwrap_or(count_eval(err), 0));
+}
+
+static void test_unwrap_or_nests_in_itself(void **ts) {
+  result_eval_t ok = result_init_ok(1);
+  result_eval_t err = result_init_err(2);
+
+  evaluations = 0;
+
+  int value = result_unwrap_or(
+    count_eval(err),
+    result_unwrap_or(count_eval(ok), 5)
+  );
+
+  assert_int_equal(1, value);
+  assert_int_equal(2, evaluations);
+}
+
+static void test_unwrap_or_else_evaluates_its_argument_once(void **ts) {
+  result_eval_t ok = result_init_ok(1);
+  result_eval_t err = result_init_err(2);
+  int runs = 0;
+
+  evaluations = 0;
+
+  int value = result_unwrap_or_else(count_eval(ok)) {
+    runs++;
+  }
+
+  assert_int_equal(1, value);
+
+  value = result_unwrap_or_else(count_eval(err)) {
+    runs++;
+  }
+
+  assert_int_equal(0, value);
+  assert_int_equal(1, runs);
+  assert_int_equal(2, evaluations);
+}
+
+static void test_unwrap_or_else_nests_in_its_block(void **ts) {
+  result_eval_t ok = result_init_ok(1);
+  result_eval_t err = result_init_err(2);
+  int outer_runs = 0;
+  int inner_runs = 0;
+
+  int value = result_unwrap_or_else(err) {
+    outer_runs++;
+
+    int inner = result_unwrap_or_else(ok) {
+      inner_runs++;
+    }
+
+    value = inner + 10;
+  }
+
+  assert_int_equal(11, value);
+  assert_int_equal(1, outer_runs);
+  assert_int_equal(0, inner_runs);
+}
+
+static void test_unwrap_or_else_ptr_evaluates_its_argument_once(void **ts) {
+  result_eval_t ok = result_init_ok(1);
+  result_eval_t err = result_init_err(2);
+  int runs = 0;
+
+  evaluations = 0;
+
+  int *value = result_unwrap_or_else_ptr(*count_eval_ptr(&ok)) {
+    runs++;
+  }
+
+  assert_ptr_equal(&ok.body.ok, value);
+
+  value = result_unwrap_or_else_ptr(*count_eval_ptr(&err)) {
+    runs++;
+  }
+
+  assert_null(value);
+  assert_int_equal(1, runs);
+  assert_int_equal(2, evaluations);
+}
+
+static void test_unwrap_err_or_else_ptr_evaluates_its_argument_once(void **ts) {
+  result_eval_t ok = result_init_ok(1);
+  result_eval_t err = result_init_err(2);
+  int runs = 0;
+
+  evaluations = 0;
+
+  int *value = result_unwrap_err_or_else_ptr(*count_eval_ptr(&err)) {
+    runs++;
+  }
+
+  assert_ptr_equal(&err.body.err, value);
+
+  value = result_unwrap_err_or_else_ptr(*count_eval_ptr(&ok)) {
+    runs++;
+  }
+
+  assert_null(value);
+  assert_int_equal(1, runs);
+  assert_int_equal(2, evaluations);
+}
+
+static void test_set_and_emplace_evaluate_their_result_once(void **ts) {
+  result_eval_t res = result_init_ok(1);
+
+  assert_evaluations(1, result_set_err(*count_eval_ptr(&res), 2));
+  assert_err(res, 2);
+
+  assert_evaluations(1, result_set_ok(*count_eval_ptr(&res), 3));
+  assert_ok(res, 3);
+
+  assert_evaluations(1, result_emplace_err(*count_eval_ptr(&res)));
+  assert_true(result_is_err(res));
+
+  assert_evaluations(1, result_emplace_ok(*count_eval_ptr(&res)));
+  assert_true(result_is_ok(res));
+}
+
+static void test_set_and_emplace_nest_in_themselves(void **ts) {
+  result_eval_t a = result_init_err(0);
+  result_eval_t b = result_init_err(0);
+
+  result_set_ok(a, (result_set_err(b, 2), 3));
+  assert_ok(a, 3);
+  assert_err(b, 2);
+
+  result_t(result_eval_t, int) outer = result_init_err(0);
+
+  *result_emplace_ok(*result_emplace_ok(outer)) = 4;
+  assert_true(result_is_ok(outer));
+  assert_ok(outer.body.ok, 4);
+}
+
+static void test_with_evaluates_its_argument_once(void **ts) {
+  result_eval_t ok = result_init_ok(1);
+  result_eval_t err = result_init_err(2);
+  int received = 0;
+
+  evaluations = 0;
+
+  {result_with_ok(count_eval(ok), value) {
+    received += value;
+  }}
+
+  {result_with_err(count_eval(err), value) {
+    received += value;
+  }}
+
+  {result_with_ok_ref(*count_eval_ptr(&ok), value) {
+    received += *value;
+  }}
+
+  {result_with_err_ref(*count_eval_ptr(&err), value) {
+    received += *value;
+  }}
+
+  assert_int_equal(6, received);
+  assert_int_equal(4, evaluations);
+}
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpragmas"
 #pragma GCC diagnostic ignored "-Wgnu-statement-expression"
@@ -660,6 +1399,103 @@ static void test_result_scoped_with_err_or_else_for_err_does_not_run_else_block(
   }));
 }
 
+static void test_result_scoped_with_ok_ref_runs_block_with_pointer(void **ts) {
+  result_t(struct big_s, int) res = result_init_ok((struct big_s) { { 1 } });
+
+  result_scoped_with_ok_ref(res, big, {
+    big->words[0] = 2;
+  });
+
+  assert_int_equal(2, result_unwrap_unchecked(res).words[0]);
+}
+
+static void test_result_scoped_with_err_ref_for_ok_does_nothing(void **ts) {
+  result_t(int, struct big_s) res = result_init_ok(111);
+
+  result_scoped_with_err_ref(res, big, {
+    (void) big;
+    fail();
+  });
+}
+
+static void test_result_scoped_with_ok_ref_or_else_for_err_runs_else_block(void **ts) {
+  result_t(struct big_s, int) res = result_init_err(111);
+
+  result_scoped_with_ok_ref_or_else(res, big, ({
+    (void) big;
+    fail();
+  }), ({
+    return;
+  }));
+
+  fail();
+}
+
+static void test_result_scoped_with_err_ref_or_else_for_err_runs_block_with_pointer(void **ts) {
+  result_t(int, struct big_s) res = result_init_err((struct big_s) { { 3 } });
+
+  int received_value = 0;
+
+  result_scoped_with_err_ref_or_else(res, big, ({
+    received_value = big->words[0];
+  }), ({
+    fail();
+  }));
+
+  assert_int_equal(3, received_value);
+}
+
+static void test_result_scoped_with_evaluates_its_argument_once(void **ts) {
+  result_eval_t ok = result_init_ok(1);
+  result_eval_t err = result_init_err(2);
+  int received = 0;
+
+  evaluations = 0;
+
+  result_scoped_with_ok(count_eval(ok), value, {
+    received += value;
+  });
+
+  result_scoped_with_err(count_eval(err), value, {
+    received += value;
+  });
+
+  result_scoped_with_ok_or_else(count_eval(err), value, ({
+    received += value;
+  }), ({
+    received += 10;
+  }));
+
+  result_scoped_with_err_or_else(count_eval(err), value, ({
+    received += value;
+  }), ({
+    fail();
+  }));
+
+  result_scoped_with_ok_ref(*count_eval_ptr(&ok), value, {
+    received += *value;
+  });
+
+  result_scoped_with_err_ref(*count_eval_ptr(&err), value, {
+    received += *value;
+  });
+
+  result_scoped_with_ok_ref_or_else(*count_eval_ptr(&ok), value, ({
+    received += *value;
+  }), ({
+    fail();
+  }));
+
+  result_scoped_with_err_ref_or_else(*count_eval_ptr(&ok), value, ({
+    received += *value;
+  }), ({
+    received += 100;
+  }));
+
+  assert_int_equal(1 + 2 + 10 + 2 + 1 + 2 + 1 + 100, received);
+  assert_int_equal(8, evaluations);
+}
+
 #pragma GCC diagnostic pop
 
 int main(void) {
@@ -698,6 +1534,49 @@ int main(void) {
     cmocka_unit_test(test_unwrap_or_else_with_err_and_missing_else_block_returns_zeroed_value),
     cmocka_unit_test(test_pads_to_multiple_of_pointer_size),
     cmocka_unit_test(test_allows_forward_declaration),
+    cmocka_unit_test(test_auto_reuses_the_tail_padding_of_the_union),
+    cmocka_unit_test(test_auto_is_never_bigger_than_result_t),
+    cmocka_unit_test(test_auto_works_with_the_macros),
+    cmocka_unit_test(test_niche_results_are_as_big_as_their_payload),
+    cmocka_unit_test(test_nonnull_inits_ok_and_err),
+    cmocka_unit_test(test_nonnull_updates_via_set_and_compound_literals),
+    cmocka_unit_test(test_nonneg_treats_zero_as_ok_and_negative_as_err),
+    cmocka_unit_test(test_nonneg_works_with_unwrap_or_and_with),
+    cmocka_unit_test(test_status_treats_zero_as_ok),
+    cmocka_unit_test(test_status_works_with_with_err),
+    cmocka_unit_test(test_tagged_ptr_is_one_word),
+    cmocka_unit_test(test_tagged_ptr_inits_ok_and_err),
+    cmocka_unit_test(test_tagged_ptr_works_with_set_and_with),
+    cmocka_unit_test(test_try_yields_the_ok_value),
+    cmocka_unit_test(test_try_returns_the_err_early),
+    cmocka_unit_test(test_try_evaluates_its_argument_once),
+    cmocka_unit_test(test_try_nests),
+    cmocka_unit_test(test_try_as_returns_the_err_as_another_result_type),
+    cmocka_unit_test(test_try_map_err_converts_the_err),
+    cmocka_unit_test(test_is_ok_evaluates_its_argument_once_for_every_layout),
+    cmocka_unit_test(test_and_and_or_evaluate_their_first_argument_once),
+    cmocka_unit_test(test_unwrap_or_evaluates_its_argument_once),
+    cmocka_unit_test(test_unwrap_or_nests_in_itself),
+    cmocka_unit_test(test_unwrap_or_else_evaluates_its_argument_once),
+    cmocka_unit_test(test_unwrap_or_else_nests_in_its_block),
+    cmocka_unit_test(test_unwrap_or_else_ptr_evaluates_its_argument_once),
+    cmocka_unit_test(test_unwrap_err_or_else_ptr_evaluates_its_argument_once),
+    cmocka_unit_test(test_set_and_emplace_evaluate_their_result_once),
+    cmocka_unit_test(test_set_and_emplace_nest_in_themselves),
+    cmocka_unit_test(test_with_evaluates_its_argument_once),
+    cmocka_unit_test(test_result_scoped_with_evaluates_its_argument_once),
+    cmocka_unit_test(test_with_ok_ref_binds_into_the_body),
+    cmocka_unit_test(test_with_ok_ref_for_err_does_nothing),
+    cmocka_unit_test(test_with_err_ref_binds_into_the_body),
+    cmocka_unit_test(test_with_ok_ref_is_const_for_const_results),
+    cmocka_unit_test(test_unwrap_err_or_else_ptr_with_err_returns_the_err),
+    cmocka_unit_test(test_unwrap_err_or_else_ptr_with_ok_returns_null_and_runs_the_block),
+    cmocka_unit_test(test_emplace_ok_fills_the_body_in_place),
+    cmocka_unit_test(test_emplace_err_fills_the_body_in_place),
+    cmocka_unit_test(test_result_scoped_with_ok_ref_runs_block_with_pointer),
+    cmocka_unit_test(test_result_scoped_with_err_ref_for_ok_does_nothing),
+    cmocka_unit_test(test_result_scoped_with_ok_ref_or_else_for_err_runs_else_block),
+    cmocka_unit_test(test_result_scoped_with_err_ref_or_else_for_err_runs_block_with_pointer),
     cmocka_unit_test(test_result_scoped_with_ok_for_err_does_nothing),
     cmocka_unit_test(test_result_scoped_with_ok_for_ok_runs_block_with_value),
     cmocka_unit_test(test_result_scoped_with_ok_or_else_for_err_does_not_run_block),
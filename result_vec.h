@@ -0,0 +1,487 @@
+#ifndef __result_vec_h__
+#define __result_vec_h__
+
+#include "core/defs.h"
+#include "result.h"
+
+//
+// Structure-of-arrays container for large numbers of results.
+//
+// Instead of an array of result_t, where every element pays for the header
+// and its padding, a result_vec keeps
+//
+//   - a bitmap with one bit per element, set when the element is ok
+//     (like the validity bitmap in Apache Arrow)
+//   - a dense column of ok values; slots of err elements are unspecified
+//   - a sparse column with only the errs, in element order
+//   - the number of errs before every block of RESULT_VEC_BLOCK elements,
+//     which together with the bitmap locates the err of any element
+//
+// so eg. 10M x result_t(uint32_t, uint8_t) is 80MB, but in a result_vec it's
+// ~41MB plus a byte per error.
+//
+//   result_vec_t(uint32_t, uint8_t) vec = { 0 };
+//   result_t(uint32_t, uint8_t) res = result_init_ok(123);
+//
+//   if (!result_vec_push(vec, res)) {
+//     // out of memory
+//   }
+//
+//   result_vec_get(vec, 0, res);
+//   result_vec_free(vec);
+//
+// Elements go in and come out as regular results: any result type with the
+// same ok and err types works (result_t, result_padded_t, ...).
+//
+// Appending and reading are O(1). Turning an ok element into an err (or back)
+// with result_vec_set moves the errs after it, so it's O(errs).
+//
+// Everything here uses GNU extensions. Macros evaluate their arguments once,
+// except for `_result` arguments that are assigned to, which must be lvalues.
+//
+
+#define RESULT_VEC_BLOCK 512
+
+#define result_vec_t(_type, _err_type) \
+  struct result_vec_d(_type, _err_type)
+
+#define result_vec_d(_type, _err_type) { \
+  uint64_t *is_ok; \
+  size_t *err_rank; \
+  _type *ok; \
+  _err_type *err; \
+  size_t len; \
+  size_t cap; \
+  size_t err_len; \
+  size_t err_cap; \
+}
+
+#define result_vec_free(_vec) ({ \
+  __typeof(&(_vec)) result_vec_self = &(_vec); \
+  \
+  free(result_vec_self->is_ok); \
+  free(result_vec_self->err_rank); \
+  free(result_vec_self->ok); \
+  free(result_vec_self->err); \
+  \
+  *result_vec_self = (__typeof(_vec)) { 0 }; \
+})
+
+// Makes room for at least `_cap` elements, of which up to `_err_cap` may be
+// errs. Returns false if out of memory, in which case the vec is unchanged
+// (but may have grown some of its columns).
+
+#define result_vec_reserve(_vec, _cap, _err_cap) ({ \
+  __typeof(&(_vec)) result_vec_self = &(_vec); \
+  size_t result_vec_want = (_cap); \
+  size_t result_vec_err_want = (_err_cap); \
+  bool result_vec_reserved = true; \
+  \
+  if (result_vec_want > result_vec_self->cap) { \
+    size_t result_vec_new_cap = result_vec_grow_cap( \
+      result_vec_self->cap, result_vec_want \
+    ); \
+    \
+    __typeof(result_vec_self->ok) result_vec_ok = realloc( \
+      result_vec_self->ok, \
+      result_vec_new_cap * sizeof(*result_vec_self->ok) \
+    ); \
+    \
+    if (result_vec_ok) { \
+      result_vec_self->ok = result_vec_ok; \
+    } \
+    \
+    result_vec_reserved = result_vec_ok && result_vec_grow_index( \
+      &result_vec_self->is_ok, \
+      &result_vec_self->err_rank, \
+      result_vec_self->cap, \
+      result_vec_new_cap \
+    ); \
+    \
+    if (result_vec_reserved) { \
+      result_vec_self->cap = result_vec_new_cap; \
+    } \
+  } \
+  \
+  if (result_vec_reserved && result_vec_err_want > result_vec_self->err_cap) { \
+    size_t result_vec_new_cap = result_vec_grow_cap( \
+      result_vec_self->err_cap, result_vec_err_want \
+    ); \
+    \
+    __typeof(result_vec_self->err) result_vec_err = realloc( \
+      result_vec_self->err, \
+      result_vec_new_cap * sizeof(*result_vec_self->err) \
+    ); \
+    \
+    if (result_vec_err) { \
+      result_vec_self->err = result_vec_err; \
+      result_vec_self->err_cap = result_vec_new_cap; \
+    } \
+    \
+    else { \
+      result_vec_reserved = false; \
+    } \
+  } \
+  \
+  result_vec_reserved; \
+})
+
+// Appends a result. Returns false if out of memory.
+
+#define result_vec_push(_vec, _result) ({ \
+  __typeof(&(_vec)) result_vec_vec = &(_vec); \
+  __typeof(_result) result_vec_res = (_result); \
+  bool result_vec_is_ok = result_is_ok(result_vec_res); \
+  \
+  bool result_vec_pushed = result_vec_reserve( \
+    *result_vec_vec, \
+    result_vec_vec->len + 1, \
+    result_vec_vec->err_len + !result_vec_is_ok \
+  ); \
+  \
+  if (result_vec_pushed) { \
+    size_t result_vec_i = result_vec_vec->len++; \
+    \
+    if (result_vec_i % RESULT_VEC_BLOCK == 0) { \
+      result_vec_vec->err_rank[result_vec_i / RESULT_VEC_BLOCK] = \
+        result_vec_vec->err_len; \
+    } \
+    \
+    if (result_vec_is_ok) { \
+      result_bitmap_set(result_vec_vec->is_ok, result_vec_i); \
+      result_vec_vec->ok[result_vec_i] = \
+        result_unwrap_unchecked(result_vec_res); \
+    } \
+    \
+    else { \
+      result_bitmap_clear(result_vec_vec->is_ok, result_vec_i); \
+      result_vec_vec->err[result_vec_vec->err_len++] = \
+        result_unwrap_err_unchecked(result_vec_res); \
+    } \
+  } \
+  \
+  result_vec_pushed; \
+})
+
+#define result_vec_is_ok(_vec, _index) \
+  result_bitmap_get((_vec).is_ok, (_index))
+
+// Reads element `_index` into the lvalue `_result`. The index must be in
+// bounds.
+
+#define result_vec_get(_vec, _index, _result) ({ \
+  __typeof(&(_vec)) result_vec_vec = &(_vec); \
+  size_t result_vec_i = (_index); \
+  \
+  if (result_bitmap_get(result_vec_vec->is_ok, result_vec_i)) { \
+    result_set_ok(_result, result_vec_vec->ok[result_vec_i]); \
+  } \
+  \
+  else { \
+    size_t result_vec_slot = result_vec_err_slot( \
+      result_vec_vec->is_ok, result_vec_vec->err_rank, result_vec_i \
+    ); \
+    \
+    result_set_err(_result, result_vec_vec->err[result_vec_slot]); \
+  } \
+})
+
+// Overwrites element `_index`, which must be in bounds. Returns false if out
+// of memory, in which case the element is unchanged.
+
+#define result_vec_set(_vec, _index, _result) ({ \
+  __typeof(&(_vec)) result_vec_vec = &(_vec); \
+  size_t result_vec_i = (_index); \
+  __typeof(_result) result_vec_res = (_result); \
+  bool result_vec_was_ok = \
+    result_bitmap_get(result_vec_vec->is_ok, result_vec_i); \
+  bool result_vec_done = true; \
+  \
+  size_t result_vec_slot = result_vec_err_slot( \
+    result_vec_vec->is_ok, result_vec_vec->err_rank, result_vec_i \
+  ); \
+  \
+  if (result_is_ok(result_vec_res)) { \
+    result_vec_vec->ok[result_vec_i] = \
+      result_unwrap_unchecked(result_vec_res); \
+    \
+    if (!result_vec_was_ok) { \
+      result_vec_vec->err_len--; \
+      \
+      memmove( \
+        &result_vec_vec->err[result_vec_slot], \
+        &result_vec_vec->err[result_vec_slot + 1], \
+        (result_vec_vec->err_len - result_vec_slot) \
+          * sizeof(*result_vec_vec->err) \
+      ); \
+      \
+      result_bitmap_set(result_vec_vec->is_ok, result_vec_i); \
+      result_vec_shift_rank( \
+        result_vec_vec->err_rank, result_vec_vec->len, result_vec_i, -1 \
+      ); \
+    } \
+  } \
+  \
+  else if (!result_vec_was_ok) { \
+    result_vec_vec->err[result_vec_slot] = \
+      result_unwrap_err_unchecked(result_vec_res); \
+  } \
+  \
+  else if (result_vec_reserve( \
+    *result_vec_vec, result_vec_vec->len, result_vec_vec->err_len + 1 \
+  )) { \
+    memmove( \
+      &result_vec_vec->err[result_vec_slot + 1], \
+      &result_vec_vec->err[result_vec_slot], \
+      (result_vec_vec->err_len - result_vec_slot) \
+        * sizeof(*result_vec_vec->err) \
+    ); \
+    \
+    result_vec_vec->err[result_vec_slot] = \
+      result_unwrap_err_unchecked(result_vec_res); \
+    result_vec_vec->err_len++; \
+    \
+    result_bitmap_clear(result_vec_vec->is_ok, result_vec_i); \
+    result_vec_shift_rank( \
+      result_vec_vec->err_rank, result_vec_vec->len, result_vec_i, 1 \
+    ); \
+  } \
+  \
+  else { \
+    result_vec_done = false; \
+  } \
+  \
+  result_vec_done; \
+})
+
+// Appends `_len` results from a plain array. Returns false if out of memory,
+// in which case some of them may have been appended.
+
+#define result_vec_push_array(_vec, _array, _len) ({ \
+  __typeof(&(_vec)) result_vec_dst = &(_vec); \
+  __typeof(&*(_array)) result_vec_src = (_array); \
+  size_t result_vec_src_len = (_len); \
+  bool result_vec_all = result_vec_reserve( \
+    *result_vec_dst, result_vec_dst->len + result_vec_src_len, 0 \
+  ); \
+  \
+  for (size_t result_vec_j = 0; \
+    result_vec_all && result_vec_j < result_vec_src_len; \
+    result_vec_j++ \
+  ) { \
+    result_vec_all = result_vec_push( \
+      *result_vec_dst, result_vec_src[result_vec_j] \
+    ); \
+  } \
+  \
+  result_vec_all; \
+})
+
+// Writes all elements to a plain array of results, which must have room for
+// `vec.len` elements.
+
+#define result_vec_to_array(_vec, _array) ({ \
+  __typeof(&(_vec)) result_vec_src = &(_vec); \
+  __typeof(&*(_array)) result_vec_dst = (_array); \
+  size_t result_vec_slot = 0; \
+  \
+  for (size_t result_vec_j = 0; \
+    result_vec_j < result_vec_src->len; \
+    result_vec_j++ \
+  ) { \
+    if (result_bitmap_get(result_vec_src->is_ok, result_vec_j)) { \
+      result_set_ok( \
+        result_vec_dst[result_vec_j], \
+        result_vec_src->ok[result_vec_j] \
+      ); \
+    } \
+    \
+    else { \
+      result_set_err( \
+        result_vec_dst[result_vec_j], \
+        result_vec_src->err[result_vec_slot++] \
+      ); \
+    } \
+  } \
+})
+
+// Number of ok elements in [_from, _to).
+#define result_vec_count_ok_range(_vec, _from, _to) \
+  result_bitmap_count((_vec).is_ok, (_from), (_to))
+
+#define result_vec_count_ok(_vec) ({ \
+  __typeof(&(_vec)) result_vec_self = &(_vec); \
+  result_bitmap_count(result_vec_self->is_ok, 0, result_vec_self->len); \
+})
+
+#define result_vec_count_err(_vec) \
+  ((_vec).err_len)
+
+// Index of the first err at or after `_from`, or `vec.len` if there's none.
+#define result_vec_first_err_from(_vec, _from) ({ \
+  __typeof(&(_vec)) result_vec_self = &(_vec); \
+  result_bitmap_first_zero( \
+    result_vec_self->is_ok, (_from), result_vec_self->len \
+  ); \
+})
+
+#define result_vec_first_err(_vec) \
+  result_vec_first_err_from(_vec, 0)
+
+// Bytes allocated by the vec.
+#define result_vec_memory_usage(_vec) ({ \
+  __typeof(&(_vec)) result_vec_self = &(_vec); \
+  \
+  result_vec_self->cap * sizeof(*result_vec_self->ok) \
+    + result_bitmap_words(result_vec_self->cap) * sizeof(uint64_t) \
+    + result_vec_blocks(result_vec_self->cap) * sizeof(size_t) \
+    + result_vec_self->err_cap * sizeof(*result_vec_self->err); \
+})
+
+//
+// Helpers. These don't depend on the element types.
+//
+
+#define result_bitmap_words(_bits) (((_bits) + 63) / 64)
+#define result_vec_blocks(_len) (((_len) + RESULT_VEC_BLOCK - 1) / RESULT_VEC_BLOCK)
+
+static inline bool result_bitmap_get(const uint64_t *bitmap, size_t i) {
+  return (bitmap[i / 64] >> (i % 64)) & 1;
+}
+
+static inline void result_bitmap_set(uint64_t *bitmap, size_t i) {
+  bitmap[i / 64] |= (uint64_t) 1 << (i % 64);
+}
+
+static inline void result_bitmap_clear(uint64_t *bitmap, size_t i) {
+  bitmap[i / 64] &= ~((uint64_t) 1 << (i % 64));
+}
+
+// Word with bits [from, to) set, where from < to <= 64.
+static inline uint64_t result_bitmap_mask(size_t from, size_t to) {
+  uint64_t ones = to - from >= 64
+    ? ~(uint64_t) 0
+    : ((uint64_t) 1 << (to - from)) - 1;
+
+  return ones << from;
+}
+
+// Number of set bits in [from, to).
+static inline size_t result_bitmap_count(
+  const uint64_t *bitmap,
+  size_t from,
+  size_t to
+) {
+  if (from >= to) {
+    return 0;
+  }
+
+  size_t first = from / 64;
+  size_t last = (to - 1) / 64;
+
+  if (first == last) {
+    return __builtin_popcountll(
+      bitmap[first] & result_bitmap_mask(from % 64, (to - 1) % 64 + 1)
+    );
+  }
+
+  size_t count = __builtin_popcountll(
+    bitmap[first] & result_bitmap_mask(from % 64, 64)
+  );
+
+  for (size_t w = first + 1; w < last; w++) {
+    count += __builtin_popcountll(bitmap[w]);
+  }
+
+  count += __builtin_popcountll(
+    bitmap[last] & result_bitmap_mask(0, (to - 1) % 64 + 1)
+  );
+
+  return count;
+}
+
+// Index of the first clear bit in [from, to), or `to` if there's none.
+static inline size_t result_bitmap_first_zero(
+  const uint64_t *bitmap,
+  size_t from,
+  size_t to
+) {
+  for (size_t w = from / 64; w * 64 < to; w++) {
+    uint64_t zeros = ~bitmap[w];
+
+    if (w == from / 64) {
+      zeros &= result_bitmap_mask(from % 64, 64);
+    }
+
+    if (zeros) {
+      size_t i = w * 64 + __builtin_ctzll(zeros);
+      return i < to ? i : to;
+    }
+  }
+
+  return to;
+}
+
+static inline size_t result_vec_grow_cap(size_t cap, size_t want) {
+  size_t new_cap = cap ? cap : RESULT_VEC_BLOCK / 8;
+
+  while (new_cap < want) {
+    new_cap *= 2;
+  }
+
+  return new_cap;
+}
+
+static inline bool result_vec_grow_index(
+  uint64_t **is_ok,
+  size_t **err_rank,
+  size_t old_cap,
+  size_t new_cap
+) {
+  size_t old_words = result_bitmap_words(old_cap);
+  size_t new_words = result_bitmap_words(new_cap);
+  uint64_t *bitmap = realloc(*is_ok, new_words * sizeof(uint64_t));
+
+  if (!bitmap) {
+    return false;
+  }
+
+  memset(&bitmap[old_words], 0, (new_words - old_words) * sizeof(uint64_t));
+  *is_ok = bitmap;
+
+  size_t *rank = realloc(*err_rank, result_vec_blocks(new_cap) * sizeof(size_t));
+
+  if (!rank) {
+    return false;
+  }
+
+  *err_rank = rank;
+  return true;
+}
+
+// Position in the err column of element `i`, or of where it would go if it
+// were an err.
+static inline size_t result_vec_err_slot(
+  const uint64_t *is_ok,
+  const size_t *err_rank,
+  size_t i
+) {
+  size_t block_start = i - i % RESULT_VEC_BLOCK;
+  size_t ok_in_block = result_bitmap_count(is_ok, block_start, i);
+
+  return err_rank[i / RESULT_VEC_BLOCK] + (i - block_start) - ok_in_block;
+}
+
+// Adds `delta` to the err counts of the blocks after the one with element `i`.
+static inline void result_vec_shift_rank(
+  size_t *err_rank,
+  size_t len,
+  size_t i,
+  int delta
+) {
+  for (size_t b = i / RESULT_VEC_BLOCK + 1; b < result_vec_blocks(len); b++) {
+    err_rank[b] += delta;
+  }
+}
+
+#endif // __result_vec_h__
@@ -0,0 +1,302 @@
+#include "core/defs.h"
+#include "result_vec.h"
+
+/*sublime-c-static-fn-hoist-start*/
+static void test_starts_empty(void **ts);
+static void test_pushes_and_gets_ok_and_err(void **ts);
+static void test_accepts_any_result_layout(void **ts);
+static void test_set_turns_ok_into_err_and_back(void **ts);
+static void test_set_overwrites_in_place(void **ts);
+static void test_set_keeps_errs_in_later_blocks_reachable(void **ts);
+static void test_round_trips_through_arrays(void **ts);
+static void test_counts_ok_across_words(void **ts);
+static void test_counts_ok_in_range(void **ts);
+static void test_finds_first_err(void **ts);
+static void test_uses_less_memory_than_an_array(void **ts);
+/*sublime-c-static-fn-hoist-end*/
+
+typedef result_t(uint32_t, uint8_t) result_u32_t;
+typedef result_vec_t(uint32_t, uint8_t) result_vec_u32_t;
+
+#define assert_vec_ok(_vec, _index, _value) { \
+  result_u32_t res = result_init_err(0); \
+  result_vec_get(_vec, _index, res); \
+  assert_true(result_is_ok(res)); \
+  assert_int_equal((_value), result_unwrap_unchecked(res)); \
+}
+
+#define assert_vec_err(_vec, _index, _err) { \
+  result_u32_t res = result_init_ok(0); \
+  result_vec_get(_vec, _index, res); \
+  assert_true(result_is_err(res)); \
+  assert_int_equal((_err), result_unwrap_err_unchecked(res)); \
+}
+
+// Every seventh element is an err.
+static void push_pattern(result_vec_u32_t *vec, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    result_u32_t res = result_init_ok((uint32_t) i);
+
+    if (i % 7 == 3) {
+      result_set_err(res, (uint8_t) i);
+    }
+
+    assert_true(result_vec_push(*vec, res));
+  }
+}
+
+static void test_starts_empty(void **ts) {
+  result_vec_u32_t vec = { 0 };
+
+  assert_int_equal(0, vec.len);
+  assert_int_equal(0, result_vec_count_ok(vec));
+  assert_int_equal(0, result_vec_count_err(vec));
+  assert_int_equal(0, result_vec_first_err(vec));
+
+  result_vec_free(vec);
+}
+
+static void test_pushes_and_gets_ok_and_err(void **ts) {
+  result_vec_u32_t vec = { 0 };
+
+  assert_true(result_vec_push(vec, (result_u32_t) result_init_ok(111)));
+  assert_true(result_vec_push(vec, (result_u32_t) result_init_err(22)));
+  assert_true(result_vec_push(vec, (result_u32_t) result_init_ok(333)));
+
+  assert_int_equal(3, vec.len);
+  assert_vec_ok(vec, 0, 111);
+  assert_vec_err(vec, 1, 22);
+  assert_vec_ok(vec, 2, 333);
+
+  assert_true(result_vec_is_ok(vec, 0));
+  assert_false(result_vec_is_ok(vec, 1));
+
+  result_vec_free(vec);
+  assert_null(vec.ok);
+}
+
+static void test_accepts_any_result_layout(void **ts) {
+  result_vec_u32_t vec = { 0 };
+
+  result_padded_t(uint32_t, uint8_t) padded = result_init_ok(111);
+  result_packed_t(uint32_t, uint8_t) packed = result_init_err(22);
+
+  assert_true(result_vec_push(vec, padded));
+  assert_true(result_vec_push(vec, packed));
+
+  result_vec_get(vec, 0, packed);
+  result_vec_get(vec, 1, padded);
+
+  assert_true(result_is_ok(packed));
+  assert_int_equal(111, result_unwrap_unchecked(packed));
+  assert_true(result_is_err(padded));
+  assert_int_equal(22, result_unwrap_err_unchecked(padded));
+
+  result_vec_free(vec);
+}
+
+static void test_set_turns_ok_into_err_and_back(void **ts) {
+  result_vec_u32_t vec = { 0 };
+  push_pattern(&vec, 100);
+
+  assert_true(result_vec_set(vec, 50, (result_u32_t) result_init_err(5)));
+  assert_true(result_vec_set(vec, 0, (result_u32_t) result_init_err(6)));
+  assert_true(result_vec_set(vec, 99, (result_u32_t) result_init_err(7)));
+
+  assert_vec_err(vec, 0, 6);
+  assert_vec_err(vec, 3, 3);
+  assert_vec_err(vec, 50, 5);
+  assert_vec_err(vec, 52, 52);
+  assert_vec_err(vec, 99, 7);
+
+  assert_true(result_vec_set(vec, 50, (result_u32_t) result_init_ok(555)));
+  assert_true(result_vec_set(vec, 3, (result_u32_t) result_init_ok(333)));
+
+  assert_vec_ok(vec, 50, 555);
+  assert_vec_ok(vec, 3, 333);
+  assert_vec_err(vec, 0, 6);
+  assert_vec_err(vec, 10, 10);
+  assert_vec_err(vec, 99, 7);
+
+  result_vec_free(vec);
+}
+
+static void test_set_overwrites_in_place(void **ts) {
+  result_vec_u32_t vec = { 0 };
+  push_pattern(&vec, 20);
+
+  size_t errs = result_vec_count_err(vec);
+
+  assert_true(result_vec_set(vec, 3, (result_u32_t) result_init_err(33)));
+  assert_true(result_vec_set(vec, 4, (result_u32_t) result_init_ok(44)));
+
+  assert_vec_err(vec, 3, 33);
+  assert_vec_ok(vec, 4, 44);
+  assert_int_equal(errs, result_vec_count_err(vec));
+
+  result_vec_free(vec);
+}
+
+static void test_set_keeps_errs_in_later_blocks_reachable(void **ts) {
+  result_vec_u32_t vec = { 0 };
+  push_pattern(&vec, 3 * RESULT_VEC_BLOCK);
+
+  // an err in the last block
+  size_t late = 2 * RESULT_VEC_BLOCK;
+
+  while (late % 7 != 3) {
+    late++;
+  }
+
+  assert_true(result_vec_set(vec, 10, (result_u32_t) result_init_err(1)));
+  assert_true(result_vec_set(vec, 11, (result_u32_t) result_init_err(2)));
+  assert_vec_err(vec, late, (uint8_t) late);
+
+  assert_true(result_vec_set(vec, 10, (result_u32_t) result_init_ok(10)));
+  assert_true(result_vec_set(vec, 17, (result_u32_t) result_init_ok(17)));
+  assert_true(result_vec_set(vec, 24, (result_u32_t) result_init_ok(24)));
+  assert_vec_err(vec, late, (uint8_t) late);
+  assert_vec_err(vec, 11, 2);
+
+  for (size_t i = RESULT_VEC_BLOCK; i < 3 * RESULT_VEC_BLOCK; i++) {
+    if (i % 7 == 3) {
+      assert_vec_err(vec, i, (uint8_t) i);
+    }
+
+    else {
+      assert_vec_ok(vec, i, i);
+    }
+  }
+
+  result_vec_free(vec);
+}
+
+static void test_round_trips_through_arrays(void **ts) {
+  result_u32_t input[200];
+  result_u32_t output[200];
+
+  for (size_t i = 0; i < w_array_size(input); i++) {
+    result_u32_t res = result_init_ok((uint32_t) i * 3);
+
+    if (i % 5 == 0) {
+      result_set_err(res, (uint8_t) i);
+    }
+
+    input[i] = res;
+  }
+
+  result_vec_u32_t vec = { 0 };
+
+  assert_true(result_vec_push_array(vec, input, w_array_size(input)));
+  assert_int_equal(w_array_size(input), vec.len);
+  assert_int_equal(40, result_vec_count_err(vec));
+
+  result_vec_to_array(vec, output);
+
+  for (size_t i = 0; i < w_array_size(input); i++) {
+    assert_int_equal(result_is_ok(input[i]), result_is_ok(output[i]));
+
+    if (result_is_ok(input[i])) {
+      assert_int_equal(
+        result_unwrap_unchecked(input[i]),
+        result_unwrap_unchecked(output[i])
+      );
+    }
+
+    else {
+      assert_int_equal(
+        result_unwrap_err_unchecked(input[i]),
+        result_unwrap_err_unchecked(output[i])
+      );
+    }
+  }
+
+  result_vec_free(vec);
+}
+
+static void test_counts_ok_across_words(void **ts) {
+  result_vec_u32_t vec = { 0 };
+  push_pattern(&vec, 1000);
+
+  size_t expected_err = 0;
+
+  for (size_t i = 0; i < 1000; i++) {
+    expected_err += i % 7 == 3;
+  }
+
+  assert_int_equal(1000 - expected_err, result_vec_count_ok(vec));
+  assert_int_equal(expected_err, result_vec_count_err(vec));
+
+  result_vec_free(vec);
+}
+
+static void test_counts_ok_in_range(void **ts) {
+  result_vec_u32_t vec = { 0 };
+  push_pattern(&vec, 300);
+
+  for (size_t from = 0; from < 300; from += 37) {
+    for (size_t to = from; to <= 300; to += 29) {
+      size_t expected = 0;
+
+      for (size_t i = from; i < to; i++) {
+        expected += i % 7 != 3;
+      }
+
+      assert_int_equal(expected, result_vec_count_ok_range(vec, from, to));
+    }
+  }
+
+  result_vec_free(vec);
+}
+
+static void test_finds_first_err(void **ts) {
+  result_vec_u32_t vec = { 0 };
+
+  for (size_t i = 0; i < 200; i++) {
+    assert_true(result_vec_push(vec, (result_u32_t) result_init_ok(i)));
+  }
+
+  assert_int_equal(200, result_vec_first_err(vec));
+
+  assert_true(result_vec_set(vec, 130, (result_u32_t) result_init_err(1)));
+  assert_true(result_vec_set(vec, 150, (result_u32_t) result_init_err(1)));
+
+  assert_int_equal(130, result_vec_first_err(vec));
+  assert_int_equal(130, result_vec_first_err_from(vec, 130));
+  assert_int_equal(150, result_vec_first_err_from(vec, 131));
+  assert_int_equal(200, result_vec_first_err_from(vec, 151));
+
+  result_vec_free(vec);
+}
+
+static void test_uses_less_memory_than_an_array(void **ts) {
+  size_t len = 4096;
+
+  result_vec_u32_t vec = { 0 };
+  push_pattern(&vec, len);
+
+  // 4 bytes per ok value, a bit and a byte for 1 in 7 errs versus 8 bytes
+  assert_true(
+    result_vec_memory_usage(vec) * 3 / 2 < len * sizeof(result_u32_t)
+  );
+
+  result_vec_free(vec);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_starts_empty),
+    cmocka_unit_test(test_pushes_and_gets_ok_and_err),
+    cmocka_unit_test(test_accepts_any_result_layout),
+    cmocka_unit_test(test_set_turns_ok_into_err_and_back),
+    cmocka_unit_test(test_set_overwrites_in_place),
+    cmocka_unit_test(test_set_keeps_errs_in_later_blocks_reachable),
+    cmocka_unit_test(test_round_trips_through_arrays),
+    cmocka_unit_test(test_counts_ok_across_words),
+    cmocka_unit_test(test_counts_ok_in_range),
+    cmocka_unit_test(test_finds_first_err),
+    cmocka_unit_test(test_uses_less_memory_than_an_array),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}